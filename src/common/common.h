@@ -19,10 +19,25 @@
 
 /*****************************************************************************/
 
+#include <complex.h>
 #include <limits.h>
 
 /*****************************************************************************/
 
+/* Sample types of the DSP path, from SDR samples to soft symbols.
+ * Single precision (built with GLRPT_FLOAT_DSP) halves memory
+ * traffic of sample buffers and filters. Loop states (AGC, PLL,
+ * IIR filter memory) are kept in double precision either way */
+#ifdef GLRPT_FLOAT_DSP
+typedef float dsp_t;
+typedef complex float cdsp_t;
+#else
+typedef double dsp_t;
+typedef complex double cdsp_t;
+#endif
+
+/*****************************************************************************/
+
 /* Control flags */
 #define STATUS_RECEIVING        0x00000001 /* SDR receiver running or not     */
 #define STATUS_STREAMING        0x00000002 /* SDR receiver streaming or not   */
@@ -52,6 +67,7 @@
 #define IMAGE_SAVE_PPGM         0x01000000 /* Save channel image as PGM/PPM   */
 #define TUNER_GAIN_AUTO         0x02000000 /* Set tuner gain to auto mode     */
 #define AUTO_DETECT_SDR         0x04000000 /* Auto detect SDR device & driver */
+#define HEADLESS_MODE           0x08000000 /* Run without GTK user interface  */
 
 /* Number of APID image channels */
 #define CHANNEL_IMAGE_NUM   3
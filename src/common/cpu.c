@@ -0,0 +1,120 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+#include "cpu.h"
+
+#include "../glrpt/utils.h"
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <strings.h>
+
+/*****************************************************************************/
+
+static uint8_t Cpu_Detect(void);
+
+/*****************************************************************************/
+
+/* Names of SIMD levels, as given to -S or GLRPT_SIMD */
+static const char *simd_names[CPU_SIMD_MAX + 1] = {
+    "none", "sse2", "ssse3", "avx2", "avx512"
+};
+
+/* SIMD level kernels are bound to, none till Cpu_Init() */
+static uint8_t simd_level = CPU_SIMD_NONE;
+
+/*****************************************************************************/
+
+/* Cpu_Simd_Level()
+ *
+ * Gets the SIMD level by its name
+ */
+bool Cpu_Simd_Level(const char *name, uint8_t *level) {
+    for (uint8_t idx = 0; idx <= CPU_SIMD_MAX; idx++)
+        if (strcasecmp(name, simd_names[idx]) == 0) {
+            *level = idx;
+            return true;
+        }
+
+    return false;
+}
+
+/*****************************************************************************/
+
+/* Cpu_Simd_Name()
+ *
+ * Returns the name of a SIMD level
+ */
+const char *Cpu_Simd_Name(uint8_t level) {
+    return (level <= CPU_SIMD_MAX) ? simd_names[level] : "unknown";
+}
+
+/*****************************************************************************/
+
+/* Cpu_Detect()
+ *
+ * Returns the highest SIMD level the CPU and OS support
+ */
+static uint8_t Cpu_Detect(void) {
+#ifdef CPU_X86_DISPATCH
+    __builtin_cpu_init();
+
+    if (!__builtin_cpu_supports("sse2"))
+        return CPU_SIMD_NONE;
+    if (!__builtin_cpu_supports("ssse3"))
+        return CPU_SIMD_SSE2;
+    if (!__builtin_cpu_supports("avx2"))
+        return CPU_SIMD_SSSE3;
+    if (!__builtin_cpu_supports("avx512f") ||
+            !__builtin_cpu_supports("avx512bw"))
+        return CPU_SIMD_AVX2;
+
+    return CPU_SIMD_AVX512;
+#else
+    return CPU_SIMD_NONE;
+#endif
+}
+
+/*****************************************************************************/
+
+/* Cpu_Init()
+ *
+ * Detects SIMD support of the CPU, limited to max_level,
+ * for kernels to bind to. Must run before any DSP or
+ * decoder init, as those pick their kernels by Cpu_Simd()
+ */
+void Cpu_Init(uint8_t max_level) {
+    char mesg[MESG_SIZE];
+    uint8_t detected = Cpu_Detect();
+
+    simd_level = (detected < max_level) ? detected : max_level;
+
+    snprintf(mesg, sizeof(mesg), "SIMD Kernels: %s (CPU supports %s)",
+            Cpu_Simd_Name(simd_level), Cpu_Simd_Name(detected));
+    Show_Message(mesg, "green");
+}
+
+/*****************************************************************************/
+
+/* Cpu_Simd()
+ *
+ * Returns the SIMD level kernels should use
+ */
+uint8_t Cpu_Simd(void) {
+    return simd_level;
+}
@@ -0,0 +1,55 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+#ifndef COMMON_CPU_H
+#define COMMON_CPU_H
+
+/*****************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+
+/* SIMD instruction set levels, each including the ones before it */
+enum {
+    CPU_SIMD_NONE = 0,  /* Plain C kernels only */
+    CPU_SIMD_SSE2,
+    CPU_SIMD_SSSE3,
+    CPU_SIMD_AVX2,
+    CPU_SIMD_AVX512,
+    CPU_SIMD_MAX = CPU_SIMD_AVX512
+};
+
+/* Environment variable limiting the SIMD level, as the -S option */
+#define CPU_SIMD_ENV    "GLRPT_SIMD"
+
+/* With GCC or Clang on x86 kernels for every level are built
+ * with target attributes, and picked at runtime by CPU features */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_X86_DISPATCH
+#endif
+
+/*****************************************************************************/
+
+bool Cpu_Simd_Level(const char *name, uint8_t *level);
+const char *Cpu_Simd_Name(uint8_t level);
+void Cpu_Init(uint8_t max_level);
+uint8_t Cpu_Simd(void);
+
+/*****************************************************************************/
+
+#endif
@@ -124,11 +124,9 @@ filter_data_t filter_data_q;
 sem_t demod_semaphore;
 
 /* Meteor decoder variables */
-ac_table_rec_t *ac_table = NULL;
-size_t ac_table_len;
 mtd_rec_t mtd_record;
 
 /* Channel images and sizes */
 uint8_t *channel_image[CHANNEL_IMAGE_NUM];
-size_t   channel_image_size;
+size_t   channel_image_size, channel_image_capacity;
 uint32_t channel_image_width, channel_image_height;
@@ -127,13 +127,12 @@ extern filter_data_t filter_data_q;
 extern sem_t demod_semaphore;
 
 /* Meteor decoder variables */
-extern ac_table_rec_t *ac_table;
-extern size_t ac_table_len;
 extern mtd_rec_t mtd_record;
 
-/* Channel images and sizes */
+/* Channel images and sizes. The images are allocated
+ * channel_image_capacity bytes, channel_image_size in use */
 extern uint8_t *channel_image[CHANNEL_IMAGE_NUM];
-extern size_t   channel_image_size;
+extern size_t   channel_image_size, channel_image_capacity;
 extern uint32_t channel_image_width, channel_image_height;
 
 /*****************************************************************************/
@@ -20,6 +20,7 @@
 /*****************************************************************************/
 
 #include <stdint.h>
+#include <string.h>
 
 /*****************************************************************************/
 
@@ -31,6 +32,17 @@ typedef struct bit_io_rec_t {
     int cur_len;
 } bit_io_rec_t;
 
+/* Buffered bit reader: bits MSB first in a 64 bit buffer, the top cnt
+ * valid, refilled 8 bytes at a time from p. Bits past end read as 0 */
+typedef struct bit_reader_rec_t {
+    const uint8_t *p, *end;
+    uint64_t buf;
+    int cnt;
+} bit_reader_rec_t;
+
+/* Fewest bits in the buffer after a refill */
+#define BITOP_REFILL_MIN    56
+
 /*****************************************************************************/
 
 static inline void Bitop_AdvanceNBits(bit_io_rec_t *b, const int n) {
@@ -39,6 +51,98 @@ static inline void Bitop_AdvanceNBits(bit_io_rec_t *b, const int n) {
 
 /*****************************************************************************/
 
+/* Bitop_Load_BE64()
+ *
+ * Big endian 64 bit load from unaligned bytes
+ */
+static inline uint64_t Bitop_Load_BE64(const uint8_t *p) {
+    uint64_t w;
+
+    memcpy(&w, p, sizeof(w));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+
+    return w;
+}
+
+/*****************************************************************************/
+
+/* Bitop_ReaderInit()
+ *
+ * Starts reading len bytes at p
+ */
+static inline void Bitop_ReaderInit(
+        bit_reader_rec_t *r,
+        const uint8_t *p,
+        int len) {
+    r->p   = p;
+    r->end = p + len;
+    r->buf = 0;
+    r->cnt = 0;
+}
+
+/*****************************************************************************/
+
+/* Bitop_Refill()
+ *
+ * Tops the buffer up to at least BITOP_REFILL_MIN bits. With 8 bytes
+ * left it ORs in a whole load below the valid bits and steps past the
+ * bytes that fit, with no branches. Bits of a byte only partly taken
+ * stay in the buffer, and the next load ORs in the same ones again
+ */
+static inline void Bitop_Refill(bit_reader_rec_t *r) {
+    if (r->end - r->p >= 8) {
+        r->buf |= Bitop_Load_BE64(r->p) >> r->cnt;
+        r->p   += (63 - r->cnt) >> 3;
+        r->cnt |= BITOP_REFILL_MIN;
+        return;
+    }
+
+    /* Near the end, a byte at a time and zeros past it */
+    while (r->cnt <= BITOP_REFILL_MIN) {
+        if (r->p < r->end)
+            r->buf |= (uint64_t)(*r->p++) << (64 - 8 - r->cnt);
+        r->cnt += 8;
+    }
+}
+
+/*****************************************************************************/
+
+/* Bitop_Peek()
+ *
+ * Next n (0 to 32) bits, which must be in the buffer
+ */
+static inline uint32_t Bitop_Peek(const bit_reader_rec_t *r, const int n) {
+    return (uint32_t)((r->buf >> 32) >> (32 - n));
+}
+
+/*****************************************************************************/
+
+/* Bitop_Skip()
+ *
+ * Consumes n bits, which must be in the buffer
+ */
+static inline void Bitop_Skip(bit_reader_rec_t *r, const int n) {
+    r->buf <<= n;
+    r->cnt  -= n;
+}
+
+/*****************************************************************************/
+
+/* Bitop_Read()
+ *
+ * Fetches n (0 to 32) bits, which must be in the buffer
+ */
+static inline uint32_t Bitop_Read(bit_reader_rec_t *r, const int n) {
+    uint32_t result = Bitop_Peek(r, n);
+    Bitop_Skip(r, n);
+
+    return result;
+}
+
+/*****************************************************************************/
+
 void Bitop_WriterCreate(bit_io_rec_t *w, uint8_t *bytes, int len);
 void Bitop_WriteBitlistReversed(bit_io_rec_t *w, uint8_t *l, int len);
 int Bitop_CountBits(uint32_t n);
@@ -16,12 +16,16 @@
 
 #include "correlator.h"
 
+#include "../common/cpu.h"
+#include "../glrpt/utils.h"
+
+#include <stdbool.h>
 #include <stdint.h>
 #include <strings.h>
 
-/*****************************************************************************/
-
-#define CORR_LIMIT  55
+#ifdef CPU_X86_DISPATCH
+#include <immintrin.h>
+#endif
 
 /*****************************************************************************/
 
@@ -30,33 +34,51 @@ static uint64_t Rotate_IQ_QW(uint64_t data, int shift);
 static uint64_t Flip_IQ_QW(uint64_t data);
 static void Corr_Set_Patt(corr_rec_t *c, int n, uint64_t p);
 static void Corr_Reset(corr_rec_t *c);
+static uint32_t Corr_Pack_Signs(corr_rec_t *c, uint8_t *data, uint32_t len);
+static inline uint64_t Corr_Window(const corr_rec_t *c, uint32_t i);
+static inline bool Corr_Update(corr_rec_t *c, int n, int corr, uint32_t i);
+static int Corr_Best(const corr_rec_t *c);
+static int Corr_Search(corr_rec_t *c, uint8_t *data, uint32_t len);
+#ifdef CPU_X86_DISPATCH
+static inline __m256i Popcnt_Epi64_AVX2(__m256i x);
+static int Corr_Search_AVX2(corr_rec_t *c, uint8_t *data, uint32_t len);
+#endif
+static int Corr_Acquire_Best(corr_rec_t *c, uint32_t best, uint32_t best_i, int best_n);
+static int Corr_Acquire_Plain(corr_rec_t *c, uint8_t *data, uint32_t phase);
+#ifdef CPU_X86_DISPATCH
+static int Corr_Acquire_AVX2(corr_rec_t *c, uint8_t *data, uint32_t phase);
+#endif
 
 /*****************************************************************************/
 
 static uint8_t rotate_iq_tab[256];
 static uint8_t invert_iq_tab[256];
-static int corr_tab[256][256];
+
+/* Search and acquisition kernels, bound to CPU features by Correlator_Init() */
+static int (*corr_search)(corr_rec_t *c, uint8_t *data, uint32_t len) =
+    Corr_Search;
+static int (*corr_acquire)(corr_rec_t *c, uint8_t *data, uint32_t phase) =
+    Corr_Acquire_Plain;
 
 /*****************************************************************************/
 
+/* Hard_Correlate()
+ *
+ * Correlation between a soft sample d and a hard value w (0 or 255)
+ */
 int Hard_Correlate(const uint8_t d, const uint8_t w) {
-    return corr_tab[d][w];
+    return ((d > 127) && (w == 0)) || ((d <= 127) && (w == 255));
 }
 
 /*****************************************************************************/
 
 void Init_Correlator_Tables(void) {
-  int i, j;
+  int i;
 
   for( i = 0; i <= 255; i++ )
   {
     rotate_iq_tab[i] = (uint8_t)( (((i & 0x55) ^ 0x55) << 1) | ((i & 0xAA) >> 1) );
     invert_iq_tab[i] = (uint8_t)( ( (i & 0x55)         << 1) | ((i & 0xAA) >> 1) );
-
-    //Correlation between a soft sample i and a hard value j
-    for( j = 0; j <= 255; j++ )
-      corr_tab[i][j] =
-        (int)( ((i > 127) && (j == 0)) || ((i <= 127) && (j == 255)) );
   }
 }
 
@@ -109,6 +131,13 @@ static uint64_t Flip_IQ_QW(uint64_t data) {
 
 /*****************************************************************************/
 
+/* Fix_Packet()
+ *
+ * Undoes the rotation or I/Q flip of the symbols of a frame
+ * found by the correlator as the word of its sync pattern.
+ * Symbols rotated by 180 degrees need no fix, as the code
+ * is transparent to inversion, which Try_Frame() undoes
+ */
 void Fix_Packet(void *data, int len, int shift) {
   int j;
   int8_t *d;
@@ -117,6 +146,24 @@ void Fix_Packet(void *data, int len, int shift) {
   d = (int8_t *)data;
   switch( shift )
   {
+    case 1:
+      for( j = 0; j < len / 2; j++ )
+      {
+        b = d[j * 2 + 0];
+        d[j * 2 + 0] = d[j * 2 + 1];
+        d[j * 2 + 1] = -b;
+      }
+      break;
+
+    case 3:
+      for( j = 0; j < len / 2; j++ )
+      {
+        b = d[j * 2 + 0];
+        d[j * 2 + 0] = -d[j * 2 + 1];
+        d[j * 2 + 1] = b;
+      }
+      break;
+
     case 4:
       for( j = 0; j < len / 2; j++ )
       {
@@ -155,13 +202,11 @@ void Fix_Packet(void *data, int len, int shift) {
 static void Corr_Set_Patt(corr_rec_t *c, int n, uint64_t p) {
   int i;
 
+  /* Symbol i is bit i of pattern, and MSB down of p */
+  c->patts[n] = 0;
   for( i = 0; i < PATTERN_SIZE; i++ )
-  {
     if( ((p >> (PATTERN_SIZE - i - 1)) & 1) != 0 )
-      c->patts[i][n] = 0xFF;
-    else
-      c->patts[i][n] = 0;
-  }
+      c->patts[n] |= (uint64_t)1 << i;
 }
 
 /*****************************************************************************/
@@ -169,75 +214,373 @@ static void Corr_Set_Patt(corr_rec_t *c, int n, uint64_t p) {
 void Correlator_Init(corr_rec_t *c, uint64_t q) {
   int i;
 
-  bzero( c->correlation, PATTERN_CNT * 4 );
-  bzero( c->position,    PATTERN_CNT * 4 );
-  bzero( c->tmp_corr,    PATTERN_CNT * 4 );
+  Corr_Reset( c );
 
   for( i = 0; i <= 3; i++ )
     Corr_Set_Patt( c, i, Rotate_IQ_QW(q, i) );
 
   for( i = 0; i <= 3; i++ )
     Corr_Set_Patt( c, i + 4, Rotate_IQ_QW(Flip_IQ_QW(q), i) );
+
+  Corr_Acquire_Reset( c );
+
+  /* Pick the search for the CPU */
+  corr_search  = Corr_Search;
+  corr_acquire = Corr_Acquire_Plain;
+#ifdef CPU_X86_DISPATCH
+  if( Cpu_Simd() >= CPU_SIMD_AVX2 )
+  {
+    corr_search  = Corr_Search_AVX2;
+    corr_acquire = Corr_Acquire_AVX2;
+  }
+#endif
+}
+
+/*****************************************************************************/
+
+/* Corr_Acquire_Reset()
+ *
+ * Forgets the correlations acquired over past frames, once sync
+ * is found or when their phases don't match those of the symbols
+ * after a gap, and frees their table till acquisition restarts
+ */
+void Corr_Acquire_Reset(corr_rec_t *c) {
+  free_ptr( (void **)&(c->acq) );
+  c->acq_weight = 0.0;
+  c->acq_frames = 0;
 }
 
 /*****************************************************************************/
 
 static void Corr_Reset(corr_rec_t *c) {
-  bzero( c->correlation, PATTERN_CNT * 4 );
-  bzero( c->position,    PATTERN_CNT * 4 );
-  bzero( c->tmp_corr,    PATTERN_CNT * 4 );
+  bzero( c->correlation, sizeof(c->correlation) );
+  bzero( c->position,    sizeof(c->position) );
 }
 
 /*****************************************************************************/
 
-int Corr_Correlate(corr_rec_t *c, uint8_t *data, uint32_t len) {
-  int i, n, k;
-  int *d;
-  uint8_t *p;
+/* Corr_Pack_Signs()
+ *
+ * Packs the sign bits of len soft symbols (at most CORR_MAX_LEN)
+ * as patterns are, and resets correlations. Returns the length
+ */
+static uint32_t Corr_Pack_Signs(corr_rec_t *c, uint8_t *data, uint32_t len) {
+  uint32_t i, words;
 
-  int result = -1;
   Corr_Reset( c );
 
-  for( i = 0; (uint32_t)i < (len - PATTERN_SIZE); i++ )
+  if( len > CORR_MAX_LEN )
+    len = CORR_MAX_LEN;
+
+  words = (len + PATTERN_SIZE - 1) / PATTERN_SIZE;
+  bzero( c->signs, sizeof(uint64_t) * (words + 1) );
+  for( i = 0; i < len; i++ )
+    c->signs[i / PATTERN_SIZE] |= (uint64_t)(data[i] >> 7) << (i % PATTERN_SIZE);
+
+  return( len );
+}
+
+/*****************************************************************************/
+
+/* Corr_Window()
+ *
+ * Returns sign bits of symbols i to i + 63. A symbol correlates
+ * with a pattern bit if its sign bit differs, so correlation is
+ * the popcount of their XOR
+ */
+static inline uint64_t Corr_Window(const corr_rec_t *c, uint32_t i) {
+  uint32_t j = i / PATTERN_SIZE;
+  uint32_t s = i % PATTERN_SIZE;
+
+  /* No bits of the next word when i is word aligned */
+  return( (c->signs[j] >> s) | ((c->signs[j + 1] << 1) << (63 - s)) );
+}
+
+/*****************************************************************************/
+
+/* Corr_Update()
+ *
+ * Keeps a better correlation of pattern n at offset i.
+ * Returns true if it is good enough to stop searching
+ */
+static inline bool Corr_Update(corr_rec_t *c, int n, int corr, uint32_t i) {
+  if( corr > c->correlation[n] )
   {
-    for( n = 0; n < PATTERN_CNT; n++ )
-      c->tmp_corr[n] = 0;
-    for( k = 0; k < PATTERN_SIZE; k++ )
+    c->correlation[n] = corr;
+    c->position[n] = (int)i;
+    if( corr > CORR_LIMIT )
+      return( true );
+  }
+
+  return( false );
+}
+
+/*****************************************************************************/
+
+/* Corr_Best()
+ *
+ * Returns the pattern correlating best, -1 if none does
+ */
+static int Corr_Best(const corr_rec_t *c) {
+  int n, k = 0, result = -1;
+
+  for( n = 0; n < PATTERN_CNT; n++ )
+    if( c->correlation[n] > k )
     {
-      d = &(corr_tab[ data[i + k] ] [0]);
-      p = &(c->patts[k][0]);
-      //Unrolled to pattern_cnt times
-      c->tmp_corr[0] += d[p[0]];
-      c->tmp_corr[1] += d[p[1]];
-      c->tmp_corr[2] += d[p[2]];
-      c->tmp_corr[3] += d[p[3]];
-      c->tmp_corr[4] += d[p[4]];
-      c->tmp_corr[5] += d[p[5]];
-      c->tmp_corr[6] += d[p[6]];
-      c->tmp_corr[7] += d[p[7]];
+      result = n;
+      k = c->correlation[n];
     }
 
+  return( result );
+}
+
+/*****************************************************************************/
+
+/* Corr_Search()
+ *
+ * Slides the patterns over the sign bits of soft symbols,
+ * a popcount per offset and pattern
+ */
+static int Corr_Search(corr_rec_t *c, uint8_t *data, uint32_t len) {
+  uint32_t i;
+  uint64_t window;
+  int n;
+
+  len = Corr_Pack_Signs( c, data, len );
+
+  for( i = 0; i < (len - PATTERN_SIZE); i++ )
+  {
+    window = Corr_Window( c, i );
+    for( n = 0; n < PATTERN_CNT; n++ )
+      if( Corr_Update(c, n, __builtin_popcountll(window ^ c->patts[n]), i) )
+        return( n );
+  }
+
+  return( Corr_Best(c) );
+}
+
+/*****************************************************************************/
+
+#ifdef CPU_X86_DISPATCH
+/* Popcnt_Epi64_AVX2()
+ *
+ * Popcounts of the 64 bit lanes of x, by nibbles summed with SAD
+ */
+__attribute__((target("avx2")))
+static inline __m256i Popcnt_Epi64_AVX2(__m256i x) {
+  const __m256i nibble_bits = _mm256_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 );
+  const __m256i low_nibble = _mm256_set1_epi8( 0x0F );
+
+  return( _mm256_sad_epu8( _mm256_add_epi8(
+          _mm256_shuffle_epi8( nibble_bits, _mm256_and_si256(x, low_nibble) ),
+          _mm256_shuffle_epi8( nibble_bits,
+            _mm256_and_si256(_mm256_srli_epi16(x, 4), low_nibble) )),
+        _mm256_setzero_si256() ) );
+}
+#endif
+
+/*****************************************************************************/
+
+#ifdef CPU_X86_DISPATCH
+/* Corr_Search_AVX2()
+ *
+ * Corr_Search() with the popcounts of 4 patterns at a time,
+ * by nibble lookup. Correlations are only stored when one
+ * of them is better than the best so far, which is rare
+ */
+__attribute__((target("avx2")))
+static int Corr_Search_AVX2(corr_rec_t *c, uint8_t *data, uint32_t len) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i patt_lo, patt_hi, best_lo, best_hi, corr_lo, corr_hi;
+  int64_t corr[PATTERN_CNT];
+  uint32_t i;
+  int n;
+
+  len = Corr_Pack_Signs( c, data, len );
+
+  patt_lo = _mm256_loadu_si256( (const __m256i *)&c->patts[0] );
+  patt_hi = _mm256_loadu_si256( (const __m256i *)&c->patts[4] );
+  best_lo = zero;
+  best_hi = zero;
+
+  for( i = 0; i < (len - PATTERN_SIZE); i++ )
+  {
+    __m256i window = _mm256_set1_epi64x( (int64_t)Corr_Window(c, i) );
+
+    corr_lo = Popcnt_Epi64_AVX2( _mm256_xor_si256(window, patt_lo) );
+    corr_hi = Popcnt_Epi64_AVX2( _mm256_xor_si256(window, patt_hi) );
+
+    if( _mm256_testz_si256(
+          _mm256_or_si256( _mm256_cmpgt_epi64(corr_lo, best_lo),
+            _mm256_cmpgt_epi64(corr_hi, best_hi) ),
+          _mm256_set1_epi8(-1) ) )
+      continue;
+
+    /* Some pattern correlates better, update in pattern order */
+    _mm256_storeu_si256( (__m256i *)&corr[0], corr_lo );
+    _mm256_storeu_si256( (__m256i *)&corr[4], corr_hi );
     for( n = 0; n < PATTERN_CNT; n++ )
-      if( c->tmp_corr[n] > c->correlation[n] )
+      if( Corr_Update(c, n, (int)corr[n], i) )
+        return( n );
+
+    best_lo = _mm256_max_epi32( best_lo, corr_lo );
+    best_hi = _mm256_max_epi32( best_hi, corr_hi );
+  }
+
+  return( Corr_Best(c) );
+}
+#endif
+
+/*****************************************************************************/
+
+/* Corr_Correlate()
+ *
+ * Finds the best correlation of each of the sync patterns over len
+ * soft symbols (at most CORR_MAX_LEN), stopping at one good enough.
+ * Returns the pattern correlating best, -1 if none does
+ */
+int Corr_Correlate(corr_rec_t *c, uint8_t *data, uint32_t len) {
+  return( corr_search(c, data, len) );
+}
+
+/*****************************************************************************/
+
+/* Corr_Acquire_Best()
+ *
+ * Sets the best acquisition sum as the correlation of its pattern,
+ * averaged over frames, at its offset, and returns the pattern.
+ * Returns -1 till enough frames are folded, as the best of
+ * one frame is no better than Corr_Correlate()
+ */
+static int Corr_Acquire_Best(corr_rec_t *c, uint32_t best, uint32_t best_i, int best_n) {
+  c->acq_weight = c->acq_weight * (1.0 - 1.0 / (1 << CORR_ACQ_SHIFT)) + 1.0;
+  if( ++c->acq_frames < CORR_ACQ_FRAMES )
+    return( -1 );
+
+  if( best_n >= 0 )
+  {
+    c->position[best_n]    = (int)best_i;
+    c->correlation[best_n] = (int)( (double)best / c->acq_weight );
+  }
+
+  return( best_n );
+}
+
+/*****************************************************************************/
+
+/* Corr_Acquire_Plain()
+ *
+ * Folds correlations of the patterns at a frame of offsets into the
+ * acquisition sums of their phase in the frame period, and finds
+ * the best sum. Data must hold CORR_MAX_LEN symbols
+ */
+static int Corr_Acquire_Plain(corr_rec_t *c, uint8_t *data, uint32_t phase) {
+  uint32_t i, best = 0, best_i = 0;
+  uint64_t window;
+  uint16_t *acc;
+  int n, best_n = -1;
+
+  Corr_Pack_Signs( c, data, CORR_MAX_LEN );
+
+  for( i = 0; i < CORR_FRAME_LEN; i++ )
+  {
+    window = Corr_Window( c, i );
+    acc = c->acq[phase];
+    for( n = 0; n < PATTERN_CNT; n++ )
+    {
+      acc[n] = (uint16_t)( acc[n] - (acc[n] >> CORR_ACQ_SHIFT) +
+          __builtin_popcountll(window ^ c->patts[n]) );
+      if( acc[n] > best )
       {
-        c->correlation[n] = c->tmp_corr[n];
-        c->position[n] = i;
-        c->tmp_corr[n] = 0;
-        if( c->correlation[n] > CORR_LIMIT )
-        {
-          result = n;
-          return( result );
-        }
+        best   = acc[n];
+        best_i = i;
+        best_n = n;
       }
+    }
+
+    if( ++phase == CORR_FRAME_LEN )
+      phase = 0;
   }
 
-  k = 0;
-  for( i = 0; i < PATTERN_CNT; i++ )
-    if( c->correlation[i] > k )
+  return( Corr_Acquire_Best(c, best, best_i, best_n) );
+}
+
+/*****************************************************************************/
+
+#ifdef CPU_X86_DISPATCH
+/* Corr_Acquire_AVX2()
+ *
+ * Corr_Acquire_Plain() with the sums of a phase in a vector,
+ * their best found by MINPOS of the complement
+ */
+__attribute__((target("avx2")))
+static int Corr_Acquire_AVX2(corr_rec_t *c, uint8_t *data, uint32_t phase) {
+  const __m256i order = _mm256_setr_epi32( 0, 2, 4, 6, 1, 3, 5, 7 );
+  __m256i patt_lo, patt_hi, window, corr;
+  __m128i acc, cnt, pos;
+  uint32_t i, best = 0, best_i = 0, sum;
+  int best_n = -1;
+
+  Corr_Pack_Signs( c, data, CORR_MAX_LEN );
+
+  patt_lo = _mm256_loadu_si256( (const __m256i *)&c->patts[0] );
+  patt_hi = _mm256_loadu_si256( (const __m256i *)&c->patts[4] );
+
+  for( i = 0; i < CORR_FRAME_LEN; i++ )
+  {
+    window = _mm256_set1_epi64x( (int64_t)Corr_Window(c, i) );
+
+    /* Counts of patterns 0-3 in low and 4-7 in high 32 bits
+     * of 64 bit lanes, in pattern order, narrowed to 16 bits */
+    corr = _mm256_or_si256(
+        Popcnt_Epi64_AVX2( _mm256_xor_si256(window, patt_lo) ),
+        _mm256_slli_epi64(
+          Popcnt_Epi64_AVX2(_mm256_xor_si256(window, patt_hi)), 32) );
+    corr = _mm256_permutevar8x32_epi32( corr, order );
+    cnt  = _mm256_castsi256_si128( _mm256_permute4x64_epi64(
+          _mm256_packus_epi32(corr, corr), 0x08) );
+
+    acc = _mm_loadu_si128( (const __m128i *)c->acq[phase] );
+    acc = _mm_add_epi16( _mm_sub_epi16(acc,
+          _mm_srli_epi16(acc, CORR_ACQ_SHIFT)), cnt );
+    _mm_storeu_si128( (__m128i *)c->acq[phase], acc );
+
+    /* Lowest complement is the best sum, first pattern on ties */
+    pos = _mm_minpos_epu16( _mm_xor_si128(acc, _mm_set1_epi16(-1)) );
+    sum = 0xFFFF ^ (uint32_t)_mm_extract_epi16( pos, 0 );
+    if( sum > best )
     {
-      result = i;
-      k = c->correlation[i];
+      best   = sum;
+      best_i = i;
+      best_n = _mm_extract_epi16( pos, 1 );
     }
 
-  return( result );
+    if( ++phase == CORR_FRAME_LEN )
+      phase = 0;
+  }
+
+  return( Corr_Acquire_Best(c, best, best_i, best_n) );
+}
+#endif
+
+/*****************************************************************************/
+
+/* Corr_Acquire()
+ *
+ * Acquires sync when no frame has a sure one: sync patterns recur
+ * every frame at the same phase, so correlations of each phase are
+ * averaged over frames, which lifts a weak pattern above the best
+ * random ones. data is at phase of the frame period and must hold
+ * CORR_MAX_LEN symbols. Returns the pattern with the best average,
+ * with its offset in data and average correlation as Corr_Correlate(),
+ * -1 if none yet
+ */
+int Corr_Acquire(corr_rec_t *c, uint8_t *data, uint32_t phase) {
+  if( c->acq == NULL )
+    mem_alloc( (void **)&(c->acq),
+        CORR_FRAME_LEN * PATTERN_CNT * sizeof(uint16_t) );
+
+  return( corr_acquire(c, data, phase % CORR_FRAME_LEN) );
 }
@@ -26,16 +26,43 @@
 #define PATTERN_SIZE    64
 #define PATTERN_CNT     8
 
+/* Correlation above which a sync pattern is taken for sure */
+#define CORR_LIMIT      55
+
+/* Soft symbols from a sync pattern to the next, SOFT_FRAME_LEN */
+#define CORR_FRAME_LEN  16384
+
+/* Longest data to correlate: a frame of offsets
+ * and the symbols of a pattern at the last one */
+#define CORR_MAX_LEN    (CORR_FRAME_LEN + PATTERN_SIZE)
+
+/* Weight of past frames in acquisition, 1 - 1/2^shift,
+ * and frames to fold before its best is trusted */
+#define CORR_ACQ_SHIFT  2
+#define CORR_ACQ_FRAMES 2
+
 /*****************************************************************************/
 
 /* Decoder correlator data */
 typedef struct corr_rec_t {
-    uint8_t patts[PATTERN_SIZE][PATTERN_SIZE];
+    /* Sync patterns as bits, a bit per symbol from the LSB up */
+    uint64_t patts[PATTERN_CNT];
+
+    /* Sign bits of the soft symbols being correlated, packed
+     * as patterns with a spare zero word for the last offsets */
+    uint64_t signs[CORR_MAX_LEN / PATTERN_SIZE + 1];
 
     int
         correlation[PATTERN_CNT],
-        tmp_corr[PATTERN_CNT],
         position[PATTERN_CNT];
+
+    /* Acquisition: correlation of the patterns at each symbol of
+     * the frame period, decaying over frames, allocated only while
+     * acquiring, the sum of the weights of frames to average by
+     * and frames folded */
+    uint16_t (*acq)[PATTERN_CNT];
+    double acq_weight;
+    uint32_t acq_frames;
 } corr_rec_t;
 
 /*****************************************************************************/
@@ -45,6 +72,8 @@ void Init_Correlator_Tables(void);
 void Fix_Packet(void *data, int len, int shift);
 void Correlator_Init(corr_rec_t *c, uint64_t q);
 int Corr_Correlate(corr_rec_t *c, uint8_t *data, uint32_t len);
+int Corr_Acquire(corr_rec_t *c, uint8_t *data, uint32_t phase);
+void Corr_Acquire_Reset(corr_rec_t *c);
 
 /*****************************************************************************/
 
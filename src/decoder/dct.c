@@ -16,67 +16,350 @@
 
 #include "dct.h"
 
-#include <math.h>
-#include <stdbool.h>
+#include "../common/cpu.h"
+
 #include <stdint.h>
 
+#ifdef CPU_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
 /*****************************************************************************/
 
-static void Init_Cos(void);
+/* Fixed point of the Loeffler-Ligtenberg-Moschytz IDCT, as the
+ * "islow" IDCT of the IJG JPEG library: constants have CONST_BITS
+ * fraction bits, and the column pass output keeps PASS1_BITS more.
+ * Row pass output is descaled by 3 more bits, the 1/8 of the IDCT */
+#define CONST_BITS  13
+#define PASS1_BITS  2
+#define PASS1_SHIFT (CONST_BITS - PASS1_BITS)
+#define PASS2_SHIFT (CONST_BITS + PASS1_BITS + 3)
+
+/* Level shift of the output samples */
+#define IDCT_CENTER 128
+
+#define FIX_0_298631336     2446
+#define FIX_0_390180644     3196
+#define FIX_0_541196100     4433
+#define FIX_0_765366865     6270
+#define FIX_0_899976223     7373
+#define FIX_1_175875602     9633
+#define FIX_1_501321110     12299
+#define FIX_1_847759065     15137
+#define FIX_1_961570560     16069
+#define FIX_2_053119869     16819
+#define FIX_2_562915447     20995
+#define FIX_3_072711026     25172
 
 /*****************************************************************************/
 
-static double cosine[8][8];
-static double alpha[8];
+static void Idct_1D(int32_t *v, int stride, int32_t bias, int shift);
+static void Idct_Blocks_Plain(
+        const int16_t *coef,
+        const int16_t *dqt,
+        int n,
+        uint8_t *pix,
+        int stride);
+#ifdef CPU_X86_DISPATCH
+static inline void Idct_1D_AVX2(__m256i *v, __m256i bias, int shift);
+static inline void Transpose_8x8_AVX2(__m256i *v);
+static void Idct_Blocks_AVX2(
+        const int16_t *coef,
+        const int16_t *dqt,
+        int n,
+        uint8_t *pix,
+        int stride);
+#endif
 
 /*****************************************************************************/
 
-static void Init_Cos(void) {
-    static bool cos_inited = false;
+/* IDCT kernel, bound to CPU features by Idct_Init() */
+static void (*idct_blocks)(
+        const int16_t *coef,
+        const int16_t *dqt,
+        int n,
+        uint8_t *pix,
+        int stride) = Idct_Blocks_Plain;
+
+/*****************************************************************************/
+
+/* Idct_1D()
+ *
+ * One dimensional 8 point IDCT of v[0], v[stride] ... v[7 * stride]
+ * in place, outputs descaled by shift bits after adding bias
+ */
+static void Idct_1D(int32_t *v, int stride, int32_t bias, int shift) {
+    int32_t tmp0, tmp1, tmp2, tmp3, tmp10, tmp11, tmp12, tmp13;
+    int32_t z1, z2, z3, z4, z5;
 
-    if (cos_inited)
-        return;
+    /* Even part */
+    z2 = v[2 * stride];
+    z3 = v[6 * stride];
+    z1 = (z2 + z3) * FIX_0_541196100;
+    tmp2 = z1 - z3 * FIX_1_847759065;
+    tmp3 = z1 + z2 * FIX_0_765366865;
 
-    cos_inited = true;
+    tmp0 = (v[0] + v[4 * stride]) * (1 << CONST_BITS);
+    tmp1 = (v[0] - v[4 * stride]) * (1 << CONST_BITS);
 
-    for (uint8_t y = 0; y < 8; y++)
-        for (uint8_t x = 0; x < 8; x++)
-            cosine[y][x] = cos(M_PI / 16.0 * (2.0 * (double)y + 1.0) * (double)x);
+    tmp10 = tmp0 + tmp3 + bias;
+    tmp13 = tmp0 - tmp3 + bias;
+    tmp11 = tmp1 + tmp2 + bias;
+    tmp12 = tmp1 - tmp2 + bias;
 
-    alpha[0] = 1.0 / sqrt(2.0);
+    /* Odd part */
+    tmp0 = v[7 * stride];
+    tmp1 = v[5 * stride];
+    tmp2 = v[3 * stride];
+    tmp3 = v[1 * stride];
 
-    for (uint8_t x = 1; x < 8; x++)
-        alpha[x] = 1.0;
+    z1 = tmp0 + tmp3;
+    z2 = tmp1 + tmp2;
+    z3 = tmp0 + tmp2;
+    z4 = tmp1 + tmp3;
+    z5 = (z3 + z4) * FIX_1_175875602;
+
+    tmp0 *= FIX_0_298631336;
+    tmp1 *= FIX_2_053119869;
+    tmp2 *= FIX_3_072711026;
+    tmp3 *= FIX_1_501321110;
+    z1 *= -FIX_0_899976223;
+    z2 *= -FIX_2_562915447;
+    z3 = z3 * -FIX_1_961570560 + z5;
+    z4 = z4 * -FIX_0_390180644 + z5;
+
+    tmp0 += z1 + z3;
+    tmp1 += z2 + z4;
+    tmp2 += z2 + z3;
+    tmp3 += z1 + z4;
+
+    v[0 * stride] = (tmp10 + tmp3) >> shift;
+    v[7 * stride] = (tmp10 - tmp3) >> shift;
+    v[1 * stride] = (tmp11 + tmp2) >> shift;
+    v[6 * stride] = (tmp11 - tmp2) >> shift;
+    v[2 * stride] = (tmp12 + tmp1) >> shift;
+    v[5 * stride] = (tmp12 - tmp1) >> shift;
+    v[3 * stride] = (tmp13 + tmp0) >> shift;
+    v[4 * stride] = (tmp13 - tmp0) >> shift;
 }
 
 /*****************************************************************************/
 
-void Flt_Idct_8x8(double *res, const double *inpt) {
-    Init_Cos();
-
-    for (uint8_t y = 0; y < 8; y++)
-        for (uint8_t x = 0; x < 8; x++) {
-            double s = 0;
-
-            /* for u = 0 to 7 do for v = 0 to 7 do
-             *s = s+inp[v*8+u]*alpha[u]*alpha[v]*cosine[x][u]*cosine[y][v];
-             */
-
-            for (uint8_t u = 0; u < 8; u++) {
-                double cxu = alpha[u] * cosine[x][u];
-
-                /* Unrolled to 8 */
-                s += cxu * (
-                        inpt[0 * 8 + u] * alpha[0] * cosine[y][0] +
-                        inpt[1 * 8 + u] * alpha[1] * cosine[y][1] +
-                        inpt[2 * 8 + u] * alpha[2] * cosine[y][2] +
-                        inpt[3 * 8 + u] * alpha[3] * cosine[y][3] +
-                        inpt[4 * 8 + u] * alpha[4] * cosine[y][4] +
-                        inpt[5 * 8 + u] * alpha[5] * cosine[y][5] +
-                        inpt[6 * 8 + u] * alpha[6] * cosine[y][6] +
-                        inpt[7 * 8 + u] * alpha[7] * cosine[y][7]);
+/* Idct_Blocks_Plain()
+ *
+ * Dequantizes and clamps each block, then columns and rows
+ * through Idct_1D(), level shifted and clamped
+ */
+static void Idct_Blocks_Plain(
+        const int16_t *coef,
+        const int16_t *dqt,
+        int n,
+        uint8_t *pix,
+        int stride) {
+    int32_t ws[64];
+
+    for (int b = 0; b < n; b++, coef += 64, pix += 8) {
+        for (int i = 0; i < 64; i++) {
+            int32_t c = coef[i] * dqt[i];
+            ws[i] = c < -IDCT_COEF_MAX ? -IDCT_COEF_MAX :
+                (c > IDCT_COEF_MAX ? IDCT_COEF_MAX : c);
+        }
+
+        for (int x = 0; x < 8; x++)
+            Idct_1D(&ws[x], 8, 1 << (PASS1_SHIFT - 1), PASS1_SHIFT);
+
+        for (int y = 0; y < 8; y++) {
+            Idct_1D(&ws[y * 8], 1,
+                    (IDCT_CENTER << PASS2_SHIFT) + (1 << (PASS2_SHIFT - 1)),
+                    PASS2_SHIFT);
+
+            for (int x = 0; x < 8; x++) {
+                int32_t t = ws[y * 8 + x];
+                pix[y * stride + x] =
+                    (uint8_t)(t < 0 ? 0 : (t > 255 ? 255 : t));
             }
+        }
+    }
+}
+
+/*****************************************************************************/
+
+#ifdef CPU_X86_DISPATCH
+/* Idct_1D_AVX2()
+ *
+ * Idct_1D() of v[0] ... v[7] on 8 lanes, the same integer arithmetic
+ */
+__attribute__((target("avx2")))
+static inline void Idct_1D_AVX2(__m256i *v, __m256i bias, int shift) {
+    __m256i tmp0, tmp1, tmp2, tmp3, tmp10, tmp11, tmp12, tmp13;
+    __m256i z1, z2, z3, z4, z5;
+
+    /* Even part */
+    z1 = _mm256_mullo_epi32(_mm256_add_epi32(v[2], v[6]),
+            _mm256_set1_epi32(FIX_0_541196100));
+    tmp2 = _mm256_sub_epi32(z1,
+            _mm256_mullo_epi32(v[6], _mm256_set1_epi32(FIX_1_847759065)));
+    tmp3 = _mm256_add_epi32(z1,
+            _mm256_mullo_epi32(v[2], _mm256_set1_epi32(FIX_0_765366865)));
+
+    tmp0 = _mm256_slli_epi32(_mm256_add_epi32(v[0], v[4]), CONST_BITS);
+    tmp1 = _mm256_slli_epi32(_mm256_sub_epi32(v[0], v[4]), CONST_BITS);
+
+    tmp10 = _mm256_add_epi32(_mm256_add_epi32(tmp0, tmp3), bias);
+    tmp13 = _mm256_add_epi32(_mm256_sub_epi32(tmp0, tmp3), bias);
+    tmp11 = _mm256_add_epi32(_mm256_add_epi32(tmp1, tmp2), bias);
+    tmp12 = _mm256_add_epi32(_mm256_sub_epi32(tmp1, tmp2), bias);
 
-            res[y * 8 + x] = s / 4.0;
+    /* Odd part */
+    z1 = _mm256_add_epi32(v[7], v[1]);
+    z2 = _mm256_add_epi32(v[5], v[3]);
+    z3 = _mm256_add_epi32(v[7], v[3]);
+    z4 = _mm256_add_epi32(v[5], v[1]);
+    z5 = _mm256_mullo_epi32(_mm256_add_epi32(z3, z4),
+            _mm256_set1_epi32(FIX_1_175875602));
+
+    tmp0 = _mm256_mullo_epi32(v[7], _mm256_set1_epi32(FIX_0_298631336));
+    tmp1 = _mm256_mullo_epi32(v[5], _mm256_set1_epi32(FIX_2_053119869));
+    tmp2 = _mm256_mullo_epi32(v[3], _mm256_set1_epi32(FIX_3_072711026));
+    tmp3 = _mm256_mullo_epi32(v[1], _mm256_set1_epi32(FIX_1_501321110));
+    z1 = _mm256_mullo_epi32(z1, _mm256_set1_epi32(-FIX_0_899976223));
+    z2 = _mm256_mullo_epi32(z2, _mm256_set1_epi32(-FIX_2_562915447));
+    z3 = _mm256_add_epi32(
+            _mm256_mullo_epi32(z3, _mm256_set1_epi32(-FIX_1_961570560)), z5);
+    z4 = _mm256_add_epi32(
+            _mm256_mullo_epi32(z4, _mm256_set1_epi32(-FIX_0_390180644)), z5);
+
+    tmp0 = _mm256_add_epi32(tmp0, _mm256_add_epi32(z1, z3));
+    tmp1 = _mm256_add_epi32(tmp1, _mm256_add_epi32(z2, z4));
+    tmp2 = _mm256_add_epi32(tmp2, _mm256_add_epi32(z2, z3));
+    tmp3 = _mm256_add_epi32(tmp3, _mm256_add_epi32(z1, z4));
+
+    v[0] = _mm256_srai_epi32(_mm256_add_epi32(tmp10, tmp3), shift);
+    v[7] = _mm256_srai_epi32(_mm256_sub_epi32(tmp10, tmp3), shift);
+    v[1] = _mm256_srai_epi32(_mm256_add_epi32(tmp11, tmp2), shift);
+    v[6] = _mm256_srai_epi32(_mm256_sub_epi32(tmp11, tmp2), shift);
+    v[2] = _mm256_srai_epi32(_mm256_add_epi32(tmp12, tmp1), shift);
+    v[5] = _mm256_srai_epi32(_mm256_sub_epi32(tmp12, tmp1), shift);
+    v[3] = _mm256_srai_epi32(_mm256_add_epi32(tmp13, tmp0), shift);
+    v[4] = _mm256_srai_epi32(_mm256_sub_epi32(tmp13, tmp0), shift);
+}
+
+/*****************************************************************************/
+
+/* Transpose_8x8_AVX2()
+ *
+ * Transposes 8 rows of 8 32 bit elements in place
+ */
+__attribute__((target("avx2")))
+static inline void Transpose_8x8_AVX2(__m256i *v) {
+    __m256i a[8], b[8];
+
+    for (int i = 0; i < 8; i += 2) {
+        a[i]     = _mm256_unpacklo_epi32(v[i], v[i + 1]);
+        a[i + 1] = _mm256_unpackhi_epi32(v[i], v[i + 1]);
+    }
+
+    for (int i = 0; i < 8; i += 4) {
+        b[i]     = _mm256_unpacklo_epi64(a[i],     a[i + 2]);
+        b[i + 1] = _mm256_unpackhi_epi64(a[i],     a[i + 2]);
+        b[i + 2] = _mm256_unpacklo_epi64(a[i + 1], a[i + 3]);
+        b[i + 3] = _mm256_unpackhi_epi64(a[i + 1], a[i + 3]);
+    }
+
+    for (int i = 0; i < 4; i++) {
+        v[i]     = _mm256_permute2x128_si256(b[i], b[i + 4], 0x20);
+        v[i + 4] = _mm256_permute2x128_si256(b[i], b[i + 4], 0x31);
+    }
+}
+
+/*****************************************************************************/
+
+/* Idct_Blocks_AVX2()
+ *
+ * Idct_Blocks_Plain() with the 8 columns, then the 8 rows, in lanes.
+ * Outputs are clamped by the saturating packs
+ */
+__attribute__((target("avx2")))
+static void Idct_Blocks_AVX2(
+        const int16_t *coef,
+        const int16_t *dqt,
+        int n,
+        uint8_t *pix,
+        int stride) {
+    const __m256i cmax = _mm256_set1_epi32(IDCT_COEF_MAX);
+    const __m256i cmin = _mm256_set1_epi32(-IDCT_COEF_MAX);
+    __m256i q[8], v[8];
+    __m128i lo, hi, r;
+
+    for (int i = 0; i < 8; i++)
+        q[i] = _mm256_cvtepi16_epi32(
+                _mm_loadu_si128((const __m128i *)&dqt[i * 8]));
+
+    for (int b = 0; b < n; b++, coef += 64, pix += 8) {
+        for (int i = 0; i < 8; i++) {
+            v[i] = _mm256_mullo_epi32(q[i], _mm256_cvtepi16_epi32(
+                        _mm_loadu_si128((const __m128i *)&coef[i * 8])));
+            v[i] = _mm256_max_epi32(_mm256_min_epi32(v[i], cmax), cmin);
         }
+
+        Idct_1D_AVX2(v, _mm256_set1_epi32(1 << (PASS1_SHIFT - 1)),
+                PASS1_SHIFT);
+        Transpose_8x8_AVX2(v);
+        Idct_1D_AVX2(v, _mm256_set1_epi32(
+                    (IDCT_CENTER << PASS2_SHIFT) + (1 << (PASS2_SHIFT - 1))),
+                PASS2_SHIFT);
+        Transpose_8x8_AVX2(v);
+
+        /* Rows 0-3 and 4-7 saturated to 16 then 8 bits */
+        for (int i = 0; i < 8; i += 4) {
+            __m256i w01 = _mm256_packs_epi32(v[i],     v[i + 1]);
+            __m256i w23 = _mm256_packs_epi32(v[i + 2], v[i + 3]);
+            __m256i w   = _mm256_packus_epi16(w01, w23);
+
+            /* Low lane holds the left, high lane the right half of rows */
+            lo = _mm256_castsi256_si128(w);
+            hi = _mm256_extracti128_si256(w, 1);
+            r  = _mm_unpacklo_epi32(lo, hi);
+            _mm_storel_epi64((__m128i *)&pix[i * stride], r);
+            _mm_storel_epi64((__m128i *)&pix[(i + 1) * stride],
+                    _mm_srli_si128(r, 8));
+            r  = _mm_unpackhi_epi32(lo, hi);
+            _mm_storel_epi64((__m128i *)&pix[(i + 2) * stride], r);
+            _mm_storel_epi64((__m128i *)&pix[(i + 3) * stride],
+                    _mm_srli_si128(r, 8));
+        }
+    }
+}
+#endif
+
+/*****************************************************************************/
+
+/* Idct_Init()
+ *
+ * Binds the IDCT kernel to the CPU
+ */
+void Idct_Init(void) {
+    idct_blocks = Idct_Blocks_Plain;
+#ifdef CPU_X86_DISPATCH
+    if (Cpu_Simd() >= CPU_SIMD_AVX2)
+        idct_blocks = Idct_Blocks_AVX2;
+#endif
+}
+
+/*****************************************************************************/
+
+/* Idct_Blocks()
+ *
+ * Inverse DCT of n 8x8 blocks of quantized coefficients in row
+ * order, dequantized by dqt and clamped to IDCT_COEF_MAX, to level
+ * shifted and clamped pixels. Blocks go side by side to pix, rows
+ * stride bytes apart
+ */
+void Idct_Blocks(
+        const int16_t *coef,
+        const int16_t *dqt,
+        int n,
+        uint8_t *pix,
+        int stride) {
+    idct_blocks(coef, dqt, n, pix, stride);
 }
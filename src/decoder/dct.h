@@ -19,7 +19,25 @@
 
 /*****************************************************************************/
 
-void Flt_Idct_8x8(double *res, const double *inpt);
+#include <stdint.h>
+
+/*****************************************************************************/
+
+/* Largest magnitude of dequantized coefficients. The DCT of 8 bit
+ * samples is within 1024, larger ones come of corrupt data and are
+ * clamped. With this clamp the row pass of the fixed point IDCT peaks
+ * at about 1.905e9, within int32: twice that would overflow it */
+#define IDCT_COEF_MAX   1023
+
+/*****************************************************************************/
+
+void Idct_Init(void);
+void Idct_Blocks(
+        const int16_t *coef,
+        const int16_t *dqt,
+        int n,
+        uint8_t *pix,
+        int stride);
 
 /*****************************************************************************/
 
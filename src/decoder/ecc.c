@@ -16,11 +16,53 @@
 
 #include "ecc.h"
 
+#include "../common/cpu.h"
+
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 #include <strings.h>
 
+#ifdef CPU_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+/*****************************************************************************/
+
+/* Symbols of a code word, parity symbols (syndromes) */
+#define RS_N        255
+#define RS_PARITY   32
+
+/* Syndrome kernel symbols per SIMD block */
+#define RS_BLOCK    16
+
+/*****************************************************************************/
+
+static uint8_t Gf_Mul_Log(uint8_t x, int log);
+static void Ecc_Syndromes_Interleaved(
+        const uint8_t *data,
+        uint8_t s[ECC_INTERLEAVE][RS_PARITY]);
+#ifdef CPU_X86_DISPATCH
+static void Ecc_Syndromes_Interleaved_SSSE3(
+        const uint8_t *data,
+        uint8_t s[ECC_INTERLEAVE][RS_PARITY]);
+#endif
+static int Ecc_Berlekamp(uint8_t *s, uint8_t *lambda);
+static void Ecc_Chien_Interleaved(
+        uint8_t lambda[ECC_INTERLEAVE][RS_PARITY + 1],
+        const int *deg,
+        uint8_t root[ECC_INTERLEAVE][RS_PARITY],
+        int *count);
+#ifdef CPU_X86_DISPATCH
+static void Ecc_Chien_Interleaved_SSSE3(
+        uint8_t lambda[ECC_INTERLEAVE][RS_PARITY + 1],
+        const int *deg,
+        uint8_t root[ECC_INTERLEAVE][RS_PARITY],
+        int *count);
+#endif
+static bool Ecc_Forney(uint8_t *data, int stride, const uint8_t *s,
+    const uint8_t *lambda, int deg_lambda, const uint8_t *root, int count);
+
 /*****************************************************************************/
 
 static const uint8_t alpha[256] = {
@@ -93,34 +135,185 @@ static const uint8_t indx[256] = {
     246, 135, 165, 23, 58, 163, 60, 183
 };
 
+/* alpha[] twice, so a sum of two logs indexes it with no modulo */
+static uint8_t alpha2[2 * RS_N];
+
+/* Logs of the roots of the syndromes, 11 * (112 + i) */
+static uint8_t root_log[RS_PARITY];
+
+/* Products of low and high nibbles by
+ * root^(RS_BLOCK / ECC_INTERLEAVE), for PSHUFB */
+static uint8_t root_ilv_lo[RS_PARITY][16], root_ilv_hi[RS_PARITY][16];
+
+/* Products of low and high nibbles by alpha^(j * ECC_INTERLEAVE),
+ * the step of term j of the Chien search, for PSHUFB */
+static uint8_t chien_ilv_lo[RS_PARITY + 1][16], chien_ilv_hi[RS_PARITY + 1][16];
+
+/* Syndrome and Chien search kernels, bound
+ * to CPU features by Init_Ecc_Tables() */
+static void (*ecc_syndromes_interleaved)(
+        const uint8_t *data,
+        uint8_t s[ECC_INTERLEAVE][RS_PARITY]) = Ecc_Syndromes_Interleaved;
+static void (*ecc_chien_interleaved)(
+        uint8_t lambda[ECC_INTERLEAVE][RS_PARITY + 1],
+        const int *deg,
+        uint8_t root[ECC_INTERLEAVE][RS_PARITY],
+        int *count) = Ecc_Chien_Interleaved;
+
 /*****************************************************************************/
 
-bool Ecc_Decode(uint8_t *idata, int pad) {
-  int i, j, r, k, deg_lambda, el, deg_omega;
-  int syn_error;
-  uint8_t q, tmp, num1, num2, den, discr_r;
-  uint8_t lambda[33], b[33], reg[33], t[33], omega[33];
-  uint8_t root[32], s[32], loc[32];
-  uint8_t *data;
-  int result = 0; /* holds amount of errors fixed */
+/* Gf_Mul_Log()
+ *
+ * Product of x by the field element of log (< 255)
+ */
+static inline uint8_t Gf_Mul_Log(uint8_t x, int log) {
+  return( x == 0 ? 0 : alpha2[indx[x] + log] );
+}
 
-  data = idata;
-  for( i = 0; i < 32; i++ )
-    s[i] = data[0];
-  for( j = 1; j < 255 - pad; j++ )
-    for( i = 0; i < 32; i++ )
-      if( s[i] == 0 ) s[i] = data[j];
-      else s[i] = data[j] ^ alpha[ (indx[s[i]] + (112 + i) * 11) % 255 ];
+/*****************************************************************************/
 
-  syn_error = 0;
-  for( i = 0; i < 32; i++ )
+/* Init_Ecc_Tables()
+ *
+ * Fills the field tables of the decoder and binds the
+ * syndrome and Chien search kernels to the CPU
+ */
+void Init_Ecc_Tables(void) {
+  int i, n, log;
+
+  for( i = 0; i < 2 * RS_N; i++ )
+    alpha2[i] = alpha[i % RS_N];
+
+  for( i = 0; i < RS_PARITY; i++ )
   {
-    syn_error |= s[i];
-    s[i] = indx[ s[i] ];
+    root_log[i] = (uint8_t)( (112 + i) * 11 % RS_N );
+
+    log = root_log[i] * (RS_BLOCK / ECC_INTERLEAVE) % RS_N;
+    for( n = 0; n < 16; n++ )
+    {
+      root_ilv_lo[i][n] = Gf_Mul_Log( (uint8_t)n, log );
+      root_ilv_hi[i][n] = Gf_Mul_Log( (uint8_t)(n << 4), log );
+    }
+  }
+
+  for( i = 0; i <= RS_PARITY; i++ )
+  {
+    log = i * ECC_INTERLEAVE % RS_N;
+    for( n = 0; n < 16; n++ )
+    {
+      chien_ilv_lo[i][n] = Gf_Mul_Log( (uint8_t)n, log );
+      chien_ilv_hi[i][n] = Gf_Mul_Log( (uint8_t)(n << 4), log );
+    }
   }
 
+  ecc_syndromes_interleaved = Ecc_Syndromes_Interleaved;
+  ecc_chien_interleaved     = Ecc_Chien_Interleaved;
+#ifdef CPU_X86_DISPATCH
+  if( Cpu_Simd() >= CPU_SIMD_SSSE3 )
+  {
+    ecc_syndromes_interleaved = Ecc_Syndromes_Interleaved_SSSE3;
+    ecc_chien_interleaved     = Ecc_Chien_Interleaved_SSSE3;
+  }
+#endif
+}
+
+/*****************************************************************************/
+
+/* Ecc_Syndromes_Interleaved()
+ *
+ * Syndromes of each of ECC_INTERLEAVE code words interleaved
+ * symbol by symbol in data, read in place, by Horner's rule
+ * at each root
+ */
+static void Ecc_Syndromes_Interleaved(
+        const uint8_t *data,
+        uint8_t s[ECC_INTERLEAVE][RS_PARITY]) {
+  int i, j, w;
+
+  for( w = 0; w < ECC_INTERLEAVE; w++ )
+    for( i = 0; i < RS_PARITY; i++ )
+      s[w][i] = data[w];
+
+  for( j = ECC_INTERLEAVE; j < ECC_INTERLEAVE * RS_N; j += ECC_INTERLEAVE )
+    for( w = 0; w < ECC_INTERLEAVE; w++ )
+      for( i = 0; i < RS_PARITY; i++ )
+        s[w][i] = data[j + w] ^ Gf_Mul_Log( s[w][i], root_log[i] );
+}
+
+/*****************************************************************************/
+
+#ifdef CPU_X86_DISPATCH
+/* Ecc_Syndromes_Interleaved_SSSE3()
+ *
+ * Ecc_Syndromes_Interleaved() on RS_BLOCK streams of the data at
+ * once: a block holds RS_BLOCK / ECC_INTERLEAVE symbols of each word,
+ * so lane r * ECC_INTERLEAVE + w is stream r of word w and all lanes
+ * step by the same root^(RS_BLOCK / ECC_INTERLEAVE), multiplying by
+ * two PSHUFB nibble lookups. Lanes of a word are then combined by
+ * Horner's rule. Each word has one symbol less than whole blocks, so
+ * the first block is shifted in by a symbol of each word, zeros in
+ * front as if padded
+ */
+__attribute__((target("ssse3")))
+static void Ecc_Syndromes_Interleaved_SSSE3(
+        const uint8_t *data,
+        uint8_t s[ECC_INTERLEAVE][RS_PARITY]) {
+  const __m128i low_nibble = _mm_set1_epi8( 0x0F );
+  const int first = RS_BLOCK - ECC_INTERLEAVE;
+  uint8_t lane[RS_BLOCK];
+  __m128i acc, lo, hi, head;
+  int i, m, r, w;
+
+  head = _mm_slli_si128( _mm_loadu_si128((const __m128i *)data), ECC_INTERLEAVE );
+
+  for( i = 0; i < RS_PARITY; i++ )
+  {
+    lo  = _mm_loadu_si128( (const __m128i *)root_ilv_lo[i] );
+    hi  = _mm_loadu_si128( (const __m128i *)root_ilv_hi[i] );
+    acc = head;
+
+    for( m = first; m < ECC_INTERLEAVE * RS_N; m += RS_BLOCK )
+    {
+      acc = _mm_xor_si128(
+          _mm_shuffle_epi8( lo, _mm_and_si128(acc, low_nibble) ),
+          _mm_shuffle_epi8( hi,
+            _mm_and_si128(_mm_srli_epi16(acc, 4), low_nibble) ) );
+      acc = _mm_xor_si128( acc, _mm_loadu_si128((const __m128i *)&data[m]) );
+    }
+
+    _mm_storeu_si128( (__m128i *)lane, acc );
+    for( w = 0; w < ECC_INTERLEAVE; w++ )
+    {
+      s[w][i] = lane[w];
+      for( r = ECC_INTERLEAVE + w; r < RS_BLOCK; r += ECC_INTERLEAVE )
+        s[w][i] = lane[r] ^ Gf_Mul_Log( s[w][i], root_log[i] );
+    }
+  }
+}
+#endif
+
+/*****************************************************************************/
+
+/* Ecc_Berlekamp()
+ *
+ * Error locator of a code word from its syndromes s, turned into
+ * logs in place, by Berlekamp-Massey, into lambda as logs (255 for
+ * zero). Returns its degree, -1 if the word is clean
+ */
+static int Ecc_Berlekamp(uint8_t *s, uint8_t *lambda) {
+  int i, r, el, deg_lambda;
+  int syn_error;
+  uint8_t discr_r;
+  uint8_t b[33], t[33];
+
+  /* Most code words are clean */
+  syn_error = 0;
+  for( i = 0; i < 32; i++ )
+    syn_error |= s[i];
   if (syn_error == 0)
-      return true;
+      return( -1 );
+
+  for( i = 0; i < 32; i++ )
+    s[i] = indx[ s[i] ];
 
   bzero( &lambda[1], 32 );
   lambda[0] = 1;
@@ -135,7 +328,7 @@ bool Ecc_Decode(uint8_t *idata, int pad) {
     discr_r = 0;
     for( i = 0; i < r; i++ )
       if( (lambda[i] != 0) && (s[r - i - 1] != 255) )
-        discr_r ^= alpha[ (indx[lambda[i]] + s[r - i - 1]) % 255 ];
+        discr_r ^= alpha2[ indx[lambda[i]] + s[r - i - 1] ];
 
     discr_r = indx[discr_r];
     if( discr_r == 255 )
@@ -149,7 +342,7 @@ bool Ecc_Decode(uint8_t *idata, int pad) {
       for( i = 0; i < 32; i++ )
       {
         if( b[i] != 255 )
-          t[i + 1] = lambda[i + 1] ^ alpha[ (discr_r + b[i]) % 255 ];
+          t[i + 1] = lambda[i + 1] ^ alpha2[ discr_r + b[i] ];
         else
           t[i + 1] = lambda[i + 1];
       }
@@ -160,7 +353,9 @@ bool Ecc_Decode(uint8_t *idata, int pad) {
         for( i = 0; i < 32; i++ )
         {
           if( lambda[i] == 0 ) b[i] = 255;
-          else b[i] = (uint8_t)( (indx[lambda[i]] - discr_r + 255) % 255 );
+          else if( indx[lambda[i]] >= discr_r )
+            b[i] = (uint8_t)( indx[lambda[i]] - discr_r );
+          else b[i] = (uint8_t)( indx[lambda[i]] - discr_r + 255 );
         }
       }
       else
@@ -180,43 +375,144 @@ bool Ecc_Decode(uint8_t *idata, int pad) {
     if( lambda[i] != 255 ) deg_lambda = i;
   }
 
-  memmove( &reg[1], &lambda[1], 32 );
-  result = 0;
+  return( deg_lambda );
+}
 
-  i = 1;
-  k = 115;
+/*****************************************************************************/
 
-  while (true) {
-    if( !(i <= 255) ) break;
+/* Ecc_Chien_Interleaved()
+ *
+ * Chien search of the error locator of each of ECC_INTERLEAVE
+ * code words, of degree deg[w] (-1 if clean), at alpha^i for i
+ * from 1 to 255. Stores the i of its roots in root[w], in order,
+ * and their count, up to the degree, in count[w]
+ */
+static void Ecc_Chien_Interleaved(
+        uint8_t lambda[ECC_INTERLEAVE][RS_PARITY + 1],
+        const int *deg,
+        uint8_t root[ECC_INTERLEAVE][RS_PARITY],
+        int *count) {
+  uint8_t reg[RS_PARITY + 1], q;
+  int i, j, w;
+
+  for( w = 0; w < ECC_INTERLEAVE; w++ )
+  {
+    count[w] = 0;
+    if( deg[w] <= 0 ) continue;
 
-    q = 1;
-    for( j = deg_lambda; j >= 1; j-- )
+    memmove( &reg[1], &lambda[w][1], RS_PARITY );
+    for( i = 1; i <= RS_N; i++ )
     {
-      if( reg[j] != 255 )
+      q = 1;
+      for( j = deg[w]; j >= 1; j-- )
       {
-        reg[j] = (uint8_t)( (reg[j] + j) % 255 );
-        q ^= alpha[ reg[j] ];
+        if( reg[j] != 255 )
+        {
+          reg[j] = (uint8_t)( reg[j] + j >= 255 ? reg[j] + j - 255 : reg[j] + j );
+          q ^= alpha[ reg[j] ];
+        }
       }
+
+      if( q != 0 ) continue;
+
+      root[w][count[w]++] = (uint8_t)i;
+      if( count[w] == deg[w] )
+        break;
     }
+  }
+}
+
+/*****************************************************************************/
 
-    if( q != 0 )
+#ifdef CPU_X86_DISPATCH
+/* Ecc_Chien_Interleaved_SSSE3()
+ *
+ * Ecc_Chien_Interleaved() on all code words at once: lane
+ * r * ECC_INTERLEAVE + w holds the terms of the locator of word w
+ * at alpha^(i + r), a block of lanes ECC_INTERLEAVE points of each
+ * word. Term j of all lanes steps by alpha^(j * ECC_INTERLEAVE),
+ * multiplying by two PSHUFB nibble lookups, terms beyond the degree
+ * of a word are zero. The last block runs past alpha^255 by a point,
+ * masked off. A locator has no more roots than its degree, so roots
+ * found over all points are those the plain search stops at
+ */
+__attribute__((target("ssse3")))
+static void Ecc_Chien_Interleaved_SSSE3(
+        uint8_t lambda[ECC_INTERLEAVE][RS_PARITY + 1],
+        const int *deg,
+        uint8_t root[ECC_INTERLEAVE][RS_PARITY],
+        int *count) {
+  const __m128i low_nibble = _mm_set1_epi8( 0x0F );
+  const __m128i one = _mm_set1_epi8( 1 );
+  __m128i term[RS_PARITY + 1], lo, hi, q;
+  uint8_t lane[RS_BLOCK];
+  int i, j, l, r, w, max_deg, mask;
+
+  max_deg = 0;
+  for( w = 0; w < ECC_INTERLEAVE; w++ )
+  {
+    count[w] = 0;
+    if( deg[w] > max_deg ) max_deg = deg[w];
+  }
+  if( max_deg == 0 ) return;
+
+  /* Terms lambda[j] * alpha^(j * (1 + r)) of the first block */
+  for( j = 1; j <= max_deg; j++ )
+  {
+    for( r = 0; r < RS_BLOCK / ECC_INTERLEAVE; r++ )
+      for( w = 0; w < ECC_INTERLEAVE; w++ )
+        lane[r * ECC_INTERLEAVE + w] =
+          ( (j > deg[w]) || (lambda[w][j] == 255) ) ? 0 :
+          alpha2[ lambda[w][j] + j * (1 + r) % RS_N ];
+    term[j] = _mm_loadu_si128( (const __m128i *)lane );
+  }
+
+  for( i = 1; i <= RS_N; i += RS_BLOCK / ECC_INTERLEAVE )
+  {
+    q = one;
+    for( j = 1; j <= max_deg; j++ )
     {
-      i++;
-      k = (k + 116) % 255;
-      continue;
+      q  = _mm_xor_si128( q, term[j] );
+      lo = _mm_loadu_si128( (const __m128i *)chien_ilv_lo[j] );
+      hi = _mm_loadu_si128( (const __m128i *)chien_ilv_hi[j] );
+      term[j] = _mm_xor_si128(
+          _mm_shuffle_epi8( lo, _mm_and_si128(term[j], low_nibble) ),
+          _mm_shuffle_epi8( hi,
+            _mm_and_si128(_mm_srli_epi16(term[j], 4), low_nibble) ) );
     }
 
-    root[result] = (uint8_t)i;
-    loc[result]  = (uint8_t)k;
-    result++;
-    if( result == deg_lambda )
-      break;
-
-    i++;
-    k = (k + 116) % 255;
+    mask = _mm_movemask_epi8( _mm_cmpeq_epi8(q, _mm_setzero_si128()) );
+    while( mask != 0 )
+    {
+      l = __builtin_ctz( (unsigned)mask );
+      mask &= mask - 1;
+      w = l % ECC_INTERLEAVE;
+      r = l / ECC_INTERLEAVE;
+      if( (i + r <= RS_N) && (count[w] < deg[w]) )
+        root[w][count[w]++] = (uint8_t)( i + r );
+    }
   }
+}
+#endif
+
+/*****************************************************************************/
 
-  if (deg_lambda != result)
+/* Ecc_Forney()
+ *
+ * Corrects a code word of 255 symbols, stride apart in data, at
+ * the count roots of its error locator lambda of degree deg_lambda,
+ * from its syndromes s, both as logs. Returns false if it has more
+ * errors than can be corrected. Sums of logs index alpha2[] or are
+ * reduced by a subtraction, not by modulo
+ */
+static bool Ecc_Forney(uint8_t *data, int stride, const uint8_t *s,
+    const uint8_t *lambda, int deg_lambda, const uint8_t *root, int count) {
+  int i, j, deg_omega;
+  uint8_t tmp, num1, num2, den;
+  uint8_t omega[33];
+  int root_pow[33], log, loc;
+
+  if (deg_lambda != count)
       return false;
 
   deg_omega = deg_lambda - 1;
@@ -225,17 +521,25 @@ bool Ecc_Decode(uint8_t *idata, int pad) {
     tmp = 0;
     for( j = i; j >= 0; j-- )
       if( (s[i - j] != 255) && (lambda[j] != 255) )
-        tmp ^= alpha[ (s[i - j] + lambda[j]) % 255 ];
+        tmp ^= alpha2[ s[i - j] + lambda[j] ];
     omega[i] = indx[tmp];
   }
 
-  for( j = result - 1; j >= 0; j-- )
+  for( j = count - 1; j >= 0; j-- )
   {
+    /* Logs of powers of the root, i * root[j] */
+    root_pow[0] = 0;
+    for( i = 1; i < 33; i++ )
+    {
+      root_pow[i] = root_pow[i - 1] + root[j];
+      if( root_pow[i] >= 255 ) root_pow[i] -= 255;
+    }
+
     num1 = 0;
     for( i = deg_omega; i >= 0; i-- )
       if( omega[i] != 255 )
-        num1 ^= alpha[ (omega[i] + i * root[j]) % 255 ];
-    num2 = alpha[ (root[j] * 111 + 255) % 255 ];
+        num1 ^= alpha2[ omega[i] + root_pow[i] ];
+    num2 = alpha[ root[j] * 111 % 255 ];
     den = 0;
 
     if( deg_lambda < 31 ) i = deg_lambda;
@@ -245,12 +549,18 @@ bool Ecc_Decode(uint8_t *idata, int pad) {
     while (true) {
       if( !(i >= 0) ) break;
       if( lambda[i + 1] != 255 )
-        den ^= alpha[ (lambda[i + 1] + i * root[j]) % 255 ];
+        den ^= alpha2[ lambda[i + 1] + root_pow[i] ];
       i -= 2;
     }
 
-    if( (num1 != 0) && (loc[j] >= pad) )
-      data[loc[j] - pad] ^= alpha[ (indx[num1] + indx[num2] + 255 - indx[den]) % 255 ];
+    /* Symbol of the root alpha^i, at 116 * i - 1 */
+    loc = ( root[j] * 116 + 254 ) % 255;
+    if( num1 != 0 )
+    {
+      log = indx[num1] + indx[num2];
+      if( log >= 255 ) log -= 255;
+      data[loc * stride] ^= alpha2[ log + 255 - indx[den] ];
+    }
   }
 
   return true;
@@ -258,16 +568,29 @@ bool Ecc_Decode(uint8_t *idata, int pad) {
 
 /*****************************************************************************/
 
-void Ecc_Deinterleave(uint8_t *data, uint8_t *output, int pos, int n) {
-  int i;
-  for( i = 0; i < 255; i++ )
-    output[i] = data[ i * n + pos ];
-}
+/* Ecc_Decode_Interleaved()
+ *
+ * Corrects in place ECC_INTERLEAVE code words interleaved symbol by
+ * symbol in data, with syndromes of all of them found together, and
+ * their error locators searched together. Sets ok[w] false for code
+ * words with too many errors to correct
+ */
+void Ecc_Decode_Interleaved(uint8_t *data, bool *ok) {
+  uint8_t s[ECC_INTERLEAVE][RS_PARITY];
+  uint8_t lambda[ECC_INTERLEAVE][RS_PARITY + 1];
+  uint8_t root[ECC_INTERLEAVE][RS_PARITY];
+  int deg[ECC_INTERLEAVE], count[ECC_INTERLEAVE];
+  int w;
 
-/*****************************************************************************/
+  ecc_syndromes_interleaved( data, s );
+
+  for( w = 0; w < ECC_INTERLEAVE; w++ )
+    deg[w] = Ecc_Berlekamp( s[w], lambda[w] );
+
+  ecc_chien_interleaved( lambda, deg, root, count );
 
-void Ecc_Interleave(uint8_t *data, uint8_t *output, int pos, int n) {
-  int i;
-  for( i = 0; i < 255; i++ )
-    output[ i * n + pos] = data[i];
+  for( w = 0; w < ECC_INTERLEAVE; w++ )
+    ok[w] = (deg[w] < 0) ||
+      Ecc_Forney( &data[w], ECC_INTERLEAVE, s[w], lambda[w], deg[w],
+          root[w], count[w] );
 }
@@ -22,11 +22,13 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+/* Code words interleaved symbol by symbol in a frame */
+#define ECC_INTERLEAVE  4
+
 /*****************************************************************************/
 
-bool Ecc_Decode(uint8_t *idata, int pad);
-void Ecc_Deinterleave(uint8_t *data, uint8_t *output, int pos, int n);
-void Ecc_Interleave(uint8_t *data, uint8_t *output, int pos, int n);
+void Init_Ecc_Tables(void);
+void Ecc_Decode_Interleaved(uint8_t *data, bool *ok);
 
 /*****************************************************************************/
 
@@ -0,0 +1,227 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+#include "frame_queue.h"
+
+#include "../common/common.h"
+#include "../glrpt/utils.h"
+#include "medet.h"
+#include "met_to_data.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*****************************************************************************/
+
+static void *Frame_Queue_Decoder(void *arg);
+
+/*****************************************************************************/
+
+/* Queue of soft frames from the demodulator to the decoder thread:
+ * frames, whether each is to be decoded (PLL was locked) and whether
+ * frames were dropped just before it, indices, max frames queued and
+ * frames dropped because the queue was full */
+static int8_t *queue_buf = NULL;
+static bool queue_decode[FRAME_QUEUE_LEN], queue_gap[FRAME_QUEUE_LEN];
+static bool queue_dropping;
+static uint32_t queue_head, queue_tail, queue_high, queue_dropped;
+static bool queue_running = false, queue_stop;
+static pthread_t queue_thread;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+
+/* Decoder's own soft symbols buffer, 3 sections of
+ * SOFT_FRAME_LEN laid out as the demodulator's buffer */
+static int8_t *soft_buf = NULL;
+
+/*****************************************************************************/
+
+/* Frame_Queue_Decoder()
+ *
+ * Runs in a thread of its own, shifting queued frames into
+ * the decoder's soft buffer and decoding them, till stopped
+ */
+static void *Frame_Queue_Decoder(void *arg) {
+    int8_t *frame;
+    bool decode, gap;
+
+    (void)arg;
+
+    while (true) {
+        /* Wait for a frame or stop request */
+        pthread_mutex_lock(&queue_mutex);
+        while ((queue_head == queue_tail) && !queue_stop)
+            pthread_cond_wait(&queue_cond, &queue_mutex);
+
+        if (queue_head == queue_tail) {
+            pthread_mutex_unlock(&queue_mutex);
+            break;
+        }
+
+        frame  = queue_buf + (queue_tail % FRAME_QUEUE_LEN) * SOFT_FRAME_LEN;
+        decode = queue_decode[queue_tail % FRAME_QUEUE_LEN];
+        gap    = queue_gap[queue_tail % FRAME_QUEUE_LEN];
+        pthread_mutex_unlock(&queue_mutex);
+
+        /* Frames before this one were dropped, so the buffer no longer
+         * holds a continuous stream: clear it and let the decoder start
+         * searching for sync again, as after Frame_Queue_Start() */
+        if (gap) {
+            memset(soft_buf, 0, 3 * SOFT_FRAME_LEN);
+            Medet_Resync();
+        }
+
+        /* Save the frame in the lower section and move the 2 lower
+         * sections to the top, as Demod_PSK() does with its buffer */
+        memcpy(soft_buf + 2 * SOFT_FRAME_LEN, frame, SOFT_FRAME_LEN);
+        memmove(soft_buf, soft_buf + SOFT_FRAME_LEN, 2 * SOFT_FRAME_LEN);
+
+        if (decode)
+            Decode_Frame((uint8_t *)soft_buf);
+
+        /* Free the queue slot */
+        pthread_mutex_lock(&queue_mutex);
+        queue_tail++;
+        pthread_mutex_unlock(&queue_mutex);
+    }
+
+    return NULL;
+}
+
+/*****************************************************************************/
+
+/* Frame_Queue_Start()
+ *
+ * Allocates the frame queue and starts the decoder thread
+ */
+bool Frame_Queue_Start(void) {
+    if (queue_running)
+        return true;
+
+    mem_alloc((void **)&queue_buf, (size_t)FRAME_QUEUE_LEN * SOFT_FRAME_LEN);
+    mem_alloc((void **)&soft_buf, 3 * SOFT_FRAME_LEN);
+    memset(soft_buf, 0, 3 * SOFT_FRAME_LEN);
+
+    queue_head     = 0;
+    queue_tail     = 0;
+    queue_high     = 0;
+    queue_dropped  = 0;
+    queue_dropping = false;
+    queue_stop     = false;
+
+    if (pthread_create(&queue_thread, NULL, Frame_Queue_Decoder, NULL) != 0) {
+        Show_Message("Failed to create Decoder thread", "red");
+        free_ptr((void **)&queue_buf);
+        free_ptr((void **)&soft_buf);
+        return false;
+    }
+
+    queue_running = true;
+
+    return true;
+}
+
+/*****************************************************************************/
+
+/* Frame_Queue_Post()
+ *
+ * Queues a new soft frame to the decoder thread, to be decoded
+ * if decode is true or only shifted into its buffer otherwise.
+ * Never blocks the demodulator: if the queue is full the frame
+ * is dropped (and counted) and the next frame queued is marked
+ * so that the decoder resynchronizes at it
+ */
+void Frame_Queue_Post(const int8_t *frame, bool decode) {
+    uint32_t used;
+
+    if (!queue_running)
+        return;
+
+    /* Only the decoder thread advances queue_tail */
+    pthread_mutex_lock(&queue_mutex);
+    used = queue_head - queue_tail;
+    if (used >= FRAME_QUEUE_LEN) {
+        queue_dropped++;
+        queue_dropping = true;
+    }
+    pthread_mutex_unlock(&queue_mutex);
+
+    if (used >= FRAME_QUEUE_LEN)
+        return;
+
+    memcpy(queue_buf + (queue_head % FRAME_QUEUE_LEN) * SOFT_FRAME_LEN,
+            frame, SOFT_FRAME_LEN);
+
+    pthread_mutex_lock(&queue_mutex);
+    queue_decode[queue_head % FRAME_QUEUE_LEN] = decode;
+    queue_gap[queue_head % FRAME_QUEUE_LEN]    = queue_dropping;
+    queue_dropping = false;
+    queue_head++;
+    if (queue_head - queue_tail > queue_high)
+        queue_high = queue_head - queue_tail;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+/*****************************************************************************/
+
+/* Frame_Queue_Stop()
+ *
+ * Lets the decoder thread finish queued frames, stops it and
+ * reports queue metrics
+ */
+void Frame_Queue_Stop(void) {
+    char mesg[MESG_SIZE];
+    uint32_t depth, high_water, dropped;
+
+    if (!queue_running)
+        return;
+
+    pthread_mutex_lock(&queue_mutex);
+    queue_stop = true;
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_mutex);
+    pthread_join(queue_thread, NULL);
+    queue_running = false;
+
+    free_ptr((void **)&queue_buf);
+    free_ptr((void **)&soft_buf);
+
+    Frame_Queue_Stats(&depth, &high_water, &dropped);
+    snprintf(mesg, sizeof(mesg),
+            "Decoder Queue: Max %u of %u Frames Queued, %u Dropped",
+            high_water, FRAME_QUEUE_LEN, dropped);
+    Show_Message(mesg, dropped ? "orange" : "black");
+}
+
+/*****************************************************************************/
+
+/* Frame_Queue_Stats()
+ *
+ * Returns current depth, high-water mark and dropped
+ * frames count of the queue to the decoder thread
+ */
+void Frame_Queue_Stats(uint32_t *depth, uint32_t *high_water, uint32_t *dropped) {
+    pthread_mutex_lock(&queue_mutex);
+    *depth      = queue_head - queue_tail;
+    *high_water = queue_high;
+    *dropped    = queue_dropped;
+    pthread_mutex_unlock(&queue_mutex);
+}
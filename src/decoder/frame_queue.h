@@ -0,0 +1,39 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+#ifndef DECODER_FRAME_QUEUE_H
+#define DECODER_FRAME_QUEUE_H
+
+/*****************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+
+/* Soft frames the queue to the decoder thread can hold */
+#define FRAME_QUEUE_LEN     16
+
+/*****************************************************************************/
+
+bool Frame_Queue_Start(void);
+void Frame_Queue_Post(const int8_t *frame, bool decode);
+void Frame_Queue_Stop(void);
+void Frame_Queue_Stats(uint32_t *depth, uint32_t *high_water, uint32_t *dropped);
+
+/*****************************************************************************/
+
+#endif
@@ -16,24 +16,44 @@
 
 #include "huffman.h"
 
-#include "../common/shared.h"
-#include "../glrpt/utils.h"
-
 #include <stdbool.h>
-#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+
+/*****************************************************************************/
+
+/* Code bits left to the second level tables */
+#define HUFF_SUB_BITS   ( 16 - HUFF_LOOKUP_BITS )
+
+/* First level entry pointing to a second level table */
+#define HUFF_SUB        0x8000
+
+/* Second level tables, enough for the prefixes of the long AC codes */
+#define HUFF_SUB_MAX    8
 
 /*****************************************************************************/
 
-static int Get_AC_Real(const uint16_t w);
-static int Get_DC_Real(const uint16_t w);
+static void Build_Table(
+        const uint8_t *spec,
+        uint16_t *lookup,
+        uint16_t sub[][1 << HUFF_SUB_BITS],
+        int sub_max);
 
 /*****************************************************************************/
 
-static int ac_lookup[65536];
-static int dc_lookup[65536];
+static uint16_t ac_lookup[1 << HUFF_LOOKUP_BITS];
+static uint16_t ac_sub[HUFF_SUB_MAX][1 << HUFF_SUB_BITS];
+static uint16_t dc_lookup[1 << HUFF_LOOKUP_BITS];
+static bool tables_built = false;
 
-static uint8_t t_ac_0[178] = {
+/* Standard luminance DC table: code counts per length, categories */
+static const uint8_t t_dc_0[28] = {
+    0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
+};
+
+/* Standard luminance AC table: code counts per length, run/size values */
+static const uint8_t t_ac_0[178] = {
     0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4,
     4, 0, 0, 1, 125, 1, 2, 3, 0, 4, 17,
     5, 18, 33, 49, 65, 6, 19, 81, 97, 7, 34,
@@ -55,52 +75,28 @@ static uint8_t t_ac_0[178] = {
 
 /*****************************************************************************/
 
-int Get_AC(const uint16_t w) {
-  return( ac_lookup[w] );
-}
-
-/*****************************************************************************/
-
-int Get_DC(const uint16_t w) {
-  return( dc_lookup[w] );
-}
-
-/*****************************************************************************/
-
-static int Get_AC_Real(const uint16_t w) {
-  int i;
+/* Get_AC()
+ *
+ * Looks up the AC code at the top of the 16 bit window w
+ */
+uint16_t Get_AC(const uint16_t w) {
+  uint16_t e = ac_lookup[w >> HUFF_SUB_BITS];
 
-  for( i = 0; (size_t)i < ac_table_len; i++ )
-  {
-    if( ((w >> (16 - ac_table[i].len)) &
-          ac_table[i].mask) == ac_table[i].code )
-      return( i );
-  }
+  if( e & HUFF_SUB )
+    e = ac_sub[e & ~HUFF_SUB][w & ((1 << HUFF_SUB_BITS) - 1)];
 
-  return( -1 );
+  return( e );
 }
 
 /*****************************************************************************/
 
-static int Get_DC_Real(const uint16_t w) {
-  if( (w >> 14) == 0 ) return( 0 );
-
-  switch( w >> 13 )
-  {
-    case 2: return( 1 );
-    case 3: return( 2 );
-    case 4: return( 3 );
-    case 5: return( 4 );
-    case 6: return( 5 );
-  }
-
-  if( (w  >>  12) == 0x00E ) return( 6 );
-  else if( (w  >>  11) == 0x01E )  return( 7 );
-  else if( (w  >>  10) == 0x03E )  return( 8 );
-  else if( (w  >>   9) == 0x07E )  return( 9 );
-  else if( (w  >>   8) == 0x0FE )  return( 10 );
-  else if( (w  >>   7) == 0x1FE )  return( 11 );
-  else return( -1 );
+/* Get_DC()
+ *
+ * Looks up the DC code at the top of the 16 bit window w,
+ * DC codes all fit the first level table
+ */
+uint16_t Get_DC(const uint16_t w) {
+  return( dc_lookup[w >> HUFF_SUB_BITS] );
 }
 
 /*****************************************************************************/
@@ -122,75 +118,67 @@ int Map_Range(const int cat, const int vl) {
 
 /*****************************************************************************/
 
-void Default_Huffman_Table(void) {
-  int k, i, n;
-  uint32_t code;
-  uint8_t *t;
-  int p;
-  uint8_t v[65536];
-  uint16_t min_code[17], maj_code[17];
-  uint16_t max_val, min_val, size_val;
-  int min_valn, max_valn, run, size;
-
-  t = t_ac_0;
-  p = 16;
-  for( k = 1; k <= 16; k++ )
-    for( i = 0; i < t[k - 1]; i++ )
-    {
-      v[(k << 8) + i] = t[p];
-      p++;
-    }
+/* Build_Table()
+ *
+ * Assigns the canonical codes of a JPEG style table spec (16 code
+ * counts per length, then the values) and fills the first level
+ * lookup table, and second level tables for codes longer than it
+ */
+static void Build_Table(
+        const uint8_t *spec,
+        uint16_t *lookup,
+        uint16_t sub[][1 << HUFF_SUB_BITS],
+        int sub_max) {
+  uint32_t code = 0, pre, lo, i;
+  uint16_t e, *tbl;
+  int k, n, p = 16, nsub = 0;
+
+  memset( lookup, 0, sizeof(uint16_t) << HUFF_LOOKUP_BITS );
 
-  code = 0;
   for( k = 1; k <= 16; k++ )
   {
-    min_code[k] = (uint16_t)code;
-    for( i = 1; i <= t[k - 1]; i++ )
-      code++;
-    maj_code[k] = (uint16_t)( code - 1 * (uint32_t)(code != 0) );
-    code *= 2;
-    if( t[k - 1] == 0 )
+    for( n = 0; n < spec[k - 1]; n++, code++, p++ )
     {
-      min_code[k] = 0xFFFF;
-      maj_code[k] = 0;
-    }
-  }
+      e = (uint16_t)( k | ((spec[p] & 0x0F) << 5) | ((spec[p] >> 4) << 9) );
 
-  ac_table_len = 256;
-  mem_alloc( (void **)&ac_table, ac_table_len * sizeof(ac_table_rec_t)) ;
+      if( k <= HUFF_LOOKUP_BITS )
+      {
+        /* Every window starting with the code maps to it */
+        lo = code << (HUFF_LOOKUP_BITS - k);
+        for( i = 0; i < (1u << (HUFF_LOOKUP_BITS - k)); i++ )
+          lookup[lo + i] = e;
+        continue;
+      }
 
-  n = 0;
-  min_valn = 1;
-  max_valn = 1;
-  for( k = 1; k <= 16; k++ )
-  {
-    min_val = min_code[min_valn];
-    max_val = maj_code[max_valn];
-    for( i = 0; i < (1 << k); i++ )
-    {
-      if( ((uint32_t)i <= max_val) &&
-          ((uint32_t)i >= min_val) )
+      /* Long codes continue in the table of their prefix */
+      pre = code >> (k - HUFF_LOOKUP_BITS);
+      if( !(lookup[pre] & HUFF_SUB) )
       {
-        size_val = v[(k << 8) + i - (int)min_val];
-        run = size_val >> 4;
-        size = size_val & 0x0F;
-        ac_table[n].run  = run;
-        ac_table[n].size = size;
-        ac_table[n].len  = k;
-        ac_table[n].mask = (1 << k) - 1;
-        ac_table[n].code = (uint32_t)i;
-        n++;
+        if( nsub == sub_max ) return;
+        memset( sub[nsub], 0, sizeof(sub[nsub]) );
+        lookup[pre] = (uint16_t)( HUFF_SUB | nsub++ );
       }
+      tbl = sub[lookup[pre] & ~HUFF_SUB];
+
+      lo = (code & ((1u << (k - HUFF_LOOKUP_BITS)) - 1)) << (16 - k);
+      for( i = 0; i < (1u << (16 - k)); i++ )
+        tbl[lo + i] = e;
     }
-    min_valn++;
-    max_valn++;
+
+    code <<= 1;
   }
+}
+
+/*****************************************************************************/
 
-  ac_table_len = (size_t)n;
-  mem_realloc( (void **)&ac_table, ac_table_len * sizeof(ac_table_rec_t) );
+/* Default_Huffman_Table()
+ *
+ * Builds the lookup tables of the standard DC and AC tables, once
+ */
+void Default_Huffman_Table(void) {
+  if( tables_built ) return;
 
-  for( i = 0; i <= 65535; i++ )
-    ac_lookup[i] = Get_AC_Real((uint16_t)i);
-  for( i = 0; i <= 65535; i++ )
-    dc_lookup[i] = Get_DC_Real((uint16_t)i);
+  Build_Table( t_dc_0, dc_lookup, NULL, 0 );
+  Build_Table( t_ac_0, ac_lookup, ac_sub, HUFF_SUB_MAX );
+  tables_built = true;
 }
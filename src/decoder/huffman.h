@@ -23,16 +23,20 @@
 
 /*****************************************************************************/
 
-/* Decoder AC table data */
-typedef struct ac_table_rec_t {
-  int run, size, len;
-  uint32_t mask, code;
-} ac_table_rec_t;
+/* Code bits resolved by the first level lookup table,
+ * longer codes continue in a second level table */
+#define HUFF_LOOKUP_BITS    9
+
+/* A lookup table entry packs code length, value size (DC category)
+ * and zero run; an entry of 0 marks an invalid code */
+#define HUFF_LEN(e)     ( (e) & 0x1F )
+#define HUFF_SIZE(e)    ( ((e) >> 5) & 0x0F )
+#define HUFF_RUN(e)     ( ((e) >> 9) & 0x0F )
 
 /*****************************************************************************/
 
-int Get_AC(const uint16_t w);
-int Get_DC(const uint16_t w);
+uint16_t Get_AC(const uint16_t w);
+uint16_t Get_DC(const uint16_t w);
 int Map_Range(const int cat, const int vl);
 void Default_Huffman_Table(void);
 
@@ -21,6 +21,7 @@
 #include "../glrpt/display.h"
 #include "../glrpt/utils.h"
 #include "correlator.h"
+#include "ecc.h"
 #include "met_jpg.h"
 #include "met_packet.h"
 #include "met_to_data.h"
@@ -28,6 +29,7 @@
 #include <glib.h>
 #include <gtk/gtk.h>
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -40,13 +42,20 @@
 
 static int ok_cnt, total_cnt;
 
+/* Serializes decoding in the decoder thread with
+ * (de)initialization of the decoder by the GUI */
+static pthread_mutex_t medet_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /*****************************************************************************/
 
 void Medet_Init(void) {
   int idx;
 
+  pthread_mutex_lock( &medet_lock );
+
   /* Initialize things */
   Init_Correlator_Tables();
+  Init_Ecc_Tables();
   Mj_Init();
   Mtd_Init( &mtd_record );
 
@@ -55,10 +64,13 @@ void Medet_Init(void) {
   for( idx = 0; idx < CHANNEL_IMAGE_NUM; idx++ )
     free_ptr( (void **)&channel_image[idx] );
   channel_image_size = 0;
+  channel_image_capacity = 0;
   channel_image_width = METEOR_IMAGE_WIDTH;
 
   ok_cnt    = 0;
   total_cnt = 1;
+
+  pthread_mutex_unlock( &medet_lock );
 }
 
 /*****************************************************************************/
@@ -68,10 +80,14 @@ void Medet_Init(void) {
  * My addition, de-inits the met decoder (free's buffer pointers)
  */
 void Medet_Deinit(void) {
+  pthread_mutex_lock( &medet_lock );
+
   free_ptr( (void **)&(mtd_record.v.pair_distances) );
-  free_ptr( (void **)&ac_table );
+  Corr_Acquire_Reset( &(mtd_record.c) );
   uint8_t **dec = ret_decoded();
   free_ptr( (void **)dec );
+
+  pthread_mutex_unlock( &medet_lock );
 }
 
 /*****************************************************************************/
@@ -109,11 +125,62 @@ void Decode_Image(uint8_t *in_buffer, int buf_len) {
   }
 
   /* Print decoder status data */
+  if( isFlagSet(HEADLESS_MODE) ) return;
+
   snprintf( txt, sizeof(txt), "%d", mtd_record.sig_q );
-  gtk_entry_set_text( GTK_ENTRY(sig_quality_entry), txt );
+  Display_Entry( sig_quality_entry, txt );
   int percent = ( 100 * ok_cnt ) / total_cnt;
   snprintf( txt, sizeof(txt), "%d:%d%%", ok_cnt, percent );
-  gtk_entry_set_text( GTK_ENTRY(packet_cnt_entry), txt );
+  Display_Entry( packet_cnt_entry, txt );
+}
+
+/*****************************************************************************/
+
+/* Decode_Frame()
+ *
+ * Decodes images from a soft buffer of 3 SOFT_FRAME_LEN sections
+ * into which a new frame has just been shifted, as done by the
+ * demodulator, and moves decoder positions back one section
+ */
+void Decode_Frame(uint8_t *in_buffer) {
+  pthread_mutex_lock( &medet_lock );
+
+  /* Decoder may have been stopped while frames were queued */
+  if( isFlagSet(STATUS_DECODING) )
+  {
+    Decode_Image( in_buffer, SOFT_FRAME_LEN );
+
+    /* The mtd_record.pos and mtd_record.prev_pos pointers must be
+     * decrimented to point back to the same data in the soft buffer */
+    mtd_record.pos      -= SOFT_FRAME_LEN;
+    mtd_record.prev_pos -= SOFT_FRAME_LEN;
+  }
+
+  pthread_mutex_unlock( &medet_lock );
+}
+
+/*****************************************************************************/
+
+/* Medet_Resync()
+ *
+ * Makes the decoder search for sync again from the start of its
+ * soft buffer, after frames were lost between it and the demodulator
+ */
+void Medet_Resync(void) {
+  pthread_mutex_lock( &medet_lock );
+  Mtd_Resync( &mtd_record );
+  pthread_mutex_unlock( &medet_lock );
+}
+
+/*****************************************************************************/
+
+/* Medet_Frame_Counts()
+ *
+ * Returns the number of good and of all frames tried by the decoder
+ */
+void Medet_Frame_Counts(int *ok, int *total) {
+    *ok    = ok_cnt;
+    *total = total_cnt - 1;
 }
 
 /*****************************************************************************/
@@ -26,6 +26,9 @@
 void Medet_Init(void);
 void Medet_Deinit(void);
 void Decode_Image(uint8_t *in_buffer, int buf_len);
+void Decode_Frame(uint8_t *in_buffer);
+void Medet_Resync(void);
+void Medet_Frame_Counts(int *ok, int *total);
 double Sig_Quality(void);
 
 /*****************************************************************************/
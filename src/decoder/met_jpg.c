@@ -30,16 +30,34 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 /*****************************************************************************/
 
 #define MCU_PER_PACKET  14
+#define PACKET_WIDTH    ( MCU_PER_PACKET * 8 )
+
+/* Image lines first allocated to channel images, doubled as they fill */
+#define IMAGE_LINES_MIN 256
+
+/* APIDs covered by the dispatch table, all those of config files */
+#define APID_MAP_LEN    256
+
+/*****************************************************************************/
+
+/* Where the MCUs of an APID go */
+typedef struct apid_map_t {
+  uint8_t **plane;      /* Channel image, NULL if the APID isn't shown */
+  const uint8_t *lut;   /* Palette LUT, NULL to store pixels as is     */
+} apid_map_t;
 
 /*****************************************************************************/
 
 static void Save_Images(int type);
-static void Fill_Dqt_by_Q(int *dqt, int q);
-static void Fill_Pix(double *img_dct, uint32_t apid, int mcu_id, int m);
+static void Fill_Dqt_by_Q(int16_t *dqt, int q);
+static void Build_Apid_Map(void);
+static void Map_Band(uint8_t *band, int width, const uint8_t *lut);
+static bool Dec_Block(bit_reader_rec_t *b, int *prev_dc, int16_t *blk);
 static bool Progress_Image(uint32_t apid, int mcu_id, int pck_cnt);
 
 /*****************************************************************************/
@@ -50,6 +68,14 @@ static int last_y    = -1;
 static int first_pck = 0;
 static int prev_pck  = 0;
 
+/* APID dispatch table of the session, built by Mj_Init() */
+static apid_map_t apid_map[APID_MAP_LEN];
+static uint8_t invert_lut[256];
+
+/* Dequantization table of the last packet's quality */
+static int16_t dqt[64];
+static int dqt_q = -1;
+
 static const uint8_t standard_quantization_table[64] = {
     16,  11,  10,  16,  24,  40,  51,  61,
     12,  12,  14,  19,  26,  58,  60,  55,
@@ -61,19 +87,18 @@ static const uint8_t standard_quantization_table[64] = {
     72,  92,  95,  98, 112, 100, 103,  99
 };
 
-static const uint8_t zigzag[64] = {
-    0,  1,  5,  6, 14, 15, 27, 28,
-    2,  4,  7, 13, 16, 26, 29, 42,
-    3,  8, 12, 17, 25, 30, 41, 43,
-    9, 11, 18, 24, 31, 40, 44, 53,
-    10, 19, 23, 32, 39, 45, 52, 54,
-    20, 22, 33, 38, 46, 51, 55, 60,
-    21, 34, 37, 47, 50, 56, 59, 61,
-    35, 36, 48, 49, 57, 58, 62, 63
+/* Row order position of coefficients in zigzag order */
+static const uint8_t unzigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63
 };
 
-static const int dc_cat_off[12] = { 2, 3, 3, 3, 3, 3, 4, 5, 6, 7, 8, 9 };
-
 /*****************************************************************************/
 
 /* Save_Images()
@@ -236,7 +261,7 @@ void Mj_Dump_Image(void) {
 
 /*****************************************************************************/
 
-static void Fill_Dqt_by_Q(int *dqt, int q) {
+static void Fill_Dqt_by_Q(int16_t *dqt, int q) {
   double f;
   int i;
 
@@ -247,55 +272,60 @@ static void Fill_Dqt_by_Q(int *dqt, int q) {
 
   for( i = 0; i <= 63; i++ )
   {
-    dqt[i] = (int)( round(f / 100.0 * (double)standard_quantization_table[i]) );
+    dqt[i] = (int16_t)( round(f / 100.0 * (double)standard_quantization_table[i]) );
     if( dqt[i] < 1 ) dqt[i] = 1;
   }
 }
 
 /*****************************************************************************/
 
-static void Fill_Pix(double *img_dct, uint32_t apid, int mcu_id, int m) {
-  int i, j, t, x, y, off = 0, inv = 0;
+/* Build_Apid_Map()
+ *
+ * Maps the configured APIDs to their channel image
+ * and the APIDs of inverted palette to an inverting LUT
+ */
+static void Build_Apid_Map(void) {
+  int i;
 
-  for( i = 0; i <= 63; i++ )
-  {
-    t = (int)( round(img_dct[i] + 128.0) );
-    if( t < 0 )   t = 0;
-    if( t > 255 ) t = 255;
-    x = ( mcu_id + m ) * 8 + i % 8;
-    y = cur_y + i / 8;
-    off = x + y * METEOR_IMAGE_WIDTH;
-
-    /* Invert image palette if APID matches */
-    for( j = 0; j < 3; j++ )
-      if( apid == rc_data.invert_palette[j] ) inv = 1;
-    if( inv )
-    {
-      if( apid == rc_data.apid[RED] )
-        channel_image[RED][off]   = 255 - (uint8_t)t;
-      else if( apid == rc_data.apid[GREEN] )
-        channel_image[GREEN][off] = 255 - (uint8_t)t;
-      else if( apid == rc_data.apid[BLUE] )
-        channel_image[BLUE][off]  = 255 - (uint8_t)t;
-    }
-    else /* Normal palette */
-    {
-      if( apid == rc_data.apid[RED] )
-        channel_image[RED][off]   = (uint8_t)t;
-      else if( apid == rc_data.apid[GREEN] )
-        channel_image[GREEN][off] = (uint8_t)t;
-      else if( apid == rc_data.apid[BLUE] )
-        channel_image[BLUE][off]  = (uint8_t)t;
-    }
-  }
+  memset( apid_map, 0, sizeof(apid_map) );
+  for( i = 0; i < 256; i++ )
+    invert_lut[i] = (uint8_t)( 255 - i );
+
+  /* The first channel of an APID gets it */
+  for( i = 0; i < CHANNEL_IMAGE_NUM; i++ )
+    if( apid_map[rc_data.apid[i]].plane == NULL )
+      apid_map[rc_data.apid[i]].plane = &channel_image[i];
+
+  for( i = 0; i < 3; i++ )
+    if( rc_data.invert_palette[i] < APID_MAP_LEN )
+      apid_map[rc_data.invert_palette[i]].lut = invert_lut;
+}
+
+/*****************************************************************************/
+
+/* Map_Band()
+ *
+ * Maps width pixels of 8 image lines through lut
+ */
+static void Map_Band(uint8_t *band, int width, const uint8_t *lut) {
+  int x, y;
+
+  for( y = 0; y < 8; y++, band += METEOR_IMAGE_WIDTH )
+    for( x = 0; x < width; x++ )
+      band[x] = lut[band[x]];
 }
 
 /*****************************************************************************/
 
+/* Progress_Image()
+ *
+ * Finds the image line of a packet and grows the channel images to
+ * hold it. Capacity grows geometrically, so that images aren't
+ * reallocated and copied every 8 lines of a pass
+ */
 static bool Progress_Image(uint32_t apid, int mcu_id, int pck_cnt) {
-  static size_t prev_len = 0;
-  size_t delta_len = 0, i, s;
-  int j;
+  size_t new_size, cap;
+  int i;
 
   if( (apid == 0) || (apid == 70) )
     return false;
@@ -311,31 +341,34 @@ static bool Progress_Image(uint32_t apid, int mcu_id, int pck_cnt) {
       first_pck -= 28;
     last_mcu = 0;
     cur_y = -1;
-    prev_len = 0;
   }
 
   if( pck_cnt < prev_pck ) first_pck -= 16384;
   prev_pck = pck_cnt;
 
   cur_y = 8 * ( (pck_cnt - first_pck) / 43 );
-  if( cur_y > last_y )
+  new_size = (size_t)channel_image_width * (size_t)( cur_y + 8 );
+  if( (cur_y > last_y) && (new_size > channel_image_size) )
   {
-    channel_image_height = (uint32_t)( cur_y + 8 );
-    channel_image_size = (size_t)
-      ( channel_image_width * channel_image_height );
-    for( i = 0; i < CHANNEL_IMAGE_NUM; i++ )
-      mem_realloc( (void **)&channel_image[i], channel_image_size );
-
-    /* Clear new allocation */
-    delta_len = channel_image_size - prev_len;
-    for( i = 0; i < delta_len; i++ )
+    if( new_size > channel_image_capacity )
     {
-      s = i + prev_len;
-      for( j = 0; j < CHANNEL_IMAGE_NUM; j++ )
-        channel_image[j][s] = 0;
+      cap = channel_image_capacity;
+      if( cap == 0 )
+        cap = (size_t)channel_image_width * IMAGE_LINES_MIN;
+      while( cap < new_size ) cap *= 2;
+
+      for( i = 0; i < CHANNEL_IMAGE_NUM; i++ )
+        mem_realloc( (void **)&channel_image[i], cap );
+      channel_image_capacity = cap;
     }
 
-    prev_len = channel_image_size;
+    /* Clear the new image lines */
+    for( i = 0; i < CHANNEL_IMAGE_NUM; i++ )
+      memset( &channel_image[i][channel_image_size], 0,
+          new_size - channel_image_size );
+
+    channel_image_height = (uint32_t)( cur_y + 8 );
+    channel_image_size = new_size;
   }
   last_y = cur_y;
 
@@ -344,93 +377,117 @@ static bool Progress_Image(uint32_t apid, int mcu_id, int pck_cnt) {
 
 /*****************************************************************************/
 
+/* Dec_Block()
+ *
+ * Entropy decodes the quantized coefficients of an MCU to blk,
+ * in row order. blk must be zeroed, only nonzero ones are stored
+ */
+static bool Dec_Block(bit_reader_rec_t *b, int *prev_dc, int16_t *blk) {
+  uint16_t dc, ac, n;
+  int k, dc_cat, ac_run, ac_size;
+
+  /* A refill holds a code and its value bits */
+  Bitop_Refill( b );
+  dc = Get_DC( (uint16_t)(Bitop_Peek(b, 16)) );
+  if( dc == 0 )
+  {
+    Show_Message( "Bad DC huffman code!", "red" );
+    return( false );
+  }
+  dc_cat = HUFF_SIZE( dc );
+  Bitop_Skip( b, HUFF_LEN(dc) );
+  n = (uint16_t)(Bitop_Read(b, dc_cat));
+
+  /* Beyond IDCT_COEF_MAX it dequantizes to the same clamped value */
+  *prev_dc += Map_Range( dc_cat, n );
+  if( *prev_dc > IDCT_COEF_MAX )
+    blk[0] = IDCT_COEF_MAX;
+  else if( *prev_dc < -IDCT_COEF_MAX )
+    blk[0] = -IDCT_COEF_MAX;
+  else
+    blk[0] = (int16_t)( *prev_dc );
+
+  k = 1;
+  while( k < 64 )
+  {
+    Bitop_Refill( b );
+    ac = Get_AC( (uint16_t)(Bitop_Peek(b, 16)) );
+    if( ac == 0 )
+    {
+      Show_Message( "Bad AC huffman code!", "red" );
+      return( false );
+    }
+    ac_size = HUFF_SIZE( ac );
+    ac_run  = HUFF_RUN( ac );
+    Bitop_Skip( b, HUFF_LEN(ac) );
+
+    /* End of block */
+    if( (ac_run == 0) && (ac_size == 0) )
+      break;
+
+    /* Zeros are already in place */
+    k += ac_run;
+
+    if( ac_size != 0 )
+    {
+      n = (uint16_t)(Bitop_Read(b, ac_size));
+      if( k < 64 )
+        blk[unzigzag[k]] = (int16_t)( Map_Range(ac_size, n) );
+      k++;
+    }
+    else if( ac_run == 15 )
+      k++;
+  }
+
+  return( true );
+}
+
+/*****************************************************************************/
+
 void Mj_Dec_Mcus(
         uint8_t *p,
+        int len,
         uint32_t apid,
         int pck_cnt,
         int mcu_id,
         uint8_t q) {
-  bit_io_rec_t b;
-  int i, m;
-  uint16_t k, n;
-  double prev_dc;
-  int dc_cat, ac;
-  double dct[64];
-  double zdct[64];
-  double img_dct[64];
-  int dqt[64];
-  int ac_run, ac_size, ac_len;
-
-  b.p = p;
-  b.pos = 0;
+  bit_reader_rec_t b;
+  int m, prev_dc;
+  const apid_map_t *map;
+  int16_t coef[MCU_PER_PACKET * 64] __attribute__((aligned(32)));
+  uint8_t *band;
+
+  Bitop_ReaderInit( &b, p, len );
 
   if( !Progress_Image(apid, mcu_id, pck_cnt) )
     return;
 
-  Fill_Dqt_by_Q( dqt, q );
-
-  prev_dc = 0;
-  m = 0;
-  while( m < MCU_PER_PACKET )
-  {
-    dc_cat = Get_DC( (uint16_t)(Bitop_PeekNBits(&b, 16)) );
-    if( dc_cat == -1 )
-    {
-      Show_Message( "Bad DC huffman code!", "red" );
-      return;
-    }
-    Bitop_AdvanceNBits(&b, dc_cat_off[dc_cat]);
-    n = (uint16_t)(Bitop_FetchNBits(&b, dc_cat));
-
-    zdct[0] = Map_Range( dc_cat, n ) + prev_dc;
-    prev_dc = zdct[0];
-
-    k = 1;
-    while( k < 64 )
-    {
-      ac = Get_AC( (uint16_t)(Bitop_PeekNBits(&b, 16)) );
-      if( ac == -1 )
-      {
-        Show_Message( "Bad DC huffman code!", "red" );
-        return;
-      }
-      ac_len  = ac_table[ac].len;
-      ac_size = ac_table[ac].size;
-      ac_run  = ac_table[ac].run;
-      Bitop_AdvanceNBits(&b, ac_len);
-
-      if( (ac_run == 0) && (ac_size == 0) )
-      {
-        for( i = k; i <= 63; i++ ) zdct[i] = 0;
-        break;
-      }
+  /* The packet's MCUs must fit in the image line */
+  if( mcu_id * 8 + PACKET_WIDTH > METEOR_IMAGE_WIDTH )
+    return;
 
-      for( i = 0; i < ac_run; i++ )
-      {
-        zdct[k] = 0;
-        k++;
-      }
+  if( (apid >= APID_MAP_LEN) || (apid_map[apid].plane == NULL) )
+    return;
+  map = &apid_map[apid];
 
-      if( ac_size != 0 )
-      {
-        n = (uint16_t)(Bitop_FetchNBits(&b, ac_size));
-        zdct[k] = Map_Range( ac_size, n );
-        k++;
-      }
-      else if( ac_run == 15 )
-      {
-        zdct[k] = 0;
-        k++;
-      }
-    }
+  if( q != dqt_q )
+  {
+    Fill_Dqt_by_Q( dqt, q );
+    dqt_q = q;
+  }
 
-    for( i = 0; i <= 63; i++ )
-      dct[i] = zdct[ zigzag[i] ] * dqt[i];
+  /* Entropy decode all MCUs first, the bit parsing is branchy */
+  memset( coef, 0, sizeof(coef) );
+  prev_dc = 0;
+  for( m = 0; m < MCU_PER_PACKET; m++ )
+    if( !Dec_Block(&b, &prev_dc, &coef[m * 64]) )
+      break;
 
-    Flt_Idct_8x8( img_dct, dct );
-    Fill_Pix( img_dct, apid, mcu_id, m );
-    m++;
-  }
+  /* Then dequantize and IDCT the MCUs decoded, straight into the image */
+  band = &(*map->plane)[cur_y * METEOR_IMAGE_WIDTH + mcu_id * 8];
+  Idct_Blocks( coef, dqt, m, band, METEOR_IMAGE_WIDTH );
+  if( map->lut )
+    Map_Band( band, m * 8, map->lut );
 
   /* My addition, incrementally display LRPT images */
   Display_Scaled_Image( channel_image, apid, cur_y );
@@ -440,6 +497,9 @@ void Mj_Dec_Mcus(
 
 void Mj_Init(void) {
   Default_Huffman_Table();
+  Idct_Init();
+  Build_Apid_Map();
+  dqt_q     = -1;
   last_mcu  = -1;
   cur_y     = 0;
   last_y    = -1;
@@ -24,7 +24,13 @@
 /*****************************************************************************/
 
 void Mj_Dump_Image(void);
-void Mj_Dec_Mcus(uint8_t *p, uint32_t apid, int pck_cnt, int mcu_id, uint8_t q);
+void Mj_Dec_Mcus(
+        uint8_t *p,
+        int len,
+        uint32_t apid,
+        int pck_cnt,
+        int mcu_id,
+        uint8_t q);
 void Mj_Init(void);
 
 /*****************************************************************************/
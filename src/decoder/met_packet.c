@@ -17,6 +17,8 @@
 #include "met_packet.h"
 
 #include "../common/shared.h"
+#include "../glrpt/display.h"
+#include "../glrpt/utils.h"
 #include "met_jpg.h"
 
 #include <glib.h>
@@ -35,8 +37,8 @@
 /*****************************************************************************/
 
 static void Parse_70(uint8_t *p);
-static void Act_Apd(uint8_t *p, uint32_t apid, int pck_cnt);
-static void Parse_Apd(uint8_t *p);
+static void Act_Apd(uint8_t *p, int len, uint32_t apid, int pck_cnt);
+static void Parse_Apd(uint8_t *p, int len);
 static int Parse_Partial(uint8_t *p, int len);
 
 /*****************************************************************************/
@@ -50,29 +52,31 @@ static void Parse_70(uint8_t *p) {
   int h, m, s;
   gchar txt[12];
 
+  if( isFlagSet(HEADLESS_MODE) ) return;
+
   h  = p[8];
   m  = p[9];
   s  = p[10];
 
   /* Display the Satellite's onboard time */
   snprintf( txt, sizeof(txt), "%02d:%02d:%02d", h, m, s );
-  gtk_entry_set_text( GTK_ENTRY(ob_time_entry), txt );
+  Display_Entry( ob_time_entry, txt );
 }
 
 /*****************************************************************************/
 
-static void Act_Apd(uint8_t *p, uint32_t apid, int pck_cnt) {
+static void Act_Apd(uint8_t *p, int len, uint32_t apid, int pck_cnt) {
   int mcu_id, q;
 
   mcu_id   = p[0];
   q = p[5];
 
-  Mj_Dec_Mcus( &p[6], apid, pck_cnt, mcu_id, (uint8_t)q );
+  Mj_Dec_Mcus( &p[6], len - 6, apid, pck_cnt, mcu_id, (uint8_t)q );
 }
 
 /*****************************************************************************/
 
-static void Parse_Apd(uint8_t *p) {
+static void Parse_Apd(uint8_t *p, int len) {
   uint16_t w;
   int pck_cnt;
   uint32_t apid;
@@ -91,7 +95,7 @@ static void Parse_Apd(uint8_t *p) {
   if( apid == 70 )
     Parse_70( &p[14] );
   else
-    Act_Apd( &p[14], apid, pck_cnt );
+    Act_Apd( &p[14], len - 14, apid, pck_cnt );
 }
 
 /*****************************************************************************/
@@ -112,7 +116,7 @@ static int Parse_Partial(uint8_t *p, int len) {
     return( 0 );
   }
 
-  Parse_Apd( p );
+  Parse_Apd( p, len_pck + 6 + 1 );
 
   partial_packet = false;
   return( len_pck + 6 + 1 );
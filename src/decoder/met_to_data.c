@@ -34,7 +34,9 @@
 
 /*****************************************************************************/
 
-static void Do_Full_Correlate(mtd_rec_t *mtd, uint8_t *raw, uint8_t *aligned);
+static void Align_Frame(mtd_rec_t *mtd, uint8_t *raw, uint8_t *aligned);
+static bool Do_Full_Correlate(mtd_rec_t *mtd, uint8_t *raw, uint8_t *aligned);
+static bool Do_Acquire(mtd_rec_t *mtd, uint8_t *raw, uint8_t *aligned, bool tried);
 static void Do_Next_Correlate(mtd_rec_t *mtd, uint8_t *raw, uint8_t *aligned);
 static bool Try_Frame(mtd_rec_t *mtd, uint8_t *aligned);
 
@@ -91,34 +93,95 @@ void Mtd_Init(mtd_rec_t *mtd) {
 
 /*****************************************************************************/
 
-static void Do_Full_Correlate(mtd_rec_t *mtd, uint8_t *raw, uint8_t *aligned) {
+/* Mtd_Resync()
+ *
+ * Drops the position of the next frame and the acquired sync
+ * phase in a soft stream which is no longer continuous, so that
+ * sync is searched and acquired from its start
+ */
+void Mtd_Resync(mtd_rec_t *mtd) {
+  mtd->pos      = 0;
+  mtd->prev_pos = 0;
+  mtd->cpos     = 0;
+  Corr_Acquire_Reset( &(mtd->c) );
+}
+
+/*****************************************************************************/
+
+/* Align_Frame()
+ *
+ * Aligns the frame of symbols from pos at the sync found at
+ * cpos, and moves pos past it
+ */
+static void Align_Frame(mtd_rec_t *mtd, uint8_t *raw, uint8_t *aligned) {
+  mtd->prev_pos = mtd->pos + (int)mtd->cpos;
+
+  memmove(
+      aligned,
+      &(raw[mtd->pos + (int)mtd->cpos]),
+      SOFT_FRAME_LEN - mtd->cpos );
+  memmove(
+      &(aligned[SOFT_FRAME_LEN - mtd->cpos]),
+      &(raw[mtd->pos + SOFT_FRAME_LEN]),
+      mtd->cpos );
+  mtd->pos += SOFT_FRAME_LEN + mtd->cpos;
+
+  Fix_Packet( aligned, SOFT_FRAME_LEN, (int)mtd->word );
+}
+
+/*****************************************************************************/
+
+/* Do_Full_Correlate()
+ *
+ * Searches a frame of symbols from pos for a sync pattern and
+ * aligns the frame at the best one. Returns false if even that
+ * is too weak to try, with pos left at the frame searched
+ */
+static bool Do_Full_Correlate(mtd_rec_t *mtd, uint8_t *raw, uint8_t *aligned) {
   mtd->word = (uint16_t)
     ( Corr_Correlate(&(mtd->c), &(raw[mtd->pos]), SOFT_FRAME_LEN) );
   mtd->cpos = (uint16_t)( mtd->c.position[mtd->word] );
   mtd->corr = (uint16_t)( mtd->c.correlation[mtd->word] );
 
   if( mtd->corr < MIN_CORRELATION )
+    return( false );
+
+  Align_Frame( mtd, raw, aligned );
+
+  return( true );
+}
+
+/*****************************************************************************/
+
+/* Do_Acquire()
+ *
+ * Folds a frame of symbols from pos into the sync acquired over
+ * frames and aligns the frame at the pattern recurring at the same
+ * phase, unless that is where its own best, tried already, was.
+ * Returns false if there is none to try, with pos past the frame
+ */
+static bool Do_Acquire(mtd_rec_t *mtd, uint8_t *raw, uint8_t *aligned, bool tried) {
+  int word;
+
+  word = Corr_Acquire( &(mtd->c), &(raw[mtd->pos]), (uint32_t)mtd->pos );
+  if( (word >= 0) &&
+      (mtd->c.correlation[word] >= MIN_CORRELATION) &&
+      (!tried || (word != mtd->word) ||
+       (mtd->c.position[word] != mtd->cpos)) )
   {
-    mtd->prev_pos = mtd->pos;
-    memmove( aligned, &(raw[mtd->pos]), SOFT_FRAME_LEN );
-    mtd->pos += SOFT_FRAME_LEN / 4;
-  }
-  else
-  {
-    mtd->prev_pos = mtd->pos + (int)mtd->cpos;
-
-    memmove(
-        aligned,
-        &(raw[mtd->pos + (int)mtd->cpos]),
-        SOFT_FRAME_LEN - mtd->cpos );
-    memmove(
-        &(aligned[SOFT_FRAME_LEN - mtd->cpos]),
-        &(raw[mtd->pos + SOFT_FRAME_LEN]),
-        mtd->cpos );
-    mtd->pos += SOFT_FRAME_LEN + mtd->cpos;
-
-    Fix_Packet( aligned, SOFT_FRAME_LEN, (int)mtd->word );
+    mtd->word = (uint16_t)word;
+    mtd->cpos = (uint16_t)( mtd->c.position[word] );
+    mtd->corr = (uint16_t)( mtd->c.correlation[word] );
+    Align_Frame( mtd, raw, aligned );
+    return( true );
   }
+
+  /* No sync: the frame can't be decoded, skip all of it */
+  mtd->prev_pos = mtd->pos;
+  mtd->pos  += SOFT_FRAME_LEN;
+  mtd->sig_q = 0;
+
+  return( false );
 }
 
 /*****************************************************************************/
@@ -136,7 +199,6 @@ static void Do_Next_Correlate(mtd_rec_t *mtd, uint8_t *raw, uint8_t *aligned) {
 
 static bool Try_Frame(mtd_rec_t *mtd, uint8_t *aligned) {
   int j;
-  uint8_t ecc_buf[256];
   uint32_t temp;
 
   if( decoded == NULL )
@@ -170,12 +232,8 @@ static bool Try_Frame(mtd_rec_t *mtd, uint8_t *aligned) {
   for( j = 0; j < HARD_FRAME_LEN - 4; j++ )
     decoded[4 + j] ^= prand[j % 255];
 
-  for( j = 0; j <= 3; j++ )
-  {
-    Ecc_Deinterleave( &(decoded[4]), ecc_buf, j, 4 );
-    mtd->r[j] = Ecc_Decode( ecc_buf, 0 );
-    Ecc_Interleave( ecc_buf, mtd->ecced_data, j, 4 );
-  }
+  memcpy( mtd->ecced_data, &(decoded[4]), HARD_FRAME_LEN - 4 );
+  Ecc_Decode_Interleaved( mtd->ecced_data, mtd->r );
 
   return (mtd->r[0] && mtd->r[1] && mtd->r[2] && mtd->r[3]);
 }
@@ -184,7 +242,7 @@ static bool Try_Frame(mtd_rec_t *mtd, uint8_t *aligned) {
 
 bool Mtd_One_Frame(mtd_rec_t *mtd, uint8_t *raw) {
     uint8_t aligned[SOFT_FRAME_LEN];
-    bool result = false;
+    bool result = false, acquired = false;
 
     if (mtd->cpos == 0) {
         Do_Next_Correlate(mtd, raw, aligned);
@@ -195,10 +253,26 @@ bool Mtd_One_Frame(mtd_rec_t *mtd, uint8_t *raw) {
     }
 
     if (!result) {
-        Do_Full_Correlate(mtd, raw, aligned);
-        result = Try_Frame(mtd, aligned);
+        int start = mtd->pos;
+        bool tried = Do_Full_Correlate(mtd, raw, aligned);
+
+        if (tried)
+            result = Try_Frame(mtd, aligned);
+
+        /* The best of a frame of random symbols often beats a weak
+         * sync, so then take the pattern recurring at the same phase */
+        if (!result && (mtd->corr <= CORR_LIMIT)) {
+            mtd->pos = start;
+            if (Do_Acquire(mtd, raw, aligned, tried))
+                acquired = result = Try_Frame(mtd, aligned);
+        }
     }
 
+    /* Sync is found without acquisition, which is
+     * over, and its table freed, till sync is lost */
+    if (result && !acquired)
+        Corr_Acquire_Reset(&(mtd->c));
+
     return result;
 }
 
@@ -48,6 +48,7 @@ typedef struct mtd_rec_t {
 /*****************************************************************************/
 
 void Mtd_Init(mtd_rec_t *mtd);
+void Mtd_Resync(mtd_rec_t *mtd);
 uint8_t **ret_decoded(void);
 bool Mtd_One_Frame(mtd_rec_t *mtd, uint8_t *raw);
 
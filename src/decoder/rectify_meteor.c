@@ -573,7 +573,8 @@ void Rectify_Images(void) {
     memmove( temp_image, channel_image[idx], orig_size );
 
     /* Re-allocate image buffer and rectify */
-    mem_realloc( (void **) &channel_image[idx], new_size );
+    if( new_size > channel_image_capacity )
+      mem_realloc( (void **) &channel_image[idx], new_size );
     switch( rc_data.rectify_function )
     {
       case 1:
@@ -590,6 +591,9 @@ void Rectify_Images(void) {
     }
   }
 
+  if( new_size > channel_image_capacity )
+    channel_image_capacity = new_size;
+
   SetFlag( IMAGES_RECTIFIED );
   free_ptr( (void **) &temp_image );
 }
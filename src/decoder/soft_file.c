@@ -0,0 +1,335 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+#include "soft_file.h"
+
+#include "../common/common.h"
+#include "../glrpt/utils.h"
+#include "medet.h"
+#include "met_jpg.h"
+#include "met_to_data.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*****************************************************************************/
+
+/* Header of soft symbols files packed to 4 bits per symbol.
+ * Unpacked files are plain 8 bit symbols with no header */
+#define SOFT_PACKED_MAGIC   "LRPTSYM4"
+#define SOFT_MAGIC_LEN      8
+
+/* Frames the recording ring can hold before frames are dropped */
+#define SOFT_RING_LEN       64
+
+/* stdio buffer of the recording file */
+#define SOFT_FILE_BUF_LEN   (4 * SOFT_FRAME_LEN)
+
+/*****************************************************************************/
+
+static void Pack_Frame(const int8_t *frame, uint8_t *packed);
+static void Unpack_Frame(const uint8_t *packed, int8_t *frame);
+static void *Soft_File_Writer(void *arg);
+
+/*****************************************************************************/
+
+/* Soft symbols recording: file, ring of frames shared with the
+ * writer thread, ring indices and count of frames dropped on overrun */
+static FILE *rec_fp = NULL;
+static char *rec_fbuf = NULL;
+static int8_t *rec_ring = NULL;
+static uint32_t rec_head, rec_tail, rec_dropped;
+static bool rec_packed, rec_stop;
+static pthread_t rec_thread;
+static pthread_mutex_t rec_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rec_cond = PTHREAD_COND_INITIALIZER;
+
+/*****************************************************************************/
+
+/* Pack_Frame()
+ *
+ * Quantizes a frame of soft symbols to 4 bits, two per byte
+ */
+static void Pack_Frame(const int8_t *frame, uint8_t *packed) {
+    for (int idx = 0; idx < SOFT_FRAME_LEN; idx += 2)
+        packed[idx / 2] = (uint8_t)(((frame[idx] >> 4) << 4) |
+                ((frame[idx + 1] >> 4) & 0x0F));
+}
+
+/*****************************************************************************/
+
+/* Unpack_Frame()
+ *
+ * Expands 4 bit soft symbols to the middle of their 8 bit range
+ */
+static void Unpack_Frame(const uint8_t *packed, int8_t *frame) {
+    for (int idx = 0; idx < SOFT_FRAME_LEN; idx += 2) {
+        frame[idx]     = (int8_t)((packed[idx / 2] & 0xF0) | 0x08);
+        frame[idx + 1] = (int8_t)((uint8_t)(packed[idx / 2] << 4) | 0x08);
+    }
+}
+
+/*****************************************************************************/
+
+/* Soft_File_Decode()
+ *
+ * Decodes images from a file of soft symbols as written by the
+ * demodulator (8 bit or packed 4 bit), as fast as the decoder
+ * can go, and reports throughput
+ */
+bool Soft_File_Decode(const char *fname) {
+    char mesg[MESG_SIZE];
+    char magic[SOFT_MAGIC_LEN];
+    FILE *fp;
+    int8_t *buffer = NULL;
+    uint8_t packed[SOFT_FRAME_LEN / 2];
+    bool is_packed;
+    size_t len;
+    uint32_t frames = 0;
+    int ok, total;
+    struct timespec beg, end;
+    double secs;
+
+    if (!Open_File(&fp, fname, "rb"))
+        return false;
+
+    /* Packed files start with a magic, others are raw symbols */
+    is_packed = (fread(magic, 1, SOFT_MAGIC_LEN, fp) == SOFT_MAGIC_LEN) &&
+        (memcmp(magic, SOFT_PACKED_MAGIC, SOFT_MAGIC_LEN) == 0);
+    if (!is_packed)
+        rewind(fp);
+
+    /* Same 3 section buffer as used by the demodulator */
+    mem_alloc((void **)&buffer, 3 * SOFT_FRAME_LEN);
+    int8_t *buf_midl = buffer + SOFT_FRAME_LEN;
+    int8_t *buf_lowr = buffer + 2 * SOFT_FRAME_LEN;
+
+    Medet_Init();
+    SetFlag(STATUS_DECODING);
+    ClearFlag(IMAGES_PROCESSED);
+    ClearFlag(IMAGES_RECTIFIED);
+    ClearFlag(IMAGE_COLORIZED);
+
+    snprintf(mesg, sizeof(mesg), "Decoding Soft Symbols from \"%s\"", fname);
+    Show_Message(mesg, "green");
+
+    clock_gettime(CLOCK_MONOTONIC, &beg);
+
+    while (true) {
+        if (is_packed) {
+            len = 2 * fread(packed, 1, sizeof(packed), fp);
+            Unpack_Frame(packed, buf_lowr);
+        }
+        else
+            len = fread(buf_lowr, 1, SOFT_FRAME_LEN, fp);
+
+        if (len == 0)
+            break;
+
+        /* Pad last partial frame with erased symbols */
+        if (len < SOFT_FRAME_LEN)
+            memset(buf_lowr + len, 0, SOFT_FRAME_LEN - len);
+
+        /* Move the 2 lower parts of buffer to the top and
+         * decode as Demodulator_Run() does for a new frame */
+        memmove(buffer, buf_midl, 2 * SOFT_FRAME_LEN);
+        Decode_Frame((uint8_t *)buffer);
+
+        frames++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fclose(fp);
+
+    /* Report decoder throughput */
+    secs = (double)(end.tv_sec - beg.tv_sec) +
+        (double)(end.tv_nsec - beg.tv_nsec) / 1.0e9;
+    if (secs <= 0.0)
+        secs = 1.0e-9;
+
+    Medet_Frame_Counts(&ok, &total);
+
+    snprintf(mesg, sizeof(mesg),
+            "Decoded %u Soft Frames in %.3f sec: %.1f frames/s",
+            frames, secs, (double)frames / secs);
+    Show_Message(mesg, "black");
+    snprintf(mesg, sizeof(mesg),
+            "Frames OK: %d of %d tried, %.1f MB/s of soft symbols",
+            ok, total, (double)frames * SOFT_FRAME_LEN / secs / 1.0e6);
+    Show_Message(mesg, "black");
+
+    /* Process and save images as at the end of reception */
+    Mj_Dump_Image();
+
+    ClearFlag(STATUS_DECODING);
+    Medet_Deinit();
+    free_ptr((void **)&buffer);
+
+    return true;
+}
+
+/*****************************************************************************/
+
+/* Soft_File_Writer()
+ *
+ * Runs in a thread of its own and writes recorded
+ * frames from the ring to file till recording stops
+ */
+static void *Soft_File_Writer(void *arg) {
+    uint8_t packed[SOFT_FRAME_LEN / 2];
+    int8_t *frame;
+
+    (void)arg;
+
+    while (true) {
+        /* Wait for a frame or stop request */
+        pthread_mutex_lock(&rec_mutex);
+        while ((rec_head == rec_tail) && !rec_stop)
+            pthread_cond_wait(&rec_cond, &rec_mutex);
+
+        if (rec_head == rec_tail) {
+            pthread_mutex_unlock(&rec_mutex);
+            break;
+        }
+
+        frame = rec_ring + (rec_tail % SOFT_RING_LEN) * SOFT_FRAME_LEN;
+        pthread_mutex_unlock(&rec_mutex);
+
+        if (rec_packed) {
+            Pack_Frame(frame, packed);
+            fwrite(packed, 1, sizeof(packed), rec_fp);
+        }
+        else
+            fwrite(frame, 1, SOFT_FRAME_LEN, rec_fp);
+
+        /* Free the ring slot */
+        pthread_mutex_lock(&rec_mutex);
+        rec_tail++;
+        pthread_mutex_unlock(&rec_mutex);
+    }
+
+    return NULL;
+}
+
+/*****************************************************************************/
+
+/* Soft_File_Open()
+ *
+ * Opens a file for recording demodulator soft symbols,
+ * optionally packed to 4 bits, and starts its writer thread
+ */
+bool Soft_File_Open(const char *fname, bool packed) {
+    char mesg[MESG_SIZE];
+
+    if (rec_fp)
+        return true;
+
+    if (!Open_File(&rec_fp, fname, "wb"))
+        return false;
+
+    mem_alloc((void **)&rec_fbuf, SOFT_FILE_BUF_LEN);
+    setvbuf(rec_fp, rec_fbuf, _IOFBF, SOFT_FILE_BUF_LEN);
+
+    if (packed)
+        fwrite(SOFT_PACKED_MAGIC, 1, SOFT_MAGIC_LEN, rec_fp);
+
+    mem_alloc((void **)&rec_ring, (size_t)SOFT_RING_LEN * SOFT_FRAME_LEN);
+    rec_head    = 0;
+    rec_tail    = 0;
+    rec_dropped = 0;
+    rec_packed  = packed;
+    rec_stop    = false;
+
+    if (pthread_create(&rec_thread, NULL, Soft_File_Writer, NULL) != 0) {
+        Show_Message("Failed to create Soft Symbols writer thread", "red");
+        fclose(rec_fp);
+        rec_fp = NULL;
+        free_ptr((void **)&rec_fbuf);
+        free_ptr((void **)&rec_ring);
+        return false;
+    }
+
+    snprintf(mesg, sizeof(mesg), "Recording %s Soft Symbols to \"%s\"",
+            packed ? "4 bit" : "8 bit", fname);
+    Show_Message(mesg, "green");
+
+    return true;
+}
+
+/*****************************************************************************/
+
+/* Soft_File_Write()
+ *
+ * Queues a frame of soft symbols for recording. Never blocks
+ * the caller: the frame is dropped (and counted) if the ring
+ * is full. Does nothing if recording is not open
+ */
+void Soft_File_Write(const int8_t *frame) {
+    if (!rec_fp)
+        return;
+
+    /* Only the writer thread advances rec_tail */
+    pthread_mutex_lock(&rec_mutex);
+    uint32_t used = rec_head - rec_tail;
+    pthread_mutex_unlock(&rec_mutex);
+
+    if (used >= SOFT_RING_LEN) {
+        rec_dropped++;
+        return;
+    }
+
+    memcpy(rec_ring + (rec_head % SOFT_RING_LEN) * SOFT_FRAME_LEN,
+            frame, SOFT_FRAME_LEN);
+
+    pthread_mutex_lock(&rec_mutex);
+    rec_head++;
+    pthread_cond_signal(&rec_cond);
+    pthread_mutex_unlock(&rec_mutex);
+}
+
+/*****************************************************************************/
+
+/* Soft_File_Close()
+ *
+ * Writes out queued frames, stops the writer thread and closes file
+ */
+void Soft_File_Close(void) {
+    char mesg[MESG_SIZE];
+
+    if (!rec_fp)
+        return;
+
+    pthread_mutex_lock(&rec_mutex);
+    rec_stop = true;
+    pthread_cond_signal(&rec_cond);
+    pthread_mutex_unlock(&rec_mutex);
+    pthread_join(rec_thread, NULL);
+
+    fclose(rec_fp);
+    rec_fp = NULL;
+    free_ptr((void **)&rec_fbuf);
+    free_ptr((void **)&rec_ring);
+
+    snprintf(mesg, sizeof(mesg),
+            "Soft Symbols Recording Closed, %u frames written, %u dropped",
+            rec_tail, rec_dropped);
+    Show_Message(mesg, rec_dropped ? "orange" : "green");
+}
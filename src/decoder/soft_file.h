@@ -0,0 +1,34 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+#ifndef DECODER_SOFT_FILE_H
+#define DECODER_SOFT_FILE_H
+
+/*****************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+
+bool Soft_File_Decode(const char *fname);
+bool Soft_File_Open(const char *fname, bool packed);
+void Soft_File_Write(const int8_t *frame);
+void Soft_File_Close(void);
+
+/*****************************************************************************/
+
+#endif
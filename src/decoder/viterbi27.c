@@ -16,15 +16,21 @@
 
 #include "viterbi27.h"
 
+#include "../common/cpu.h"
 #include "../glrpt/utils.h"
 #include "bitop.h"
 #include "correlator.h"
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <strings.h>
 
+#ifdef CPU_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
 /*****************************************************************************/
 
 #define VITERBI27_POLYA     79      // 1001111
@@ -35,6 +41,13 @@
 #define NUM_ITER            128     // HIGH_BIT << 1
 #define RENORM_INTERVAL     128     // DISTANCE_MAX / (2 * SOFT_MAX) (TODO: rounded?)
 
+/* Branch metric of a symbol pair is 2 * SOFT_MAX - s0 * y0 - s1 * y1,
+ * with s = +1/-1 as the encoder output bit is 0/1. Both polynomials
+ * have the high bit set, so the branch from the high state has the
+ * complement output and its metric is 4 * SOFT_MAX - low branch */
+#define BRANCH_SUM          (2 * SOFT_MAX)
+#define BRANCH_PAIR_SUM     (4 * SOFT_MAX)
+
 /*****************************************************************************/
 
 static uint16_t Metric_Soft_Distance(
@@ -53,7 +66,13 @@ static void History_Buffer_Traceback(
         uint32_t min_traceback_length);
 static void History_Buffer_Process_Skip(viterbi27_rec_t *v, int skip);
 static void Error_Buffer_Swap(viterbi27_rec_t *v);
+static void Vit_Start(viterbi27_rec_t *v, uint8_t *soft);
 static void Vit_Inner(viterbi27_rec_t *v, uint8_t *soft);
+#ifdef CPU_X86_DISPATCH
+static void Vit_Inner_SSE2(viterbi27_rec_t *v, uint8_t *soft);
+static void Vit_Inner_AVX2(viterbi27_rec_t *v, uint8_t *soft);
+#endif
+static inline bool Vit_History_Advance(viterbi27_rec_t *v);
 static void Vit_Tail(viterbi27_rec_t *v, uint8_t *soft);
 static void Vit_Conv_Decode(
         viterbi27_rec_t *v,
@@ -66,6 +85,11 @@ static void Vit_Conv_Encode(
 
 /*****************************************************************************/
 
+/* Inner loop kernel, bound to CPU features by Mk_Viterbi27() */
+static void (*vit_inner)(viterbi27_rec_t *v, uint8_t *soft) = Vit_Inner;
+
+/*****************************************************************************/
+
 static uint16_t Metric_Soft_Distance(
         uint8_t hard,
         uint8_t soft_y0,
@@ -204,7 +228,7 @@ static void History_Buffer_Traceback(
         uint32_t min_traceback_length) {
   int j;
   uint32_t index, fetched_index, pathbit, prefetch_index, len;
-  uint8_t history;
+  uint64_t history;
 
   fetched_index = 0;
   index = (uint32_t)(v->hist_index);
@@ -214,8 +238,8 @@ static void History_Buffer_Traceback(
       index = MIN_TRACEBACK + TRACEBACK_LENGTH - 1;
     else index--;
 
-    history = v->history[index][bestpath];
-    if( history != 0 ) pathbit = HIGH_BIT;
+    history = v->history[index] >> bestpath;
+    if( history & 1 ) pathbit = HIGH_BIT;
     else pathbit = 0;
     bestpath = (bestpath | pathbit) >> 1;
   }
@@ -233,8 +257,8 @@ static void History_Buffer_Traceback(
       prefetch_index = MIN_TRACEBACK + TRACEBACK_LENGTH - 1;
     else prefetch_index--;
 
-    history = v->history[index][bestpath];
-    if( history != 0 ) pathbit = HIGH_BIT;
+    history = v->history[index] >> bestpath;
+    if( history & 1 ) pathbit = HIGH_BIT;
     else pathbit = 0;
     bestpath = (bestpath | pathbit) >> 1;
 
@@ -285,15 +309,13 @@ static void Error_Buffer_Swap(viterbi27_rec_t *v) {
 
 /*****************************************************************************/
 
-static void Vit_Inner(viterbi27_rec_t *v, uint8_t *soft) {
-  uint32_t highbase, low, high, base, offset, base_offset;
+/* Vit_Start()
+ *
+ * Runs the first 6 bits of a frame, which fan out from
+ * state 0 to all states, without recording decisions
+ */
+static void Vit_Start(viterbi27_rec_t *v, uint8_t *soft) {
   int i, j;
-  uint8_t *history;
-  uint32_t low_key, high_key, low_concat_dist, high_concat_dist;
-  uint32_t successor, low_plus_one, plus_one_successor;
-  uint16_t low_past_error, high_past_error, low_error, high_error, error;
-  uint16_t low_plus_one_error, high_plus_one_error, plus_one_error;
-  uint8_t history_mask, plus_one_history_mask;
 
   for( i = 0; i <= 5; i++ )
   {
@@ -305,6 +327,19 @@ static void Vit_Inner(viterbi27_rec_t *v, uint8_t *soft) {
     }
     Error_Buffer_Swap( v );
   }
+}
+
+/*****************************************************************************/
+
+static void Vit_Inner(viterbi27_rec_t *v, uint8_t *soft) {
+  uint32_t highbase, low, high, base, offset, base_offset;
+  int i, j;
+  uint64_t history;
+  uint32_t low_key, high_key, low_concat_dist, high_concat_dist;
+  uint32_t successor, low_plus_one, plus_one_successor;
+  uint16_t low_past_error, high_past_error, low_error, high_error, error;
+  uint16_t low_plus_one_error, high_plus_one_error, plus_one_error;
+  uint64_t history_mask, plus_one_history_mask;
 
   for( i = 6; i <= FRAME_BITS - 7; i++ )
   {
@@ -313,7 +348,7 @@ static void Vit_Inner(viterbi27_rec_t *v, uint8_t *soft) {
       int idx = (soft[i * 2 + 1] << 8) + soft[i * 2];
       v->distances[j] = v->dist_table[j][idx];
     }
-    history = &(v->history[v->hist_index][0]);
+    history = 0;
 
     Pair_Lookup_Fill_Distance( v );
 
@@ -351,7 +386,7 @@ static void Vit_Inner(viterbi27_rec_t *v, uint8_t *soft) {
           history_mask = 1;
         }
         v->write_errors[successor] = error;
-        history[successor] = history_mask;
+        history |= history_mask << successor;
 
         low_plus_one = low + offset + 1;
 
@@ -370,7 +405,7 @@ static void Vit_Inner(viterbi27_rec_t *v, uint8_t *soft) {
           plus_one_history_mask = 1;
         }
         v->write_errors[plus_one_successor] = plus_one_error;
-        history[plus_one_successor] = plus_one_history_mask;
+        history |= plus_one_history_mask << plus_one_successor;
 
         offset += 2;
         base_offset++;
@@ -380,6 +415,7 @@ static void Vit_Inner(viterbi27_rec_t *v, uint8_t *soft) {
       high += 8;
       base += 4;
     }
+    v->history[v->hist_index] = history;
 
     History_Buffer_Process_Skip( v, 1 );
     Error_Buffer_Swap( v );
@@ -388,16 +424,228 @@ static void Vit_Inner(viterbi27_rec_t *v, uint8_t *soft) {
 
 /*****************************************************************************/
 
+/* Vit_History_Advance()
+ *
+ * Advances history after a bit of the SIMD kernels. Returns false,
+ * without advancing, when renormalization or traceback is due: the
+ * kernel must then store its metrics to write_errors and call
+ * History_Buffer_Process_Skip(), as Vit_Inner() does every bit
+ */
+static inline bool Vit_History_Advance(viterbi27_rec_t *v) {
+    if ((v->renormalize_counter == RENORM_INTERVAL - 1) ||
+            (v->len == MIN_TRACEBACK + TRACEBACK_LENGTH - 1))
+        return false;
+
+    v->hist_index++;
+    if (v->hist_index == MIN_TRACEBACK + TRACEBACK_LENGTH)
+        v->hist_index = 0;
+    v->renormalize_counter++;
+    v->len++;
+
+    return true;
+}
+
+/*****************************************************************************/
+
+#ifdef CPU_X86_DISPATCH
+/* Vit_Inner_SSE2()
+ *
+ * Same as Vit_Inner(), with the 64 path metrics held in 8 vectors
+ * of 16 bit unsigned ints. Branch metrics are computed from the
+ * soft symbols, and the decisions of a bit are packed into a word.
+ * Metrics are only stored for renormalization and traceback, at
+ * the same steps as Vit_Inner(), so the output is the same
+ */
+__attribute__((target("sse2")))
+static void Vit_Inner_SSE2(viterbi27_rec_t *v, uint8_t *soft) {
+    __m128i metric[8], next[8], sign0[8], sign1[8];
+    __m128i low_dist, high_dist, low_err, high_err, diff, low_dec, high_dec;
+    const __m128i branch_sum = _mm_set1_epi16(BRANCH_SUM);
+    const __m128i pair_sum   = _mm_set1_epi16(BRANCH_PAIR_SUM);
+    const __m128i zero       = _mm_setzero_si128();
+    int16_t signs[2][NUM_STATES / 2];
+    uint64_t history;
+
+    /* Signs of the soft symbols in branch metrics
+     * of the successor states, from encoder output */
+    for (int s = 0; s < NUM_STATES / 2; s++) {
+        signs[0][s] = (v->table[s] & 1) ? -1 : 1;
+        signs[1][s] = (v->table[s] & 2) ? -1 : 1;
+    }
+
+    for (int k = 0; k < 8; k++) {
+        sign0[k]  = _mm_loadu_si128((const __m128i *)&signs[0][k * 8]);
+        sign1[k]  = _mm_loadu_si128((const __m128i *)&signs[1][k * 8]);
+        metric[k] = _mm_loadu_si128((const __m128i *)&v->read_errors[k * 8]);
+    }
+
+    for (int i = 6; i <= FRAME_BITS - 7; i++) {
+        __m128i y0 = _mm_set1_epi16((int8_t)soft[i * 2]);
+        __m128i y1 = _mm_set1_epi16((int8_t)soft[i * 2 + 1]);
+
+        /* Successors 2s and 2s + 1 come from states s and s + 32,
+         * so 8 successors at a time take 4 duplicated metrics */
+        history = 0;
+        for (int k = 0; k < 8; k += 2) {
+            __m128i low  = metric[k / 2];
+            __m128i high = metric[k / 2 + 4];
+
+            low_dist = _mm_sub_epi16(branch_sum, _mm_add_epi16(
+                        _mm_mullo_epi16(sign0[k], y0),
+                        _mm_mullo_epi16(sign1[k], y1)));
+            high_dist = _mm_sub_epi16(pair_sum, low_dist);
+            low_err  = _mm_add_epi16(_mm_unpacklo_epi16(low, low), low_dist);
+            high_err = _mm_add_epi16(_mm_unpacklo_epi16(high, high), high_dist);
+
+            /* Select the low path on ties, as in Vit_Inner() */
+            diff    = _mm_subs_epu16(low_err, high_err);
+            next[k] = _mm_sub_epi16(low_err, diff);
+            low_dec = _mm_cmpeq_epi16(diff, zero);
+
+            low_dist = _mm_sub_epi16(branch_sum, _mm_add_epi16(
+                        _mm_mullo_epi16(sign0[k + 1], y0),
+                        _mm_mullo_epi16(sign1[k + 1], y1)));
+            high_dist = _mm_sub_epi16(pair_sum, low_dist);
+            low_err  = _mm_add_epi16(_mm_unpackhi_epi16(low, low), low_dist);
+            high_err = _mm_add_epi16(_mm_unpackhi_epi16(high, high), high_dist);
+
+            diff        = _mm_subs_epu16(low_err, high_err);
+            next[k + 1] = _mm_sub_epi16(low_err, diff);
+            high_dec    = _mm_cmpeq_epi16(diff, zero);
+
+            history |= (uint64_t)(~_mm_movemask_epi8(
+                        _mm_packs_epi16(low_dec, high_dec)) & 0xFFFF) << (k * 8);
+        }
+        v->history[v->hist_index] = history;
+
+        for (int k = 0; k < 8; k++)
+            metric[k] = next[k];
+
+        if (!Vit_History_Advance(v)) {
+            for (int k = 0; k < 8; k++)
+                _mm_storeu_si128((__m128i *)&v->write_errors[k * 8], metric[k]);
+
+            History_Buffer_Process_Skip(v, 1);
+
+            for (int k = 0; k < 8; k++)
+                metric[k] = _mm_loadu_si128(
+                        (const __m128i *)&v->write_errors[k * 8]);
+        }
+    }
+
+    for (int k = 0; k < 8; k++)
+        _mm_storeu_si128((__m128i *)&v->write_errors[k * 8], metric[k]);
+    Error_Buffer_Swap(v);
+}
+
+/*****************************************************************************/
+
+/* Vit_Inner_AVX2()
+ *
+ * Same as Vit_Inner_SSE2() with the path metrics in 4 vectors.
+ * Unpack works within 128 bit lanes, so metrics are permuted to
+ * put states 4 apart in a lane before duplicating them, and packed
+ * decisions are permuted back to successor order
+ */
+__attribute__((target("avx2")))
+static void Vit_Inner_AVX2(viterbi27_rec_t *v, uint8_t *soft) {
+    __m256i metric[4], next[4], sign0[4], sign1[4];
+    __m256i low_dist, high_dist, low_err, high_err, diff, low_dec, high_dec;
+    const __m256i branch_sum = _mm256_set1_epi16(BRANCH_SUM);
+    const __m256i pair_sum   = _mm256_set1_epi16(BRANCH_PAIR_SUM);
+    const __m256i zero       = _mm256_setzero_si256();
+    int16_t signs[2][NUM_STATES / 2];
+    uint64_t history;
+
+    for (int s = 0; s < NUM_STATES / 2; s++) {
+        signs[0][s] = (v->table[s] & 1) ? -1 : 1;
+        signs[1][s] = (v->table[s] & 2) ? -1 : 1;
+    }
+
+    for (int k = 0; k < 4; k++) {
+        sign0[k]  = _mm256_loadu_si256((const __m256i *)&signs[0][k * 16]);
+        sign1[k]  = _mm256_loadu_si256((const __m256i *)&signs[1][k * 16]);
+        metric[k] = _mm256_loadu_si256(
+                (const __m256i *)&v->read_errors[k * 16]);
+    }
+
+    for (int i = 6; i <= FRAME_BITS - 7; i++) {
+        __m256i y0 = _mm256_set1_epi16((int8_t)soft[i * 2]);
+        __m256i y1 = _mm256_set1_epi16((int8_t)soft[i * 2 + 1]);
+
+        /* 16 states give their 32 successors in 2 vectors */
+        history = 0;
+        for (int k = 0; k < 4; k += 2) {
+            __m256i low  = _mm256_permute4x64_epi64(metric[k / 2], 0xD8);
+            __m256i high = _mm256_permute4x64_epi64(metric[k / 2 + 2], 0xD8);
+
+            low_dist = _mm256_sub_epi16(branch_sum, _mm256_add_epi16(
+                        _mm256_mullo_epi16(sign0[k], y0),
+                        _mm256_mullo_epi16(sign1[k], y1)));
+            high_dist = _mm256_sub_epi16(pair_sum, low_dist);
+            low_err  = _mm256_add_epi16(
+                    _mm256_unpacklo_epi16(low, low), low_dist);
+            high_err = _mm256_add_epi16(
+                    _mm256_unpacklo_epi16(high, high), high_dist);
+
+            diff    = _mm256_subs_epu16(low_err, high_err);
+            next[k] = _mm256_sub_epi16(low_err, diff);
+            low_dec = _mm256_cmpeq_epi16(diff, zero);
+
+            low_dist = _mm256_sub_epi16(branch_sum, _mm256_add_epi16(
+                        _mm256_mullo_epi16(sign0[k + 1], y0),
+                        _mm256_mullo_epi16(sign1[k + 1], y1)));
+            high_dist = _mm256_sub_epi16(pair_sum, low_dist);
+            low_err  = _mm256_add_epi16(
+                    _mm256_unpackhi_epi16(low, low), low_dist);
+            high_err = _mm256_add_epi16(
+                    _mm256_unpackhi_epi16(high, high), high_dist);
+
+            diff        = _mm256_subs_epu16(low_err, high_err);
+            next[k + 1] = _mm256_sub_epi16(low_err, diff);
+            high_dec    = _mm256_cmpeq_epi16(diff, zero);
+
+            history |= (uint64_t)(~(uint32_t)_mm256_movemask_epi8(
+                        _mm256_permute4x64_epi64(
+                            _mm256_packs_epi16(low_dec, high_dec), 0xD8)))
+                << (k * 16);
+        }
+        v->history[v->hist_index] = history;
+
+        for (int k = 0; k < 4; k++)
+            metric[k] = next[k];
+
+        if (!Vit_History_Advance(v)) {
+            for (int k = 0; k < 4; k++)
+                _mm256_storeu_si256(
+                        (__m256i *)&v->write_errors[k * 16], metric[k]);
+
+            History_Buffer_Process_Skip(v, 1);
+
+            for (int k = 0; k < 4; k++)
+                metric[k] = _mm256_loadu_si256(
+                        (const __m256i *)&v->write_errors[k * 16]);
+        }
+    }
+
+    for (int k = 0; k < 4; k++)
+        _mm256_storeu_si256((__m256i *)&v->write_errors[k * 16], metric[k]);
+    Error_Buffer_Swap(v);
+}
+#endif
+
+/*****************************************************************************/
+
 static void Vit_Tail(viterbi27_rec_t *v, uint8_t *soft) {
   int i, j;
-  uint8_t *history;
+  uint64_t *history;
   uint32_t skip, base_skip, highbase, low, high;
   uint32_t base, low_output, high_output;
   uint16_t low_dist, high_dist, low_past_error;
   uint16_t high_past_error, low_error, high_error;
   uint32_t successor;
   uint16_t error;
-  uint8_t history_mask;
+  uint64_t history_mask;
 
 
   for( i = FRAME_BITS - 6; i < FRAME_BITS; i++ )
@@ -407,7 +655,7 @@ static void Vit_Tail(viterbi27_rec_t *v, uint8_t *soft) {
       int idx = (soft[i * 2 + 1] << 8) + soft[i * 2];
       v->distances[j] = v->dist_table[j][idx];
     }
-    history = &(v->history[v->hist_index][0]);
+    history = &(v->history[v->hist_index]);
 
     skip = 1 << ( 7 - (FRAME_BITS - i) );
     base_skip = skip >> 1;
@@ -442,7 +690,8 @@ static void Vit_Tail(viterbi27_rec_t *v, uint8_t *soft) {
         history_mask = 1;
       }
       v->write_errors[successor] = error;
-      history[successor] = history_mask;
+      *history = (*history & ~((uint64_t)1 << successor)) |
+        (history_mask << successor);
 
       low += skip;
       high += skip;
@@ -474,7 +723,8 @@ static void Vit_Conv_Decode(
   v->read_errors  = &(v->errors[0][0]);
   v->write_errors = &(v->errors[1][0]);
 
-  Vit_Inner( v, soft_encoded );
+  Vit_Start( v, soft_encoded );
+  vit_inner( v, soft_encoded );
   Vit_Tail(  v, soft_encoded );
   History_Buffer_Traceback( v, 0, 0 );
 }
@@ -548,4 +798,13 @@ void Mk_Viterbi27(viterbi27_rec_t *v) {
   }
 
   Pair_Lookup_Create( v );
+
+  /* Pick the inner loop for the CPU */
+  vit_inner = Vit_Inner;
+#ifdef CPU_X86_DISPATCH
+  if( Cpu_Simd() >= CPU_SIMD_AVX2 )
+    vit_inner = Vit_Inner_AVX2;
+  else if( Cpu_Simd() >= CPU_SIMD_SSE2 )
+    vit_inner = Vit_Inner_SSE2;
+#endif
 }
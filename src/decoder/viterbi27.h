@@ -50,7 +50,8 @@ typedef struct viterbi27_rec_t {
   uint32_t pair_outputs[16];   //1 shl (2*rate)
   uint32_t pair_outputs_len;
 
-  uint8_t history[MIN_TRACEBACK + TRACEBACK_LENGTH][NUM_STATES];
+  /* Survivor decisions, a bit per state of the 64 in path metrics */
+  uint64_t history[MIN_TRACEBACK + TRACEBACK_LENGTH];
   uint8_t fetched[MIN_TRACEBACK + TRACEBACK_LENGTH];
   int hist_index, len, renormalize_counter;
 
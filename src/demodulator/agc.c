@@ -16,12 +16,18 @@
 
 #include "agc.h"
 
+#include "../common/cpu.h"
 #include "../glrpt/utils.h"
 #include "demod.h"
 
 #include <complex.h>
 #include <math.h>
 #include <stddef.h>
+#include <stdint.h>
+
+#ifdef CPU_X86_DISPATCH
+#include <immintrin.h>
+#endif
 
 /*****************************************************************************/
 
@@ -32,6 +38,42 @@
 #define AGC_BIAS_WINSIZE    262144.0 // 256*1024
 #define AGC_BIAS_WINSIZE_1  262143.0 // 256*1024 - 1
 
+/* Reciprocals of the window sizes. These are powers of 2, so
+ * multiplying by them gives exactly the same as dividing */
+#define AGC_WINSIZE_RECIP       (1.0 / AGC_WINSIZE)
+#define AGC_BIAS_WINSIZE_RECIP  (1.0 / AGC_BIAS_WINSIZE)
+
+/* Decay of the averages per sample, (N - 1) / N exactly */
+#define AGC_DECAY       (AGC_WINSIZE_1 * AGC_WINSIZE_RECIP)
+#define AGC_BIAS_DECAY  (AGC_BIAS_WINSIZE_1 * AGC_BIAS_WINSIZE_RECIP)
+
+/* Samples per pass of Agc_Apply_Block() over a block */
+#define AGC_CHUNK   256
+
+/*****************************************************************************/
+
+static void Agc_Magnitudes(
+        const double *re, const double *im, double *rho, uint32_t len);
+static inline void Agc_Debias(
+        double *bias_re, double *bias_im, const cdsp_t *in,
+        double *re, double *im, uint32_t len);
+static inline void Agc_Amplify(
+        double *average, double *gain, double target, const double *rho,
+        const double *re, const double *im, cdsp_t *out, uint32_t len);
+#ifdef CPU_X86_DISPATCH
+static void Agc_Magnitudes_SSE2(
+        const double *re, const double *im, double *rho, uint32_t len);
+static void Agc_Magnitudes_AVX2(
+        const double *re, const double *im, double *rho, uint32_t len);
+#endif
+
+/*****************************************************************************/
+
+/* Magnitude kernel, bound to CPU features by Agc_Init() */
+static void (*agc_magnitudes)(
+        const double *re, const double *im, double *rho, uint32_t len) =
+  Agc_Magnitudes;
+
 /*****************************************************************************/
 
 /* Agc_Init()
@@ -48,38 +90,207 @@ Agc_t *Agc_Init(void) {
   agc->gain        = 1.0;
   agc->bias        = 0.0;
 
+  agc_magnitudes = Agc_Magnitudes;
+#ifdef CPU_X86_DISPATCH
+  if( Cpu_Simd() >= CPU_SIMD_AVX2 )
+    agc_magnitudes = Agc_Magnitudes_AVX2;
+  else if( Cpu_Simd() >= CPU_SIMD_SSE2 )
+    agc_magnitudes = Agc_Magnitudes_SSE2;
+#endif
+
   return( agc );
 }
 
 /*****************************************************************************/
 
+/* Agc_Magnitudes()
+ *
+ * Magnitudes of len samples of real and imaginary parts re and im
+ */
+static void Agc_Magnitudes(
+        const double *re, const double *im, double *rho, uint32_t len) {
+  uint32_t idx;
+
+  for( idx = 0; idx < len; idx++ )
+    rho[idx] = sqrt( re[idx] * re[idx] + im[idx] * im[idx] );
+}
+
+/*****************************************************************************/
+
+#ifdef CPU_X86_DISPATCH
+/* Agc_Magnitudes_SSE2()
+ *
+ * Agc_Magnitudes() two samples at a time. The square root
+ * is correctly rounded, so results are the same
+ */
+__attribute__((target("sse2")))
+static void Agc_Magnitudes_SSE2(
+        const double *re, const double *im, double *rho, uint32_t len) {
+  __m128d r, i;
+  uint32_t idx;
+
+  for( idx = 0; idx + 2 <= len; idx += 2 )
+  {
+    r = _mm_loadu_pd( re + idx );
+    i = _mm_loadu_pd( im + idx );
+    r = _mm_add_pd( _mm_mul_pd(r, r), _mm_mul_pd(i, i) );
+    _mm_storeu_pd( rho + idx, _mm_sqrt_pd(r) );
+  }
+
+  Agc_Magnitudes( re + idx, im + idx, rho + idx, len - idx );
+}
+
+/*****************************************************************************/
+
+/* Agc_Magnitudes_AVX2()
+ *
+ * Agc_Magnitudes() four samples at a time
+ */
+__attribute__((target("avx2")))
+static void Agc_Magnitudes_AVX2(
+        const double *re, const double *im, double *rho, uint32_t len) {
+  __m256d r, i;
+  uint32_t idx;
+
+  for( idx = 0; idx + 4 <= len; idx += 4 )
+  {
+    r = _mm256_loadu_pd( re + idx );
+    i = _mm256_loadu_pd( im + idx );
+    r = _mm256_add_pd( _mm256_mul_pd(r, r), _mm256_mul_pd(i, i) );
+    _mm256_storeu_pd( rho + idx, _mm256_sqrt_pd(r) );
+  }
+
+  Agc_Magnitudes( re + idx, im + idx, rho + idx, len - idx );
+}
+#endif
+
+/*****************************************************************************/
+
+/* Agc_Debias()
+ *
+ * Remove the sliding window average (bias) from len samples
+ * of in, into real and imaginary parts re and im. The window
+ * constants are powers of 2 apart, so scaling the decay and
+ * the new sample separately rounds exactly like the textbook
+ * (bias * (N - 1) + x) / N, with a shorter dependency chain
+ */
+static inline void Agc_Debias(
+        double *bias_re, double *bias_im, const cdsp_t *in,
+        double *re, double *im, uint32_t len) {
+  double b_re = *bias_re;
+  double b_im = *bias_im;
+  uint32_t idx;
+
+  for( idx = 0; idx < len; idx++ )
+  {
+    b_re = b_re * AGC_BIAS_DECAY + creal( in[idx] ) * AGC_BIAS_WINSIZE_RECIP;
+    b_im = b_im * AGC_BIAS_DECAY + cimag( in[idx] ) * AGC_BIAS_WINSIZE_RECIP;
+    re[idx] = creal( in[idx] ) - b_re;
+    im[idx] = cimag( in[idx] ) - b_im;
+  }
+
+  *bias_re = b_re;
+  *bias_im = b_im;
+}
+
+/*****************************************************************************/
+
+/* Agc_Amplify()
+ *
+ * Update the magnitude average with len magnitudes rho and
+ * apply the resulting gain to samples re and im, into out
+ */
+static inline void Agc_Amplify(
+        double *average, double *gain, double target, const double *rho,
+        const double *re, const double *im, cdsp_t *out, uint32_t len) {
+  double avg = *average;
+  double g   = *gain;
+  uint32_t idx;
+
+  for( idx = 0; idx < len; idx++ )
+  {
+    avg = avg * AGC_DECAY + rho[idx] * AGC_WINSIZE_RECIP;
+
+    g = target / avg;
+    if( g > AGC_MAX_GAIN )
+      g = AGC_MAX_GAIN;
+
+    out[idx] = (cdsp_t)( re[idx] * g + im[idx] * g * I );
+  }
+
+  *average = avg;
+  *gain    = g;
+}
+
+/*****************************************************************************/
+
+/* Agc_Apply_Block()
+ *
+ * Apply the right gain to a block of samples. Gives exactly
+ * the same output and state as Agc_Apply() sample by sample.
+ * Runs over chunks of the block: bias removal, magnitudes in
+ * a SIMD kernel, then averaging and gain. Bias removal of the
+ * next chunk shares a loop with the gain of the current one,
+ * so that their two dependency chains overlap. in and out
+ * may be the same
+ */
+void Agc_Apply_Block(Agc_t *self, const cdsp_t *in, cdsp_t *out, uint32_t len) {
+  double re[2][AGC_CHUNK], im[2][AGC_CHUNK], rho[AGC_CHUNK];
+  double bias_re  = creal( self->bias );
+  double bias_im  = cimag( self->bias );
+  double average  = self->average;
+  double target   = self->target_ampl;
+  double gain     = self->gain;
+  uint32_t chunk, next, both, cur, idx;
+
+  chunk = len < AGC_CHUNK ? len : AGC_CHUNK;
+  Agc_Debias( &bias_re, &bias_im, in, re[0], im[0], chunk );
+
+  for( cur = 0; len > 0; cur ^= 1 )
+  {
+    agc_magnitudes( re[cur], im[cur], rho, chunk );
+
+    len -= chunk;
+    next = len < AGC_CHUNK ? len : AGC_CHUNK;
+    both = next < chunk ? next : chunk;
+
+    /* Bias of the next chunk and gain of this one */
+    for( idx = 0; idx < both; idx++ )
+    {
+      Agc_Debias( &bias_re, &bias_im, in + chunk + idx,
+          re[cur ^ 1] + idx, im[cur ^ 1] + idx, 1 );
+      Agc_Amplify( &average, &gain, target, rho + idx,
+          re[cur] + idx, im[cur] + idx, out + idx, 1 );
+    }
+
+    /* Whatever of the shorter last chunk is left */
+    Agc_Debias( &bias_re, &bias_im, in + chunk + both,
+        re[cur ^ 1] + both, im[cur ^ 1] + both, next - both );
+    Agc_Amplify( &average, &gain, target, rho + both,
+        re[cur] + both, im[cur] + both, out + both, chunk - both );
+
+    in   += chunk;
+    out  += chunk;
+    chunk = next;
+  }
+
+  self->bias    = bias_re + bias_im * I;
+  self->average = average;
+  self->gain    = gain;
+}
+
+/*****************************************************************************/
+
 /* Agc_Apply()
  *
  * Apply the right gain to a sample
  */
-complex double Agc_Apply(Agc_t *self, complex double sample) {
-  double rho;
-
-  /* Sliding window average */
-  self->bias *= AGC_BIAS_WINSIZE_1;
-  self->bias += sample;
-  self->bias /= AGC_BIAS_WINSIZE;
-  sample     -= self->bias;
-
-  /* Update the sample magnitude average */
-  double real = creal( sample );
-  double imag = cimag( sample );
-  rho = sqrt( real * real + imag * imag );
-  self->average *= AGC_WINSIZE_1;
-  self->average += rho;
-  self->average /= AGC_WINSIZE;
-
-  /* Apply AGC to samples */
-  self->gain = self->target_ampl / self->average;
-  if( self->gain > AGC_MAX_GAIN )
-    self->gain = AGC_MAX_GAIN;
-
-  return( sample * self->gain );
+cdsp_t Agc_Apply(Agc_t *self, cdsp_t samp) {
+  cdsp_t out;
+
+  Agc_Apply_Block( self, &samp, &out, 1 );
+
+  return( out );
 }
 
 /*****************************************************************************/
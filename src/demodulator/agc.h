@@ -19,7 +19,10 @@
 
 /*****************************************************************************/
 
+#include "../common/common.h"
+
 #include <complex.h>
+#include <stdint.h>
 
 /*****************************************************************************/
 
@@ -33,7 +36,8 @@ typedef struct Agc_t {
 /*****************************************************************************/
 
 Agc_t *Agc_Init(void);
-complex double Agc_Apply(Agc_t *self, complex double sample);
+void Agc_Apply_Block(Agc_t *self, const cdsp_t *in, cdsp_t *out, uint32_t len);
+cdsp_t Agc_Apply(Agc_t *self, cdsp_t samp);
 void Agc_Free(Agc_t *self);
 
 /*****************************************************************************/
@@ -21,18 +21,24 @@
 #include "../glrpt/callback_func.h"
 #include "../glrpt/display.h"
 #include "../glrpt/utils.h"
+#include "../decoder/frame_queue.h"
 #include "../decoder/medet.h"
 #include "../decoder/met_jpg.h"
 #include "../decoder/met_to_data.h"
+#include "../decoder/soft_file.h"
 #include "../sdr/filters.h"
+#include "../sdr/iq_file.h"
 #include "../sdr/SoapySDR.h"
 #include "agc.h"
 #include "doqpsk.h"
 #include "filters.h"
 #include "pll.h"
 
+#include <glib.h>
+
 #include <complex.h>
 #include <math.h>
+#include <pthread.h>
 #include <semaphore.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -60,19 +66,28 @@
 /* TODO refer directly */
 #define RAW_BUF_REALLOC 73728 // INTLV_BASE_LEN
 
-#define IFFT_DECIMATE   2
-
 /*****************************************************************************/
 
 static inline int8_t Clamp_Int8(double x);
-static bool Demod_QPSK(complex double fdata, int8_t *buffer);
-static bool Demod_DOQPSK(complex double fdata, int8_t *buffer);
-static bool Demod_IDOQPSK(complex double fdata, int8_t *demod_buf);
+static bool Demod_QPSK(cdsp_t fdata, int8_t *buffer);
+static bool Demod_DOQPSK(cdsp_t fdata, int8_t *buffer);
+static bool Demod_IDOQPSK(cdsp_t fdata, int8_t *demod_buf);
+static void *Demodulator_Thread(void *arg);
 
 /*****************************************************************************/
 
 static Demod_t *demodulator = NULL;
-static bool (*Demod_PSK)(complex double, int8_t *);
+static bool (*Demod_PSK)(cdsp_t, int8_t *);
+
+/* Soft symbols output buffer of the demodulator */
+static int8_t *out_buffer = NULL;
+
+/* GTK timeout source displaying demodulator snapshots */
+static guint snapshot_source = 0;
+
+/* Demodulator thread, joined by Demodulator_Stop() */
+static pthread_t demod_thread;
+static bool demod_thread_run = false;
 
 /*****************************************************************************/
 
@@ -99,8 +114,8 @@ static inline int8_t Clamp_Int8(double x) {
  *
  * Demodulate QPSK signal from Meteor
  */
-static bool Demod_QPSK(complex double fdata, int8_t *buffer) {
-  static complex double
+static bool Demod_QPSK(cdsp_t fdata, int8_t *buffer) {
+  static cdsp_t
     before  = 0.0,
     middle  = 0.0,
     current = 0.0;
@@ -129,11 +144,11 @@ static bool Demod_QPSK(complex double fdata, int8_t *buffer) {
   /* Symbol timing recovery (Gardner) */
   if( (resync_offset >= sp2) && (resync_offset < sp2p1) )
   {
-    middle = Agc_Apply( demodulator->agc, fdata );
+    middle = fdata;
   }
   else if( resync_offset >= sym_period )
   {
-    current = Agc_Apply( demodulator->agc, fdata );
+    current = fdata;
     resync_offset -= sym_period;
     resync_error   = ( cimag(current) - cimag(before) ) * cimag(middle);
     resync_offset += ( resync_error * sym_period / RESYNC_SCALE_QPSK );
@@ -173,10 +188,10 @@ static bool Demod_QPSK(complex double fdata, int8_t *buffer) {
  *
  * Demodulate DOQPSK signal from Meteor
  */
-static bool Demod_DOQPSK(complex double fdata, int8_t *buffer) {
-  complex double quad, agc;
+static bool Demod_DOQPSK(cdsp_t fdata, int8_t *buffer) {
+  cdsp_t quad;
 
-  static complex double
+  static cdsp_t
     inphase = 0.0,
     before  = 0.0,
     middle  = 0.0,
@@ -206,17 +221,15 @@ static bool Demod_DOQPSK(complex double fdata, int8_t *buffer) {
   /* Symbol timing recovery (Gardner) */
   if( (resync_offset >= sp2) && (resync_offset < sp2p1) )
   {
-    agc     = Agc_Apply( demodulator->agc, fdata );
-    inphase = Costas_Mix( demodulator->costas, agc );
-    middle  = prev_i + (complex double)I * cimag( inphase );
+    inphase = Costas_Mix( demodulator->costas, fdata );
+    middle  = prev_i + (cdsp_t)I * cimag( inphase );
     prev_i  = creal( inphase );
   }
   else if( resync_offset >= sym_period )
   {
     /* Symbol timing recovery (Gardner) */
-    agc     = Agc_Apply( demodulator->agc, fdata );
-    quad    = Costas_Mix( demodulator->costas, agc );
-    current = prev_i + (complex double)I * cimag( quad );
+    quad    = Costas_Mix( demodulator->costas, fdata );
+    current = prev_i + (cdsp_t)I * cimag( quad );
     prev_i = creal( quad );
 
     resync_offset -= sym_period;
@@ -258,10 +271,10 @@ static bool Demod_DOQPSK(complex double fdata, int8_t *buffer) {
  *
  * Demodulate Interleaved DOQPSK signal from Meteor
  */
-static bool Demod_IDOQPSK(complex double fdata, int8_t *demod_buf) {
-  complex double quad, agc;
+static bool Demod_IDOQPSK(cdsp_t fdata, int8_t *demod_buf) {
+  cdsp_t quad;
 
-  static complex double
+  static cdsp_t
     inphase = 0.0,
     before  = 0.0,
     middle  = 0.0,
@@ -304,17 +317,15 @@ static bool Demod_IDOQPSK(complex double fdata, int8_t *demod_buf) {
     /* Symbol timing recovery (Gardner) */
     if( (resync_offset >= sp2) && (resync_offset < sp2p1) )
     {
-      agc     = Agc_Apply( demodulator->agc, fdata );
-      inphase = Costas_Mix( demodulator->costas, agc );
-      middle  = prev_i + (complex double)I * cimag( inphase );
+      inphase = Costas_Mix( demodulator->costas, fdata );
+      middle  = prev_i + (cdsp_t)I * cimag( inphase );
       prev_i  = creal( inphase );
     }
     else if( resync_offset >= sym_period )
     {
       /* Symbol timing recovery (Gardner) */
-      agc     = Agc_Apply( demodulator->agc, fdata );
-      quad    = Costas_Mix( demodulator->costas, agc );
-      current = prev_i + (complex double)I * cimag( quad );
+      quad    = Costas_Mix( demodulator->costas, fdata );
+      current = prev_i + (cdsp_t)I * cimag( quad );
       prev_i  = creal( quad );
 
       resync_offset -= sym_period;
@@ -402,7 +413,8 @@ void Demod_Init(void) {
   /* Initialize Costas loop */
   double pll_bw =
     M_2PI * rc_data.costas_bandwidth / (double)rc_data.symbol_rate;
-  demodulator->costas = Costas_Init( pll_bw, rc_data.psk_mode );
+  demodulator->costas =
+    Costas_Init( pll_bw, rc_data.psk_mode, rc_data.costas_nco );
   demodulator->mode   = rc_data.psk_mode;
 
   /* Initialize the timing recovery variables */
@@ -514,30 +526,12 @@ double Pll_Average(void) {
  * soft symbols to the LRPT decoder functions
  */
 bool Demodulator_Run(void) {
-  uint32_t count, done, idx, buf_idx;
-  complex double  cdata, fdata;
-  static int8_t  *out_buffer = NULL;
-  uint32_t fft_decim_cnt, data_idx;
-  double sum_i, sum_q;
+  uint32_t count, done;
+  cdsp_t *fdata;
 
-  /* On user stop action */
+  /* On user stop action, Demodulator_Stop() takes over */
   if( isFlagClear(STATUS_RECEIVING) )
-  {
-    Mj_Dump_Image();
-    free_ptr( (void **)&out_buffer );
-    ClearFlag( STATUS_DEMODULATING );
-
-    /* Will de-initialize systems and free
-     * buffers only if (hopefully) its safe */
-    Cleanup();
-
-    Display_Icon( frame_icon, "gtk-no" );
-    ClearFlag( FRAME_OK_ICON );
-    Display_Icon( pll_lock_icon, "gtk-no" );
-    Show_Message( "Receiving & Decoding Ended", "green" );
-    Set_Check_Menu_Item( "decode_images_menuitem",  false );
     return false;
-  }
 
   /* Allocate output buffer on first call. It is 3 sections
    * of SOFT_FRAME_LEN size, top and middle sections are used
@@ -546,84 +540,160 @@ bool Demodulator_Run(void) {
   {
     SetFlag( STATUS_DEMODULATING );
     mem_alloc( (void **)&out_buffer, 3 * SOFT_FRAME_LEN );
+
+    /* Start decoder thread fed with frames by the demodulator */
+    Frame_Queue_Start();
   }
 
-  /* Wait on DSP data to be ready for processing */
-  sem_wait( &demod_semaphore );
+  /* Read I/Q file directly, stopping at its end,
+   * or wait on a block of samples from the SDR ring */
+  if( IQ_File_Input() )
+  {
+    if( !IQ_File_Read() )
+    {
+      if( rc_data.psk_mode == IDOQPSK )
+        SetFlag( STATUS_IDOQPSK_STOP );
+      else
+        ClearFlag( STATUS_RECEIVING );
+    }
+  }
+  else
+  {
+    sem_wait( &demod_semaphore );
+
+    /* Woken up with no samples at end of reception */
+    if( !SoapySDR_Read_Block() ) return( true );
+  }
 
   /* Filter samples from SDR receiver */
-  DSP_Filter( &filter_data_i );
-  DSP_Filter( &filter_data_q );
+  DSP_Filter_IQ( &filter_data_i, &filter_data_q );
 
   /* Save samples for carrier ifft and display waterfall */
-  buf_idx  = 0;
-  sum_i    = 0.0;
-  sum_q    = 0.0;
-  data_idx = 0;
-  fft_decim_cnt = 0;
-  for( idx = 0; idx < ifft_data_length; idx++ )
+  if( isFlagClear(HEADLESS_MODE) )
+    Snapshot_Waterfall( filter_data_i.samples_buf, filter_data_q.samples_buf );
+
+  /* Interpolate and RRC filter the whole block of samples,
+   * now incorporated here in the demodulator code */
+  done  = filter_data_i.samples_buf_len * rc_data.interp_factor;
+  fdata = Filter_Interp( demodulator->rrc,
+      filter_data_i.samples_buf, filter_data_q.samples_buf,
+      filter_data_i.samples_buf_len );
+
+  /* AGC of the whole block of samples, in place */
+  Agc_Apply_Block( demodulator->agc, fdata, fdata, done );
+
+  /* Demodulate using appropriate function (QPSK|DOQPSK|IDOQPSK).
+   * Pass new frames to the decoder, to be decoded if PLL is locked */
+  for( count = 0; count < done; count++ )
   {
-    sum_i += filter_data_i.samples_buf[buf_idx];
-    sum_q += filter_data_q.samples_buf[buf_idx];
-    buf_idx++;
-
-    fft_decim_cnt++;
-    if( fft_decim_cnt >= IFFT_DECIMATE )
+    if( Demod_PSK(fdata[count], out_buffer) )
     {
-      ifft_data[data_idx++] = (int16_t)sum_i;
-      ifft_data[data_idx++] = (int16_t)sum_q;
-      fft_decim_cnt = 0;
-      sum_i = 0.0;
-      sum_q = 0.0;
+      /* Queue the new frame, now in the middle section, for
+       * recording. This only copies it to the writer's ring */
+      Soft_File_Write( out_buffer + DEMOD_BUF_MIDL );
+
+      /* Queue the new frame to the decoder thread */
+      if( isFlagSet(STATUS_DECODING) )
+        Frame_Queue_Post( out_buffer + DEMOD_BUF_MIDL,
+            demodulator->costas->locked );
     }
-  } /* for( idx = 0; idx < ifft_data_length; idx++ ) */
-  Display_Waterfall();
+  }
 
-  /* Process I/Q data from the SDR Receiver */
-  count = 0;
-  done  = filter_data_i.samples_buf_len;
-  while( count < done )
-  {
-    /* Convert filtered samples to complex variable */
-    cdata =
-      filter_data_i.samples_buf[count] +
-      filter_data_q.samples_buf[count] * (complex double)I;
-
-    /* The interpolation and RRC filtering is now
-     * incorporated here in the demodulator code */
-    for( idx = 0; idx < rc_data.interp_factor; idx++ )
-    {
-      /* Pass samples through interpolator RRC filter */
-      fdata = Filter_Fwd( demodulator->rrc, cdata );
-
-      /* Demodulate using appropriate function (QPSK|DOQPSK|IDOQPSK).
-       * Try to decode one or more LRPT frames when PLL is locked */
-      if( Demod_PSK(fdata, out_buffer) &&
-          demodulator->costas->locked  &&
-          isFlagSet(STATUS_DECODING) )
-      {
-        /* Try to decode one or more LRPT frames */
-        Decode_Image( (uint8_t *)out_buffer, SOFT_FRAME_LEN );
+  /* Done with this block of samples from the SDR ring */
+  if( !IQ_File_Input() ) SoapySDR_Release_Block();
 
-        /* The mtd_record.pos and mtd_record.prev_pos pointers must be
-         * decrimented to point back to the same data in the soft buffer */
-        mtd_record.pos      -= SOFT_FRAME_LEN;
-        mtd_record.prev_pos -= SOFT_FRAME_LEN;
+  /* Snapshot QPSK constellation and Demodulator
+   * params (AGC gain, PLL freq etc) for display */
+  if( isFlagSet(STATUS_RECEIVING) && isFlagClear(HEADLESS_MODE) )
+    Snapshot_Demod( out_buffer, demodulator );
+
+  return true;
+}
 
-      } /* if( demodulator->costas->locked ... ) */
-    } /* for( idx = 0; idx < rc_data.interp_mult; idx++ ) */
+/*****************************************************************************/
 
-    count++;
-  } /* while( count < done ) */
+/* Demodulator_Stop()
+ *
+ * Finishes reception when Demodulator_Run() has stopped:
+ * processes and saves images and frees resources. Runs in
+ * the GTK thread, as an idle callback, when there is a GUI
+ */
+gboolean Demodulator_Stop(gpointer data) {
+  if( snapshot_source )
+  {
+    g_source_remove( snapshot_source );
+    snapshot_source = 0;
+  }
 
-  if( isFlagSet(STATUS_RECEIVING) )
+  /* Make sure the demodulator thread has left Demodulator_Run() */
+  if( demod_thread_run )
   {
-    /* Display the QPSK constellation */
-    Display_QPSK_Const( out_buffer );
+    ClearFlag( STATUS_RECEIVING );
+    sem_post( &demod_semaphore );
+    pthread_join( demod_thread, NULL );
+    demod_thread_run = false;
+  }
+
+  /* Then stop streaming and free the sample ring and filters */
+  if( !IQ_File_Input() ) SoapySDR_Close_Device();
+
+  /* Decode frames still queued before processing images */
+  Frame_Queue_Stop();
+  Soft_File_Close();
+  Mj_Dump_Image();
+  free_ptr( (void **)&out_buffer );
+  ClearFlag( STATUS_DEMODULATING );
+
+  /* Will de-initialize systems and free
+   * buffers only if (hopefully) its safe */
+  Cleanup();
+
+  Display_Icon( frame_icon, "gtk-no" );
+  ClearFlag( FRAME_OK_ICON );
+  Display_Icon( pll_lock_icon, "gtk-no" );
+  Show_Message( "Receiving & Decoding Ended", "green" );
+  if( isFlagClear(HEADLESS_MODE) )
+    Set_Check_Menu_Item( "decode_images_menuitem",  false );
+
+  return( FALSE );
+}
 
-    /* Display Demodulator params (AGC gain, PLL freq etc) */
-    Display_Demod_Params( demodulator );
+/*****************************************************************************/
+
+/* Demodulator_Thread()
+ *
+ * Runs the Demodulator in a thread of its own, so that
+ * GUI activity does not hold up signal processing
+ */
+static void *Demodulator_Thread(void *arg) {
+  while( Demodulator_Run() );
+
+  /* Finish up in the GTK thread */
+  g_idle_add( Demodulator_Stop, NULL );
+
+  return( NULL );
+}
+
+/*****************************************************************************/
+
+/* Demodulator_Start()
+ *
+ * Starts the Demodulator thread and periodic display of its state
+ */
+bool Demodulator_Start(void) {
+  SetFlag( STATUS_DEMODULATING );
+
+  int ret = pthread_create( &demod_thread, NULL, Demodulator_Thread, NULL );
+  if( ret != SUCCESS )
+  {
+    Show_Message( "Failed to create Demodulator thread", "red" );
+    Error_Dialog();
+    ClearFlag( STATUS_DEMODULATING );
+    return( false );
   }
+  demod_thread_run = true;
 
-  return true;
+  snapshot_source = g_timeout_add( DISPLAY_INTERVAL, Display_Snapshot, NULL );
+
+  return( true );
 }
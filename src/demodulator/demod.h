@@ -23,6 +23,8 @@
 #include "filters.h"
 #include "pll.h"
 
+#include <glib.h>
+
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -45,6 +47,8 @@ double Agc_Gain(double *gain);
 double Signal_Level(uint32_t *level);
 double Pll_Average(void);
 bool Demodulator_Run(void);
+gboolean Demodulator_Stop(gpointer data);
+bool Demodulator_Start(void);
 
 /*****************************************************************************/
 
@@ -16,6 +16,7 @@
 
 #include "filters.h"
 
+#include "../common/cpu.h"
 #include "../glrpt/utils.h"
 #include "demod.h"
 
@@ -24,6 +25,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 /*****************************************************************************/
 
@@ -32,7 +34,49 @@ static double Compute_RRC_Coeff(
         uint32_t taps,
         double osf,
         double alpha);
-static Filter_t *Filter_New(uint32_t fwd_count, double *fwd_coeff);
+static Filter_t *Filter_Polyphase(
+        uint32_t taps,
+        const double *coeffs,
+        uint32_t factor);
+static uint32_t Filter_Phase_Vec(
+        const dsp_t *restrict coeff,
+        uint32_t taps,
+        const dsp_t *restrict x_i,
+        const dsp_t *restrict x_q,
+        uint32_t len,
+        uint32_t factor,
+        cdsp_t *restrict out);
+#ifdef CPU_X86_DISPATCH
+static uint32_t Filter_Phase_AVX2(
+        const dsp_t *restrict coeff,
+        uint32_t taps,
+        const dsp_t *restrict x_i,
+        const dsp_t *restrict x_q,
+        uint32_t len,
+        uint32_t factor,
+        cdsp_t *restrict out);
+#endif
+static void Filter_Phase(
+        const dsp_t *restrict coeff,
+        uint32_t taps,
+        const dsp_t *restrict x_i,
+        const dsp_t *restrict x_q,
+        uint32_t len,
+        uint32_t factor,
+        cdsp_t *restrict out);
+
+/*****************************************************************************/
+
+/* Kernel running a phase sub-filter over whole vectors of outputs,
+ * bound to CPU features by Filter_RRC(). None for plain C */
+static uint32_t (*filter_phase_vec)(
+        const dsp_t *restrict coeff,
+        uint32_t taps,
+        const dsp_t *restrict x_i,
+        const dsp_t *restrict x_q,
+        uint32_t len,
+        uint32_t factor,
+        cdsp_t *restrict out) = Filter_Phase_Vec;
 
 /*****************************************************************************/
 
@@ -68,29 +112,53 @@ static double Compute_RRC_Coeff(
 
 /*****************************************************************************/
 
-/* Filter_New()
+/* Filter_Polyphase()
  *
- * Create a new filter, an FIR if back_count is 0, an IIR filter
- * otherwise. Variable length arguments are two ptrs to doubles,
- * holding the coefficients to use in the filter
+ * Creates a polyphase interpolator from the taps of an FIR filter
+ * running at factor times the input rate, fed with each input
+ * sample held for factor periods (zero-order hold). The held input
+ * is folded into the taps: phase p output of input n is the sum of
+ * x[n-j] * g_p[j], where g_p[j] sums taps jL+p-L+1 to jL+p. This
+ * needs factor times fewer multiplies than the full length filter
  */
-static Filter_t *Filter_New(uint32_t fwd_count, double *fwd_coeff) {
+static Filter_t *Filter_Polyphase(
+        uint32_t taps,
+        const double *coeffs,
+        uint32_t factor) {
   Filter_t *flt = NULL;
-  uint32_t idx;
+  uint32_t phase, idx;
+  int k, kmin, kmax;
+  double sum;
 
   mem_alloc( (void **)&flt, sizeof(*flt) );
-  flt->fwd_count = fwd_count;
-  flt->fwd_coeff = NULL;
-
-  if( fwd_count )
+  flt->factor    = factor;
+  flt->phase_len = (taps - 1) / factor + 2;
+
+  /* Sub-filter taps are stored reversed, so that
+   * they run forward over the input history */
+  mem_alloc( (void **)&(flt->coeff),
+      sizeof(*flt->coeff) * factor * flt->phase_len );
+  for( phase = 0; phase < factor; phase++ )
   {
-    /* Initialize the filter memory nodes and forward coefficients */
-    mem_alloc( (void **)&(flt->fwd_coeff), sizeof(*flt->fwd_coeff) * fwd_count );
-    flt->memory = calloc( sizeof(*flt->memory), fwd_count );
-    for( idx = 0; idx < fwd_count; idx++ )
-      flt->fwd_coeff[idx] = (double)fwd_coeff[idx];
+    for( idx = 0; idx < flt->phase_len; idx++ )
+    {
+      kmax = (int)( idx * factor + phase );
+      kmin = kmax - (int)factor + 1;
+      sum  = 0.0;
+      for( k = kmin; k <= kmax; k++ )
+        if( (k >= 0) && (k < (int)taps) ) sum += coeffs[k];
+
+      flt->coeff[phase * flt->phase_len + flt->phase_len - 1 - idx] =
+        (dsp_t)sum;
+    }
   }
 
+  /* History starts zeroed, work buffers are allocated on first use */
+  mem_alloc( (void **)&(flt->hist_i), sizeof(*flt->hist_i) * flt->phase_len );
+  mem_alloc( (void **)&(flt->hist_q), sizeof(*flt->hist_q) * flt->phase_len );
+  flt->block_len = 0;
+  flt->out       = NULL;
+
   return( flt );
 }
 
@@ -117,61 +185,177 @@ Filter_t *Filter_RRC(
   for( idx = 0; idx < taps; idx++ )
     coeffs[idx] = Compute_RRC_Coeff( (int)idx, taps, osf * (double)factor, alpha );
 
-  rrc = Filter_New( taps, coeffs );
+  rrc = Filter_Polyphase( taps, coeffs, factor );
   free_ptr( (void **)&coeffs );
 
+  /* Pick the vector kernel for the CPU */
+  filter_phase_vec = Filter_Phase_Vec;
+#ifdef CPU_X86_DISPATCH
+  if( Cpu_Simd() >= CPU_SIMD_AVX2 )
+    filter_phase_vec = Filter_Phase_AVX2;
+  else if( Cpu_Simd() < CPU_SIMD_SSE2 )
+    filter_phase_vec = NULL;
+#endif
+
   return( rrc );
 }
 
 /*****************************************************************************/
 
-/* Filter_Fwd()
+/* Filter_Phase_Vec()
  *
- * Feed a signal through a filter, and output the result
+ * Runs one phase sub-filter over a block of I/Q input, vector by
+ * vector of outputs, and stores results to every factor'th output.
+ * x_i and x_q point to the history preceding the block. Returns
+ * the number of outputs done, leaving less than a vector
  */
-complex double Filter_Fwd(Filter_t *const self, complex double in) {
-  uint32_t idc;       /* Coefficients index */
-  static int idm = 0; /* Ring buiffer (memory) index */
-  complex double out;
-
-  /* Update the memory nodes, save input to first node */
-  self->memory[idm] = in;
-
-  /* Calculate the feed-forward output */
-  out = 0.0;
-  idc = 0;
-
-  /* Summate nodes till the end of the ring buffer */
-  while( idm < (int)self->fwd_count )
-    out += self->memory[idm++] * self->fwd_coeff[idc++];
-
-  /* Go back to the beginning of the ring
-   * buffer and summate remaining nodes */
-  idm = 0;
-  while( idc < self->fwd_count )
-    out += self->memory[idm++] * self->fwd_coeff[idc++];
-
-  /* Move back (left) in the ring buffer */
-  idm--;
-  if( idm < 0 ) idm += self->fwd_count;
-
-  return( out );
-
-  /****** Original code
-  size_t idx, fc_1;
-  complex double out;
-
-  Update the memory nodes
-  fc_1 = self->fwd_count - 1;
-  memmove( self->memory + 1, self->memory, sizeof(*self->memory) * fc_1 );
-  self->memory[0] = in;
-
-  Calculate the feed-forward output
-  out = in * self->fwd_coeff[0];
-  for( idx = fc_1; idx > 0; idx-- )
-    out += self->memory[idx] * self->fwd_coeff[idx];
-  return( out );
-  *********/
+static uint32_t Filter_Phase_Vec(
+        const dsp_t *restrict coeff,
+        uint32_t taps,
+        const dsp_t *restrict x_i,
+        const dsp_t *restrict x_q,
+        uint32_t len,
+        uint32_t factor,
+        cdsp_t *restrict out) {
+  const uint32_t vlen = sizeof(dsp_vec_t) / sizeof(dsp_t);
+  dsp_vec_t acc_i, acc_q, vx_i, vx_q;
+  uint32_t idn, idx, idv;
+
+  /* Whole vectors of outputs, accumulated in registers */
+  for( idn = 0; idn + vlen <= len; idn += vlen )
+  {
+    acc_i = (dsp_vec_t){ 0 };
+    acc_q = (dsp_vec_t){ 0 };
+    for( idx = 0; idx < taps; idx++ )
+    {
+      memcpy( &vx_i, x_i + idn + idx, sizeof(vx_i) );
+      memcpy( &vx_q, x_q + idn + idx, sizeof(vx_q) );
+      acc_i += coeff[idx] * vx_i;
+      acc_q += coeff[idx] * vx_q;
+    }
+
+    for( idv = 0; idv < vlen; idv++ )
+      out[(idn + idv) * factor] = acc_i[idv] + acc_q[idv] * (cdsp_t)I;
+  }
+
+  return( idn );
+}
+
+/*****************************************************************************/
+
+#ifdef CPU_X86_DISPATCH
+/* Filter_Phase_AVX2()
+ *
+ * Filter_Phase_Vec() with AVX vectors of outputs
+ */
+__attribute__((target("avx2")))
+static uint32_t Filter_Phase_AVX2(
+        const dsp_t *restrict coeff,
+        uint32_t taps,
+        const dsp_t *restrict x_i,
+        const dsp_t *restrict x_q,
+        uint32_t len,
+        uint32_t factor,
+        cdsp_t *restrict out) {
+  const uint32_t vlen = sizeof(dsp_vec_avx2_t) / sizeof(dsp_t);
+  dsp_vec_avx2_t acc_i, acc_q, vx_i, vx_q;
+  uint32_t idn, idx, idv;
+
+  for( idn = 0; idn + vlen <= len; idn += vlen )
+  {
+    acc_i = (dsp_vec_avx2_t){ 0 };
+    acc_q = (dsp_vec_avx2_t){ 0 };
+    for( idx = 0; idx < taps; idx++ )
+    {
+      memcpy( &vx_i, x_i + idn + idx, sizeof(vx_i) );
+      memcpy( &vx_q, x_q + idn + idx, sizeof(vx_q) );
+      acc_i += coeff[idx] * vx_i;
+      acc_q += coeff[idx] * vx_q;
+    }
+
+    for( idv = 0; idv < vlen; idv++ )
+      out[(idn + idv) * factor] = acc_i[idv] + acc_q[idv] * (cdsp_t)I;
+  }
+
+  return( idn );
+}
+#endif
+
+/*****************************************************************************/
+
+/* Filter_Phase()
+ *
+ * Runs one phase sub-filter over a block of I/Q input with the
+ * vector kernel, then the outputs left over one by one
+ */
+static void Filter_Phase(
+        const dsp_t *restrict coeff,
+        uint32_t taps,
+        const dsp_t *restrict x_i,
+        const dsp_t *restrict x_q,
+        uint32_t len,
+        uint32_t factor,
+        cdsp_t *restrict out) {
+  dsp_t sum_i, sum_q;
+  uint32_t idn = 0, idx;
+
+  if( filter_phase_vec )
+    idn = filter_phase_vec( coeff, taps, x_i, x_q, len, factor, out );
+
+  /* Remaining outputs */
+  for( ; idn < len; idn++ )
+  {
+    sum_i = 0.0;
+    sum_q = 0.0;
+    for( idx = 0; idx < taps; idx++ )
+    {
+      sum_i += coeff[idx] * x_i[idn + idx];
+      sum_q += coeff[idx] * x_q[idn + idx];
+    }
+
+    out[idn * factor] = sum_i + sum_q * (cdsp_t)I;
+  }
+}
+
+/*****************************************************************************/
+
+/* Filter_Interp()
+ *
+ * Interpolates and filters a block of I/Q samples. Returns
+ * len * factor output samples, valid till the next call,
+ * which the caller may modify in place
+ */
+cdsp_t *Filter_Interp(
+        Filter_t *self,
+        const dsp_t *in_i,
+        const dsp_t *in_q,
+        uint32_t len) {
+  uint32_t hlen = self->phase_len - 1;
+  uint32_t phase;
+
+  /* Grow work buffers to the block length */
+  if( len > self->block_len )
+  {
+    mem_realloc( (void **)&(self->hist_i), sizeof(dsp_t) * (hlen + len) );
+    mem_realloc( (void **)&(self->hist_q), sizeof(dsp_t) * (hlen + len) );
+    mem_realloc( (void **)&(self->out),
+        sizeof(cdsp_t) * (size_t)len * self->factor );
+    self->block_len = len;
+  }
+
+  /* Append input to the history of previous block */
+  memcpy( self->hist_i + hlen, in_i, sizeof(dsp_t) * len );
+  memcpy( self->hist_q + hlen, in_q, sizeof(dsp_t) * len );
+
+  for( phase = 0; phase < self->factor; phase++ )
+    Filter_Phase( self->coeff + phase * self->phase_len, self->phase_len,
+        self->hist_i, self->hist_q, len, self->factor, self->out + phase );
+
+  /* Keep the tail of input as history of next block */
+  memmove( self->hist_i, self->hist_i + len, sizeof(dsp_t) * hlen );
+  memmove( self->hist_q, self->hist_q + len, sizeof(dsp_t) * hlen );
+
+  return( self->out );
 }
 
 /*****************************************************************************/
@@ -181,10 +365,10 @@ complex double Filter_Fwd(Filter_t *const self, complex double in) {
  * Free a filter object
  */
 void Filter_Free(Filter_t *self) {
-  if( self->memory )
-    free_ptr( (void **)&(self->memory) );
-  if( self->fwd_count )
-    free_ptr( (void **)&(self->fwd_coeff) );
+  free_ptr( (void **)&(self->coeff) );
+  free_ptr( (void **)&(self->hist_i) );
+  free_ptr( (void **)&(self->hist_q) );
+  free_ptr( (void **)&(self->out) );
 
   free_ptr( (void **)&self );
 }
@@ -19,22 +19,42 @@
 
 /*****************************************************************************/
 
+#include "../common/common.h"
+
 #include <complex.h>
 #include <stdint.h>
 
 /*****************************************************************************/
 
+/* Width of the SIMD vectors of the interpolator, in bytes:
+ * SSE/NEON registers, and AVX ones if the CPU has AVX2 */
+#define FILTER_VEC_SIZE         16
+#define FILTER_VEC_SIZE_AVX2    32
+
+typedef dsp_t dsp_vec_t __attribute__((vector_size(FILTER_VEC_SIZE)));
+typedef dsp_t dsp_vec_avx2_t __attribute__((vector_size(FILTER_VEC_SIZE_AVX2)));
+
+/* Polyphase interpolating FIR filter */
 typedef struct Filter_t {
-    complex double *restrict memory;
-    uint32_t fwd_count;
-    uint32_t stage_no;
-    double  *restrict fwd_coeff;
+    uint32_t factor;        /* Interpolation factor, number of phases   */
+    uint32_t phase_len;     /* Taps of each phase sub-filter            */
+    dsp_t   *coeff;         /* Sub-filter taps, phase by phase, reversed */
+
+    /* Input history of phase_len - 1 samples followed by the
+     * current block, block capacity and interpolated output */
+    dsp_t   *hist_i, *hist_q;
+    uint32_t block_len;
+    cdsp_t  *out;
 } Filter_t;
 
 /*****************************************************************************/
 
 Filter_t *Filter_RRC(uint32_t order, uint32_t factor, double osf, double alpha);
-complex double Filter_Fwd(Filter_t *const self, complex double in);
+cdsp_t *Filter_Interp(
+        Filter_t *self,
+        const dsp_t *in_i,
+        const dsp_t *in_q,
+        uint32_t len);
 void Filter_Free(Filter_t *self);
 
 /*****************************************************************************/
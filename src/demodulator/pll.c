@@ -24,7 +24,10 @@
 
 #include <complex.h>
 #include <math.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <strings.h>
 
 /*****************************************************************************/
 
@@ -42,17 +45,29 @@
 #define LOCKED_BW_REDUCE    4.0     /* PLL Bandwidth reduction (in lock) */
 #define LOCKED_ERR_SCALE    10.0    /* Phase error scale on lock */
 
+/* Phasor table of the NCO, interpolated linearly between
+ * its entries, and scale of radians to accumulator units */
+#define NCO_LUT_BITS        10
+#define NCO_LUT_LEN         (1 << NCO_LUT_BITS)
+#define NCO_FRAC_BITS       (32 - NCO_LUT_BITS)
+#define NCO_FRAC_MASK       ((1u << NCO_FRAC_BITS) - 1)
+#define NCO_SCALE           (4294967296.0 / M_2PI)
+
 /*****************************************************************************/
 
 static inline double Clamp_Double(double x, double max_abs);
 static void Costas_Recompute_Coeffs(Costas_t *self, double damping, double bw);
 static double Lut_Tanh(double val);
+static inline int32_t Nco_Units(double phase);
 
 /*****************************************************************************/
 
 static double *lut_tanh = NULL;
 static double costas_err_scale;
 
+/* Phasors exp(-j*phase) of the table NCO, one extra to interpolate */
+static cdsp_t nco_lut[NCO_LUT_LEN + 1];
+
 /*****************************************************************************/
 
 /* Clamp_Double()
@@ -103,11 +118,39 @@ static double Lut_Tanh(double val) {
 
 /*****************************************************************************/
 
+/* Nco_Units()
+ *
+ * Converts a phase (or phase step) in radians, within
+ * +/- Pi, to the units of the table NCO accumulator
+ */
+static inline int32_t Nco_Units(double phase) {
+    return (int32_t)lrint(phase * NCO_SCALE);
+}
+
+/*****************************************************************************/
+
+/* Costas_Nco_Type()
+ *
+ * Maps an NCO name to a COSTAS_NCO_* value
+ */
+bool Costas_Nco_Type(const char *name, uint8_t *type) {
+    if (strcasecmp(name, "lut") == 0)
+        *type = COSTAS_NCO_LUT;
+    else if (strcasecmp(name, "cexp") == 0)
+        *type = COSTAS_NCO_CEXP;
+    else
+        return false;
+
+    return true;
+}
+
+/*****************************************************************************/
+
 /* Costas_Init()
  *
  * Initialize a Costas loop for carrier frequency/phase recovery
  */
-Costas_t *Costas_Init(double bw, ModScheme mode) {
+Costas_t *Costas_Init(double bw, ModScheme mode, uint8_t nco_type) {
   int idx;
   Costas_t *costas = NULL;
 
@@ -115,6 +158,9 @@ Costas_t *Costas_Init(double bw, ModScheme mode) {
 
   costas->nco_freq  = COSTAS_INIT_FREQ;
   costas->nco_phase = 0.0;
+  costas->nco_type  = nco_type;
+  costas->nco_acc   = 0;
+  costas->nco_step  = Nco_Units( COSTAS_INIT_FREQ );
 
   Costas_Recompute_Coeffs( costas, COSTAS_DAMP, bw );
 
@@ -149,6 +195,9 @@ Costas_t *Costas_Init(double bw, ModScheme mode) {
   for( idx = 0; idx < 256; idx++ )
     lut_tanh[idx] = tanh( (double)(idx - 128) );
 
+  for( idx = 0; idx <= NCO_LUT_LEN; idx++ )
+    nco_lut[idx] = (cdsp_t)cexp( -(complex double)I * M_2PI * idx / NCO_LUT_LEN );
+
   return( costas );
 }
 
@@ -158,16 +207,34 @@ Costas_t *Costas_Init(double bw, ModScheme mode) {
  *
  * Mixes a sample with the PLL nco frequency
  */
-complex double Costas_Mix(Costas_t *self, complex double samp) {
+cdsp_t Costas_Mix(Costas_t *self, cdsp_t samp) {
   complex double nco_out;
   complex double retval;
 
+  /* Table NCO: phase wraps around with the accumulator */
+  if( self->nco_type == COSTAS_NCO_LUT )
+  {
+    uint32_t idx  = self->nco_acc >> NCO_FRAC_BITS;
+    dsp_t    frac = (dsp_t)( self->nco_acc & NCO_FRAC_MASK ) /
+      (dsp_t)( 1u << NCO_FRAC_BITS );
+    dsp_t    re, im;
+
+    re = creal( nco_lut[idx] ) +
+      ( creal(nco_lut[idx + 1]) - creal(nco_lut[idx]) ) * frac;
+    im = cimag( nco_lut[idx] ) +
+      ( cimag(nco_lut[idx + 1]) - cimag(nco_lut[idx]) ) * frac;
+    self->nco_acc += (uint32_t)self->nco_step;
+
+    return( (creal(samp) * re - cimag(samp) * im) +
+        (creal(samp) * im + cimag(samp) * re) * (cdsp_t)I );
+  }
+
   nco_out = cexp( -(complex double)I * self->nco_phase );
   retval = samp * nco_out;
   self->nco_phase += self->nco_freq;
   self->nco_phase  = fmod( self->nco_phase, M_2PI );
 
-  return( retval );
+  return( (cdsp_t)retval );
 }
 
 /*****************************************************************************/
@@ -187,8 +254,13 @@ void Costas_Correct_Phase(Costas_t *self, double error) {
   self->moving_average += fabs( error );
   self->moving_average /= avg_winsize;
 
-  self->nco_phase += self->alpha * error;
-  self->nco_phase  = fmod( self->nco_phase, M_2PI );
+  if( self->nco_type == COSTAS_NCO_LUT )
+    self->nco_acc += (uint32_t)Nco_Units( self->alpha * error );
+  else
+  {
+    self->nco_phase += self->alpha * error;
+    self->nco_phase  = fmod( self->nco_phase, M_2PI );
+  }
 
   /* Calculate sliding window average of phase error */
   if( self->locked ) error /= LOCKED_ERR_SCALE;
@@ -222,13 +294,15 @@ void Costas_Correct_Phase(Costas_t *self, double error) {
 
     /* Report zero signal quality */
     mtd_record.sig_q = 0;
-    gtk_entry_set_text( GTK_ENTRY(sig_quality_entry), "0" );
+    Display_Entry( sig_quality_entry, "0" );
   }
 
   /* Limit frequency to a sensible range */
   if( (self->nco_freq <= -FREQ_MAX) ||
       (self->nco_freq >= FREQ_MAX) )
     self->nco_freq = 0.0;
+
+  self->nco_step = Nco_Units( self->nco_freq );
 }
 
 /*****************************************************************************/
@@ -249,7 +323,7 @@ void Costas_Free(Costas_t *self) {
  * Compute the delta phase value to use when
  * correcting the NCO frequency (OQPSK)
  */
-double Costas_Delta(complex double sample, complex double cosample) {
+double Costas_Delta(cdsp_t sample, cdsp_t cosample) {
   double error;
 
   error  = ( Lut_Tanh(creal(sample))   * cimag(sample) ) -
@@ -19,7 +19,10 @@
 
 /*****************************************************************************/
 
+#include "../common/common.h"
+
 #include <complex.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /*****************************************************************************/
@@ -30,8 +33,17 @@ typedef enum ModScheme {
     IDOQPSK   /* Interleaved DOQPSK */
 } ModScheme;
 
+/* NCO implementations of the Costas loop */
+enum {
+    COSTAS_NCO_CEXP = 0,    /* cexp() of double phase, wrapped by fmod()  */
+    COSTAS_NCO_LUT          /* 32 bit phase accumulator and phasor table  */
+};
+
 typedef struct Costas_t {
     double  nco_phase, nco_freq;
+    uint8_t nco_type;
+    uint32_t nco_acc;       /* Phase and frequency of the table NCO, */
+    int32_t  nco_step;      /* 2^32 per 2 Pi                         */
     double  alpha, beta;
     double  damping, bandwidth;
     uint8_t locked;
@@ -41,11 +53,12 @@ typedef struct Costas_t {
 
 /*****************************************************************************/
 
-Costas_t *Costas_Init(double bw, ModScheme mode);
-complex double Costas_Mix(Costas_t *self, complex double samp);
+bool Costas_Nco_Type(const char *name, uint8_t *type);
+Costas_t *Costas_Init(double bw, ModScheme mode, uint8_t nco_type);
+cdsp_t Costas_Mix(Costas_t *self, cdsp_t samp);
 void Costas_Correct_Phase(Costas_t *self, double error);
 void Costas_Free(Costas_t *self);
-double Costas_Delta(complex double sample, complex double cosample);
+double Costas_Delta(cdsp_t sample, cdsp_t cosample);
 
 /*****************************************************************************/
 
@@ -19,8 +19,10 @@
 #include "../common/common.h"
 #include "../common/shared.h"
 #include "../decoder/medet.h"
+#include "../decoder/soft_file.h"
 #include "../demodulator/demod.h"
 #include "../sdr/ifft.h"
+#include "../sdr/iq_file.h"
 #include "../sdr/SoapySDR.h"
 #include "display.h"
 #include "image.h"
@@ -47,6 +49,7 @@
 
 static void Sensitize_Menu_Item(gchar *item_name, gboolean flag);
 static bool Init_Reception(void);
+static bool Activate_Reception(void);
 
 /*****************************************************************************/
 
@@ -56,6 +59,10 @@ static bool Init_Reception(void);
  */
 void Error_Dialog(void) {
   GtkBuilder *builder;
+
+  /* Errors are already printed to stderr in headless mode */
+  if( isFlagSet(HEADLESS_MODE) ) return;
+
   if( !error_dialog )
   {
     error_dialog = create_error_dialog( &builder );
@@ -216,8 +223,15 @@ static bool Init_Reception(void) {
     /* Initialize semaphore */
     sem_init(&demod_semaphore, 0, 0);
 
-    /* Initialize SoapySDR device */
-    if (!SoapySDR_Init()) {
+    /* Open I/Q recording or initialize SoapySDR device */
+    if (IQ_File_Input()) {
+        if (!IQ_File_Init()) {
+            Show_Message("Failed to Open I/Q File", "red");
+            Error_Dialog();
+            return false;
+        }
+    }
+    else if (!SoapySDR_Init()) {
         Show_Message("Failed to Initialize SoapySDR", "red");
         Error_Dialog();
         return false;
@@ -226,11 +240,33 @@ static bool Init_Reception(void) {
     /* Init demodulator object */
     Demod_Init();
 
+    /* Start recording of soft symbols if requested */
+    if (rc_data.soft_file[0] && !Soft_File_Open(rc_data.soft_file,
+                rc_data.soft_packed)) {
+        Show_Message("Failed to Open Soft Symbols File", "red");
+        Error_Dialog();
+        return false;
+    }
+
     return true;
 }
 
 /*****************************************************************************/
 
+/* Activate_Reception()
+ *
+ * Starts the SoapySDR receive stream. I/Q files need no
+ * streaming thread as the demodulator reads them directly
+ */
+static bool Activate_Reception(void) {
+    if (IQ_File_Input())
+        return true;
+
+    return SoapySDR_Activate_Stream();
+}
+
+/*****************************************************************************/
+
 /* Start_Togglebutton_Toggled()
  *
  * Handles the on_start_togglebutton_toggled CB
@@ -261,6 +297,7 @@ void Start_Receiver_Menuitem_Toggled(GtkCheckMenuItem *menuitem) {
   /* Start SDR Receeiver if not satrted already */
   if( gtk_check_menu_item_get_active(menuitem) &&
       isFlagClear(STATUS_RECEIVING) &&
+      isFlagClear(STATUS_DEMODULATING) &&
       isFlagClear(STATUS_PENDING) )
   {
     /* Start SDR Receiver and Demodulator.
@@ -275,17 +312,17 @@ void Start_Receiver_Menuitem_Toggled(GtkCheckMenuItem *menuitem) {
         return;
     }
 
-    /* Activate the SoapySDR Receive Stream */
+    /* Activate the Receive Stream */
     SetFlag( STATUS_RECEIVING );
-    if( !SoapySDR_Activate_Stream() )
+    if( !Activate_Reception() )
     {
       ClearFlag( STATUS_RECEIVING );
       return;
     }
 
-    /* Start demodulator by idle callback */
+    /* Start demodulator thread */
     ClearFlag(STATUS_PENDING);
-    g_idle_add(G_SOURCE_FUNC(Demodulator_Run), NULL );
+    Demodulator_Start();
 
     /* Display Device Driver in use */
     char mesg[MESG_SIZE];
@@ -364,7 +401,8 @@ void Decode_Images_Menuitem_Toggled(GtkCheckMenuItem *menuitem) {
 void Alarm_Action(void) {
   /* Start Receive/Decode Operation */
   if( isFlagSet(ALARM_ACTION_START) &&
-      isFlagClear(STATUS_RECEIVING) )
+      isFlagClear(STATUS_RECEIVING) &&
+      isFlagClear(STATUS_DEMODULATING) )
   {
     /* Start SDR Receiver and Demodulator/Decoder */
     Show_Message( "Starting Receiver & Decoder", "black" );
@@ -389,9 +427,9 @@ void Alarm_Action(void) {
         return;
     }
 
-    /* Activate the SoapySDR Receive Stream */
+    /* Activate the Receive Stream */
     SetFlag( STATUS_RECEIVING );
-    if( !SoapySDR_Activate_Stream() )
+    if( !Activate_Reception() )
     {
       ClearFlag( STATUS_RECEIVING );
       return;
@@ -403,9 +441,9 @@ void Alarm_Action(void) {
         "Decoding from %s Receiver", rc_data.device_driver );
     Show_Message( mesg, "black" );
 
-    /* Start demodulator by idle callback */
+    /* Start demodulator thread */
     ClearFlag(STATUS_PENDING);
-    g_idle_add(G_SOURCE_FUNC(Demodulator_Run), NULL );
+    Demodulator_Start();
 
     return;
   } /* if( isFlagSet(ALARM_ACTION_START) ) */
@@ -433,6 +471,64 @@ void Alarm_Action(void) {
 
 /*****************************************************************************/
 
+/* Headless_Decode()
+ *
+ * Runs the receiver, demodulator and decoder without the
+ * GUI for rc_data.decode_timer seconds, then saves images
+ */
+bool Headless_Decode(void) {
+  char mesg[MESG_SIZE];
+
+  /* Initialize Meteor Image Decoder */
+  Medet_Init();
+  SetFlag( STATUS_DECODING );
+
+  /* Initialize SDR receiver and QPSK demodulator */
+  SetFlag( STATUS_PENDING );
+  if( !Init_Reception() )
+  {
+    ClearFlag( STATUS_PENDING );
+    return( false );
+  }
+
+  /* Activate the Receive Stream */
+  SetFlag( STATUS_RECEIVING );
+  if( !Activate_Reception() )
+  {
+    ClearFlag( STATUS_RECEIVING );
+    return( false );
+  }
+  ClearFlag( STATUS_PENDING );
+
+  /* Reception is stopped by SIGALRM, user interrupt or end of file */
+  if( IQ_File_Input() )
+  {
+    snprintf( mesg, sizeof(mesg),
+        "Decoding from I/Q File \"%s\"", rc_data.iq_file );
+    Show_Message( mesg, "green" );
+  }
+  else
+  {
+    snprintf( mesg, sizeof(mesg),
+        "Decoding from Device \"%s\" for %u sec",
+        rc_data.device_driver, rc_data.decode_timer );
+    Show_Message( mesg, "green" );
+    alarm( rc_data.decode_timer );
+  }
+
+  /* Run the demodulator till reception is stopped,
+   * images are processed and saved on the last call */
+  while( Demodulator_Run() );
+  Demodulator_Stop( NULL );
+
+  ClearFlag( STATUS_DECODING );
+  Medet_Deinit();
+
+  return( true );
+}
+
+/*****************************************************************************/
+
 /* Decode_Timer_Setup()
  *
  * Handles on_timeout_okbutton_clicked CB
@@ -23,6 +23,7 @@
 #include <glib.h>
 #include <gtk/gtk.h>
 
+#include <stdbool.h>
 #include <stdint.h>
 
 /*****************************************************************************/
@@ -35,6 +36,7 @@ void Start_Togglebutton_Toggled(GtkToggleButton *togglebutton);
 void Start_Receiver_Menuitem_Toggled(GtkCheckMenuItem *menuitem);
 void Decode_Images_Menuitem_Toggled(GtkCheckMenuItem *menuitem);
 void Alarm_Action(void);
+bool Headless_Decode(void);
 void Decode_Timer_Setup(void);
 void Auto_Timer_OK_Clicked(void);
 void Hours_Entry(GtkEditable *editable);
@@ -25,9 +25,12 @@
 #include <glib.h>
 #include <gtk/gtk.h>
 
+#include <pthread.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 /*****************************************************************************/
 
@@ -43,10 +46,40 @@
 #define RED_THRESHOLD   4.0
 #define GREEN_THRESHOLD 1.5
 
+/* Decimation of filtered samples fed to the waterfall ifft */
+#define IFFT_DECIMATE   2
+
 /*****************************************************************************/
 
 static int IFFT_Bin_Value(int sum_i, int sum_q, gboolean reset);
 static void Colorize(guchar *pix, int pixel_val);
+static void Display_Waterfall(void);
+static void Display_QPSK_Const(int8_t *buffer);
+static void Display_Demod_Params(void);
+static gboolean Display_Icon_Idle(gpointer data);
+static gboolean Display_Entry_Idle(gpointer data);
+
+/*****************************************************************************/
+
+/* Snapshot of demodulator state, taken by the DSP thread
+ * and displayed periodically by the GTK thread. The DSP
+ * thread skips a snapshot rather than wait for the lock */
+static pthread_mutex_t snap_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool snap_wfall = false, snap_demod = false;
+static int8_t snap_qpsk[2 * QPSK_CONST_POINTS];
+static double snap_gain, snap_freq, snap_pll_ave;
+static uint32_t snap_level;
+
+/* Icon or entry text passed to the GTK thread by other threads */
+typedef struct icon_t {
+  GtkWidget *img;
+  const gchar *name;
+} icon_t;
+
+typedef struct entry_t {
+  GtkWidget *entry;
+  gchar *txt;
+} entry_t;
 
 /*****************************************************************************/
 
@@ -131,7 +164,7 @@ static void Colorize(guchar *pix, int pixel_val) {
  *
  * Displays IFFT Spectrum as "waterfall"
  */
-void Display_Waterfall(void) {
+static void Display_Waterfall(void) {
   int
     vert_lim,  /* Limit of vertical index for copying lines */
     idh, idv,  /* Index to hor. and vert. position in warterfall */
@@ -205,9 +238,6 @@ void Display_Waterfall(void) {
 
   /* At last draw waterfall */
   gtk_widget_queue_draw( ifft_drawingarea );
-
-  /* Wait for GTK to complete its tasks */
-  while( g_main_context_iteration(NULL, FALSE) );
 }
 
 /*****************************************************************************/
@@ -216,7 +246,7 @@ void Display_Waterfall(void) {
  *
  *  Displays the QPSK constellation
  */
-void Display_QPSK_Const(int8_t *buffer) {
+static void Display_QPSK_Const(int8_t *buffer) {
   /* Pointer to current pixel */
   static guchar *pix;
 
@@ -239,18 +269,44 @@ void Display_QPSK_Const(int8_t *buffer) {
     pix[2] = 0xff;
   }
 
-  /* Wait for GTK to complete its tasks */
   gtk_widget_queue_draw( qpsk_drawingarea );
-  while( g_main_context_iteration(NULL, FALSE) );
+}
+
+/*****************************************************************************/
+
+/* Display_Icon_Idle()
+ *
+ * Sets an icon passed from another thread in the GTK thread
+ */
+static gboolean Display_Icon_Idle(gpointer data) {
+  icon_t *icon = (icon_t *)data;
+
+  Display_Icon( icon->img, icon->name );
+  g_free( icon );
+
+  return( FALSE );
 }
 
 /*****************************************************************************/
 
 /* Display_Icon()
  *
- * Sets an icon to be displayed in a GTK_IMAGE
+ * Sets an icon to be displayed in a GTK_IMAGE.
+ * Icon names must be string literals
  */
 void Display_Icon(GtkWidget *img, const gchar *name) {
+  if( isFlagSet(HEADLESS_MODE) ) return;
+
+  /* Only the GTK thread may touch widgets */
+  if( !isGuiThread() )
+  {
+    icon_t *icon = g_new( icon_t, 1 );
+    icon->img  = img;
+    icon->name = name;
+    g_idle_add( Display_Icon_Idle, icon );
+    return;
+  }
+
   /* Set the icon in the image */
   gtk_image_set_from_icon_name(
       GTK_IMAGE(img), name, GTK_ICON_SIZE_BUTTON );
@@ -261,33 +317,63 @@ void Display_Icon(GtkWidget *img, const gchar *name) {
 
 /*****************************************************************************/
 
+/* Display_Entry_Idle()
+ *
+ * Sets entry text passed from another thread in the GTK thread
+ */
+static gboolean Display_Entry_Idle(gpointer data) {
+  entry_t *entry = (entry_t *)data;
+
+  gtk_entry_set_text( GTK_ENTRY(entry->entry), entry->txt );
+  g_free( entry->txt );
+  g_free( entry );
+
+  return( FALSE );
+}
+
+/*****************************************************************************/
+
+/* Display_Entry()
+ *
+ * Sets the text of a GTK_ENTRY from any thread
+ */
+void Display_Entry(GtkWidget *entry, const gchar *txt) {
+  if( isFlagSet(HEADLESS_MODE) ) return;
+
+  if( isGuiThread() )
+  {
+    gtk_entry_set_text( GTK_ENTRY(entry), txt );
+    return;
+  }
+
+  entry_t *ent = g_new( entry_t, 1 );
+  ent->entry = entry;
+  ent->txt   = g_strdup( txt );
+  g_idle_add( Display_Entry_Idle, ent );
+}
+
+/*****************************************************************************/
+
 /* Display_Demod_Params()
  *
  * Displays Demodulator parameters (AGC gain PLL freq etc)
+ * from the last snapshot
  */
-void Display_Demod_Params(Demod_t *demod) {
+static void Display_Demod_Params(void) {
   char txt[10];
-  double freq, gain;
-  uint32_t level;
 
   /* Display AGC Gain and Signal Level */
-  Agc_Gain( &gain );
-  snprintf( txt, sizeof(txt), "%6.3f", gain );
+  snprintf( txt, sizeof(txt), "%6.3f", snap_gain );
   gtk_entry_set_text( GTK_ENTRY(agc_gain_entry), txt );
-  Signal_Level( &level );
-  snprintf( txt, sizeof(txt), "%6u", level );
+  snprintf( txt, sizeof(txt), "%6u", snap_level );
   gtk_entry_set_text( GTK_ENTRY(sig_level_entry), txt );
 
-  /* Display Costas PLL Frequency FIXME */
-  freq = demod->costas->nco_freq * demod->sym_rate / M_2PI;
-  if( (rc_data.psk_mode == DOQPSK) ||
-      (rc_data.psk_mode == IDOQPSK) )
-    freq *= 2.0;
-  snprintf( txt, sizeof(txt), "%+8d", (int)freq );
+  /* Display Costas PLL Frequency */
+  snprintf( txt, sizeof(txt), "%+8d", (int)snap_freq );
   gtk_entry_set_text( GTK_ENTRY(pll_freq_entry), txt );
 
   /* Display Costas PLL Lock Detect Level */
-  snprintf( txt, sizeof(txt), "%6.3f", demod->costas->moving_average );
+  snprintf( txt, sizeof(txt), "%6.3f", snap_pll_ave );
   gtk_entry_set_text( GTK_ENTRY(pll_ave_entry), txt );
 
   /* Draw the level gauges */
@@ -295,9 +381,96 @@ void Display_Demod_Params(Demod_t *demod) {
   gtk_widget_queue_draw( sig_qual_drawingarea );
   gtk_widget_queue_draw( agc_gain_drawingarea );
   gtk_widget_queue_draw( pll_ave_drawingarea );
+}
 
-  /* Wait for GTK to complete its tasks */
-  while( g_main_context_iteration(NULL, FALSE) );
+/*****************************************************************************/
+
+/* Snapshot_Waterfall()
+ *
+ * Decimates a block of filtered samples into the ifft
+ * data buffer for the waterfall. Called by the DSP thread
+ */
+void Snapshot_Waterfall(const dsp_t *buf_i, const dsp_t *buf_q) {
+  uint32_t idx, data_idx = 0, fft_decim_cnt = 0;
+  double sum_i = 0.0, sum_q = 0.0;
+
+  /* Skip snapshot if the GTK thread is displaying the last one */
+  if( pthread_mutex_trylock(&snap_lock) != 0 ) return;
+
+  for( idx = 0; idx < ifft_data_length; idx++ )
+  {
+    sum_i += buf_i[idx];
+    sum_q += buf_q[idx];
+
+    fft_decim_cnt++;
+    if( fft_decim_cnt >= IFFT_DECIMATE )
+    {
+      ifft_data[data_idx++] = (int16_t)sum_i;
+      ifft_data[data_idx++] = (int16_t)sum_q;
+      fft_decim_cnt = 0;
+      sum_i = 0.0;
+      sum_q = 0.0;
+    }
+  }
+
+  snap_wfall = true;
+  pthread_mutex_unlock( &snap_lock );
+}
+
+/*****************************************************************************/
+
+/* Snapshot_Demod()
+ *
+ * Copies QPSK constellation points and demodulator
+ * parameters for display. Called by the DSP thread
+ */
+void Snapshot_Demod(const int8_t *buffer, Demod_t *demod) {
+  /* Skip snapshot if the GTK thread is displaying the last one */
+  if( pthread_mutex_trylock(&snap_lock) != 0 ) return;
+
+  memcpy( snap_qpsk, buffer, sizeof(snap_qpsk) );
+
+  Agc_Gain( &snap_gain );
+  Signal_Level( &snap_level );
+
+  /* Costas PLL Frequency FIXME */
+  snap_freq = demod->costas->nco_freq * demod->sym_rate / M_2PI;
+  if( (rc_data.psk_mode == DOQPSK) ||
+      (rc_data.psk_mode == IDOQPSK) )
+    snap_freq *= 2.0;
+
+  snap_pll_ave = demod->costas->moving_average;
+
+  snap_demod = true;
+  pthread_mutex_unlock( &snap_lock );
+}
+
+/*****************************************************************************/
+
+/* Display_Snapshot()
+ *
+ * Timeout callback that displays the last demodulator
+ * snapshot (waterfall, constellation and parameters)
+ */
+gboolean Display_Snapshot(gpointer data) {
+  pthread_mutex_lock( &snap_lock );
+
+  if( snap_wfall )
+  {
+    Display_Waterfall();
+    snap_wfall = false;
+  }
+
+  if( snap_demod )
+  {
+    Display_QPSK_Const( snap_qpsk );
+    Display_Demod_Params();
+    snap_demod = false;
+  }
+
+  pthread_mutex_unlock( &snap_lock );
+
+  return( TRUE );
 }
 
 /*****************************************************************************/
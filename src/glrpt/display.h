@@ -19,6 +19,7 @@
 
 /*****************************************************************************/
 
+#include "../common/common.h"
 #include "../demodulator/demod.h"
 
 #include <cairo.h>
@@ -29,10 +30,16 @@
 
 /*****************************************************************************/
 
-void Display_Waterfall(void);
-void Display_QPSK_Const(int8_t *buffer);
+/* Period (ms) of displaying demodulator snapshots */
+#define DISPLAY_INTERVAL    40
+
+/*****************************************************************************/
+
 void Display_Icon(GtkWidget *img, const gchar *name);
-void Display_Demod_Params(Demod_t *demod);
+void Display_Entry(GtkWidget *entry, const gchar *txt);
+void Snapshot_Waterfall(const dsp_t *buf_i, const dsp_t *buf_q);
+void Snapshot_Demod(const int8_t *buffer, Demod_t *demod);
+gboolean Display_Snapshot(gpointer data);
 void Draw_Level_Gauge(GtkWidget *widget, cairo_t *cr, double level);
 
 /*****************************************************************************/
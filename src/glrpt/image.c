@@ -35,6 +35,23 @@
 
 /*****************************************************************************/
 
+/* Scaled lines of a channel image, passed to the GTK thread */
+typedef struct image_lines_t {
+  int x;        /* Pixbuf column of the first pixel of the lines */
+  int y;        /* Pixbuf row of the first line */
+  int rows;     /* Number of lines */
+  int width;    /* Number of pixels per line */
+  guchar val[]; /* Gray levels of the pixels, rows * width */
+} image_lines_t;
+
+/*****************************************************************************/
+
+static void Copy_Image_Lines(const image_lines_t *lines);
+static gboolean Copy_Image_Lines_Idle(gpointer data);
+static gboolean Clear_Image_Idle(gpointer data);
+
+/*****************************************************************************/
+
 /*  Normalize_Image()
  *
  *  Does histogram (linear) normalization of a pgm (P5) image file
@@ -168,21 +185,90 @@ void Flip_Image(uint8_t *image_buffer, uint32_t image_size) {
 
 /*****************************************************************************/
 
+/* Copy_Image_Lines()
+ *
+ * Copies scaled lines of a channel image into the image
+ * pixbuf, with the white separator line on their right,
+ * and sets the LRPT image from the pixbuf
+ */
+static void Copy_Image_Lines(const image_lines_t *lines) {
+  int row, x;
+  guchar *pixel;
+
+  for( row = 0; row < lines->rows; row++ )
+  {
+    /* The pixbuf may have been recreated smaller since */
+    if( lines->y + row >= scaled_image_height ) break;
+
+    pixel = scaled_image_pixel_buf +
+      (lines->y + row) * scaled_image_rowstride +
+      lines->x * scaled_image_n_channels;
+    for( x = 0; x < lines->width; x++ )
+    {
+      pixel[0] = lines->val[row * lines->width + x];
+      pixel[1] = pixel[0];
+      pixel[2] = pixel[0];
+      pixel += scaled_image_n_channels;
+    }
+
+    /* Draw a vertical white line between images */
+    pixel[0] = 0xff;
+    pixel[1] = 0xff;
+    pixel[2] = 0xff;
+  }
+
+  gtk_image_set_from_pixbuf( GTK_IMAGE(lrpt_image), scaled_image_pixbuf );
+}
+
+/*****************************************************************************/
+
+/* Copy_Image_Lines_Idle()
+ *
+ * Copies scaled lines passed from the decoder thread
+ * into the image pixbuf in the GTK thread
+ */
+static gboolean Copy_Image_Lines_Idle(gpointer data) {
+  Copy_Image_Lines( (image_lines_t *)data );
+  g_free( data );
+
+  return( FALSE );
+}
+
+/*****************************************************************************/
+
+/* Clear_Image_Idle()
+ *
+ * Fills the image pixbuf with the background color in the GTK thread
+ */
+static gboolean Clear_Image_Idle(gpointer data) {
+  gdk_pixbuf_fill( scaled_image_pixbuf, 0xaaaaaaff );
+  gtk_image_set_from_pixbuf( GTK_IMAGE(lrpt_image), scaled_image_pixbuf );
+
+  return( FALSE );
+}
+
+/*****************************************************************************/
+
 /* Display_Scaled_Image
  *
- * Scales an LRPT image horizontal line by the scale
- * factor and stores the result in the image pixbuf
+ * Scales an LRPT image horizontal line by the scale factor
+ * and stores the result in the image pixbuf. The pixbuf is
+ * only written in the GTK thread, as GTK may be rendering it
  */
 void Display_Scaled_Image(uint8_t *chan_image[], uint32_t apid, int current_y) {
-  int chn, idx, idy, cnt, scale;
-  int scaled_width, scaled_x, scaled_idx;
+  int chn, idx, idy, cnt, scale, rows;
+  int scaled_width, scaled_x;
   static int
     scaled_y[CHANNEL_IMAGE_NUM] = { 0, 0, 0 },
     last_y  [CHANNEL_IMAGE_NUM] = { 0, 0, 0 };
   uint16_t *pix_val = NULL;
-  guchar *pixel, val;
+  image_lines_t *lines;
+  guchar *val;
 
 
+  /* No live image display without GUI */
+  if( isFlagSet(HEADLESS_MODE) ) return;
+
   /* Signal to reset indices for new images */
   if( current_y == 0 )
   {
@@ -193,7 +279,10 @@ void Display_Scaled_Image(uint8_t *chan_image[], uint32_t apid, int current_y) {
     }
 
     /* Fill pixbuf with background color */
-    gdk_pixbuf_fill( scaled_image_pixbuf, 0xaaaaaaff );
+    if( isGuiThread() )
+      Clear_Image_Idle( NULL );
+    else
+      g_idle_add( Clear_Image_Idle, NULL );
 
     return;
   }
@@ -226,6 +315,15 @@ void Display_Scaled_Image(uint8_t *chan_image[], uint32_t apid, int current_y) {
   size_t siz = (size_t)scaled_width * sizeof(uint16_t);
   mem_alloc( (void **)&pix_val, siz );
 
+  /* Private buffer of the scaled lines, handed over to the GTK thread */
+  rows  = (current_y - last_y[chn]) / scale;
+  lines = g_malloc( sizeof(image_lines_t) + (size_t)(rows * scaled_width) );
+  lines->x     = chn * scaled_width + chn;
+  lines->y     = scaled_y[chn];
+  lines->rows  = rows;
+  lines->width = scaled_width;
+  val = lines->val;
+
   /* Keep scaling image while image size is enough */
   while( (current_y - last_y[chn]) >= scale )
   {
@@ -246,26 +344,9 @@ void Display_Scaled_Image(uint8_t *chan_image[], uint32_t apid, int current_y) {
       last_y[chn]++;
     }
 
-    /* Fill scaled image buffer with scaled summed pixel values */
-    int y =
-      scaled_y[chn] * scaled_image_rowstride +
-      (chn * scaled_width + chn) * scaled_image_n_channels;
+    /* Fill line buffer with scaled summed pixel values */
     for( scaled_x = 0; scaled_x < scaled_width; scaled_x++ )
-    {
-      scaled_idx = scaled_x * scaled_image_n_channels + y;
-      pixel = &scaled_image_pixel_buf[scaled_idx];
-      val = (guchar)(pix_val[scaled_x] / (uint16_t)scale / (uint16_t)scale);
-      pixel[0] = val;
-      pixel[1] = val;
-      pixel[2] = val;
-    }
-
-    /* Draw a vertical white line between images */
-    scaled_idx = scaled_x * scaled_image_n_channels + y;
-    pixel = &scaled_image_pixel_buf[scaled_idx];
-    pixel[0] = 0xff;
-    pixel[1] = 0xff;
-    pixel[2] = 0xff;
+      *val++ = (guchar)(pix_val[scaled_x] / (uint16_t)scale / (uint16_t)scale);
 
     /* Go down the scaled image buffer */
     scaled_y[chn]++;
@@ -273,8 +354,13 @@ void Display_Scaled_Image(uint8_t *chan_image[], uint32_t apid, int current_y) {
   } /* while( (current_y - last_y) >= rc_data.image_scale ) */
   free_ptr( (void **)&pix_val );
 
-  /* Set lrpt image from pixbuff */
-  gtk_image_set_from_pixbuf( GTK_IMAGE(lrpt_image), scaled_image_pixbuf );
+  /* Copy the lines into the pixbuf in the GTK thread */
+  if( isGuiThread() )
+  {
+    Copy_Image_Lines( lines );
+    g_free( lines );
+  }
+  else g_idle_add( Copy_Image_Lines_Idle, lines );
 }
 
 /*****************************************************************************/
@@ -14,9 +14,15 @@
 
 /*****************************************************************************/
 
+#include "../common/cpu.h"
 #include "../common/shared.h"
+#include "../decoder/soft_file.h"
+#include "../demodulator/pll.h"
+#include "../sdr/decimator.h"
 #include "../sdr/filters.h"
 #include "../sdr/ifft.h"
+#include "../sdr/iq_file.h"
+#include "../sdr/sample_ring.h"
 #include "callback_func.h"
 #include "interface.h"
 #include "rc_config.h"
@@ -26,13 +32,21 @@
 #include <gtk/gtk.h>
 
 #include <signal.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <unistd.h>
 
 /*****************************************************************************/
 
+static bool Run_Headless(
+        const char *cfg_path,
+        const char *device,
+        const char *soft_path);
 static void sig_handler(int signal);
 
 /*****************************************************************************/
@@ -62,9 +76,136 @@ int main(int argc, char *argv[]) {
 
     /* Process command line options */
     int option;
+    long duration, depth;
+    const char *cfg_path = NULL, *device = NULL, *img_dir = NULL;
+    const char *soft_path = NULL;
 
-    while ((option = getopt(argc, argv, "hv")) != -1)
+    /* Defaults/initialization */
+    rc_data.decode_timer = 0;
+    rc_data.ring_depth   = SAMPLE_RING_DEPTH;
+    rc_data.decim_filter = DECIM_BOXCAR;
+    rc_data.costas_nco   = COSTAS_NCO_LUT;
+    rc_data.cpu_simd     = CPU_SIMD_MAX;
+
+    /* SIMD level may be limited from environment, -S overrides it */
+    const char *simd = getenv(CPU_SIMD_ENV);
+    if (simd && !Cpu_Simd_Level(simd, &rc_data.cpu_simd)) {
+        fprintf(stderr, "glrpt: %s\n", "invalid " CPU_SIMD_ENV " level");
+        exit(-1);
+    }
+
+    while ((option = getopt(argc, argv, "b:c:d:f:i:o:r:s:t:w:D:N:S:Hmphv")) != -1)
         switch (option) {
+            case 'b': /* Depth of SDR sample blocks ring */
+                depth = strtol(optarg, NULL, 10);
+
+                if ((depth < SAMPLE_RING_DEPTH_MIN) ||
+                        (depth > SAMPLE_RING_DEPTH_MAX)) {
+                    fprintf(stderr, "glrpt: %s\n", "invalid sample ring depth");
+                    exit(-1);
+                }
+
+                rc_data.ring_depth = (uint32_t)depth;
+
+                break;
+
+            case 'D': /* Decimation filter of SDR samples */
+                if (!Decimator_Type(optarg, &rc_data.decim_filter)) {
+                    fprintf(stderr, "glrpt: %s\n", "invalid decimation filter");
+                    exit(-1);
+                }
+
+                break;
+
+            case 'N': /* NCO implementation of the Costas PLL */
+                if (!Costas_Nco_Type(optarg, &rc_data.costas_nco)) {
+                    fprintf(stderr, "glrpt: %s\n", "invalid NCO type");
+                    exit(-1);
+                }
+
+                break;
+
+            case 'S': /* Highest SIMD level of kernels */
+                if (!Cpu_Simd_Level(optarg, &rc_data.cpu_simd)) {
+                    fprintf(stderr, "glrpt: %s\n", "invalid SIMD level");
+                    exit(-1);
+                }
+
+                break;
+
+            case 'c': /* Configuration file to load */
+                cfg_path = optarg;
+
+                break;
+
+            case 'd': /* SoapySDR driver and optional device index */
+                device = optarg;
+
+                break;
+
+            case 'i': /* I/Q recording to read instead of SDR device */
+                Strlcpy(rc_data.iq_file, optarg, sizeof(rc_data.iq_file));
+
+                break;
+
+            case 'f': /* Sample format of I/Q recording */
+                rc_data.iq_format = IQ_File_Format(optarg);
+
+                if (rc_data.iq_format == IQ_FORMAT_AUTO) {
+                    fprintf(stderr, "glrpt: %s\n", "invalid I/Q file format");
+                    exit(-1);
+                }
+
+                break;
+
+            case 'r': /* Sample rate of I/Q recording */
+                rc_data.iq_samplerate = (uint32_t)strtoul(optarg, NULL, 10);
+
+                break;
+
+            case 'm': /* Replay I/Q recording as fast as possible */
+                rc_data.iq_max_speed = true;
+
+                break;
+
+            case 's': /* Decode soft symbols file, implies headless mode */
+                soft_path = optarg;
+                SetFlag(HEADLESS_MODE);
+
+                break;
+
+            case 'w': /* Record demodulator soft symbols to file */
+                Strlcpy(rc_data.soft_file, optarg, sizeof(rc_data.soft_file));
+
+                break;
+
+            case 'p': /* Pack recorded soft symbols to 4 bits */
+                rc_data.soft_packed = true;
+
+                break;
+
+            case 'o': /* Directory for decoded images */
+                img_dir = optarg;
+
+                break;
+
+            case 't': /* Decode duration in seconds */
+                duration = strtol(optarg, NULL, 10);
+
+                if ((duration <= 0) || (duration > 86400)) {
+                    fprintf(stderr, "glrpt: %s\n", "invalid decode duration");
+                    exit(-1);
+                }
+
+                rc_data.decode_timer = (uint32_t)duration;
+
+                break;
+
+            case 'H': /* Run without GUI */
+                SetFlag(HEADLESS_MODE);
+
+                break;
+
             case 'h': /* Print help and exit */
                 Usage();
                 exit(0);
@@ -85,7 +226,7 @@ int main(int argc, char *argv[]) {
         }
 
     /* Find and prepare program directories */
-    if (!prepareDirectories()) {
+    if (!prepareDirectories(img_dir)) {
         fprintf(stderr, "glrpt: %s\n", "error during preparing directories");
         exit(-1);
     }
@@ -94,11 +235,16 @@ int main(int argc, char *argv[]) {
     snprintf(glrpt_glade_file, sizeof(glrpt_glade_file),
             "%s/glrpt.glade", PACKAGE_DATADIR);
 
+    /* Decode without any GTK+ involvement and exit. Kernels
+     * are bound here as messages already go to stderr */
+    if (isFlagSet(HEADLESS_MODE)) {
+        Cpu_Init(rc_data.cpu_simd);
+        exit(Run_Headless(cfg_path, device, soft_path) ? 0 : -1);
+    }
+
     /* Start GTK+ */
     gtk_init(&argc, &argv);
-
-    /* Defaults/initialization */
-    rc_data.decode_timer = 0;
+    Set_Gui_Thread();
 
     /* Create glrpt main window */
     main_window = create_main_window(&main_window_builder);
@@ -174,6 +320,10 @@ int main(int argc, char *argv[]) {
     snprintf(ver, sizeof(ver), "Welcome to %s", PACKAGE_STRING);
     Show_Message(ver, "bold");
 
+    /* Bind DSP and decoder kernels to CPU features, now
+     * that the level chosen can be shown in the text view */
+    Cpu_Init(rc_data.cpu_simd);
+
     /* Find configuration files and open the first as default */
 /*    g_idle_add(G_SOURCE_FUNC(Find_Config_Files), NULL);*/
     /* TODO this will change in future when user-selectable configs arrive */
@@ -182,7 +332,8 @@ int main(int argc, char *argv[]) {
         exit(-1);
     }
 
-    g_idle_add(G_SOURCE_FUNC(loadConfig), glrpt_cfg_list[0].path);
+    g_idle_add(G_SOURCE_FUNC(loadConfig),
+            cfg_path ? (gpointer)cfg_path : glrpt_cfg_list[0].path);
 
     /* Main loop */
     gtk_main();
@@ -192,11 +343,84 @@ int main(int argc, char *argv[]) {
 
 /*****************************************************************************/
 
+/* Run_Headless()
+ *
+ * Loads the configuration, applies command line overrides and
+ * decodes a single pass (or a soft symbols file) without GUI
+ */
+static bool Run_Headless(
+        const char *cfg_path,
+        const char *device,
+        const char *soft_path) {
+    /* Use the first config found if none specified */
+    if (!cfg_path) {
+        if (!findConfigFiles()) {
+            fprintf(stderr, "glrpt: %s\n", "can't find config files!");
+            return false;
+        }
+
+        cfg_path = glrpt_cfg_list[0].path;
+    }
+
+    if (!parseConfig(cfg_path))
+        return false;
+
+    /* Device is given as driver[:index] */
+    if (device) {
+        const char *sep = strchr(device, ':');
+        size_t len = sep ? (size_t)(sep - device) : strlen(device);
+
+        if (len >= sizeof(rc_data.device_driver))
+            len = sizeof(rc_data.device_driver) - 1;
+
+        memcpy(rc_data.device_driver, device, len);
+        rc_data.device_driver[len] = '\0';
+
+        if (sep)
+            rc_data.device_index = (uint8_t)strtoul(sep + 1, NULL, 10);
+
+        if (strncasecmp(rc_data.device_driver, "auto", 4) == 0)
+            SetFlag(AUTO_DETECT_SDR);
+        else
+            ClearFlag(AUTO_DETECT_SDR);
+    }
+
+    /* Soft symbols bypass SDR and demodulator entirely */
+    if (soft_path)
+        return Soft_File_Decode(soft_path);
+
+    /* Only the decode timer stops reception from a device */
+    if (!IQ_File_Input() && !rc_data.decode_timer) {
+        fprintf(stderr, "glrpt: %s\n",
+                "decode duration is 0, set it with -t or in the config");
+        return false;
+    }
+
+    return Headless_Decode();
+}
+
+/*****************************************************************************/
+
 /* sig_handler()
  *
  * Signal action handler function
  */
 static void sig_handler(int signal) {
+    /* In headless mode timer expiry and the first interrupt
+     * stop reception gracefully so images are still saved */
+    if (isFlagSet(HEADLESS_MODE) &&
+            ((signal == SIGALRM) || (signal == SIGINT) ||
+             (signal == SIGTERM)) &&
+            isFlagSet(STATUS_RECEIVING) &&
+            isFlagClear(STATUS_IDOQPSK_STOP)) {
+        if (rc_data.psk_mode == IDOQPSK)
+            SetFlag(STATUS_IDOQPSK_STOP);
+        else
+            ClearFlag(STATUS_RECEIVING);
+
+        return;
+    }
+
     if (signal == SIGALRM) {
         Alarm_Action();
 
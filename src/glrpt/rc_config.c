@@ -68,13 +68,13 @@ static int cfgNameFilter(const struct dirent *entry) {
 
 /*****************************************************************************/
 
-/* loadConfig()
+/* parseConfig()
  *
- * Loads the glrptrc configuration file
+ * Reads the configuration file into rc_data and the flags
  * TODO more detailed error messages (using mesg)
  * TODO use DEFINEd default values
  */
-gboolean loadConfig(gpointer f_path) {
+bool parseConfig(const char *f_path) {
     char mesg[MESG_SIZE];
 
     /* Initialize string config values */
@@ -89,7 +89,7 @@ gboolean loadConfig(gpointer f_path) {
     config_set_options(&cfg, CONFIG_OPTION_AUTOCONVERT);
 
     /* Try to parse config file */
-    if (!config_read_file(&cfg, (char *)f_path)) {
+    if (!config_read_file(&cfg, f_path)) {
         snprintf(mesg, sizeof(mesg),
                 "Failed to parse config file!\n%s:%d - %s\n",
                 config_error_file(&cfg), config_error_line(&cfg),
@@ -100,7 +100,7 @@ gboolean loadConfig(gpointer f_path) {
 
         config_destroy(&cfg);
 
-        return FALSE;
+        return false;
     }
 
     /* Begin settings readout. Raw values are checked against valid ranges.
@@ -156,7 +156,7 @@ gboolean loadConfig(gpointer f_path) {
             Show_Message("Can't find valid receiver frequency!", "red");
             Error_Dialog();
 
-            return FALSE;
+            return false;
         }
 
         if (config_setting_lookup_int(set_v, "bw", &int_v) &&
@@ -181,7 +181,7 @@ gboolean loadConfig(gpointer f_path) {
         Show_Message("Can't find SDR receiver settings!", "red");
         Error_Dialog();
 
-        return FALSE;
+        return false;
     }
 
     /* Demodulator settings */
@@ -231,14 +231,14 @@ gboolean loadConfig(gpointer f_path) {
                 Show_Message("QPSK mode is invalid!", "red");
                 Error_Dialog();
 
-                return FALSE;
+                return false;
             }
         }
         else {
             Show_Message("Can't find QPSK mode!", "red");
             Error_Dialog();
 
-            return FALSE;
+            return false;
         }
 
         if (config_setting_lookup_int(set_v, "rate", &int_v) &&
@@ -249,14 +249,14 @@ gboolean loadConfig(gpointer f_path) {
                     "red");
             Error_Dialog();
 
-            return FALSE;
+            return false;
         }
     }
     else {
         Show_Message("Can't find demodulator settings!", "red");
         Error_Dialog();
 
-        return FALSE;
+        return false;
     }
 
     /* Decoder settings */
@@ -275,7 +275,7 @@ gboolean loadConfig(gpointer f_path) {
                     Show_Message("APIDs are incorrect!", "red");
                     Error_Dialog();
 
-                    return FALSE;
+                    return false;
                 }
                 else
                     rc_data.apid[idx] = apid;
@@ -285,7 +285,7 @@ gboolean loadConfig(gpointer f_path) {
             Show_Message("Can't find valid APIDs!", "red");
             Error_Dialog();
 
-            return FALSE;
+            return false;
         }
 
         arr_v = config_setting_lookup(set_v, "apids_invert");
@@ -341,7 +341,7 @@ gboolean loadConfig(gpointer f_path) {
         Show_Message("Can't find decoder settings!", "red");
         Error_Dialog();
 
-        return FALSE;
+        return false;
     }
 
     /* Post-processing settings */
@@ -608,20 +608,30 @@ gboolean loadConfig(gpointer f_path) {
     /* Cleanup */
     config_destroy(&cfg);
 
-    /* Set Gain control buttons and slider */
-    /* TODO should set flag ASAP */
-    if (rc_data.tuner_gain != 0.0) {
-        GtkWidget *radiobtn = Builder_Get_Object(
-                main_window_builder, "manual_agc_radiobutton");
-        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(radiobtn), TRUE);
+    /* Tuner gain mode follows the configured gain */
+    if (rc_data.tuner_gain != 0.0)
         ClearFlag(TUNER_GAIN_AUTO);
-    }
-    else {
-        GtkWidget *radiobtn = Builder_Get_Object(
-                main_window_builder, "auto_agc_radiobutton");
-        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(radiobtn), TRUE);
+    else
         SetFlag(TUNER_GAIN_AUTO);
-    }
+
+    return true;
+}
+
+/*****************************************************************************/
+
+/* loadConfig()
+ *
+ * Loads the glrptrc configuration file and updates the main window
+ */
+gboolean loadConfig(gpointer f_path) {
+    if (!parseConfig((const char *)f_path))
+        return FALSE;
+
+    /* Set Gain control buttons and slider */
+    GtkWidget *radiobtn = Builder_Get_Object(main_window_builder,
+            isFlagSet(TUNER_GAIN_AUTO) ?
+            "auto_agc_radiobutton" : "manual_agc_radiobutton");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(radiobtn), TRUE);
 
     /* (Re)initialize top window */
     Initialize_Top_Window();
@@ -651,11 +661,14 @@ bool findConfigFiles(void) {
         return false;
 
     /* Build "Select Satellite" popup menu item */
-    if (!popup_menu)
-        popup_menu = create_popup_menu(&popup_menu_builder);
+    GtkWidget *sat_menu = NULL;
+
+    if (isFlagClear(HEADLESS_MODE)) {
+        if (!popup_menu)
+            popup_menu = create_popup_menu(&popup_menu_builder);
 
-    GtkWidget *sat_menu =
-        Builder_Get_Object(popup_menu_builder, "select_satellite");
+        sat_menu = Builder_Get_Object(popup_menu_builder, "select_satellite");
+    }
 
     glrpt_cfg_list =
         (rc_cfg_t *)malloc(sizeof(rc_cfg_t) * (n_s_cfgs + n_u_cfgs));
@@ -679,7 +692,12 @@ bool findConfigFiles(void) {
         snprintf(glrpt_cfg_list[i].path, prefix_len + fname_len + 6,
                 "%s/%s", w_dir, w_list[idx]->d_name);
 
+        free(w_list[idx]);
+
         /* Append new child items to "Select Satellite" menu */
+        if (!sat_menu)
+            continue;
+
         GtkWidget *menu_item =
             gtk_menu_item_new_with_label(glrpt_cfg_list[i].name);
         g_signal_connect(menu_item, "activate",
@@ -694,8 +712,6 @@ bool findConfigFiles(void) {
             gtk_widget_show(separator);
             gtk_menu_shell_append(GTK_MENU_SHELL(sat_menu), separator);
         }
-
-        free(w_list[idx]);
     }
 
     free(s_cfg_list);
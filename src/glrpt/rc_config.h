@@ -103,6 +103,32 @@ typedef struct rc_data_t {
     /* Scale factor to fit images in glrpt live display */
     /* TODO do we need uint32_t? */
     uint32_t image_scale;
+
+    /* I/Q recording to read instead of SDR device (empty if none),
+     * its sample format and rate, replay as fast as possible or not
+     */
+    char iq_file[PATH_MAX + 1];
+    uint8_t iq_format;
+    uint32_t iq_samplerate;
+    bool iq_max_speed;
+
+    /* File to record demodulator soft symbols to (empty if none)
+     * and whether to pack them to 4 bits per symbol
+     */
+    char soft_file[PATH_MAX + 1];
+    bool soft_packed;
+
+    /* Number of sample blocks in the ring between SDR and demodulator */
+    uint32_t ring_depth;
+
+    /* Filter decimating SDR samples to the demodulator sample rate */
+    uint8_t decim_filter;
+
+    /* NCO implementation of the Costas PLL */
+    uint8_t costas_nco;
+
+    /* Highest SIMD level of DSP and decoder kernels to use */
+    uint8_t cpu_simd;
 } rc_data_t;
 
 /*****************************************************************************/
@@ -118,6 +144,7 @@ extern char
 
 /*****************************************************************************/
 
+bool parseConfig(const char *f_path);
 gboolean loadConfig(gpointer f_path);
 bool findConfigFiles(void);
 
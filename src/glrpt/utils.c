@@ -21,6 +21,7 @@
 #include "../demodulator/demod.h"
 #include "../sdr/filters.h"
 #include "../sdr/ifft.h"
+#include "../sdr/iq_file.h"
 #include "callback_func.h"
 #include "interface.h"
 #include "rc_config.h"
@@ -30,6 +31,7 @@
 
 #include <errno.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -43,11 +45,22 @@
 
 static bool mkdirRecurse(const char *path);
 static const char *Filename(const char *fpath);
+static gboolean Show_Message_Idle(gpointer data);
 
 /*****************************************************************************/
 
-/* An int variable holding the single-bit flags */
-static int Flags = 0;
+/* An int variable holding the single-bit flags. It is shared by
+ * the GTK, streaming, DSP and decoder threads, so it is only
+ * changed by atomic read-modify-writes */
+static atomic_int Flags = 0;
+
+/* Thread running the GTK main loop */
+static GThread *gui_thread = NULL;
+
+/* Message passed to the GTK thread by other threads */
+typedef struct message_t {
+    gchar *mesg, *attr;
+} message_t;
 
 /*****************************************************************************/
 
@@ -56,8 +69,9 @@ static int Flags = 0;
  * Find and create (if necessary) dirs for user configs and final images.
  * XDG specs are supported:
  * https://specifications.freedesktop.org/basedir-spec/basedir-spec-latest.html
+ * If img_dir is not NULL it overrides the default image directory
  */
-bool prepareDirectories(void) {
+bool prepareDirectories(const char *img_dir) {
     char *var_ptr;
 
     /* System-wide configs are mandatory */
@@ -82,8 +96,9 @@ bool prepareDirectories(void) {
     }
 
     /* Cache for image storage is mandatory */
-    /* TODO allow user to select his own directory */
-    if ((var_ptr = getenv("XDG_CACHE_HOME")))
+    if (img_dir)
+        snprintf(glrpt_img_dir, sizeof(glrpt_img_dir), "%s", img_dir);
+    else if ((var_ptr = getenv("XDG_CACHE_HOME")))
         snprintf(glrpt_img_dir, sizeof(glrpt_img_dir),
                 "%s/%s", var_ptr, PACKAGE_NAME);
     else
@@ -211,7 +226,58 @@ static const char *Filename(const char *fpath) {
  */
 void Usage(void) {
   fprintf( stderr, "%s\n",
-      "Usage: glrpt [-hv]" );
+      "Usage: glrpt [-hv] [-H] [-c config] [-d driver[:index]] [-b blocks]"
+      " [-D filter] [-N nco] [-S simd] [-t seconds] [-o directory]\n"
+      "             [-i iq_file [-f format] [-r rate] [-m]]"
+      " [-w soft_file [-p]] [-s soft_file]" );
+
+  fprintf( stderr, "%s\n",
+      "       -H: Run headless (no GUI), decode and save images then exit");
+
+  fprintf( stderr, "%s\n",
+      "       -c: Load this configuration file instead of the first found");
+
+  fprintf( stderr, "%s\n",
+      "       -d: Use this SoapySDR driver (and device index)");
+
+  fprintf( stderr, "%s\n",
+      "       -b: Depth of SDR sample blocks ring (2-256, default 8)");
+
+  fprintf( stderr, "%s\n",
+      "       -D: SDR decimation filter: boxcar (default), fir or halfband");
+
+  fprintf( stderr, "%s\n",
+      "       -N: Costas PLL NCO: lut (phase accumulator, default) or cexp");
+
+  fprintf( stderr, "%s\n",
+      "       -S: Highest SIMD level: avx512 (default), avx2, ssse3, sse2 or none");
+
+  fprintf( stderr, "%s\n",
+      "       -t: Duration of decoding in seconds");
+
+  fprintf( stderr, "%s\n",
+      "       -o: Directory to save decoded images to");
+
+  fprintf( stderr, "%s\n",
+      "       -i: Read I/Q recording instead of SDR device");
+
+  fprintf( stderr, "%s\n",
+      "       -f: I/Q sample format: cs16, cs8, cu8, cf32 or wav");
+
+  fprintf( stderr, "%s\n",
+      "       -r: I/Q sample rate in S/s (not needed for wav)");
+
+  fprintf( stderr, "%s\n",
+      "       -m: Replay I/Q recording as fast as possible");
+
+  fprintf( stderr, "%s\n",
+      "       -w: Record demodulator soft symbols to file");
+
+  fprintf( stderr, "%s\n",
+      "       -p: Pack recorded soft symbols to 4 bits per symbol");
+
+  fprintf( stderr, "%s\n",
+      "       -s: Decode soft symbols file headless and report speed");
 
   fprintf( stderr, "%s\n",
       "       -h: Print this usage information and exit");
@@ -222,9 +288,27 @@ void Usage(void) {
 
 /*****************************************************************************/
 
+/* Show_Message_Idle()
+ *
+ * Shows a message passed from another thread in the GTK thread
+ */
+static gboolean Show_Message_Idle(gpointer data) {
+  message_t *message = (message_t *)data;
+
+  Show_Message( message->mesg, message->attr );
+  g_free( message->mesg );
+  g_free( message->attr );
+  g_free( message );
+
+  return( FALSE );
+}
+
+/*****************************************************************************/
+
 /* Show_Message()
  *
  * Prints a message string in the Text View scroller
+ * (or to stderr in headless mode)
  */
 void Show_Message(const char *mesg, const char *attr) {
   GtkAdjustment *adjustment;
@@ -232,6 +316,23 @@ void Show_Message(const char *mesg, const char *attr) {
   static GtkTextIter iter;
   static bool first_call = true;
 
+  /* No text view without GUI, print to stderr instead */
+  if( isFlagSet(HEADLESS_MODE) )
+  {
+    fprintf( stderr, "glrpt: %s\n", mesg );
+    return;
+  }
+
+  /* Only the GTK thread may touch the Text View */
+  if( !isGuiThread() )
+  {
+    message_t *message = g_new( message_t, 1 );
+    message->mesg = g_strdup( mesg );
+    message->attr = g_strdup( attr );
+    g_idle_add( Show_Message_Idle, message );
+    return;
+  }
+
   /* Initialize */
   if( first_call )
   {
@@ -435,6 +536,7 @@ void Cleanup(void) {
     Deinit_Chebyshev_Filter( &filter_data_i );
     Deinit_Chebyshev_Filter( &filter_data_q );
     Deinit_Ifft();
+    IQ_File_Close();
     Demod_Deinit();
 
     ClearFlag( STATUS_FLAGS_ALL );
@@ -446,28 +548,48 @@ void Cleanup(void) {
 
 /*****************************************************************************/
 
+/* Set_Gui_Thread()
+ *
+ * Records the calling thread as the one running the GTK main loop
+ */
+void Set_Gui_Thread(void) {
+  gui_thread = g_thread_self();
+}
+
+/*****************************************************************************/
+
+/* isGuiThread()
+ *
+ * Returns true if called from the GTK thread (or before it is set)
+ */
+bool isGuiThread(void) {
+  return( (gui_thread == NULL) || (g_thread_self() == gui_thread) );
+}
+
+/*****************************************************************************/
+
 /* Functions for testing and setting/clearing flags */
 
 int isFlagSet(int flag) {
-  return( Flags & flag );
+  return( atomic_load(&Flags) & flag );
 }
 
 /*****************************************************************************/
 
 int isFlagClear(int flag) {
-  return( !(Flags & flag) );
+  return( !(atomic_load(&Flags) & flag) );
 }
 
 /*****************************************************************************/
 
 void SetFlag(int flag) {
-  Flags |= flag;
+  atomic_fetch_or( &Flags, flag );
 }
 
 /*****************************************************************************/
 
 void ClearFlag(int flag) {
-  Flags &= ~flag;
+  atomic_fetch_and( &Flags, ~flag );
 }
 
 /*****************************************************************************/
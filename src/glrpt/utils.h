@@ -50,7 +50,7 @@ static inline int iClamp(int i, int min, int max) {
 
 /*****************************************************************************/
 
-bool prepareDirectories(void);
+bool prepareDirectories(const char *img_dir);
 void File_Name(char *file_name, uint32_t chn, const char *ext);
 void Usage(void);
 void Show_Message(const char *mesg, const char *attr);
@@ -73,6 +73,8 @@ void Save_Image_Raw(
         uint32_t max_val,
         uint8_t *buffer);
 void Cleanup(void);
+void Set_Gui_Thread(void);
+bool isGuiThread(void);
 int isFlagSet(int flag);
 int isFlagClear(int flag);
 void SetFlag(int flag);
@@ -22,7 +22,9 @@
 #include "../glrpt/display.h"
 #include "../glrpt/interface.h"
 #include "../glrpt/utils.h"
+#include "decimator.h"
 #include "ifft.h"
+#include "sample_ring.h"
 
 #include <glib.h>
 #include <gtk/gtk.h>
@@ -32,6 +34,7 @@
 #include <complex.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -45,27 +48,26 @@
 /* Range of gain slider */
 #define GAIN_SCALE  100.0
 
-#define DATA_SCALE  10.0
-
 /* DSP filter parameters */
 #define FILTER_RIPPLE   5.0
 #define FILTER_POLES    6
 
 /*****************************************************************************/
 
-static void SoapySDR_Close_Device(void);
 static void *SoapySDR_Stream(void *pid);
 
 /*****************************************************************************/
 
 static SoapySDRDevice *sdr = NULL;
 static SoapySDRStream *rxStream    = NULL;
+static pthread_t stream_thread;
+static bool stream_thread_run = false;
 static complex short  *stream_buff = NULL;
-static double  *data_buf_i[2] = { NULL, NULL };
-static double  *data_buf_q[2] = { NULL, NULL };
+static sample_ring_t sample_ring;
+static decimator_t decimator;
+static dsp_t   *decim_buf_i = NULL, *decim_buf_q = NULL;
 static size_t   stream_mtu;
 static uint32_t sdr_decimate;
-static double   data_scale;
 static uint32_t sdr_samplerate, sdr_buf_length;
 double demod_samplerate;
 
@@ -73,23 +75,24 @@ double demod_samplerate;
 
 /* SoapySDR_Close_Device()
  *
- * Closes thr RTL-SDR device, if open
+ * Closes the SDR device, if open, and frees the sample path.
+ * Waits for the streaming thread to end first, so it must be
+ * called after reception is stopped and the demodulator is
+ * done with the sample ring and filters
  */
-static void SoapySDR_Close_Device(void) {
+void SoapySDR_Close_Device(void) {
   int ret;
 
-  /* Deactivate and close the stream */
+  if( stream_thread_run )
+  {
+    pthread_join( stream_thread, NULL );
+    stream_thread_run = false;
+  }
+
+  /* Close the stream, deactivated by the streaming thread */
   ClearFlag( STATUS_SOAPYSDR_INIT );
   if( (rxStream != NULL) && (sdr != NULL) )
   {
-    ret = SoapySDRDevice_deactivateStream( sdr, rxStream, 0, 0 );
-    if( ret != SUCCESS )
-    {
-      Show_Message( "Failed to Deactivate Stream", "red" );
-      Show_Message( SoapySDRDevice_lastError(), "red" );
-      Error_Dialog();
-    }
-
     ret = SoapySDRDevice_closeStream( sdr, rxStream );
     if( ret != SUCCESS )
     {
@@ -114,12 +117,24 @@ static void SoapySDR_Close_Device(void) {
     sdr = NULL;
   }
 
+  /* Report sample blocks lost because the demodulator fell behind */
+  if( sample_ring.buf_i != NULL )
+  {
+    gchar mesg[ MESG_SIZE ];
+    uint32_t overruns = atomic_load( &sample_ring.overruns );
+    snprintf( mesg, sizeof(mesg),
+        "Sample Ring Overruns: %u  Max Queued: %u of %u",
+        overruns, atomic_load(&sample_ring.high_water),
+        sample_ring.depth - 1 );
+    Show_Message( mesg, overruns ? "orange" : "black" );
+  }
+
   /* Free the samples buffer */
   free_ptr( (void **)&stream_buff );
-  free_ptr( (void **)&data_buf_i[0] );
-  free_ptr( (void **)&data_buf_q[0] );
-  free_ptr( (void **)&data_buf_i[1] );
-  free_ptr( (void **)&data_buf_q[1] );
+  free_ptr( (void **)&decim_buf_i );
+  free_ptr( (void **)&decim_buf_q );
+  Decimator_Free( &decimator );
+  Sample_Ring_Free( &sample_ring );
 
   /* De-initialize Low Pass filter */
   Deinit_Chebyshev_Filter( &filter_data_i );
@@ -143,13 +158,14 @@ static void *SoapySDR_Stream(void *pid) {
   long long timeNs = 0;
   long timeout;
 
-  double temp_i, temp_q;
+  dsp_t *data_buf_i, *data_buf_q;
+  int ret;
 
   uint32_t
-    sdr_decim_cnt = 0,  /* Samples decimation counter */
-    buf_cnt       = 0,  /* Index to current data ring buffer */
     samp_buf_idx  = 0,  /* Output samples buffer index */
-    strm_buf_idx  = sdr_buf_length; /* Streaming buffer index */
+    decim_buf_len = 0,  /* Decimated samples from last read */
+    decim_buf_idx = 0,  /* Decimated samples buffer index */
+    cnt;
 
 
   /* Data transfer timeout in uSec,
@@ -161,58 +177,46 @@ static void *SoapySDR_Stream(void *pid) {
    * till reception stopped by the user */
   while( isFlagSet(STATUS_RECEIVING) )
   {
-    /* We need sdr_decimate summations to decimate samples */
+    /* Block of the sample ring to fill */
+    Sample_Ring_Write_Block( &sample_ring, &data_buf_i, &data_buf_q );
+
+    /* Fill the block with decimated samples */
     while( samp_buf_idx < sdr_buf_length )
     {
-      /* Summate sdr_decimate samples into one samples buffer */
-      temp_i = 0.0;
-      temp_q = 0.0;
-      for( sdr_decim_cnt = 0; sdr_decim_cnt < sdr_decimate; sdr_decim_cnt++ )
+      /* Read and decimate new data from the sample stream when exhausted */
+      if( decim_buf_idx >= decim_buf_len )
       {
-        /* Read new data from the sample stream when exhausted */
-        if( strm_buf_idx >= sdr_buf_length )
+        /* Read stream I/Q data from SDR device */
+        ret = SoapySDRDevice_readStream(
+            sdr, rxStream, buffs, stream_mtu, &flags, &timeNs, timeout );
+        if( ret <= 0 )
         {
-          /* Read stream I/Q data from SDR device */
-          SoapySDRDevice_readStream(
-              sdr, rxStream, buffs, stream_mtu, &flags, &timeNs, timeout );
-          strm_buf_idx = 0;
+          if( isFlagClear(STATUS_RECEIVING) ) break;
+          continue;
         }
 
-        /* Summate samples to decimate */
-        temp_i += creal( (complex double)stream_buff[strm_buf_idx] );
-        temp_q += cimag( (complex double)stream_buff[strm_buf_idx] );
-        strm_buf_idx++;
+        decim_buf_len = Decimator_Run( &decimator,
+            (const int16_t *)stream_buff, (uint32_t)ret, decim_buf_i, decim_buf_q );
+        decim_buf_idx = 0;
+        continue;
       }
 
       /* Top up Chebyshev LP filter buffers */
-      data_buf_i[buf_cnt][samp_buf_idx] = temp_i / data_scale;
-      data_buf_q[buf_cnt][samp_buf_idx] = temp_q / data_scale;
-
-      samp_buf_idx++;
+      cnt = decim_buf_len - decim_buf_idx;
+      if( cnt > sdr_buf_length - samp_buf_idx )
+        cnt = sdr_buf_length - samp_buf_idx;
+      memcpy( data_buf_i + samp_buf_idx,
+          decim_buf_i + decim_buf_idx, cnt * sizeof(dsp_t) );
+      memcpy( data_buf_q + samp_buf_idx,
+          decim_buf_q + decim_buf_idx, cnt * sizeof(dsp_t) );
+
+      samp_buf_idx  += cnt;
+      decim_buf_idx += cnt;
     }
-    samp_buf_idx = 0;
 
-    // Writes IQ samples to file, for testing only
-    /*{
-      static FILE *fdi = NULL, *fdq = NULL;
-      if( fdi == NULL ) fdi = fopen( "i.s", "w" );
-      if( fdq == NULL ) fdq = fopen( "q.s", "w" );
-      fwrite( data_buf_i[buf_cnt],
-          sizeof(double), (size_t)sdr_buf_length, fdi );
-      fwrite( data_buf_q[buf_cnt],
-          sizeof(double), (size_t)sdr_buf_length, fdq );
-    }*/
-
-    // Reads IQ samples from file, for testing only
-    /* {
-      static FILE *fdi = NULL, *fdq = NULL;
-      if( fdi == NULL ) fdi = fopen( "i.s", "r" );
-      if( fdq == NULL ) fdq = fopen( "q.s", "r" );
-      fread( data_buf_i[buf_cnt],
-          sizeof(double), (size_t)sdr_buf_length, fdi );
-      fread( data_buf_q[buf_cnt],
-          sizeof(double), (size_t)sdr_buf_length, fdq );
-    } */
+    /* Partly filled block at end of reception */
+    if( samp_buf_idx < sdr_buf_length ) break;
+    samp_buf_idx = 0;
 
     /* // Writes the phase angle of samples, for testing only
        if( isFlagSet(STATUS_DECODING) )
@@ -221,8 +225,8 @@ static void *SoapySDR_Stream(void *pid) {
        double phase, delta, x, y;
        for( uint32_t idx = 0; idx < sdr_buf_length; idx++ )
        {
-        x = (double)(data_buf_i[buf_cnt][idx]);
-        y = (double)(data_buf_q[buf_cnt][idx]);
+        x = (double)(data_buf_i[idx]);
+        y = (double)(data_buf_q[idx]);
         phase = atan2( fabs(x), fabs(y) ) * 57.3;
         if( (x > 0.0) && (y < 0.0) ) phase = 360.0 - phase;
         if( (x < 0.0) && (y > 0.0) ) phase = 180.0 - phase;
@@ -233,23 +237,23 @@ static void *SoapySDR_Stream(void *pid) {
       }
     } */
 
-    /* Link local buffer to filter's data buffer */
-    filter_data_i.samples_buf = data_buf_i[buf_cnt];
-    filter_data_q.samples_buf = data_buf_q[buf_cnt];
-    buf_cnt++;
-    if( buf_cnt >= 2 ) buf_cnt = 0;
-
-    int sval;
-    sem_getvalue( &demod_semaphore, &sval );
-    if( !sval ) sem_post( &demod_semaphore );
+    /* Queue block to the demodulator and wake it up. If the
+     * ring is full the block is dropped and counted instead */
+    if( Sample_Ring_Commit(&sample_ring) )
+      sem_post( &demod_semaphore );
   } /* while( isFlagSet(STATUS_RECEIVING) ) */
 
-  /* Close device when streaming is stopped */
-  SoapySDR_Close_Device();
+  /* Wake up demodulator to notice end of reception */
+  sem_post( &demod_semaphore );
 
-  /* Will de-initialize systems and free
-   * buffers only if (hopefully) its safe */
-  Cleanup();
+  /* Only stop streaming here, the demodulator may still be using
+   * the ring and filters. SoapySDR_Close_Device() frees them */
+  ret = SoapySDRDevice_deactivateStream( sdr, rxStream, 0, 0 );
+  if( ret != SUCCESS )
+  {
+    Show_Message( "Failed to Deactivate Stream", "red" );
+    Show_Message( SoapySDRDevice_lastError(), "red" );
+  }
 
   return( NULL );
 }
@@ -372,6 +376,83 @@ void SoapySDR_Set_Tuner_Gain(double gain) {
 
 /*****************************************************************************/
 
+/* SoapySDR_Set_Decimation()
+ *
+ * Finds the sample rate decimation factor for an input sample
+ * rate, which is the nearest power of 2, up to 32, and sets the
+ * effective demodulator sample rate accordingly
+ */
+uint32_t SoapySDR_Set_Decimation(uint32_t samplerate) {
+  gchar mesg[ MESG_SIZE ];
+  uint32_t decimate;
+
+  /* Minimum prefered demodulator sample rate, see SoapySDR_Init() */
+  decimate = samplerate / ( 4 * rc_data.symbol_rate );
+  int sav = 1;
+  int min = 64; /* Prime to find a min */
+  for( int i = 0; i <= 5; i++ )
+  {
+    int diff = abs( (int)decimate - (1 << i) );
+    if( min > diff )
+    {
+      min = diff;
+      sav = i;
+    }
+  }
+  decimate = (uint32_t)( 1 << sav );
+
+  /* We now need to calculate the sample rate decimation factor for
+   * high sample rates and the new effective demodulator sample rate */
+  demod_samplerate = (double)samplerate / (double)decimate;
+  snprintf( mesg, sizeof(mesg),
+      "Sampling Rate Decimation: %u", decimate );
+  Show_Message( mesg, "green" );
+  snprintf( mesg, sizeof(mesg),
+      "Demod Sampling Rate: %8.1f", demod_samplerate );
+  Show_Message( mesg, "green" );
+
+  return( decimate );
+}
+
+/*****************************************************************************/
+
+/* SoapySDR_Init_Filters()
+ *
+ * Initializes the I/Q Low Pass Filters for buffers of buf_len
+ * samples at demod_samplerate and the waterfall ifft
+ */
+bool SoapySDR_Init_Filters(uint32_t buf_len) {
+  /* Init Chebyshev I/Q data Low Pass Filters */
+  if( !Init_Chebyshev_Filter(
+        &filter_data_i,
+        buf_len,
+        rc_data.sdr_filter_bw,
+        demod_samplerate,
+        FILTER_RIPPLE,
+        FILTER_POLES,
+        FILTER_LOWPASS) ||
+      !Init_Chebyshev_Filter(
+        &filter_data_q,
+        buf_len,
+        rc_data.sdr_filter_bw,
+        demod_samplerate,
+        FILTER_RIPPLE,
+        FILTER_POLES,
+        FILTER_LOWPASS) )
+    return( false );
+
+  /* Initialize ifft. Waterfall with is an odd number
+   * to provide a center line. IFFT requires a width
+   * that is a power of 2 */
+  if( isFlagClear(HEADLESS_MODE) &&
+      !Initialize_IFFT((int16_t)wfall_width + 1) )
+    return( false );
+
+  return( true );
+}
+
+/*****************************************************************************/
+
 /* SoapySDR_Init()
  *
  * Initialize SoapySDR by finding the specified SDR device,
@@ -473,9 +554,12 @@ bool SoapySDR_Init(void) {
 
   /* Display Tuner Type */
   char *hrd = SoapySDRDevice_getHardwareKey( sdr );
-  GtkEntry *entry = GTK_ENTRY(
-      Builder_Get_Object(main_window_builder, "sdr_tuner_entry") );
-  gtk_entry_set_text( entry, hrd );
+  if( isFlagClear(HEADLESS_MODE) )
+  {
+    GtkEntry *entry = GTK_ENTRY(
+        Builder_Get_Object(main_window_builder, "sdr_tuner_entry") );
+    gtk_entry_set_text( entry, hrd );
+  }
   snprintf( mesg, sizeof(mesg), "Instantiated SDR Device \"%s\"", hrd );
   Show_Message( mesg, "green" );
   Display_Icon( status_icon, "gtk-yes" );
@@ -560,33 +644,8 @@ bool SoapySDR_Init(void) {
       "Set Sampling Rate to %uS/s", sdr_samplerate );
   Show_Message( mesg, "green" );
 
-  /* Find sample rate decimation factor which
-   * is the nearest power of 2, up to 32 */
-  sdr_decimate = (uint32_t)sdr_samplerate / temp;
-  int sav = 1;
-  int min = 64; /* Prime to find a min */
-  for( int i = 0; i <= 5; i++ )
-  {
-    int diff = abs( (int)sdr_decimate - (1 << i) );
-    if( min > diff )
-    {
-      min = diff;
-      sav = i;
-    }
-  }
-  sdr_decimate = (uint32_t)( 1 << sav );
-  data_scale   = (double)sdr_decimate * DATA_SCALE;
-
-  /* We now need to calculate the sample rate decimation factor for
-   * high sample rates and the new effective demodulator sample rate */
-  demod_samplerate =
-    (double)sdr_samplerate / (double)sdr_decimate;
-  snprintf( mesg, sizeof(mesg),
-      "Sampling Rate Decimation: %u", sdr_decimate );
-  Show_Message( mesg, "green" );
-  snprintf( mesg, sizeof(mesg),
-      "Demod Sampling Rate: %8.1f", demod_samplerate );
-  Show_Message( mesg, "green" );
+  /* Find decimation factor and demodulator sample rate */
+  sdr_decimate = SoapySDR_Set_Decimation( sdr_samplerate );
 
   /* Set Tuner Gain Mode to auto or manual as per config file */
   SoapySDR_Set_Tuner_Gain_Mode();
@@ -616,37 +675,25 @@ bool SoapySDR_Init(void) {
   mreq = stream_mtu * sizeof( complex short );
   mem_alloc( (void **)&stream_buff, mreq );
 
-  /* Allocate local data buffers */
-  mreq = stream_mtu * sizeof( double );
-  for( idx = 0; idx < 2; idx++ )
+  /* Set up decimation filter and buffers for its output */
+  if( !Decimator_Init(&decimator, sdr_decimate,
+        rc_data.decim_filter, (uint32_t)stream_mtu) )
   {
-    mem_alloc( (void **)&data_buf_i[idx], mreq );
-    mem_alloc( (void **)&data_buf_q[idx], mreq );
+    Error_Dialog();
+    return( false );
   }
+  mreq = ( stream_mtu / sdr_decimate + 1 ) * sizeof( dsp_t );
+  mem_alloc( (void **)&decim_buf_i, mreq );
+  mem_alloc( (void **)&decim_buf_q, mreq );
 
-  /* Init Chebyshev I/Q data Low Pass Filters */
-  Init_Chebyshev_Filter(
-      &filter_data_i,
-      sdr_buf_length,
-      rc_data.sdr_filter_bw,
-      demod_samplerate,
-      FILTER_RIPPLE,
-      FILTER_POLES,
-      FILTER_LOWPASS );
-
-  Init_Chebyshev_Filter(
-      &filter_data_q,
-      sdr_buf_length,
-      rc_data.sdr_filter_bw,
-      demod_samplerate,
-      FILTER_RIPPLE,
-      FILTER_POLES,
-      FILTER_LOWPASS );
+  /* Allocate ring of sample blocks for the demodulator */
+  Sample_Ring_Init( &sample_ring, rc_data.ring_depth, sdr_buf_length );
+  snprintf( mesg, sizeof(mesg),
+      "Sample Ring Depth: %u Blocks", rc_data.ring_depth );
+  Show_Message( mesg, "green" );
 
-  /* Initialize ifft. Waterfall with is an odd number
-   * to provide a center line. IFFT requires a width
-   * that is a power of 2 */
-  if( !Initialize_IFFT((int16_t)wfall_width + 1) )
+  /* Init I/Q Low Pass Filters and waterfall ifft */
+  if( !SoapySDR_Init_Filters(sdr_buf_length) )
     return( false );
 
   /* Wait a little for things to settle and set init OK flag */
@@ -660,6 +707,28 @@ bool SoapySDR_Init(void) {
 
 /*****************************************************************************/
 
+/* SoapySDR_Read_Block()
+ *
+ * Links the oldest block of samples in the ring to the I/Q
+ * filters' data buffers. Returns false if none is queued
+ */
+bool SoapySDR_Read_Block(void) {
+  return( Sample_Ring_Read_Block(&sample_ring,
+        &filter_data_i.samples_buf, &filter_data_q.samples_buf) );
+}
+
+/*****************************************************************************/
+
+/* SoapySDR_Release_Block()
+ *
+ * Returns the block of samples read by the demodulator to the ring
+ */
+void SoapySDR_Release_Block(void) {
+  Sample_Ring_Release( &sample_ring );
+}
+
+/*****************************************************************************/
+
 /* SoapySDR_Activate_Stream()
  *
  * Closes thr RTL-SDR device, if open
@@ -679,6 +748,8 @@ bool SoapySDR_Activate_Stream(void) {
     Display_Icon( status_icon, "gtk-no" );
     return( false );
   }
+  stream_thread = pthread_id;
+  stream_thread_run = true;
 
   /* Activate receive stream */
   ret = SoapySDRDevice_activateStream( sdr, rxStream, 0, 0, 0 );
@@ -687,7 +758,10 @@ bool SoapySDR_Activate_Stream(void) {
     Show_Message( "Failed to activate Receive Stream", "red" );
     Show_Message( SoapySDRDevice_lastError(), "red" );
     Error_Dialog();
-    Display_Icon( status_icon, "gtk-no" );
+
+    /* Stop the streaming thread and close the device */
+    ClearFlag( STATUS_RECEIVING );
+    SoapySDR_Close_Device();
     return( false );
   }
   Show_Message( "Receive Stream activated OK", "green" );
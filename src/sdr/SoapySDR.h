@@ -24,6 +24,11 @@
 
 /*****************************************************************************/
 
+/* Scale of summated samples fed to the I/Q filters */
+#define DATA_SCALE  10.0
+
+/*****************************************************************************/
+
 extern double demod_samplerate;
 
 /*****************************************************************************/
@@ -31,8 +36,13 @@ extern double demod_samplerate;
 bool SoapySDR_Set_Center_Freq(uint32_t center_freq);
 void SoapySDR_Set_Tuner_Gain_Mode(void);
 void SoapySDR_Set_Tuner_Gain(double gain);
+uint32_t SoapySDR_Set_Decimation(uint32_t samplerate);
+bool SoapySDR_Init_Filters(uint32_t buf_len);
 bool SoapySDR_Init(void);
+bool SoapySDR_Read_Block(void);
+void SoapySDR_Release_Block(void);
 bool SoapySDR_Activate_Stream(void);
+void SoapySDR_Close_Device(void);
 
 /*****************************************************************************/
 
@@ -0,0 +1,901 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+#include "decimator.h"
+
+#include "../common/common.h"
+#include "../common/cpu.h"
+#include "../glrpt/utils.h"
+#include "SoapySDR.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#ifdef CPU_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+/*****************************************************************************/
+
+/* Taps are padded to a multiple of 8 16 bit integers, a SIMD vector */
+#define DECIM_TAP_ALIGN     8
+
+/* Taps are in Q15 fixed point, so the DC gain of low pass stages is 1 */
+#define DECIM_COEFF_SHIFT   15
+#define DECIM_COEFF_UNITY   (1 << DECIM_COEFF_SHIFT)
+
+/* Taps of the FIR decimator per decimation factor.
+ * With a Blackman window this keeps aliases into the inner
+ * half of the output band 70 dB down, 65 dB from decimation
+ * by 16, where the smallest Q15 taps round to nothing */
+#define DECIM_FIR_TAPS      12
+
+/* Taps of the last half-band stage, which has the narrowest
+ * transition, and of the earlier stages, enough to keep aliases
+ * from near their input Nyquist frequency 70 dB down */
+#define DECIM_HB_TAPS_LAST  23
+#define DECIM_HB_TAPS       15
+
+/* Pairs of taps of the longest half-band stage */
+#define DECIM_HB_PAIRS_MAX  ((DECIM_HB_TAPS_LAST + 1) / 2)
+
+/*****************************************************************************/
+
+static void Stage_Init(
+        decim_stage_t *stage,
+        uint32_t factor,
+        uint32_t taps,
+        uint32_t max_in);
+static void Stage_Boxcar(decim_stage_t *stage);
+static void Stage_Low_Pass(decim_stage_t *stage, uint32_t taps, double cutoff);
+static void Stage_Half_Band(decim_stage_t *stage, uint32_t taps);
+static void Dot_IQ(
+        const int16_t *coeff,
+        const int16_t *x_i,
+        const int16_t *x_q,
+        uint32_t taps,
+        int32_t *y_i,
+        int32_t *y_q);
+static void Half_Band_IQ(
+        const int16_t *coeff,
+        const int16_t *x_i,
+        const int16_t *x_q,
+        uint32_t pairs,
+        uint32_t cnt,
+        int32_t *y_i,
+        int32_t *y_q);
+static void Split_IQ(const int16_t *iq, uint32_t len, int16_t *x_i, int16_t *x_q);
+static void Narrow_IQ(
+        const int32_t *acc_i,
+        const int32_t *acc_q,
+        uint32_t len,
+        int16_t *x_i,
+        int16_t *x_q);
+#ifdef CPU_X86_DISPATCH
+static inline __m128i Sum_Lanes(__m128i sum);
+static void Dot_IQ_SSE2(
+        const int16_t *coeff,
+        const int16_t *x_i,
+        const int16_t *x_q,
+        uint32_t taps,
+        int32_t *y_i,
+        int32_t *y_q);
+static void Dot_IQ_AVX2(
+        const int16_t *coeff,
+        const int16_t *x_i,
+        const int16_t *x_q,
+        uint32_t taps,
+        int32_t *y_i,
+        int32_t *y_q);
+static void Half_Band_IQ_SSE2(
+        const int16_t *coeff,
+        const int16_t *x_i,
+        const int16_t *x_q,
+        uint32_t pairs,
+        uint32_t cnt,
+        int32_t *y_i,
+        int32_t *y_q);
+static void Half_Band_IQ_AVX2(
+        const int16_t *coeff,
+        const int16_t *x_i,
+        const int16_t *x_q,
+        uint32_t pairs,
+        uint32_t cnt,
+        int32_t *y_i,
+        int32_t *y_q);
+static void Split_IQ_SSE2(
+        const int16_t *iq, uint32_t len, int16_t *x_i, int16_t *x_q);
+static void Split_IQ_AVX2(
+        const int16_t *iq, uint32_t len, int16_t *x_i, int16_t *x_q);
+static void Narrow_IQ_SSE2(
+        const int32_t *acc_i,
+        const int32_t *acc_q,
+        uint32_t len,
+        int16_t *x_i,
+        int16_t *x_q);
+static void Narrow_IQ_AVX2(
+        const int32_t *acc_i,
+        const int32_t *acc_q,
+        uint32_t len,
+        int16_t *x_i,
+        int16_t *x_q);
+#endif
+static uint32_t Stage_Run(
+        decim_stage_t *stage,
+        uint32_t len,
+        int32_t *acc_i,
+        int32_t *acc_q);
+
+/*****************************************************************************/
+
+/* Dot product kernel, bound to CPU features by Decimator_Init() */
+static void (*dot_iq)(
+        const int16_t *coeff,
+        const int16_t *x_i,
+        const int16_t *x_q,
+        uint32_t taps,
+        int32_t *y_i,
+        int32_t *y_q) = Dot_IQ;
+
+/* Half-band kernel, bound to CPU features by Decimator_Init() */
+static void (*half_band_iq)(
+        const int16_t *coeff,
+        const int16_t *x_i,
+        const int16_t *x_q,
+        uint32_t pairs,
+        uint32_t cnt,
+        int32_t *y_i,
+        int32_t *y_q) = Half_Band_IQ;
+
+/* Conversions of samples between stages, bound
+ * to CPU features by Decimator_Init() */
+static void (*split_iq)(
+        const int16_t *iq, uint32_t len, int16_t *x_i, int16_t *x_q) = Split_IQ;
+static void (*narrow_iq)(
+        const int32_t *acc_i,
+        const int32_t *acc_q,
+        uint32_t len,
+        int16_t *x_i,
+        int16_t *x_q) = Narrow_IQ;
+
+/*****************************************************************************/
+
+/* Stage_Init()
+ *
+ * Allocates a stage of taps (rounded up to the vector length)
+ * for inputs of up to max_in samples, with cleared history
+ */
+static void Stage_Init(
+        decim_stage_t *stage,
+        uint32_t factor,
+        uint32_t taps,
+        uint32_t max_in) {
+    stage->factor = factor;
+    stage->taps   = (taps + DECIM_TAP_ALIGN - 1) / DECIM_TAP_ALIGN *
+        DECIM_TAP_ALIGN;
+    stage->pairs  = 0;
+    stage->phase  = 0;
+
+    stage->coeff  = NULL;
+    stage->hist_i = NULL;
+    stage->hist_q = NULL;
+    mem_alloc((void **)&stage->coeff, stage->taps * sizeof(int16_t));
+    mem_alloc((void **)&stage->hist_i,
+            (stage->taps - 1 + max_in) * sizeof(int16_t));
+    mem_alloc((void **)&stage->hist_q,
+            (stage->taps - 1 + max_in) * sizeof(int16_t));
+}
+
+/*****************************************************************************/
+
+/* Stage_Boxcar()
+ *
+ * Makes the stage sum factor consecutive samples
+ */
+static void Stage_Boxcar(decim_stage_t *stage) {
+    for (uint32_t idx = 0; idx < stage->factor; idx++)
+        stage->coeff[stage->taps - 1 - idx] = 1;
+
+    stage->coeff_sum = (int32_t)stage->factor;
+}
+
+/*****************************************************************************/
+
+/* Stage_Low_Pass()
+ *
+ * Makes the stage a Blackman windowed sinc low pass filter
+ * of taps length and cutoff as a fraction of input sample
+ * rate, quantized to Q15 with a DC gain of exactly 1
+ */
+static void Stage_Low_Pass(decim_stage_t *stage, uint32_t taps, double cutoff) {
+    double *h = NULL, sum = 0.0, t, w;
+    int32_t qsum = 0;
+    uint32_t idx, center = 0;
+
+    mem_alloc((void **)&h, taps * sizeof(double));
+
+    for (idx = 0; idx < taps; idx++) {
+        t = (double)idx - (double)(taps - 1) / 2.0;
+        w = 0.42 - 0.5 * cos(M_2PI * idx / (taps - 1)) +
+            0.08 * cos(2.0 * M_2PI * idx / (taps - 1));
+
+        if (t == 0.0)
+            h[idx] = 2.0 * cutoff;
+        else
+            h[idx] = sin(M_2PI * cutoff * t) / (M_PI * t);
+
+        h[idx] *= w;
+        sum    += h[idx];
+    }
+
+    /* Quantize, reversed, and put rounding errors in the center tap */
+    for (idx = 0; idx < taps; idx++) {
+        int32_t q = (int32_t)lround(h[idx] * DECIM_COEFF_UNITY / sum);
+
+        stage->coeff[stage->taps - 1 - idx] = (int16_t)q;
+        qsum += q;
+
+        if (fabs(h[idx]) > fabs(h[center]))
+            center = idx;
+    }
+
+    stage->coeff[stage->taps - 1 - center] += (int16_t)(DECIM_COEFF_UNITY - qsum);
+    stage->coeff_sum = DECIM_COEFF_UNITY;
+
+    free_ptr((void **)&h);
+}
+
+/*****************************************************************************/
+
+/* Stage_Half_Band()
+ *
+ * Makes the stage a half-band low pass filter of taps length,
+ * 3 more than a multiple of 4. Taps an even distance from the
+ * center are zero but the center tap, so odd numbered taps are
+ * zero but the center one: Half_Band_IQ() runs over pairs of
+ * an odd tap and the even tap after it, in which the center
+ * tap takes the place of a zero one at no cost
+ */
+static void Stage_Half_Band(decim_stage_t *stage, uint32_t taps) {
+    uint32_t center = (taps - 1) / 2, pad = stage->taps - taps;
+
+    Stage_Low_Pass(stage, taps, 0.25);
+
+    /* Zero exactly the taps that are only rounding errors */
+    for (uint32_t idx = 1; idx < center; idx += 2) {
+        stage->coeff[pad + center - 1 - idx] = 0;
+        stage->coeff[pad + center + 1 + idx] = 0;
+    }
+
+    /* Taps are padded at the front, by one at least */
+    stage->pairs = (taps + 1) / 2;
+}
+
+/*****************************************************************************/
+
+/* Decimator_Type()
+ *
+ * Maps a decimation filter name to a DECIM_* value
+ */
+bool Decimator_Type(const char *name, uint8_t *type) {
+    if (strcasecmp(name, "boxcar") == 0)
+        *type = DECIM_BOXCAR;
+    else if (strcasecmp(name, "fir") == 0)
+        *type = DECIM_FIR;
+    else if (strcasecmp(name, "halfband") == 0)
+        *type = DECIM_HALFBAND;
+    else
+        return false;
+
+    return true;
+}
+
+/*****************************************************************************/
+
+/* Decimator_Init()
+ *
+ * Sets up decimation by factor (a power of 2) with the given
+ * filter type, for inputs of up to max_in samples at a time
+ */
+bool Decimator_Init(
+        decimator_t *dec,
+        uint32_t factor,
+        uint8_t type,
+        uint32_t max_in) {
+    char mesg[MESG_SIZE];
+    uint32_t idx, taps = 0;
+
+    memset(dec, 0, sizeof(*dec));
+    dec->type    = type;
+    dec->factor  = factor;
+    dec->max_in  = max_in;
+
+    /* Pick the dot product for the CPU */
+    dot_iq       = Dot_IQ;
+    half_band_iq = Half_Band_IQ;
+    split_iq     = Split_IQ;
+    narrow_iq    = Narrow_IQ;
+#ifdef CPU_X86_DISPATCH
+    if (Cpu_Simd() >= CPU_SIMD_AVX2) {
+        dot_iq       = Dot_IQ_AVX2;
+        half_band_iq = Half_Band_IQ_AVX2;
+        split_iq     = Split_IQ_AVX2;
+        narrow_iq    = Narrow_IQ_AVX2;
+    } else if (Cpu_Simd() >= CPU_SIMD_SSE2) {
+        dot_iq       = Dot_IQ_SSE2;
+        half_band_iq = Half_Band_IQ_SSE2;
+        split_iq     = Split_IQ_SSE2;
+        narrow_iq    = Narrow_IQ_SSE2;
+    }
+#endif
+
+    /* Without decimation samples are only scaled */
+    if (factor == 1)
+        type = DECIM_BOXCAR;
+
+    switch (type) {
+        case DECIM_BOXCAR:
+            dec->nstages = 1;
+            Stage_Init(&dec->stage[0], factor, factor, max_in);
+            Stage_Boxcar(&dec->stage[0]);
+            taps = factor;
+            break;
+
+        case DECIM_FIR:
+            /* Cutoff at the output Nyquist frequency */
+            taps = DECIM_FIR_TAPS * factor;
+            dec->nstages = 1;
+            Stage_Init(&dec->stage[0], factor, taps, max_in);
+            Stage_Low_Pass(&dec->stage[0], taps, 0.5 / (double)factor);
+            break;
+
+        case DECIM_HALFBAND:
+            /* Half-bands cut off at a quarter of their input rate */
+            while ((1u << dec->nstages) < factor) {
+                if (dec->nstages >= DECIM_STAGES_MAX) {
+                    Show_Message("Decimation factor too large", "red");
+                    Decimator_Free(dec);
+                    return false;
+                }
+
+                dec->nstages++;
+            }
+
+            for (idx = 0; idx < dec->nstages; idx++) {
+                uint32_t hb_taps = (idx == dec->nstages - 1) ?
+                    DECIM_HB_TAPS_LAST : DECIM_HB_TAPS;
+
+                Stage_Init(&dec->stage[idx], 2, hb_taps, max_in);
+                Stage_Half_Band(&dec->stage[idx], hb_taps);
+                taps += hb_taps;
+            }
+            break;
+
+        default:
+            Show_Message("Invalid decimation filter", "red");
+            return false;
+    }
+
+    mem_alloc((void **)&dec->acc_i,  max_in * sizeof(int32_t));
+    mem_alloc((void **)&dec->acc_q,  max_in * sizeof(int32_t));
+
+    /* Scale outputs to unity DC gain and the demodulator's range */
+    dec->out_div = (double)dec->stage[dec->nstages - 1].coeff_sum * DATA_SCALE;
+
+    snprintf(mesg, sizeof(mesg), "Decimation Filter: %s, %u Taps",
+            (type == DECIM_BOXCAR) ? "Boxcar" :
+            (type == DECIM_FIR) ? "FIR" : "Half-band Cascade", taps);
+    Show_Message(mesg, "green");
+
+    return true;
+}
+
+/*****************************************************************************/
+
+/* Dot_IQ()
+ *
+ * Runs taps of a stage over I and Q input history
+ */
+static void Dot_IQ(
+        const int16_t *coeff,
+        const int16_t *x_i,
+        const int16_t *x_q,
+        uint32_t taps,
+        int32_t *y_i,
+        int32_t *y_q) {
+    int32_t sum_i = 0, sum_q = 0;
+
+    for (uint32_t idx = 0; idx < taps; idx++) {
+        sum_i += coeff[idx] * x_i[idx];
+        sum_q += coeff[idx] * x_q[idx];
+    }
+
+    *y_i = sum_i;
+    *y_q = sum_q;
+}
+
+/*****************************************************************************/
+
+/* Half_Band_IQ()
+ *
+ * Runs the pairs of taps of a half-band stage over I and Q input
+ * history, for cnt outputs each 2 inputs after the one before
+ */
+static void Half_Band_IQ(
+        const int16_t *coeff,
+        const int16_t *x_i,
+        const int16_t *x_q,
+        uint32_t pairs,
+        uint32_t cnt,
+        int32_t *y_i,
+        int32_t *y_q) {
+    for (uint32_t out = 0; out < cnt; out++) {
+        int32_t sum_i = 0, sum_q = 0;
+
+        for (uint32_t idx = 0; idx < 2 * pairs; idx += 2) {
+            sum_i += coeff[idx] * x_i[idx] + coeff[idx + 1] * x_i[idx + 1];
+            sum_q += coeff[idx] * x_q[idx] + coeff[idx + 1] * x_q[idx + 1];
+        }
+
+        y_i[out] = sum_i;
+        y_q[out] = sum_q;
+        x_i += 2;
+        x_q += 2;
+    }
+}
+
+/*****************************************************************************/
+
+/* Split_IQ()
+ *
+ * Separates len interleaved I/Q samples into I and Q
+ */
+static void Split_IQ(const int16_t *iq, uint32_t len, int16_t *x_i, int16_t *x_q) {
+    for (uint32_t idx = 0; idx < len; idx++) {
+        x_i[idx] = iq[2 * idx];
+        x_q[idx] = iq[2 * idx + 1];
+    }
+}
+
+/*****************************************************************************/
+
+/* Narrow_IQ()
+ *
+ * Rounds len accumulated I/Q outputs of a stage back to 16 bits
+ */
+static void Narrow_IQ(
+        const int32_t *acc_i,
+        const int32_t *acc_q,
+        uint32_t len,
+        int16_t *x_i,
+        int16_t *x_q) {
+    int32_t v;
+
+    for (uint32_t idx = 0; idx < len; idx++) {
+        v = (acc_i[idx] + (1 << (DECIM_COEFF_SHIFT - 1))) >> DECIM_COEFF_SHIFT;
+        x_i[idx] = (int16_t)iClamp(v, INT16_MIN, INT16_MAX);
+
+        v = (acc_q[idx] + (1 << (DECIM_COEFF_SHIFT - 1))) >> DECIM_COEFF_SHIFT;
+        x_q[idx] = (int16_t)iClamp(v, INT16_MIN, INT16_MAX);
+    }
+}
+
+/*****************************************************************************/
+
+#ifdef CPU_X86_DISPATCH
+/* Sum_Lanes()
+ *
+ * Adds up the 4 lanes of 32 bit sums
+ */
+__attribute__((target("sse2")))
+static inline __m128i Sum_Lanes(__m128i sum) {
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    return _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+}
+
+/*****************************************************************************/
+
+/* Dot_IQ_SSE2()
+ *
+ * Dot_IQ() with 8 16 bit products at a time
+ */
+__attribute__((target("sse2")))
+static void Dot_IQ_SSE2(
+        const int16_t *coeff,
+        const int16_t *x_i,
+        const int16_t *x_q,
+        uint32_t taps,
+        int32_t *y_i,
+        int32_t *y_q) {
+    __m128i sum_i = _mm_setzero_si128();
+    __m128i sum_q = _mm_setzero_si128();
+
+    for (uint32_t idx = 0; idx < taps; idx += DECIM_TAP_ALIGN) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(coeff + idx));
+
+        sum_i = _mm_add_epi32(sum_i, _mm_madd_epi16(c,
+                    _mm_loadu_si128((const __m128i *)(x_i + idx))));
+        sum_q = _mm_add_epi32(sum_q, _mm_madd_epi16(c,
+                    _mm_loadu_si128((const __m128i *)(x_q + idx))));
+    }
+
+    *y_i = _mm_cvtsi128_si32(Sum_Lanes(sum_i));
+    *y_q = _mm_cvtsi128_si32(Sum_Lanes(sum_q));
+}
+
+/*****************************************************************************/
+
+/* Dot_IQ_AVX2()
+ *
+ * Dot_IQ() with 16 16 bit products at a time,
+ * and 8 for the last taps if they are not 16
+ */
+__attribute__((target("avx2")))
+static void Dot_IQ_AVX2(
+        const int16_t *coeff,
+        const int16_t *x_i,
+        const int16_t *x_q,
+        uint32_t taps,
+        int32_t *y_i,
+        int32_t *y_q) {
+    __m256i acc_i = _mm256_setzero_si256();
+    __m256i acc_q = _mm256_setzero_si256();
+    __m128i sum_i, sum_q;
+    uint32_t idx;
+
+    for (idx = 0; idx + 2 * DECIM_TAP_ALIGN <= taps; idx += 2 * DECIM_TAP_ALIGN) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(coeff + idx));
+
+        acc_i = _mm256_add_epi32(acc_i, _mm256_madd_epi16(c,
+                    _mm256_loadu_si256((const __m256i *)(x_i + idx))));
+        acc_q = _mm256_add_epi32(acc_q, _mm256_madd_epi16(c,
+                    _mm256_loadu_si256((const __m256i *)(x_q + idx))));
+    }
+
+    sum_i = _mm_add_epi32(_mm256_castsi256_si128(acc_i),
+            _mm256_extracti128_si256(acc_i, 1));
+    sum_q = _mm_add_epi32(_mm256_castsi256_si128(acc_q),
+            _mm256_extracti128_si256(acc_q, 1));
+
+    if (idx < taps) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(coeff + idx));
+
+        sum_i = _mm_add_epi32(sum_i, _mm_madd_epi16(c,
+                    _mm_loadu_si128((const __m128i *)(x_i + idx))));
+        sum_q = _mm_add_epi32(sum_q, _mm_madd_epi16(c,
+                    _mm_loadu_si128((const __m128i *)(x_q + idx))));
+    }
+
+    *y_i = _mm_cvtsi128_si32(Sum_Lanes(sum_i));
+    *y_q = _mm_cvtsi128_si32(Sum_Lanes(sum_q));
+}
+
+/*****************************************************************************/
+
+/* Half_Band_IQ_SSE2()
+ *
+ * Half_Band_IQ() for 4 outputs at a time. The input pairs of 4
+ * consecutive outputs are one vector, so a pair of taps, in all
+ * lanes, takes a single multiply-add, without horizontal sums
+ */
+__attribute__((target("sse2")))
+static void Half_Band_IQ_SSE2(
+        const int16_t *coeff,
+        const int16_t *x_i,
+        const int16_t *x_q,
+        uint32_t pairs,
+        uint32_t cnt,
+        int32_t *y_i,
+        int32_t *y_q) {
+    __m128i c[DECIM_HB_PAIRS_MAX];
+    uint32_t out, idx;
+
+    for (idx = 0; idx < pairs; idx++)
+        c[idx] = _mm_set1_epi32((int32_t)((uint16_t)coeff[2 * idx] |
+                    ((uint32_t)(uint16_t)coeff[2 * idx + 1] << 16)));
+
+    for (out = 0; out + 4 <= cnt; out += 4) {
+        __m128i sum_i = _mm_setzero_si128();
+        __m128i sum_q = _mm_setzero_si128();
+
+        for (idx = 0; idx < pairs; idx++) {
+            sum_i = _mm_add_epi32(sum_i, _mm_madd_epi16(c[idx],
+                        _mm_loadu_si128((const __m128i *)(x_i + 2 * idx))));
+            sum_q = _mm_add_epi32(sum_q, _mm_madd_epi16(c[idx],
+                        _mm_loadu_si128((const __m128i *)(x_q + 2 * idx))));
+        }
+
+        _mm_storeu_si128((__m128i *)(y_i + out), sum_i);
+        _mm_storeu_si128((__m128i *)(y_q + out), sum_q);
+        x_i += 8;
+        x_q += 8;
+    }
+
+    Half_Band_IQ(coeff, x_i, x_q, pairs, cnt - out, y_i + out, y_q + out);
+}
+
+/*****************************************************************************/
+
+/* Half_Band_IQ_AVX2()
+ *
+ * Half_Band_IQ_SSE2() for 8 outputs at a time
+ */
+__attribute__((target("avx2")))
+static void Half_Band_IQ_AVX2(
+        const int16_t *coeff,
+        const int16_t *x_i,
+        const int16_t *x_q,
+        uint32_t pairs,
+        uint32_t cnt,
+        int32_t *y_i,
+        int32_t *y_q) {
+    __m256i c[DECIM_HB_PAIRS_MAX];
+    uint32_t out, idx;
+
+    for (idx = 0; idx < pairs; idx++)
+        c[idx] = _mm256_set1_epi32((int32_t)((uint16_t)coeff[2 * idx] |
+                    ((uint32_t)(uint16_t)coeff[2 * idx + 1] << 16)));
+
+    for (out = 0; out + 8 <= cnt; out += 8) {
+        __m256i sum_i = _mm256_setzero_si256();
+        __m256i sum_q = _mm256_setzero_si256();
+
+        for (idx = 0; idx < pairs; idx++) {
+            sum_i = _mm256_add_epi32(sum_i, _mm256_madd_epi16(c[idx],
+                        _mm256_loadu_si256((const __m256i *)(x_i + 2 * idx))));
+            sum_q = _mm256_add_epi32(sum_q, _mm256_madd_epi16(c[idx],
+                        _mm256_loadu_si256((const __m256i *)(x_q + 2 * idx))));
+        }
+
+        _mm256_storeu_si256((__m256i *)(y_i + out), sum_i);
+        _mm256_storeu_si256((__m256i *)(y_q + out), sum_q);
+        x_i += 16;
+        x_q += 16;
+    }
+
+    Half_Band_IQ(coeff, x_i, x_q, pairs, cnt - out, y_i + out, y_q + out);
+}
+
+/*****************************************************************************/
+
+/* Split_IQ_SSE2()
+ *
+ * Split_IQ() 8 samples at a time, I sign extended from
+ * the low halves of 32 bit lanes and Q from the high ones
+ */
+__attribute__((target("sse2")))
+static void Split_IQ_SSE2(
+        const int16_t *iq, uint32_t len, int16_t *x_i, int16_t *x_q) {
+    uint32_t idx;
+
+    for (idx = 0; idx + 8 <= len; idx += 8) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(iq + 2 * idx));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(iq + 2 * idx + 8));
+
+        _mm_storeu_si128((__m128i *)(x_i + idx), _mm_packs_epi32(
+                    _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16),
+                    _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16)));
+        _mm_storeu_si128((__m128i *)(x_q + idx), _mm_packs_epi32(
+                    _mm_srai_epi32(lo, 16), _mm_srai_epi32(hi, 16)));
+    }
+
+    Split_IQ(iq + 2 * idx, len - idx, x_i + idx, x_q + idx);
+}
+
+/*****************************************************************************/
+
+/* Split_IQ_AVX2()
+ *
+ * Split_IQ_SSE2() 16 samples at a time, with the 64 bit
+ * quarters put back in order after packing within halves
+ */
+__attribute__((target("avx2")))
+static void Split_IQ_AVX2(
+        const int16_t *iq, uint32_t len, int16_t *x_i, int16_t *x_q) {
+    uint32_t idx;
+
+    for (idx = 0; idx + 16 <= len; idx += 16) {
+        __m256i lo = _mm256_loadu_si256((const __m256i *)(iq + 2 * idx));
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(iq + 2 * idx + 16));
+
+        _mm256_storeu_si256((__m256i *)(x_i + idx), _mm256_permute4x64_epi64(
+                    _mm256_packs_epi32(
+                        _mm256_srai_epi32(_mm256_slli_epi32(lo, 16), 16),
+                        _mm256_srai_epi32(_mm256_slli_epi32(hi, 16), 16)), 0xD8));
+        _mm256_storeu_si256((__m256i *)(x_q + idx), _mm256_permute4x64_epi64(
+                    _mm256_packs_epi32(
+                        _mm256_srai_epi32(lo, 16), _mm256_srai_epi32(hi, 16)), 0xD8));
+    }
+
+    Split_IQ(iq + 2 * idx, len - idx, x_i + idx, x_q + idx);
+}
+
+/*****************************************************************************/
+
+/* Narrow_IQ_SSE2()
+ *
+ * Narrow_IQ() 8 outputs at a time, clamped by saturating packs
+ */
+__attribute__((target("sse2")))
+static void Narrow_IQ_SSE2(
+        const int32_t *acc_i,
+        const int32_t *acc_q,
+        uint32_t len,
+        int16_t *x_i,
+        int16_t *x_q) {
+    const __m128i half = _mm_set1_epi32(1 << (DECIM_COEFF_SHIFT - 1));
+    uint32_t idx;
+
+    for (idx = 0; idx + 8 <= len; idx += 8) {
+        __m128i i0 = _mm_loadu_si128((const __m128i *)(acc_i + idx));
+        __m128i i1 = _mm_loadu_si128((const __m128i *)(acc_i + idx + 4));
+        __m128i q0 = _mm_loadu_si128((const __m128i *)(acc_q + idx));
+        __m128i q1 = _mm_loadu_si128((const __m128i *)(acc_q + idx + 4));
+
+        _mm_storeu_si128((__m128i *)(x_i + idx), _mm_packs_epi32(
+                    _mm_srai_epi32(_mm_add_epi32(i0, half), DECIM_COEFF_SHIFT),
+                    _mm_srai_epi32(_mm_add_epi32(i1, half), DECIM_COEFF_SHIFT)));
+        _mm_storeu_si128((__m128i *)(x_q + idx), _mm_packs_epi32(
+                    _mm_srai_epi32(_mm_add_epi32(q0, half), DECIM_COEFF_SHIFT),
+                    _mm_srai_epi32(_mm_add_epi32(q1, half), DECIM_COEFF_SHIFT)));
+    }
+
+    Narrow_IQ(acc_i + idx, acc_q + idx, len - idx, x_i + idx, x_q + idx);
+}
+
+/*****************************************************************************/
+
+/* Narrow_IQ_AVX2()
+ *
+ * Narrow_IQ_SSE2() 16 outputs at a time
+ */
+__attribute__((target("avx2")))
+static void Narrow_IQ_AVX2(
+        const int32_t *acc_i,
+        const int32_t *acc_q,
+        uint32_t len,
+        int16_t *x_i,
+        int16_t *x_q) {
+    const __m256i half = _mm256_set1_epi32(1 << (DECIM_COEFF_SHIFT - 1));
+    uint32_t idx;
+
+    for (idx = 0; idx + 16 <= len; idx += 16) {
+        __m256i i0 = _mm256_loadu_si256((const __m256i *)(acc_i + idx));
+        __m256i i1 = _mm256_loadu_si256((const __m256i *)(acc_i + idx + 8));
+        __m256i q0 = _mm256_loadu_si256((const __m256i *)(acc_q + idx));
+        __m256i q1 = _mm256_loadu_si256((const __m256i *)(acc_q + idx + 8));
+
+        _mm256_storeu_si256((__m256i *)(x_i + idx), _mm256_permute4x64_epi64(
+                    _mm256_packs_epi32(
+                        _mm256_srai_epi32(_mm256_add_epi32(i0, half), DECIM_COEFF_SHIFT),
+                        _mm256_srai_epi32(_mm256_add_epi32(i1, half), DECIM_COEFF_SHIFT)),
+                    0xD8));
+        _mm256_storeu_si256((__m256i *)(x_q + idx), _mm256_permute4x64_epi64(
+                    _mm256_packs_epi32(
+                        _mm256_srai_epi32(_mm256_add_epi32(q0, half), DECIM_COEFF_SHIFT),
+                        _mm256_srai_epi32(_mm256_add_epi32(q1, half), DECIM_COEFF_SHIFT)),
+                    0xD8));
+    }
+
+    Narrow_IQ(acc_i + idx, acc_q + idx, len - idx, x_i + idx, x_q + idx);
+}
+#endif
+
+/*****************************************************************************/
+
+/* Stage_Run()
+ *
+ * Filters len I/Q samples, put after the history of input of a
+ * stage, computing only the outputs kept after decimation.
+ * Returns their number
+ */
+static uint32_t Stage_Run(
+        decim_stage_t *stage,
+        uint32_t len,
+        int32_t *acc_i,
+        int32_t *acc_q) {
+    uint32_t hlen = stage->taps - 1;
+    uint32_t idx, cnt = 0;
+
+    /* An output every factor inputs, the first
+     * completing the inputs taken so far */
+    idx = stage->factor - 1 - stage->phase;
+    if (stage->pairs) {
+        /* Half-bands skip the padding but for one zero tap */
+        uint32_t skip = stage->taps - 2 * stage->pairs;
+
+        if (idx < len)
+            cnt = (len - idx + 1) / 2;
+        half_band_iq(stage->coeff + skip, stage->hist_i + idx + skip,
+                stage->hist_q + idx + skip, stage->pairs, cnt, acc_i, acc_q);
+    } else
+        for (; idx < len; idx += stage->factor) {
+            dot_iq(stage->coeff, stage->hist_i + idx, stage->hist_q + idx,
+                    stage->taps, &acc_i[cnt], &acc_q[cnt]);
+            cnt++;
+        }
+
+    stage->phase = (stage->phase + len) % stage->factor;
+
+    /* Keep the tail of input as history */
+    memmove(stage->hist_i, stage->hist_i + len, hlen * sizeof(int16_t));
+    memmove(stage->hist_q, stage->hist_q + len, hlen * sizeof(int16_t));
+
+    return cnt;
+}
+
+/*****************************************************************************/
+
+/* Decimator_Run()
+ *
+ * Decimates len interleaved 16 bit I/Q samples (len up to max_in)
+ * to DSP samples in out_i and out_q. Returns the number of output
+ * samples, which is len / factor plus one at most
+ */
+uint32_t Decimator_Run(
+        decimator_t *dec,
+        const int16_t *iq,
+        uint32_t len,
+        dsp_t *out_i,
+        dsp_t *out_q) {
+    decim_stage_t *stage = &dec->stage[0];
+    uint32_t idx, stg, cnt = len;
+
+    /* Separate I and Q after the history of the first stage */
+    split_iq(iq, len, stage->hist_i + stage->taps - 1,
+            stage->hist_q + stage->taps - 1);
+
+    for (stg = 0; stg < dec->nstages; stg++, stage++) {
+        cnt = Stage_Run(stage, cnt, dec->acc_i, dec->acc_q);
+
+        /* Intermediate (half-band) outputs back to 16
+         * bits, after the history of the next stage */
+        if (stg < dec->nstages - 1)
+            narrow_iq(dec->acc_i, dec->acc_q, cnt,
+                    stage[1].hist_i + stage[1].taps - 1,
+                    stage[1].hist_q + stage[1].taps - 1);
+    }
+
+    for (idx = 0; idx < cnt; idx++) {
+        out_i[idx] = (dsp_t)((double)dec->acc_i[idx] / dec->out_div);
+        out_q[idx] = (dsp_t)((double)dec->acc_q[idx] / dec->out_div);
+    }
+
+    return cnt;
+}
+
+/*****************************************************************************/
+
+/* Decimator_Free()
+ *
+ * Frees decimator buffers
+ */
+void Decimator_Free(decimator_t *dec) {
+    for (uint32_t idx = 0; idx < DECIM_STAGES_MAX; idx++) {
+        free_ptr((void **)&dec->stage[idx].coeff);
+        free_ptr((void **)&dec->stage[idx].hist_i);
+        free_ptr((void **)&dec->stage[idx].hist_q);
+    }
+
+    free_ptr((void **)&dec->acc_i);
+    free_ptr((void **)&dec->acc_q);
+    dec->nstages = 0;
+}
@@ -0,0 +1,87 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+#ifndef SDR_DECIMATOR_H
+#define SDR_DECIMATOR_H
+
+/*****************************************************************************/
+
+#include "../common/common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+
+/* Decimation filters */
+enum {
+    DECIM_BOXCAR = 0,   /* Sum of consecutive samples (moving average) */
+    DECIM_FIR,          /* Windowed sinc low pass FIR, single stage    */
+    DECIM_HALFBAND      /* Cascade of half-band FIRs decimating by 2   */
+};
+
+/* Max number of stages, enough for half-bands decimating by 32 */
+#define DECIM_STAGES_MAX    6
+
+/*****************************************************************************/
+
+/* A decimating FIR stage on 16 bit integer I/Q samples */
+typedef struct decim_stage_t {
+    uint32_t factor;        /* Decimation factor                         */
+    uint32_t taps;          /* Taps, padded to the SIMD vector length    */
+    int16_t *coeff;         /* Taps, reversed to run over input history  */
+    int32_t  coeff_sum;     /* Sum of taps, the DC gain of the stage     */
+    uint32_t pairs;         /* Pairs of taps of a half-band stage, or 0  */
+
+    /* Input history of taps - 1 samples followed by current
+     * input, and inputs taken since the last output sample */
+    int16_t *hist_i, *hist_q;
+    uint32_t phase;
+} decim_stage_t;
+
+/* Decimator of 16 bit integer I/Q samples to DSP samples */
+typedef struct decimator_t {
+    uint8_t  type;
+    uint32_t factor, max_in, nstages;
+    decim_stage_t stage[DECIM_STAGES_MAX];
+
+    /* Accumulated outputs of a stage, rounded
+     * into the input of the next one if any */
+    int32_t *acc_i, *acc_q;
+
+    /* Divisor to scale outputs of the last stage */
+    double out_div;
+} decimator_t;
+
+/*****************************************************************************/
+
+bool Decimator_Type(const char *name, uint8_t *type);
+bool Decimator_Init(
+        decimator_t *dec,
+        uint32_t factor,
+        uint8_t type,
+        uint32_t max_in);
+uint32_t Decimator_Run(
+        decimator_t *dec,
+        const int16_t *iq,
+        uint32_t len,
+        dsp_t *out_i,
+        dsp_t *out_q);
+void Decimator_Free(decimator_t *dec);
+
+/*****************************************************************************/
+
+#endif
@@ -27,6 +27,11 @@
 
 /*****************************************************************************/
 
+/* I and Q values of a sample in the lanes of a SIMD vector */
+typedef double iq_vec_t __attribute__((vector_size(2 * sizeof(double))));
+
+/*****************************************************************************/
+
 /* Init_Chebyshev_Filter()
  *
  * Calculates Chebyshev recursive filter coefficients.
@@ -40,12 +45,18 @@ bool Init_Chebyshev_Filter(
         double ripple,
         uint32_t num_poles,
         uint32_t type) {
-  double *ta = NULL, *tb = NULL;
-  double a0, a1, a2, b1, b2, sa, sb, gain;
+  double a0, a1, a2, b1, b2, gain;
   int i, p;
   double rp, ip, es, vx, kx, t, w, m;
   double d, xn0, xn1, xn2, yn1, yn2, k, tmp;
-  size_t mreq;
+  double *sos;
+
+  /* Poles are computed in pairs, one section per pair */
+  if( (num_poles & 1) || (num_poles > SOS_MAX_POLES) )
+  {
+    Show_Message( "Chebyshev filter poles must be even and 16 at most", "red" );
+    return false;
+  }
 
   /* Initialize filter parameters */
   filter_data->cutoff   = (double)(filter_bw / 2);
@@ -53,42 +64,16 @@ bool Init_Chebyshev_Filter(
   filter_data->ripple   = ripple;
   filter_data->npoles   = num_poles;
   filter_data->type     = type;
-  filter_data->ring_idx = 0;
+  filter_data->nsect    = num_poles / 2;
   filter_data->samples_buf_len = buf_len;
 
-  /* Allocate data arrays */
-  mreq = (size_t)(filter_data->npoles + 3) * sizeof(double);
-  mem_alloc( (void **)&ta, mreq );
-  mem_alloc( (void **)&tb, mreq );
-
-  /* Allocate coefficient arrays */
-  filter_data->a = NULL;
-  filter_data->b = NULL;
-  mem_alloc( (void **)&(filter_data->a), mreq );
-  mem_alloc( (void **)&(filter_data->b), mreq );
-
-  /* Allocate saved input and output arrays */
-  filter_data->x = NULL;
-  filter_data->y = NULL;
-  mreq = (size_t)(filter_data->npoles + 1) * sizeof(double);
-  mem_alloc( (void **)&(filter_data->x), mreq );
-  mem_alloc( (void **)&(filter_data->y), mreq );
-
-  /* Clear x and y arrays */
-  for( i = 0; i <= (int)filter_data->npoles; i++ )
-  {
-    filter_data->x[i] = 0.0;
-    filter_data->y[i] = 0.0;
-  }
-
-  /* Initialize coefficient arrays */
-  for( i = 0; i <= (int)filter_data->npoles + 2; i++ )
-  {
-    filter_data->a[i] = 0.0;
-    filter_data->b[i] = 0.0;
-  }
-  filter_data->a[2] = 1.0;
-  filter_data->b[2] = 1.0;
+  /* Allocate second order sections and their (cleared) states */
+  filter_data->sos   = NULL;
+  filter_data->state = NULL;
+  mem_alloc( (void **)&(filter_data->sos),
+      (size_t)filter_data->nsect * SOS_COEFFS * sizeof(double) );
+  mem_alloc( (void **)&(filter_data->state),
+      (size_t)filter_data->nsect * 2 * sizeof(double) );
 
   /* S-domain to Z-domain conversion */
   t = 2.0 * tan( 0.5 );
@@ -103,6 +88,9 @@ bool Init_Chebyshev_Filter(
     k = sin( (1.0 - w) / 2.0 ) / sin( (1.0 + w) / 2.0 );
   else k = 1.0; // For compiler warnings */
 
+  /* Gain of the cascade at DC (low pass) or Nyquist (high pass) */
+  gain = 1.0;
+
   /* Find coefficients for 2-pole filter for each pole pair */
   for( p = 1; p <= (int)filter_data->npoles / 2; p++ )
   {
@@ -148,106 +136,84 @@ bool Init_Chebyshev_Filter(
       b1 = -b1;
     }
 
-    /* Add coefficients to the cascade */
-    for( i = 0; i <= (int)filter_data->npoles + 2; i++ )
-    {
-      ta[i] = filter_data->a[i];
-      tb[i] = filter_data->b[i];
-    }
+    /* Save coefficients as a second order section */
+    sos = filter_data->sos + (p - 1) * SOS_COEFFS;
+    sos[0] = a0;
+    sos[1] = a1;
+    sos[2] = a2;
+    sos[3] = b1;
+    sos[4] = b2;
 
-    for( i = 2; i <= (int)filter_data->npoles + 2; i++ )
-    {
-      filter_data->a[i] = a0 * ta[i] + a1 * ta[i-1] + a2 * ta[i-2];
-      filter_data->b[i] =      tb[i] - b1 * tb[i-1] - b2 * tb[i-2];
-    }
+    /* Gain of the section, at z = 1 or z = -1 */
+    if( filter_data->type == FILTER_HIGHPASS )
+      gain *= ( a0 - a1 + a2 ) / ( 1.0 + b1 - b2 );
+    else
+      gain *= ( a0 + a1 + a2 ) / ( 1.0 - b1 - b2 );
 
   } /* for( p = 1; p <= np / 2; p++ ) */
-  free_ptr( (void **)&ta);
-  free_ptr( (void **)&tb);
 
-  /* Finish combining coefficients */
-  filter_data->b[2] = 0.0;
-  for( i = 0; i <= (int)filter_data->npoles; i++ )
-  {
-    filter_data->a[i] =  filter_data->a[i+2];
-    filter_data->b[i] = -filter_data->b[i+2];
-  }
+  /* Normalize the gain of the cascade in its first section */
+  for( i = 0; i < 3; i++ )
+    filter_data->sos[i] /= gain;
 
-  /* Normalize the gain */
-  sa = 0.0;
-  sb = 0.0;
-  for( i = 0; i <= (int)filter_data->npoles; i++ )
-  {
-    if( filter_data->type == FILTER_LOWPASS )
-    {
-      sa += filter_data->a[i];
-      sb += filter_data->b[i];
-    }
-    else if( filter_data->type == FILTER_HIGHPASS )
-    {
-      sa += filter_data->a[i] * (double)( (-1) ^ i );
-      sb += filter_data->b[i] * (double)( (-1) ^ i );
-    }
-  } /* for( i = 0; i < 20; i++ ) */
-
-  gain = sa / ( 1.0 - sb );
-  for( i = 0; i <= (int)filter_data->npoles; i++ )
-  {
-    filter_data->a[i] /= gain;
-  }
-
-  /* TODO no alternative way */
   return true;
 }
 
 /*****************************************************************************/
 
-/* DSP_Filter()
+/* DSP_Filter_IQ()
  *
- * DSP Recursive Filter, normally used as low pass
+ * DSP Recursive Filter, normally used as low pass. Filters
+ * the I and Q buffers in one pass, through the cascade of
+ * second order sections, with I and Q in the lanes of SIMD
+ * vectors. Both filters must have the same coefficients
  */
-void DSP_Filter(filter_data_t *filter_data) {
-  /* Index to samples buffer */
-  uint32_t buf_idx, idx, npp1, len;
-  double y, yn0;
-
-  /* Filter samples in the buffer */
-  npp1 = filter_data->npoles + 1;
-  len  = filter_data->samples_buf_len;
+void DSP_Filter_IQ(filter_data_t *filter_i, filter_data_t *filter_q) {
+  const double *sos = filter_i->sos;
+  dsp_t *buf_i = filter_i->samples_buf;
+  dsp_t *buf_q = filter_q->samples_buf;
+  uint32_t buf_idx, sect, nsect, len;
+  iq_vec_t s1[SOS_MAX_POLES / 2], s2[SOS_MAX_POLES / 2];
+  iq_vec_t x, y;
+
+  /* Load section states of I and Q into vector lanes */
+  nsect = filter_i->nsect;
+  for( sect = 0; sect < nsect; sect++ )
+  {
+    s1[sect] = (iq_vec_t){ filter_i->state[2 * sect], filter_q->state[2 * sect] };
+    s2[sect] = (iq_vec_t){
+      filter_i->state[2 * sect + 1], filter_q->state[2 * sect + 1] };
+  }
+
+  /* Filter samples in the buffers, through each section
+   * in turn, in transposed direct form II */
+  len = filter_i->samples_buf_len;
   for( buf_idx = 0; buf_idx < len; buf_idx++ )
   {
-    /* Calculate and save filtered samples */
-    yn0 = filter_data->samples_buf[buf_idx] * filter_data->a[0];
-    for( idx = 1; idx < npp1; idx++ )
+    x = (iq_vec_t){ buf_i[buf_idx], buf_q[buf_idx] };
+    for( sect = 0; sect < nsect; sect++ )
     {
-      /* Summate contribution of past input samples */
-      y    = filter_data->a[idx];
-      y   *= filter_data->x[filter_data->ring_idx];
-      yn0 += y;
-
-      /* Summate contribution of past output samples */
-      y   = filter_data->b[idx];
-      y  *= filter_data->y[filter_data->ring_idx];
-      yn0 += y;
-
-      /* Advance ring buffers index */
-      filter_data->ring_idx++;
-      if( filter_data->ring_idx >= npp1 )
-        filter_data->ring_idx = 0;
-
-    } /* for( idx = 0; idx < npp1; idx++ ) */
-
-    /* Save new yn0 output to y ring buffer */
-    filter_data->y[filter_data->ring_idx] = yn0;
+      const double *c = sos + sect * SOS_COEFFS;
 
-    /* Save current input sample to x ring buffer */
-    filter_data->x[filter_data->ring_idx] =
-      filter_data->samples_buf[buf_idx];
+      y = c[0] * x + s1[sect];
+      s1[sect] = c[1] * x + c[3] * y + s2[sect];
+      s2[sect] = c[2] * x + c[4] * y;
+      x = y;
+    }
 
     /* Return filtered samples */
-    filter_data->samples_buf[buf_idx] = yn0;
+    buf_i[buf_idx] = (dsp_t)x[0];
+    buf_q[buf_idx] = (dsp_t)x[1];
+  }
 
-  } /* for( buf_idx = 0; buf_idx < len; buf_idx++ ) */
+  /* Save section states */
+  for( sect = 0; sect < nsect; sect++ )
+  {
+    filter_i->state[2 * sect]     = s1[sect][0];
+    filter_q->state[2 * sect]     = s1[sect][1];
+    filter_i->state[2 * sect + 1] = s2[sect][0];
+    filter_q->state[2 * sect + 1] = s2[sect][1];
+  }
 }
 
 /*****************************************************************************/
@@ -257,8 +223,6 @@ void DSP_Filter(filter_data_t *filter_data) {
  * Deinitializes Chebyshev filter (free's allocations)
  */
 void Deinit_Chebyshev_Filter(filter_data_t *data) {
-  free_ptr( (void **)&(data->a) );
-  free_ptr( (void **)&(data->b) );
-  free_ptr( (void **)&(data->x) );
-  free_ptr( (void **)&(data->y) );
+  free_ptr( (void **)&(data->sos) );
+  free_ptr( (void **)&(data->state) );
 }
@@ -19,11 +19,20 @@
 
 /*****************************************************************************/
 
+#include "../common/common.h"
+
 #include <stdbool.h>
 #include <stdint.h>
 
 /*****************************************************************************/
 
+/* Coefficients per second order section
+ * and max poles of Chebyshev filters */
+#define SOS_COEFFS      5
+#define SOS_MAX_POLES   16
+
+/*****************************************************************************/
+
 /* DSP filter data */
 typedef struct filter_data_t {
     /* Cutoff frequency as a fraction of sample rate */
@@ -38,17 +47,13 @@ typedef struct filter_data_t {
     /* Filter type as below */
     uint32_t type;
 
-    /* a and b coefficients of the filter */
-    double *a, *b;
-
-    /* Saved input and output values */
-    double *x, *y;
-
-    /* Ring buffer index */
-    uint32_t ring_idx;
+    /* The filter as a cascade of second order sections, one per
+     * pole pair: a0, a1, a2, b1, b2 of each, and their states */
+    uint32_t nsect;
+    double *sos, *state;
 
     /* Input samples buffer and its length */
-    double *samples_buf;
+    dsp_t *samples_buf;
     uint32_t samples_buf_len;
 } filter_data_t;
 
@@ -62,7 +67,7 @@ bool Init_Chebyshev_Filter(
         double ripple,
         uint32_t num_poles,
         uint32_t type);
-void DSP_Filter(filter_data_t *filter_data);
+void DSP_Filter_IQ(filter_data_t *filter_i, filter_data_t *filter_q);
 void Deinit_Chebyshev_Filter(filter_data_t *data);
 
 /*****************************************************************************/
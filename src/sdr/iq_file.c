@@ -0,0 +1,427 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+#include "iq_file.h"
+
+#include "../common/common.h"
+#include "../common/shared.h"
+#include "../glrpt/callback_func.h"
+#include "../glrpt/utils.h"
+#include "decimator.h"
+#include "SoapySDR.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+/*****************************************************************************/
+
+/* Decimated samples per block handed to the demodulator */
+#define IQ_BLOCK_LEN    16384
+
+/* WAV format tags */
+#define WAV_FORMAT_PCM          0x0001
+#define WAV_FORMAT_FLOAT        0x0003
+#define WAV_FORMAT_EXTENSIBLE   0xFFFE
+
+/*****************************************************************************/
+
+static inline uint16_t Get_LE16(const uint8_t *p);
+static inline uint32_t Get_LE32(const uint8_t *p);
+static bool Parse_Wav_Header(
+        uint8_t *format,
+        uint32_t *samplerate,
+        uint64_t *data_len);
+static inline void Get_Sample(size_t idx, int16_t *iq);
+
+/*****************************************************************************/
+
+static FILE    *iq_fp = NULL;
+static uint8_t *raw_buf = NULL;
+static int16_t *iq_buf = NULL;
+static dsp_t   *data_buf_i = NULL, *data_buf_q = NULL;
+static decimator_t iq_decimator;
+static uint8_t  iq_format;
+static size_t   iq_sample_size;
+static uint32_t iq_samplerate, iq_decimate;
+static bool     iq_eof;
+
+/* Bytes of samples left in the file, those of
+ * the data chunk of WAV files, else unlimited */
+static uint64_t iq_data_left;
+
+/* Input samples read since start, for real time
+ * pacing and the throughput report on closing */
+static uint64_t iq_samples;
+static struct timespec iq_start;
+
+/*****************************************************************************/
+
+static inline uint16_t Get_LE16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/*****************************************************************************/
+
+static inline uint32_t Get_LE32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+        ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/*****************************************************************************/
+
+/* Parse_Wav_Header()
+ *
+ * Reads the RIFF/WAVE header of a stereo I/Q recording, finds its
+ * sample format and rate and the length of its data chunk, and
+ * leaves the file at the start of data
+ */
+static bool Parse_Wav_Header(
+        uint8_t *format,
+        uint32_t *samplerate,
+        uint64_t *data_len) {
+    uint8_t hdr[40];
+    uint16_t tag = 0, channels = 0, bits = 0;
+    uint32_t size;
+
+    if ((fread(hdr, 1, 12, iq_fp) != 12) ||
+            (memcmp(hdr, "RIFF", 4) != 0) ||
+            (memcmp(hdr + 8, "WAVE", 4) != 0)) {
+        Show_Message("I/Q file is not a WAV file", "red");
+        return false;
+    }
+
+    /* Walk the chunks till "data", reading "fmt " on the way */
+    while (fread(hdr, 1, 8, iq_fp) == 8) {
+        size = Get_LE32(hdr + 4);
+
+        if (memcmp(hdr, "data", 4) == 0) {
+            /* Streaming writers leave the length unset till closing */
+            *data_len = (size == 0xFFFFFFFF) ? UINT64_MAX : size;
+            break;
+        }
+
+        if ((memcmp(hdr, "fmt ", 4) == 0) && (size >= 16)) {
+            size_t len = (size < sizeof(hdr)) ? size : sizeof(hdr);
+
+            if (fread(hdr, 1, len, iq_fp) != len)
+                break;
+
+            tag         = Get_LE16(hdr);
+            channels    = Get_LE16(hdr + 2);
+            *samplerate = Get_LE32(hdr + 4);
+            bits        = Get_LE16(hdr + 14);
+
+            /* Extensible format keeps the real tag in sub-format GUID */
+            if ((tag == WAV_FORMAT_EXTENSIBLE) && (len >= 26))
+                tag = Get_LE16(hdr + 24);
+
+            size -= (uint32_t)len;
+        }
+
+        /* Chunks are padded to even length */
+        if (fseek(iq_fp, (long)(size + (size & 1)), SEEK_CUR) != 0)
+            break;
+    }
+
+    if (feof(iq_fp) || ferror(iq_fp) || (channels == 0)) {
+        Show_Message("Can't find WAV format or data chunk", "red");
+        return false;
+    }
+
+    if (channels != 2) {
+        Show_Message("WAV file must have 2 (I/Q) channels", "red");
+        return false;
+    }
+
+    if ((tag == WAV_FORMAT_PCM) && (bits == 16))
+        *format = IQ_FORMAT_CS16;
+    else if ((tag == WAV_FORMAT_PCM) && (bits == 8))
+        *format = IQ_FORMAT_CU8;
+    else if ((tag == WAV_FORMAT_FLOAT) && (bits == 32))
+        *format = IQ_FORMAT_CF32;
+    else {
+        Show_Message("Unsupported WAV sample format", "red");
+        return false;
+    }
+
+    return true;
+}
+
+/*****************************************************************************/
+
+/* Get_Sample()
+ *
+ * Returns the I/Q values of a raw sample as CS16, as read from SDR
+ */
+static inline void Get_Sample(size_t idx, int16_t *iq) {
+    switch (iq_format) {
+        case IQ_FORMAT_CS16:
+            memcpy(iq, raw_buf + idx * 2 * sizeof(int16_t), 2 * sizeof(int16_t));
+            break;
+
+        case IQ_FORMAT_CS8:
+            iq[0] = (int16_t)((int8_t)raw_buf[2 * idx] * 256);
+            iq[1] = (int16_t)((int8_t)raw_buf[2 * idx + 1] * 256);
+            break;
+
+        case IQ_FORMAT_CU8:
+            iq[0] = (int16_t)((raw_buf[2 * idx] - 128) * 256);
+            iq[1] = (int16_t)((raw_buf[2 * idx + 1] - 128) * 256);
+            break;
+
+        case IQ_FORMAT_CF32: {
+            float s[2];
+
+            memcpy(s, raw_buf + idx * sizeof(s), sizeof(s));
+            for (int n = 0; n < 2; n++)
+                iq[n] = (int16_t)lrintf(
+                        fmaxf(fminf(s[n] * 32768.0f, 32767.0f), -32768.0f));
+            break;
+        }
+    }
+}
+
+/*****************************************************************************/
+
+/* IQ_File_Format()
+ *
+ * Maps a format name (or file name extension) to an IQ_FORMAT_* value
+ */
+uint8_t IQ_File_Format(const char *name) {
+    if ((strcasecmp(name, "cs16") == 0) || (strcasecmp(name, "s16") == 0))
+        return IQ_FORMAT_CS16;
+    else if ((strcasecmp(name, "cs8") == 0) || (strcasecmp(name, "s8") == 0))
+        return IQ_FORMAT_CS8;
+    else if ((strcasecmp(name, "cu8") == 0) || (strcasecmp(name, "u8") == 0))
+        return IQ_FORMAT_CU8;
+    else if ((strcasecmp(name, "cf32") == 0) ||
+            (strcasecmp(name, "fc32") == 0) ||
+            (strcasecmp(name, "cfile") == 0))
+        return IQ_FORMAT_CF32;
+    else if (strcasecmp(name, "wav") == 0)
+        return IQ_FORMAT_WAV;
+    else
+        return IQ_FORMAT_AUTO;
+}
+
+/*****************************************************************************/
+
+/* IQ_File_Input()
+ *
+ * Returns true if samples come from an I/Q file instead of SDR device
+ */
+bool IQ_File_Input(void) {
+    return rc_data.iq_file[0] != '\0';
+}
+
+/*****************************************************************************/
+
+/* IQ_File_Init()
+ *
+ * Opens the I/Q recording and sets up the same sample path
+ * as for SDR device: decimation, I/Q filters and buffers
+ */
+bool IQ_File_Init(void) {
+    char mesg[MESG_SIZE];
+
+    iq_format     = rc_data.iq_format;
+    iq_samplerate = rc_data.iq_samplerate;
+    iq_samples    = 0;
+    iq_data_left  = UINT64_MAX;
+
+    /* Guess format from file extension */
+    if (iq_format == IQ_FORMAT_AUTO) {
+        const char *ext = strrchr(rc_data.iq_file, '.');
+
+        if (ext)
+            iq_format = IQ_File_Format(ext + 1);
+
+        if (iq_format == IQ_FORMAT_AUTO) {
+            Show_Message("Can't detect I/Q file format", "red");
+            Error_Dialog();
+            return false;
+        }
+    }
+
+    if (!Open_File(&iq_fp, rc_data.iq_file, "rb"))
+        return false;
+
+    if ((iq_format == IQ_FORMAT_WAV) &&
+            !Parse_Wav_Header(&iq_format, &iq_samplerate, &iq_data_left)) {
+        Error_Dialog();
+        IQ_File_Close();
+        return false;
+    }
+
+    if (iq_samplerate == 0) {
+        Show_Message("Sample rate of I/Q file not specified", "red");
+        Error_Dialog();
+        IQ_File_Close();
+        return false;
+    }
+
+    switch (iq_format) {
+        case IQ_FORMAT_CS16:
+            iq_sample_size = 2 * sizeof(int16_t);
+            break;
+
+        case IQ_FORMAT_CS8:
+        case IQ_FORMAT_CU8:
+            iq_sample_size = 2 * sizeof(uint8_t);
+            break;
+
+        case IQ_FORMAT_CF32:
+            iq_sample_size = 2 * sizeof(float);
+            break;
+    }
+
+    snprintf(mesg, sizeof(mesg),
+            "Reading I/Q file at %uS/s%s", iq_samplerate,
+            rc_data.iq_max_speed ? ", max speed" : "");
+    Show_Message(mesg, "green");
+
+    /* Decimate and scale as SoapySDR_Stream() does for CS16 */
+    iq_decimate = SoapySDR_Set_Decimation(iq_samplerate);
+    if (!Decimator_Init(&iq_decimator, iq_decimate, rc_data.decim_filter,
+                IQ_BLOCK_LEN * iq_decimate)) {
+        Error_Dialog();
+        IQ_File_Close();
+        return false;
+    }
+
+    mem_alloc((void **)&raw_buf,
+            (size_t)IQ_BLOCK_LEN * iq_decimate * iq_sample_size);
+    mem_alloc((void **)&iq_buf,
+            (size_t)IQ_BLOCK_LEN * iq_decimate * 2 * sizeof(int16_t));
+    mem_alloc((void **)&data_buf_i, IQ_BLOCK_LEN * sizeof(dsp_t));
+    mem_alloc((void **)&data_buf_q, IQ_BLOCK_LEN * sizeof(dsp_t));
+
+    if (!SoapySDR_Init_Filters(IQ_BLOCK_LEN)) {
+        IQ_File_Close();
+        return false;
+    }
+
+    filter_data_i.samples_buf = data_buf_i;
+    filter_data_q.samples_buf = data_buf_q;
+
+    iq_eof = false;
+    clock_gettime(CLOCK_MONOTONIC, &iq_start);
+
+    return true;
+}
+
+/*****************************************************************************/
+
+/* IQ_File_Read()
+ *
+ * Reads and decimates the next block of samples into the I/Q filter
+ * buffers. Unless in max speed mode, waits so that samples are
+ * delivered at the recording's real time rate. Returns false when
+ * the file (or WAV data chunk) is exhausted, with the rest of the
+ * block zeroed
+ */
+bool IQ_File_Read(void) {
+    size_t want = (size_t)IQ_BLOCK_LEN * iq_decimate;
+    size_t got  = 0, len = want;
+
+    if (!iq_eof) {
+        /* Chunks after WAV data aren't samples */
+        if (iq_data_left / iq_sample_size < len)
+            len = (size_t)(iq_data_left / iq_sample_size);
+
+        got = fread(raw_buf, iq_sample_size, len, iq_fp);
+        if (iq_data_left != UINT64_MAX)
+            iq_data_left -= got * iq_sample_size;
+
+        if (got < want)
+            iq_eof = true;
+    }
+
+    /* Convert to CS16, zero padded at end of file, and
+     * decimate into exactly one block of samples buffer */
+    for (size_t idx = 0; idx < got; idx++)
+        Get_Sample(idx, iq_buf + 2 * idx);
+    memset(iq_buf + 2 * got, 0, (want - got) * 2 * sizeof(int16_t));
+
+    Decimator_Run(&iq_decimator, iq_buf, (uint32_t)want, data_buf_i, data_buf_q);
+
+    iq_samples += got;
+
+    /* Wait till the block is due in real time */
+    if (!rc_data.iq_max_speed) {
+        struct timespec due = iq_start;
+
+        due.tv_sec  += (time_t)(iq_samples / iq_samplerate);
+        due.tv_nsec += (long)((iq_samples % iq_samplerate) *
+                1000000000ULL / iq_samplerate);
+
+        if (due.tv_nsec >= 1000000000L) {
+            due.tv_sec++;
+            due.tv_nsec -= 1000000000L;
+        }
+
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+    }
+
+    return got == want;
+}
+
+/*****************************************************************************/
+
+/* IQ_File_Close()
+ *
+ * Closes the I/Q file and frees its buffers. Reports the throughput
+ * of the sample path, SDR filters to soft symbols, which is how fast
+ * the DSP can run when replaying in max speed mode
+ */
+void IQ_File_Close(void) {
+    char mesg[MESG_SIZE];
+    struct timespec end;
+    double secs;
+
+    if (iq_fp) {
+        fclose(iq_fp);
+        iq_fp = NULL;
+    }
+
+    if (iq_samples && iq_samplerate) {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        secs = (double)(end.tv_sec - iq_start.tv_sec) +
+            (double)(end.tv_nsec - iq_start.tv_nsec) / 1.0e9;
+        if (secs <= 0.0)
+            secs = 1.0e-9;
+
+        snprintf(mesg, sizeof(mesg),
+                "%s DSP: %.1f MS/s, %.1fx real time",
+                (sizeof(dsp_t) == sizeof(float)) ? "Float" : "Double",
+                (double)iq_samples / secs / 1.0e6,
+                (double)iq_samples / iq_samplerate / secs);
+        Show_Message(mesg, "black");
+        iq_samples = 0;
+    }
+
+    free_ptr((void **)&raw_buf);
+    free_ptr((void **)&iq_buf);
+    free_ptr((void **)&data_buf_i);
+    free_ptr((void **)&data_buf_q);
+    Decimator_Free(&iq_decimator);
+}
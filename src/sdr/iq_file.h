@@ -0,0 +1,47 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+#ifndef SDR_IQ_FILE_H
+#define SDR_IQ_FILE_H
+
+/*****************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+
+/* I/Q recording sample formats */
+enum {
+    IQ_FORMAT_AUTO = 0, /* Guess from file name extension    */
+    IQ_FORMAT_CS16,     /* Interleaved signed 16 bit I/Q     */
+    IQ_FORMAT_CS8,      /* Interleaved signed 8 bit I/Q      */
+    IQ_FORMAT_CU8,      /* Interleaved unsigned 8 bit I/Q    */
+    IQ_FORMAT_CF32,     /* Interleaved 32 bit float I/Q      */
+    IQ_FORMAT_WAV       /* Stereo WAV, I left and Q right    */
+};
+
+/*****************************************************************************/
+
+uint8_t IQ_File_Format(const char *name);
+bool IQ_File_Input(void);
+bool IQ_File_Init(void);
+bool IQ_File_Read(void);
+void IQ_File_Close(void);
+
+/*****************************************************************************/
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+#include "sample_ring.h"
+
+#include "../glrpt/utils.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+
+/* Sample_Ring_Init()
+ *
+ * Allocates a ring of depth blocks of block_len I/Q samples
+ */
+void Sample_Ring_Init(sample_ring_t *ring, uint32_t depth, uint32_t block_len) {
+    size_t mreq = (size_t)depth * block_len * sizeof(dsp_t);
+
+    ring->buf_i = NULL;
+    ring->buf_q = NULL;
+    mem_alloc((void **)&ring->buf_i, mreq);
+    mem_alloc((void **)&ring->buf_q, mreq);
+
+    ring->depth     = depth;
+    ring->block_len = block_len;
+
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->overruns, 0);
+    atomic_init(&ring->high_water, 0);
+}
+
+/*****************************************************************************/
+
+/* Sample_Ring_Free()
+ *
+ * Frees the ring's sample buffers
+ */
+void Sample_Ring_Free(sample_ring_t *ring) {
+    free_ptr((void **)&ring->buf_i);
+    free_ptr((void **)&ring->buf_q);
+}
+
+/*****************************************************************************/
+
+/* Sample_Ring_Write_Block()
+ *
+ * Returns the block the producer is to fill next
+ */
+void Sample_Ring_Write_Block(sample_ring_t *ring, dsp_t **buf_i, dsp_t **buf_q) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t offs = (size_t)(head % ring->depth) * ring->block_len;
+
+    *buf_i = ring->buf_i + offs;
+    *buf_q = ring->buf_q + offs;
+}
+
+/*****************************************************************************/
+
+/* Sample_Ring_Commit()
+ *
+ * Hands the block just filled over to the consumer. If the
+ * ring is full the block is dropped and counted as an overrun,
+ * the producer then refills the same block. Returns true if
+ * the block was queued
+ */
+bool Sample_Ring_Commit(sample_ring_t *ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t used = head + 1 - tail;
+
+    if (used >= ring->depth) {
+        atomic_fetch_add_explicit(&ring->overruns, 1, memory_order_relaxed);
+        return false;
+    }
+
+    if (used > atomic_load_explicit(&ring->high_water, memory_order_relaxed))
+        atomic_store_explicit(&ring->high_water, used, memory_order_relaxed);
+
+    /* Publish the block's samples along with the new head */
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    return true;
+}
+
+/*****************************************************************************/
+
+/* Sample_Ring_Read_Block()
+ *
+ * Returns the oldest filled block to the consumer, which
+ * owns it until Sample_Ring_Release(). Returns false if
+ * the ring is empty
+ */
+bool Sample_Ring_Read_Block(sample_ring_t *ring, dsp_t **buf_i, dsp_t **buf_q) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (head == tail)
+        return false;
+
+    size_t offs = (size_t)(tail % ring->depth) * ring->block_len;
+    *buf_i = ring->buf_i + offs;
+    *buf_q = ring->buf_q + offs;
+
+    return true;
+}
+
+/*****************************************************************************/
+
+/* Sample_Ring_Release()
+ *
+ * Returns the block read by the consumer to the producer
+ */
+void Sample_Ring_Release(sample_ring_t *ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
@@ -0,0 +1,67 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+#ifndef SDR_SAMPLE_RING_H
+#define SDR_SAMPLE_RING_H
+
+/*****************************************************************************/
+
+#include "../common/common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+
+/* Default number of sample blocks in the ring */
+#define SAMPLE_RING_DEPTH       8
+
+/* Limits of configurable ring depth */
+#define SAMPLE_RING_DEPTH_MIN   2
+#define SAMPLE_RING_DEPTH_MAX   256
+
+/*****************************************************************************/
+
+/* Single producer, single consumer ring of I/Q sample blocks.
+ * The block at head is owned by the producer while it fills
+ * it, the block at tail by the consumer while it filters it,
+ * so at most depth - 1 filled blocks wait in the ring.
+ * head and tail run free and are only taken modulo depth
+ */
+typedef struct sample_ring_t {
+    dsp_t *buf_i, *buf_q;      /* depth blocks of block_len samples */
+    uint32_t depth, block_len;
+
+    atomic_uint head;           /* Written by producer only */
+    atomic_uint tail;           /* Written by consumer only */
+
+    atomic_uint overruns;       /* Blocks dropped as ring was full */
+    atomic_uint high_water;     /* Max number of blocks waiting    */
+} sample_ring_t;
+
+/*****************************************************************************/
+
+void Sample_Ring_Init(sample_ring_t *ring, uint32_t depth, uint32_t block_len);
+void Sample_Ring_Free(sample_ring_t *ring);
+void Sample_Ring_Write_Block(sample_ring_t *ring, dsp_t **buf_i, dsp_t **buf_q);
+bool Sample_Ring_Commit(sample_ring_t *ring);
+bool Sample_Ring_Read_Block(sample_ring_t *ring, dsp_t **buf_i, dsp_t **buf_q);
+void Sample_Ring_Release(sample_ring_t *ring);
+
+/*****************************************************************************/
+
+#endif
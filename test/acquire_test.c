@@ -0,0 +1,216 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Test of sync search and acquisition in the decoder, on synthetic
+ * soft symbol streams starting off frame boundaries, of frames whose
+ * sync patterns are sent at a lower SNR than their data. With a weak
+ * sync the best of a frame must find it from the first frame, none
+ * lost to acquisition; at a lower sync SNR, where the best of a frame
+ * is mostly a random match, acquisition must find it over frames; on
+ * noise nothing may decode. Decoded frames must be those sent, and
+ * the acquisition table allocated only while acquiring */
+
+#include "../src/common/cpu.h"
+#include "../src/decoder/correlator.h"
+#include "../src/decoder/ecc.h"
+#include "../src/decoder/met_to_data.h"
+#include "tx.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************************/
+
+/* Frames of each stream, noise symbols before the first,
+ * and all symbols, with a frame of noise after the last */
+#define TEST_FRAMES     48
+#define TEST_LEAD       5000
+#define TEST_LEN        (TEST_LEAD + (TEST_FRAMES + 1) * TX_CODE_LEN)
+
+/* Soft symbols of the sync word, at the start of a frame */
+#define TEST_SYNC_LEN   64
+
+/* Amplitude of data symbols and noise, 2.5 dB Es/N0, and
+ * of sync symbols, weak at -2.2 dB, where its correlation
+ * is mostly between MIN_CORRELATION and CORR_LIMIT */
+#define TEST_WEAK_AMP   48.0
+#define TEST_WEAK_SYNC  28.0
+#define TEST_WEAK_SIGMA 36.0
+
+/* Data at 3.0 dB Es/N0 and sync at -4.6 dB, where
+ * the best of a frame is mostly a random match */
+#define TEST_LOW_AMP    48.0
+#define TEST_LOW_SYNC   20.0
+#define TEST_LOW_SIGMA  34.0
+
+/* Frames which must be found in each */
+#define TEST_WEAK_MIN   44
+#define TEST_LOW_MIN    40
+
+/*****************************************************************************/
+
+static void Tx_Stream(double amp, double sync_amp, double sigma, int8_t *soft);
+static bool Test_Stream(const char *name, double amp, double sync_amp,
+        double sigma, int min, bool acquire);
+
+/*****************************************************************************/
+
+/* Data of the frames sent, to check those decoded against */
+static uint8_t tx_data[TEST_FRAMES][TX_DATA_LEN];
+
+/*****************************************************************************/
+
+/* Tx_Stream()
+ *
+ * Soft symbols of TEST_FRAMES frames encoded as a stream between
+ * random code bits, their sync symbols of sync_amp, of no frames
+ * but noise if amp is 0
+ */
+static void Tx_Stream(double amp, double sync_amp, double sigma, int8_t *soft) {
+    static uint8_t code[TEST_LEN];
+    uint8_t cadu[TX_CADU_LEN];
+    uint32_t sh = 0;
+
+    Tx_Seed(0x9E3779B97F4A7C15ULL);
+    for (int n = 0; n < TEST_LEN; n++)
+        code[n] = (uint8_t)(Tx_Rand() & 1);
+    for (int f = 0; f < TEST_FRAMES; f++) {
+        Tx_Frame(f, tx_data[f], cadu);
+        Tx_Encode(cadu, &sh, &code[TEST_LEAD + f * TX_CODE_LEN]);
+    }
+
+    Tx_Soft(code, TEST_LEN, amp, sigma, soft);
+    for (int f = 0; f < TEST_FRAMES; f++) {
+        int n = TEST_LEAD + f * TX_CODE_LEN;
+
+        Tx_Soft(&code[n], TEST_SYNC_LEN, sync_amp, sigma, &soft[n]);
+    }
+}
+
+/*****************************************************************************/
+
+/* Test_Stream()
+ *
+ * Decodes a stream as Frame_Queue_Decoder(). At least min frames must
+ * be found and no other decode, the first frame without acquisition,
+ * or some by acquisition if acquire. Frames are found decoded as sent,
+ * or inverted, as the polarity check of the decoded sync word may fail
+ * on a weak sync. The acquisition table must be allocated when a frame
+ * without a sure sync fails, and freed on a resync
+ */
+static bool Test_Stream(const char *name, double amp, double sync_amp,
+        double sigma, int min, bool acquire) {
+    static int8_t soft[TEST_LEN];
+    static mtd_rec_t mtd;
+    static uint8_t soft_buf[3 * SOFT_FRAME_LEN];
+    int found = 0, inverted = 0, acquired = 0, wrong = 0, first = -1;
+    int leaks = 0;
+    bool pass;
+
+    Tx_Stream(amp, sync_amp, sigma, soft);
+
+    Mtd_Init(&mtd);
+    memcpy(soft_buf + SOFT_FRAME_LEN, soft, SOFT_FRAME_LEN);
+
+    for (size_t s = SOFT_FRAME_LEN; s < sizeof(soft); s += SOFT_FRAME_LEN) {
+        memcpy(soft_buf + 2 * SOFT_FRAME_LEN, soft + s, SOFT_FRAME_LEN);
+        memmove(soft_buf, soft_buf + SOFT_FRAME_LEN, 2 * SOFT_FRAME_LEN);
+
+        while (mtd.pos < SOFT_FRAME_LEN) {
+            int num;
+            bool same = true, flip = true;
+
+            if (!Mtd_One_Frame(&mtd, soft_buf)) {
+                leaks += (mtd.corr <= CORR_LIMIT) && (mtd.c.acq == NULL);
+                continue;
+            }
+
+            num = mtd.ecced_data[0] | (mtd.ecced_data[1] << 8);
+            if (num >= TEST_FRAMES)
+                num ^= 0xFFFF;
+            if ((amp == 0.0) || (num >= TEST_FRAMES)) {
+                wrong++;
+                continue;
+            }
+
+            for (int i = 0; i < TX_DATA_LEN; i++) {
+                same &= mtd.ecced_data[i] == tx_data[num][i];
+                flip &= mtd.ecced_data[i] == (uint8_t)~tx_data[num][i];
+            }
+            if (!same && !flip) {
+                wrong++;
+                continue;
+            }
+
+            found++;
+            inverted += flip;
+            acquired += mtd.c.acq != NULL;
+            if (first < 0)
+                first = num;
+        }
+
+        mtd.pos      -= SOFT_FRAME_LEN;
+        mtd.prev_pos -= SOFT_FRAME_LEN;
+    }
+
+    /* Acquisition is forgotten, and its table freed, on a resync */
+    Mtd_Resync(&mtd);
+    leaks += mtd.c.acq != NULL;
+
+    pass = (found >= min) && (wrong == 0) && (leaks == 0) &&
+        ((min == 0) || (acquire ? (acquired > 0) : (first == 0)));
+    printf("  %s: %d of %d frames found, %d inverted, the first %d, "
+            "%d by acquisition, %d wrong, %d table errors: %s\n", name,
+            found, TEST_FRAMES, inverted, first, acquired, wrong, leaks,
+            pass ? "pass" : "FAIL");
+
+    return pass;
+}
+
+/*****************************************************************************/
+
+/* main()
+ *
+ * Tests the plain correlator and that of the highest SIMD
+ * level of the CPU, if another, on each stream
+ */
+int main(void) {
+    uint8_t levels[2] = { CPU_SIMD_NONE, CPU_SIMD_MAX };
+    bool ok = true;
+
+    Tx_Init();
+    Init_Correlator_Tables();
+
+    for (int l = 0; l < 2; l++) {
+        Cpu_Init(levels[l]);
+        if ((l > 0) && (Cpu_Simd() == CPU_SIMD_NONE))
+            break;
+        Init_Ecc_Tables();
+
+        printf("Sync search and acquisition of SIMD level %s:\n",
+                Cpu_Simd_Name(Cpu_Simd()));
+        ok &= Test_Stream("sync at -2.2 dB", TEST_WEAK_AMP, TEST_WEAK_SYNC,
+                TEST_WEAK_SIGMA, TEST_WEAK_MIN, false);
+        ok &= Test_Stream("sync at -4.6 dB", TEST_LOW_AMP, TEST_LOW_SYNC,
+                TEST_LOW_SIGMA, TEST_LOW_MIN, true);
+        ok &= Test_Stream("noise", 0.0, 0.0, TEST_LOW_SIGMA, 0, true);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,191 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Equivalence test of the AGC applied to blocks of samples, as by the
+ * demodulator, against the AGC applied a sample at a time, and against
+ * the AGC it replaced, on a signal stepping in level and off centre */
+
+#include "../src/common/common.h"
+#include "../src/common/cpu.h"
+#include "../src/demodulator/agc.h"
+#include "legacy.h"
+#include "tx.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************************/
+
+/* Samples of the signal, and the largest block applied at once */
+#define TEST_SAMPLES        (1 << 20)
+#define TEST_MAX_BLOCK      1000
+
+/* Levels of the signal, one after the other, the first low
+ * enough for the gain to reach its limit, and its offset */
+#define TEST_LEVELS         { 0.5, 100.0, 3000.0, 20.0 }
+#define TEST_BIAS           (30.0 - 20.0 * I)
+
+/*****************************************************************************/
+
+static void Make_Signal(void);
+static bool Same_State(const Agc_t *agc, const Agc_t *ref);
+static bool Test_Blocks(bool in_place, bool random_len);
+static bool Test_Legacy(void);
+
+/*****************************************************************************/
+
+/* Signal, outputs of AGC applied to blocks and to single samples */
+static cdsp_t signal[TEST_SAMPLES];
+static cdsp_t block_out[TEST_SAMPLES], sample_out[TEST_SAMPLES];
+
+/* State of the AGC applied to single samples */
+static Agc_t sample_agc;
+
+/*****************************************************************************/
+
+/* Make_Signal()
+ *
+ * QPSK symbols of 8 samples in noise, at each of the levels
+ * in turn, with an offset, as the AGC is given by Filter_Interp()
+ */
+static void Make_Signal(void) {
+    static const double level[] = TEST_LEVELS;
+    const int nlevels = sizeof(level) / sizeof(level[0]);
+    complex double symbol = 0.0;
+
+    Tx_Seed(1);
+    for (int idx = 0; idx < TEST_SAMPLES; idx++) {
+        double ampl = level[idx / (TEST_SAMPLES / nlevels)];
+
+        if (idx % 8 == 0)
+            symbol = ((Tx_Rand() & 1) ? 1.0 : -1.0) +
+                ((Tx_Rand() & 1) ? 1.0 : -1.0) * I;
+        signal[idx] = (cdsp_t)(ampl * (symbol +
+                    0.3 * (Tx_Gauss() + Tx_Gauss() * I)) + TEST_BIAS);
+    }
+}
+
+/*****************************************************************************/
+
+/* Same_State()
+ *
+ * If the averages and gain of two AGC objects are the same
+ */
+static bool Same_State(const Agc_t *agc, const Agc_t *ref) {
+    return (agc->average == ref->average) && (agc->gain == ref->gain) &&
+        (agc->bias == ref->bias);
+}
+
+/*****************************************************************************/
+
+/* Test_Blocks()
+ *
+ * Applies the AGC to the signal in blocks, in place or not, of
+ * random lengths or of the largest, which must give exactly the
+ * output and state of Agc_Apply() on a sample at a time
+ */
+static bool Test_Blocks(bool in_place, bool random_len) {
+    Agc_t *agc = Agc_Init();
+    uint32_t len;
+    bool pass;
+
+    if (in_place)
+        memcpy(block_out, signal, sizeof(signal));
+
+    Tx_Seed(2);
+    for (uint32_t idx = 0; idx < TEST_SAMPLES; idx += len) {
+        len = random_len ? 1 + Tx_Rand() % TEST_MAX_BLOCK : TEST_MAX_BLOCK;
+        if (len > TEST_SAMPLES - idx)
+            len = TEST_SAMPLES - idx;
+        Agc_Apply_Block(agc, in_place ? block_out + idx : signal + idx,
+                block_out + idx, len);
+    }
+
+    pass = (memcmp(block_out, sample_out, sizeof(block_out)) == 0) &&
+        Same_State(agc, &sample_agc);
+    printf("  blocks %s, %s lengths: %s\n",
+            in_place ? "in place" : "apart",
+            random_len ? "random" : "fixed", pass ? "pass" : "FAIL");
+
+    Agc_Free(agc);
+    return pass;
+}
+
+/*****************************************************************************/
+
+/* Test_Legacy()
+ *
+ * The AGC applied to a sample at a time must give exactly the
+ * output and state of the AGC it replaced. Of the double build
+ * only, the latter always ran in double precision
+ */
+static bool Test_Legacy(void) {
+    legacy_agc_t legacy;
+    bool pass = true;
+
+    Legacy_Agc_Init(&legacy);
+    for (int idx = 0; idx < TEST_SAMPLES; idx++)
+        if (Legacy_Agc_Apply(&legacy, signal[idx]) != sample_out[idx])
+            pass = false;
+
+    pass &= (legacy.average == sample_agc.average) &&
+        (legacy.gain == sample_agc.gain) && (legacy.bias == sample_agc.bias);
+    printf("  samples against the old AGC: %s\n", pass ? "pass" : "FAIL");
+
+    return pass;
+}
+
+/*****************************************************************************/
+
+/* main()
+ *
+ * Tests the plain magnitude kernel and the one of the highest
+ * SIMD level of the CPU, if another
+ */
+int main(void) {
+    uint8_t levels[2] = { CPU_SIMD_NONE, CPU_SIMD_MAX };
+    bool ok = true;
+
+    Make_Signal();
+
+    for (int l = 0; l < 2; l++) {
+        Agc_t *agc;
+
+        Cpu_Init(levels[l]);
+        if ((l > 0) && (Cpu_Simd() == CPU_SIMD_NONE))
+            break;
+
+        printf("AGC of SIMD level %s:\n", Cpu_Simd_Name(Cpu_Simd()));
+
+        agc = Agc_Init();
+        for (int idx = 0; idx < TEST_SAMPLES; idx++)
+            sample_out[idx] = Agc_Apply(agc, signal[idx]);
+        sample_agc = *agc;
+        Agc_Free(agc);
+
+        ok &= Test_Legacy();
+        ok &= Test_Blocks(true, true);
+        ok &= Test_Blocks(false, true);
+        ok &= Test_Blocks(true, false);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
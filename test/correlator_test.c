@@ -0,0 +1,249 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Test of the sync correlator of the decoder, counting matching sign
+ * bits by popcount, against the one correlating a symbol at a time by
+ * table lookups it replaced. On random bytes of several lengths and on
+ * streams of frames whose sync is sent from noiseless to lost in noise,
+ * in each rotation and flip of I and Q, both must return the same
+ * pattern, and the same correlation and position of every pattern */
+
+#include "../src/common/cpu.h"
+#include "../src/decoder/correlator.h"
+#include "legacy.h"
+#include "tx.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************************/
+
+/* Sync word of Meteor-M2, as Mtd_Init() sets it */
+#define TEST_SYNC       0xfca2b63db00d9794ULL
+
+/* Random buffers of each length, the shortest with one offset */
+#define TEST_RANDOM     16
+#define TEST_LENS       { PATTERN_SIZE + 1, 100, 1000, 4097, \
+                          CORR_FRAME_LEN, CORR_MAX_LEN }
+
+/* Frames of the streams, noise symbols before the first, all
+ * symbols, and windows of CORR_MAX_LEN at random offsets in each */
+#define TEST_FRAMES     4
+#define TEST_LEAD       5000
+#define TEST_LEN        (TEST_LEAD + (TEST_FRAMES + 1) * TX_CODE_LEN)
+#define TEST_WINDOWS    8
+
+/* Amplitude of data symbols and noise, 2.5 dB Es/N0, and of
+ * sync symbols: noiseless, sure, weak, lost in noise and none */
+#define TEST_AMP        48.0
+#define TEST_SIGMA      36.0
+#define TEST_SYNC_AMPS  { 48.0, 48.0, 28.0, 12.0, 0.0 }
+#define TEST_SIGMAS     { 0.0, TEST_SIGMA, TEST_SIGMA, TEST_SIGMA, \
+                          TEST_SIGMA }
+#define TEST_STREAMS    5
+
+/*****************************************************************************/
+
+static bool Compare(corr_rec_t *c, legacy_corr_t *legacy,
+        uint8_t *data, uint32_t len);
+static void Rotate_Soft(const uint8_t *in, uint8_t *out, uint32_t len,
+        int rot);
+static void Tx_Stream(double sync_amp, double sigma, int8_t *soft);
+static bool Test_Random(corr_rec_t *c, legacy_corr_t *legacy);
+static bool Test_Streams(corr_rec_t *c, legacy_corr_t *legacy);
+
+/*****************************************************************************/
+
+/* Compare()
+ *
+ * Correlates len symbols of data by both correlators, which
+ * must return the same pattern, correlations and positions
+ */
+static bool Compare(corr_rec_t *c, legacy_corr_t *legacy,
+        uint8_t *data, uint32_t len) {
+    int res = Corr_Correlate(c, data, len);
+    int ref = Legacy_Corr_Correlate(legacy, data, len);
+    bool same = res == ref;
+
+    for (int n = 0; n < PATTERN_CNT; n++)
+        same &= (c->correlation[n] == legacy->correlation[n]) &&
+            (c->position[n] == legacy->position[n]);
+
+    return same;
+}
+
+/*****************************************************************************/
+
+/* Rotate_Soft()
+ *
+ * Soft symbol pairs of in flipped in I and Q if rot is 4 or
+ * more, then rotated by rot quarter turns, as the patterns
+ */
+static void Rotate_Soft(const uint8_t *in, uint8_t *out, uint32_t len,
+        int rot) {
+    for (uint32_t i = 0; i + 1 < len; i += 2) {
+        uint8_t a = in[i], b = in[i + 1];
+
+        if (rot >= 4) {
+            a = in[i + 1];
+            b = in[i];
+        }
+        for (int r = 0; r < rot % 4; r++) {
+            uint8_t t = a;
+
+            a = (uint8_t)~b;
+            b = t;
+        }
+        out[i]     = a;
+        out[i + 1] = b;
+    }
+    if (len & 1)
+        out[len - 1] = in[len - 1];
+}
+
+/*****************************************************************************/
+
+/* Tx_Stream()
+ *
+ * Soft symbols of TEST_FRAMES frames encoded as a stream
+ * between random code bits, their sync symbols of sync_amp
+ */
+static void Tx_Stream(double sync_amp, double sigma, int8_t *soft) {
+    static uint8_t code[TEST_LEN];
+    uint8_t data[TX_DATA_LEN], cadu[TX_CADU_LEN];
+    uint32_t sh = 0;
+
+    for (int n = 0; n < TEST_LEN; n++)
+        code[n] = (uint8_t)(Tx_Rand() & 1);
+    for (int f = 0; f < TEST_FRAMES; f++) {
+        Tx_Frame(f, data, cadu);
+        Tx_Encode(cadu, &sh, &code[TEST_LEAD + f * TX_CODE_LEN]);
+    }
+
+    Tx_Soft(code, TEST_LEN, TEST_AMP, sigma, soft);
+    for (int f = 0; f < TEST_FRAMES; f++) {
+        int n = TEST_LEAD + f * TX_CODE_LEN;
+
+        Tx_Soft(&code[n], PATTERN_SIZE, sync_amp, sigma, &soft[n]);
+    }
+}
+
+/*****************************************************************************/
+
+/* Test_Random()
+ *
+ * Compares the correlators on random bytes of each length
+ */
+static bool Test_Random(corr_rec_t *c, legacy_corr_t *legacy) {
+    static const uint32_t lens[] = TEST_LENS;
+    static uint8_t data[CORR_MAX_LEN];
+    bool ok = true;
+
+    Tx_Seed(3);
+    for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+        int diff = 0;
+
+        for (int t = 0; t < TEST_RANDOM; t++) {
+            for (uint32_t i = 0; i < lens[l]; i++)
+                data[i] = (uint8_t)Tx_Rand();
+            diff += !Compare(c, legacy, data, lens[l]);
+        }
+
+        ok &= diff == 0;
+        printf("  random bytes, length %5u: %d of %d differ: %s\n",
+                lens[l], diff, TEST_RANDOM, diff == 0 ? "pass" : "FAIL");
+    }
+
+    return ok;
+}
+
+/*****************************************************************************/
+
+/* Test_Streams()
+ *
+ * Compares the correlators on windows of each stream at
+ * random offsets, in each rotation and flip of I and Q
+ */
+static bool Test_Streams(corr_rec_t *c, legacy_corr_t *legacy) {
+    static const double sync_amps[] = TEST_SYNC_AMPS;
+    static const double sigmas[] = TEST_SIGMAS;
+    static int8_t soft[TEST_LEN];
+    static uint8_t data[CORR_MAX_LEN];
+    bool ok = true;
+
+    Tx_Seed(0x9E3779B97F4A7C15ULL);
+    for (int s = 0; s < TEST_STREAMS; s++) {
+        int diff = 0, sure = 0;
+
+        Tx_Stream(sync_amps[s], sigmas[s], soft);
+        for (int w = 0; w < TEST_WINDOWS; w++) {
+            /* Even, keeping the I and Q of a symbol pair together */
+            uint32_t off = Tx_Rand() % (TEST_LEN - CORR_MAX_LEN) & ~1u;
+
+            for (int rot = 0; rot < PATTERN_CNT; rot++) {
+                Rotate_Soft((uint8_t *)&soft[off], data, CORR_MAX_LEN, rot);
+                diff += !Compare(c, legacy, data, CORR_MAX_LEN);
+                for (int n = 0; n < PATTERN_CNT; n++)
+                    if (legacy->correlation[n] > CORR_LIMIT) {
+                        sure++;
+                        break;
+                    }
+            }
+        }
+
+        ok &= diff == 0;
+        printf("  sync amplitude %2.0f, noise %2.0f: %d sure syncs, "
+                "%d of %d differ: %s\n", sync_amps[s], sigmas[s], sure,
+                diff, TEST_WINDOWS * PATTERN_CNT, diff == 0 ? "pass" : "FAIL");
+    }
+
+    return ok;
+}
+
+/*****************************************************************************/
+
+/* main()
+ *
+ * Tests the plain correlator and that of the highest SIMD
+ * level of the CPU, if another, on each kind of buffer
+ */
+int main(void) {
+    static corr_rec_t c;
+    static legacy_corr_t legacy;
+    uint8_t levels[2] = { CPU_SIMD_NONE, CPU_SIMD_MAX };
+    bool ok = true;
+
+    Tx_Init();
+    Init_Correlator_Tables();
+    Legacy_Corr_Init(&legacy, TEST_SYNC);
+
+    for (int l = 0; l < 2; l++) {
+        Cpu_Init(levels[l]);
+        if ((l > 0) && (Cpu_Simd() == CPU_SIMD_NONE))
+            break;
+        Correlator_Init(&c, TEST_SYNC);
+
+        printf("Sync correlator of SIMD level %s:\n",
+                Cpu_Simd_Name(Cpu_Simd()));
+        ok &= Test_Random(&c, &legacy);
+        ok &= Test_Streams(&c, &legacy);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,170 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Benchmark of the IDCT kernels of each SIMD level the CPU supports,
+ * on rows of quantized blocks of smooth images as in image packets,
+ * and of a separable float IDCT for comparison */
+
+#include "../src/common/cpu.h"
+#include "../src/decoder/dct.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*****************************************************************************/
+
+/* Blocks of a row, the MCUs of an image packet, and rows */
+#define BENCH_ROW_BLOCKS    14
+#define BENCH_ROWS          2000
+
+/* Passes over all the rows */
+#define BENCH_PASSES        20
+
+/*****************************************************************************/
+
+static double Bench_Time(void);
+static void Bench_Blocks(int16_t *coef, int16_t *dqt);
+static void Flt_Idct(const int16_t *coef, const int16_t *dqt, uint8_t *pix);
+
+/*****************************************************************************/
+
+/* Separable DCT basis, C(u) / 2 * cos((2x + 1) * u * pi / 16) */
+static float flt_basis[8][8];
+
+/*****************************************************************************/
+
+/* Bench_Time()
+ *
+ * Monotonic time in seconds
+ */
+static double Bench_Time(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/*****************************************************************************/
+
+/* Bench_Blocks()
+ *
+ * Fills quantized blocks of smooth image content, most high
+ * frequency coefficients zero, and a quantization table
+ */
+static void Bench_Blocks(int16_t *coef, int16_t *dqt) {
+    srand(1);
+
+    for (int i = 0; i < 64; i++)
+        dqt[i] = (int16_t)(8 + 2 * (i / 8 + i % 8));
+
+    for (int b = 0; b < BENCH_ROWS * BENCH_ROW_BLOCKS; b++, coef += 64) {
+        memset(coef, 0, 64 * sizeof(int16_t));
+        coef[0] = (int16_t)(rand() % 128 - 64);
+
+        for (int i = 1; i < 64; i++)
+            if (rand() % (1 + i / 4) == 0)
+                coef[i] = (int16_t)(rand() % 21 - 10);
+    }
+}
+
+/*****************************************************************************/
+
+/* Flt_Idct()
+ *
+ * Dequantization and IDCT of a block in float, rows then columns
+ */
+static void Flt_Idct(const int16_t *coef, const int16_t *dqt, uint8_t *pix) {
+    float tmp[64];
+
+    for (int v = 0; v < 8; v++)
+        for (int x = 0; x < 8; x++) {
+            float sum = 0.0f;
+
+            for (int u = 0; u < 8; u++)
+                sum += flt_basis[u][x] * (float)(coef[v * 8 + u] * dqt[v * 8 + u]);
+            tmp[v * 8 + x] = sum;
+        }
+
+    for (int y = 0; y < 8; y++)
+        for (int x = 0; x < 8; x++) {
+            float sum = 128.0f;
+
+            for (int v = 0; v < 8; v++)
+                sum += flt_basis[v][y] * tmp[v * 8 + x];
+            pix[y * BENCH_ROW_BLOCKS * 8 + x] =
+                (uint8_t)lrintf(fmaxf(0.0f, fminf(255.0f, sum)));
+        }
+}
+
+/*****************************************************************************/
+
+/* main()
+ *
+ * Times the float IDCT, then the kernel of each SIMD level
+ */
+int main(void) {
+    static int16_t coef[BENCH_ROWS * BENCH_ROW_BLOCKS * 64];
+    static uint8_t pix[8 * BENCH_ROW_BLOCKS * 8];
+    int16_t dqt[64];
+    uint8_t last = CPU_SIMD_MAX + 1;
+    unsigned check = 0;
+    double start, blocks = (double)BENCH_PASSES * BENCH_ROWS * BENCH_ROW_BLOCKS;
+
+    for (int u = 0; u < 8; u++)
+        for (int x = 0; x < 8; x++)
+            flt_basis[u][x] = (float)((u ? 0.5 : 0.5 / sqrt(2.0)) *
+                cos((2 * x + 1) * u * M_PI / 16.0));
+
+    Bench_Blocks(coef, dqt);
+
+    start = Bench_Time();
+    for (int p = 0; p < BENCH_PASSES; p++)
+        for (int r = 0; r < BENCH_ROWS; r++) {
+            for (int b = 0; b < BENCH_ROW_BLOCKS; b++)
+                Flt_Idct(&coef[(r * BENCH_ROW_BLOCKS + b) * 64], dqt, &pix[b * 8]);
+            check += pix[r % (8 * BENCH_ROW_BLOCKS * 8)];
+        }
+    printf("float IDCT:          %6.1f ns per block\n",
+            (Bench_Time() - start) / blocks * 1e9);
+
+    for (uint8_t level = CPU_SIMD_NONE; level <= CPU_SIMD_MAX; level++) {
+        Cpu_Init(level);
+        if (Cpu_Simd() == last)
+            continue;
+        last = Cpu_Simd();
+        Idct_Init();
+
+        start = Bench_Time();
+        for (int p = 0; p < BENCH_PASSES; p++)
+            for (int r = 0; r < BENCH_ROWS; r++) {
+                Idct_Blocks(&coef[r * BENCH_ROW_BLOCKS * 64], dqt,
+                        BENCH_ROW_BLOCKS, pix, BENCH_ROW_BLOCKS * 8);
+                check += pix[r % (8 * BENCH_ROW_BLOCKS * 8)];
+            }
+        printf("IDCT kernel %-8s %6.1f ns per block\n",
+                Cpu_Simd_Name(last), (Bench_Time() - start) / blocks * 1e9);
+    }
+
+    /* Keeps the outputs live */
+    printf("checksum %u\n", check);
+
+    return EXIT_SUCCESS;
+}
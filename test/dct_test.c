@@ -0,0 +1,295 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Accuracy test of the fixed point IDCT kernels against a double
+ * precision IDCT: the IEEE 1180-1990 test, and blocks dequantized
+ * beyond IDCT_COEF_MAX, which must neither overflow nor differ */
+
+#include "../src/common/cpu.h"
+#include "../src/decoder/dct.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*****************************************************************************/
+
+/* Random blocks of each IEEE 1180 run and of the clamp test */
+#define TEST_BLOCKS     10000
+
+/* Level shift of the output samples, as in dct.c */
+#define TEST_CENTER     128
+
+/*****************************************************************************/
+
+static void Ref_Init(void);
+static void Ref_Fdct(const double *pix, double *coef);
+static void Ref_Idct(const double *coef, double *pix);
+static long Ieee_Rand(long low, long high);
+static void Test_Idct(const int16_t *coef, const int16_t *dqt, int *pix);
+static bool Test_Ieee1180(long low, long high, int sign);
+static bool Test_Clamp(void);
+
+/*****************************************************************************/
+
+/* Orthonormal DCT basis, C(u) / 2 * cos((2x + 1) * u * pi / 16) */
+static double ref_basis[8][8];
+
+/* State of the IEEE 1180 random generator */
+static uint32_t rand_state;
+
+/*****************************************************************************/
+
+/* Ref_Init()
+ *
+ * Fills the basis of the double precision DCT
+ */
+static void Ref_Init(void) {
+    for (int u = 0; u < 8; u++)
+        for (int x = 0; x < 8; x++)
+            ref_basis[u][x] = (u ? 0.5 : 0.5 / sqrt(2.0)) *
+                cos((2 * x + 1) * u * M_PI / 16.0);
+}
+
+/*****************************************************************************/
+
+/* Ref_Fdct()
+ *
+ * Forward DCT of an 8x8 block of samples in double precision
+ */
+static void Ref_Fdct(const double *pix, double *coef) {
+    for (int v = 0; v < 8; v++)
+        for (int u = 0; u < 8; u++) {
+            double sum = 0.0;
+
+            for (int y = 0; y < 8; y++)
+                for (int x = 0; x < 8; x++)
+                    sum += ref_basis[v][y] * ref_basis[u][x] * pix[y * 8 + x];
+
+            coef[v * 8 + u] = sum;
+        }
+}
+
+/*****************************************************************************/
+
+/* Ref_Idct()
+ *
+ * Inverse DCT of an 8x8 block of coefficients in double precision
+ */
+static void Ref_Idct(const double *coef, double *pix) {
+    for (int y = 0; y < 8; y++)
+        for (int x = 0; x < 8; x++) {
+            double sum = 0.0;
+
+            for (int v = 0; v < 8; v++)
+                for (int u = 0; u < 8; u++)
+                    sum += ref_basis[v][y] * ref_basis[u][x] * coef[v * 8 + u];
+
+            pix[y * 8 + x] = sum;
+        }
+}
+
+/*****************************************************************************/
+
+/* Ieee_Rand()
+ *
+ * The random generator of IEEE 1180, a number in -low ... high
+ */
+static long Ieee_Rand(long low, long high) {
+    double x;
+
+    rand_state = rand_state * 1103515245u + 12345u;
+    x = (double)(rand_state & 0x7ffffffe) / (double)0x7fffffff;
+
+    return (long)(x * (double)(low + high + 1)) - low;
+}
+
+/*****************************************************************************/
+
+/* Test_Idct()
+ *
+ * A block through the IDCT kernel bound, samples without level shift
+ */
+static void Test_Idct(const int16_t *coef, const int16_t *dqt, int *pix) {
+    uint8_t out[64];
+
+    Idct_Blocks(coef, dqt, 1, out, 8);
+    for (int i = 0; i < 64; i++)
+        pix[i] = out[i] - TEST_CENTER;
+}
+
+/*****************************************************************************/
+
+/* Test_Ieee1180()
+ *
+ * IEEE 1180-1990 accuracy test of random blocks of samples in
+ * -low ... high, times sign. The reference output is clamped
+ * to the 8 bit samples of the kernel, not to 9 bits
+ */
+static bool Test_Ieee1180(long low, long high, int sign) {
+    static const int16_t dqt[64] = {
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+    };
+    double sum_err[64] = { 0.0 }, sum_sqr[64] = { 0.0 };
+    double pmse = 0.0, omse = 0.0, pme = 0.0, ome = 0.0;
+    int peak = 0;
+    bool ok;
+
+    rand_state = 1;
+
+    for (int b = 0; b < TEST_BLOCKS; b++) {
+        double pix[64], coef[64], ref[64];
+        int16_t icoef[64];
+        int out[64];
+
+        for (int i = 0; i < 64; i++)
+            pix[i] = (double)(Ieee_Rand(low, high) * sign);
+
+        /* The kernel clamps coefficients, so the reference gets them clamped */
+        Ref_Fdct(pix, coef);
+        for (int i = 0; i < 64; i++) {
+            coef[i] = round(coef[i]);
+            coef[i] = fmax(-IDCT_COEF_MAX, fmin(IDCT_COEF_MAX, coef[i]));
+            icoef[i] = (int16_t)coef[i];
+        }
+
+        Ref_Idct(coef, ref);
+        Test_Idct(icoef, dqt, out);
+
+        for (int i = 0; i < 64; i++) {
+            double r = fmax(-TEST_CENTER,
+                    fmin(TEST_CENTER - 1, round(ref[i])));
+            int err = out[i] - (int)r;
+
+            if (abs(err) > peak)
+                peak = abs(err);
+            sum_err[i] += err;
+            sum_sqr[i] += err * err;
+        }
+    }
+
+    for (int i = 0; i < 64; i++) {
+        pmse = fmax(pmse, sum_sqr[i] / TEST_BLOCKS);
+        pme  = fmax(pme, fabs(sum_err[i]) / TEST_BLOCKS);
+        omse += sum_sqr[i];
+        ome  += sum_err[i];
+    }
+    omse /= 64.0 * TEST_BLOCKS;
+    ome   = fabs(ome) / (64.0 * TEST_BLOCKS);
+
+    ok = (peak <= 1) && (pmse <= 0.06) && (omse <= 0.02) &&
+        (pme <= 0.015) && (ome <= 0.0015);
+
+    printf("  IEEE 1180 -%ld...%ld x %+d: peak %d pmse %.4f omse %.4f "
+            "pme %.4f ome %.5f: %s\n", low, high, sign,
+            peak, pmse, omse, pme, ome, ok ? "pass" : "FAIL");
+
+    return ok;
+}
+
+/*****************************************************************************/
+
+/* Test_Clamp()
+ *
+ * Blocks dequantized beyond IDCT_COEF_MAX, as of corrupt data: random
+ * ones, and ones of all coefficients at the clamp with the signs of the
+ * basis of a sample, which drive the IDCT to its extremes. The output
+ * must be the reference of the clamped coefficients within 1, as any
+ * overflow of the fixed point arithmetic wraps far from it
+ */
+static bool Test_Clamp(void) {
+    int peak = 0;
+    bool ok;
+
+    srand(1);
+
+    for (int b = 0; b < TEST_BLOCKS + 64; b++) {
+        double coef[64], ref[64];
+        int16_t icoef[64], dqt[64];
+        int out[64];
+
+        for (int i = 0; i < 64; i++) {
+            if (b < TEST_BLOCKS) {
+                icoef[i] = (int16_t)(rand() % 65536 - 32768);
+                dqt[i]   = (int16_t)(1 + rand() % 255);
+            }
+            else {
+                int y = (b - TEST_BLOCKS) / 8, x = (b - TEST_BLOCKS) % 8;
+
+                icoef[i] = (ref_basis[i / 8][y] * ref_basis[i % 8][x] < 0.0) ?
+                    -IDCT_COEF_MAX : IDCT_COEF_MAX;
+                dqt[i]   = (int16_t)(1 + (i + b) % 64);
+            }
+
+            coef[i] = fmax(-IDCT_COEF_MAX,
+                    fmin(IDCT_COEF_MAX, (double)icoef[i] * dqt[i]));
+        }
+
+        Ref_Idct(coef, ref);
+        Test_Idct(icoef, dqt, out);
+
+        for (int i = 0; i < 64; i++) {
+            double r = fmax(-TEST_CENTER,
+                    fmin(TEST_CENTER - 1, round(ref[i])));
+            int err = abs(out[i] - (int)r);
+
+            if (err > peak)
+                peak = err;
+        }
+    }
+
+    ok = peak <= 1;
+    printf("  clamped coefficients: peak %d: %s\n", peak, ok ? "pass" : "FAIL");
+
+    return ok;
+}
+
+/*****************************************************************************/
+
+/* main()
+ *
+ * Tests the plain IDCT kernel and the one of the
+ * highest SIMD level of the CPU, if another
+ */
+int main(void) {
+    uint8_t levels[2] = { CPU_SIMD_NONE, CPU_SIMD_MAX };
+    bool ok = true;
+
+    Ref_Init();
+
+    for (int l = 0; l < 2; l++) {
+        Cpu_Init(levels[l]);
+        if ((l > 0) && (Cpu_Simd() == CPU_SIMD_NONE))
+            break;
+        Idct_Init();
+
+        printf("IDCT kernel of SIMD level %s:\n", Cpu_Simd_Name(Cpu_Simd()));
+        ok &= Test_Ieee1180(256, 255,  1);
+        ok &= Test_Ieee1180(256, 255, -1);
+        ok &= Test_Ieee1180(5,   5,    1);
+        ok &= Test_Ieee1180(5,   5,   -1);
+        ok &= Test_Ieee1180(300, 300,  1);
+        ok &= Test_Ieee1180(300, 300, -1);
+        ok &= Test_Clamp();
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
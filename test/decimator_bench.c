@@ -0,0 +1,131 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Benchmark of the SDR decimation filters of each SIMD level the
+ * CPU supports, on blocks of 16 bit I/Q noise as read from the SDR,
+ * and of the double precision boxcar they replaced */
+
+#include "../src/common/common.h"
+#include "../src/common/cpu.h"
+#include "../src/sdr/SoapySDR.h"
+#include "../src/sdr/decimator.h"
+#include "legacy.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*****************************************************************************/
+
+/* Samples per block, as read from the SDR, blocks of samples,
+ * passes over them per run, and runs, of which the fastest counts */
+#define BENCH_BLOCK_LEN     16384
+#define BENCH_BLOCKS        16
+#define BENCH_PASSES        100
+#define BENCH_RUNS          5
+
+/* Decimation of 2.4 MS/s to the demodulator rate of 300 kS/s */
+#define BENCH_FACTOR        8
+
+/*****************************************************************************/
+
+static double Bench_Time(void);
+
+/*****************************************************************************/
+
+/* Bench_Time()
+ *
+ * Monotonic time in seconds
+ */
+static double Bench_Time(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/*****************************************************************************/
+
+/* main()
+ *
+ * Times the double precision boxcar, then each decimation
+ * filter with the kernels of each SIMD level, the fastest of
+ * several runs as the times of single runs vary
+ */
+int main(void) {
+    static const char *name[] = { "boxcar", "fir", "halfband" };
+    static int16_t iq[BENCH_BLOCKS][2 * BENCH_BLOCK_LEN];
+    static double ref_i[BENCH_BLOCK_LEN], ref_q[BENCH_BLOCK_LEN];
+    static dsp_t out_i[BENCH_BLOCK_LEN], out_q[BENCH_BLOCK_LEN];
+    uint8_t last = CPU_SIMD_MAX + 1;
+    double start, best, check = 0.0;
+    double samples = (double)BENCH_PASSES * BENCH_BLOCKS * BENCH_BLOCK_LEN;
+
+    srand(1);
+    for (int blk = 0; blk < BENCH_BLOCKS; blk++)
+        for (int n = 0; n < 2 * BENCH_BLOCK_LEN; n++)
+            iq[blk][n] = (int16_t)(rand() % 4001 - 2000);
+
+    best = INFINITY;
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        start = Bench_Time();
+        for (int p = 0; p < BENCH_PASSES; p++)
+            for (int blk = 0; blk < BENCH_BLOCKS; blk++) {
+                Legacy_Boxcar(iq[blk], BENCH_BLOCK_LEN, BENCH_FACTOR,
+                        BENCH_FACTOR * DATA_SCALE, ref_i, ref_q);
+                check += ref_i[p % (BENCH_BLOCK_LEN / BENCH_FACTOR)];
+            }
+        best = fmin(best, Bench_Time() - start);
+    }
+    printf("double boxcar:            %6.1f MS/s\n", samples / best * 1e-6);
+
+    for (uint8_t level = CPU_SIMD_NONE; level <= CPU_SIMD_MAX; level++) {
+        Cpu_Init(level);
+        if (Cpu_Simd() == last)
+            continue;
+        last = Cpu_Simd();
+
+        for (uint8_t type = DECIM_BOXCAR; type <= DECIM_HALFBAND; type++) {
+            decimator_t dec;
+
+            if (!Decimator_Init(&dec, BENCH_FACTOR, type, BENCH_BLOCK_LEN))
+                return EXIT_FAILURE;
+
+            best = INFINITY;
+            for (int r = 0; r < BENCH_RUNS; r++) {
+                start = Bench_Time();
+                for (int p = 0; p < BENCH_PASSES; p++)
+                    for (int blk = 0; blk < BENCH_BLOCKS; blk++) {
+                        Decimator_Run(&dec, iq[blk], BENCH_BLOCK_LEN, out_i, out_q);
+                        check += (double)out_i[p % (BENCH_BLOCK_LEN / BENCH_FACTOR)];
+                    }
+                best = fmin(best, Bench_Time() - start);
+            }
+            printf("%-8s %-8s kernel: %6.1f MS/s\n", name[type],
+                    Cpu_Simd_Name(last), samples / best * 1e-6);
+
+            Decimator_Free(&dec);
+        }
+    }
+
+    /* Keeps the outputs live */
+    printf("checksum %.3g\n", check);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,208 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Frequency response test of the SDR decimation filters, FIR and
+ * half-band cascade, for each decimation factor: gain of tones in
+ * the inner half of the output band, and rejection of the tones
+ * that alias into it, measured on complex tones of 16 bit samples.
+ * The boxcar must give exactly the sums of the one it replaced */
+
+#include "../src/common/common.h"
+#include "../src/common/cpu.h"
+#include "../src/sdr/SoapySDR.h"
+#include "../src/sdr/decimator.h"
+#include "legacy.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*****************************************************************************/
+
+/* Amplitude of the input tones */
+#define TEST_AMPL           8000.0
+
+/* Output samples let through for the filters to settle, output
+ * samples measured, and input samples decimated at a time */
+#define TEST_SETTLE         64
+#define TEST_OUT_LEN        1024
+#define TEST_MAX_IN         4096
+
+/* Steps of tone frequency, as a fraction of the output sample rate,
+ * a whole number of cycles over the output samples measured */
+#define TEST_FREQ_STEPS     16
+
+/* Largest decimation factor, as for DECIM_STAGES_MAX half-bands */
+#define TEST_MAX_FACTOR     32
+
+/* Largest gain change in the inner half of the output band, and
+ * least rejection of aliases into it, in dB, as the FIR decimator
+ * has it by 16 and 32. The half-bands reject them by 70 dB */
+#define TEST_MAX_DROOP      0.5
+#define TEST_MIN_REJECTION  65.0
+
+/*****************************************************************************/
+
+static double Tone_Gain(decimator_t *dec, uint32_t factor, double freq);
+static bool Test_Response(uint8_t type, uint32_t factor);
+static bool Test_Boxcar(uint32_t factor);
+
+/*****************************************************************************/
+
+/* Input and output samples of the decimator */
+static int16_t iq[2 * TEST_MAX_IN];
+static dsp_t out_i[(TEST_SETTLE + TEST_OUT_LEN) * 2];
+static dsp_t out_q[(TEST_SETTLE + TEST_OUT_LEN) * 2];
+
+/*****************************************************************************/
+
+/* Tone_Gain()
+ *
+ * Decimates a complex tone of freq, in output sample rates,
+ * and returns the gain in dB of the tone it aliases to
+ */
+static double Tone_Gain(decimator_t *dec, uint32_t factor, double freq) {
+    uint32_t in_len = (TEST_SETTLE + TEST_OUT_LEN) * factor, cnt = 0;
+    double alias = freq - round(freq);
+    complex double sum = 0.0;
+
+    for (uint32_t in = 0; in < in_len; in += TEST_MAX_IN) {
+        uint32_t len = (in_len - in < TEST_MAX_IN) ? in_len - in : TEST_MAX_IN;
+
+        for (uint32_t n = 0; n < len; n++) {
+            double phase = M_2PI * freq * (double)(in + n) / (double)factor;
+
+            iq[2 * n]     = (int16_t)lround(TEST_AMPL * cos(phase));
+            iq[2 * n + 1] = (int16_t)lround(TEST_AMPL * sin(phase));
+        }
+
+        cnt += Decimator_Run(dec, iq, len, out_i + cnt, out_q + cnt);
+    }
+
+    /* Amplitude of the alias, over whole cycles */
+    for (uint32_t n = TEST_SETTLE; n < TEST_SETTLE + TEST_OUT_LEN; n++)
+        sum += ((double)out_i[n] + (double)out_q[n] * I) *
+            cexp(-I * M_2PI * alias * (double)n);
+
+    /* Decimator outputs are divided by DATA_SCALE */
+    return 20.0 * log10(cabs(sum) / TEST_OUT_LEN * DATA_SCALE / TEST_AMPL);
+}
+
+/*****************************************************************************/
+
+/* Test_Response()
+ *
+ * Measures a decimator of type and factor on tones in the inner
+ * half of the output band, and on the tones up to the input Nyquist
+ * frequency that alias into it
+ */
+static bool Test_Response(uint8_t type, uint32_t factor) {
+    static const char *name[] = { "boxcar", "fir", "halfband" };
+    int steps = TEST_FREQ_STEPS / 4, half = (int)factor / 2;
+    double droop = 0.0, alias = -INFINITY, gain;
+    bool pass;
+
+    for (int f = -steps; f <= steps; f++)
+        for (int m = -half; m <= half; m++) {
+            double freq = m + (double)f / TEST_FREQ_STEPS;
+            decimator_t dec;
+
+            if (fabs(freq) > half)
+                continue;
+
+            if (!Decimator_Init(&dec, factor, type, TEST_MAX_IN))
+                return false;
+            gain = Tone_Gain(&dec, factor, freq);
+            Decimator_Free(&dec);
+
+            if (m == 0) {
+                if (fabs(gain) > fabs(droop))
+                    droop = gain;
+            } else if (gain > alias)
+                alias = gain;
+        }
+
+    pass = (fabs(droop) <= TEST_MAX_DROOP) && (alias <= -TEST_MIN_REJECTION);
+    printf("  %-8s by %2u: passband %+5.2f dB, aliases %6.1f dB: %s\n",
+            name[type], factor, droop, alias, pass ? "pass" : "FAIL");
+
+    return pass;
+}
+
+/*****************************************************************************/
+
+/* Test_Boxcar()
+ *
+ * Decimates blocks of noise by the boxcar and by the double
+ * precision boxcar it replaced, which must give the same
+ */
+static bool Test_Boxcar(uint32_t factor) {
+    static double ref_i[TEST_MAX_IN], ref_q[TEST_MAX_IN];
+    decimator_t dec;
+    uint32_t cnt;
+    bool pass = true;
+
+    if (!Decimator_Init(&dec, factor, DECIM_BOXCAR, TEST_MAX_IN))
+        return false;
+
+    srand(1);
+    for (int blk = 0; blk < 16; blk++) {
+        for (int n = 0; n < 2 * TEST_MAX_IN; n++)
+            iq[n] = (int16_t)(rand() % 65536 - 32768);
+
+        cnt = Decimator_Run(&dec, iq, TEST_MAX_IN, out_i, out_q);
+        Legacy_Boxcar(iq, TEST_MAX_IN, factor, factor * DATA_SCALE, ref_i, ref_q);
+        for (uint32_t n = 0; n < cnt; n++)
+            if ((out_i[n] != (dsp_t)ref_i[n]) || (out_q[n] != (dsp_t)ref_q[n]))
+                pass = false;
+    }
+
+    printf("  boxcar   by %2u: against the double boxcar: %s\n",
+            factor, pass ? "pass" : "FAIL");
+
+    Decimator_Free(&dec);
+    return pass;
+}
+
+/*****************************************************************************/
+
+/* main()
+ *
+ * Tests the plain kernels and the ones of the highest
+ * SIMD level of the CPU, if another
+ */
+int main(void) {
+    uint8_t levels[2] = { CPU_SIMD_NONE, CPU_SIMD_MAX };
+    bool ok = true;
+
+    for (int l = 0; l < 2; l++) {
+        Cpu_Init(levels[l]);
+        if ((l > 0) && (Cpu_Simd() == CPU_SIMD_NONE))
+            break;
+
+        printf("Decimators of SIMD level %s:\n", Cpu_Simd_Name(Cpu_Simd()));
+        for (uint32_t factor = 2; factor <= TEST_MAX_FACTOR; factor *= 2) {
+            ok &= Test_Boxcar(factor);
+            ok &= Test_Response(DECIM_FIR, factor);
+            ok &= Test_Response(DECIM_HALFBAND, factor);
+        }
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
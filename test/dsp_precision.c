@@ -0,0 +1,495 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Comparison of the DSP path built in double and in single precision
+ * (GLRPT_FLOAT_DSP). A QPSK signal of encoded frames, the same in both
+ * builds, is made at a range of Es/N0 and run through the I/Q filters
+ * and the demodulator as samples of an I/Q file. Its frames are then
+ * decoded as by the decoder thread. Prints the channel bit error rate
+ * found by the Viterbi decoder, the yield of frames and the throughput
+ * of the DSP path. Given a file, the double build writes its results
+ * to it, and the single precision build checks its own against them */
+
+#include "../src/common/common.h"
+#include "../src/common/cpu.h"
+#include "../src/common/shared.h"
+#include "../src/decoder/correlator.h"
+#include "../src/decoder/ecc.h"
+#include "../src/decoder/frame_queue.h"
+#include "../src/decoder/met_to_data.h"
+#include "../src/decoder/viterbi27.h"
+#include "../src/demodulator/demod.h"
+#include "../src/demodulator/pll.h"
+#include "../src/glrpt/utils.h"
+#include "../src/sdr/filters.h"
+#include "../src/sdr/iq_file.h"
+#include "../src/sdr/SoapySDR.h"
+#include "tx.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*****************************************************************************/
+
+/* Demodulator sample rate, as of a 2.4 MS/s SDR decimated by 8,
+ * and signal parameters of Meteor-M2 as in its config file */
+#define TEST_SAMPLERATE     300000
+#define TEST_SYMBOL_RATE    72000
+#define TEST_FILTER_BW      120000
+#define TEST_RRC_ALPHA      0.6
+
+/* I/Q filters as set up by SoapySDR_Init_Filters() */
+#define TEST_FILTER_RIPPLE  5.0
+#define TEST_FILTER_POLES   6
+
+/* Frames counted at each Es/N0, frames sent before them for the PLL
+ * to lock, and after them to flush them through to the decoder */
+#define TEST_FRAMES         96
+#define TEST_LEAD_FRAMES    12
+#define TEST_TAIL_FRAMES    2
+#define TEST_ALL_FRAMES     (TEST_LEAD_FRAMES + TEST_FRAMES + TEST_TAIL_FRAMES)
+
+/* Samples per block handed to the demodulator, as IQ_File_Read() */
+#define TEST_BLOCK_LEN      16384
+
+/* Carrier offset and amplitude of the signal */
+#define TEST_FREQ_OFFSET    300.0
+#define TEST_AMPLITUDE      1000.0
+
+/* Symbols each side of the transmit pulse */
+#define TEST_RRC_SPAN       8
+
+/* Least yield of frames at the highest Es/N0 */
+#define TEST_MIN_YIELD      0.9
+
+/* Tolerances of the single precision build against the double one,
+ * checked down to TEST_CLIFF_ESN0. Below it the yield falls off the
+ * cliff of the decoder, where the builds differ by half (49 against
+ * 74 frames at 4 dB). Above it, at each Es/N0: at most so many frames
+ * fewer, a channel BER at most so much higher (the builds differ by a
+ * quarter at 5 and 6 dB, either way), and at least this share of the
+ * throughput, as the builds run one after the other on a machine that
+ * may be busy */
+#define TEST_CLIFF_ESN0     4.5
+#define TEST_MAX_LOST       3
+#define TEST_MAX_BER_RATIO  1.3
+#define TEST_MAX_BER_DIFF   0.3
+#define TEST_MIN_SPEED      0.5
+
+/*****************************************************************************/
+
+static double Tx_Pulse(double t);
+static void Tx_Signal(double esn0);
+static double Run_Demod(void);
+static int Decode_Frames(double *ber);
+static bool Save_Results(const char *fname);
+static bool Check_Results(const char *fname);
+
+/*****************************************************************************/
+
+/* Data of the frames sent, before randomization */
+static uint8_t tx_data[TEST_ALL_FRAMES][TX_DATA_LEN];
+
+/* I/Q samples of the signal and the next one fed to the demodulator */
+static double *tx_i = NULL, *tx_q = NULL;
+static size_t tx_len, tx_pos;
+
+/* Soft frames of the demodulator, and whether the PLL was locked */
+static int8_t rx_frames[TEST_ALL_FRAMES + 8][SOFT_FRAME_LEN];
+static bool rx_locked[TEST_ALL_FRAMES + 8];
+static int rx_count;
+
+/* Es/N0 of the runs, from high to low, and their results */
+static const double esn0[] = { 10.0, 8.0, 6.0, 5.0, 4.5, 4.0, 3.5, 3.0 };
+#define TEST_RUNS   (sizeof(esn0) / sizeof(esn0[0]))
+
+static int res_frames[TEST_RUNS];
+static double res_ber[TEST_RUNS], res_speed[TEST_RUNS];
+
+/* Buffers of the I/Q filters */
+static dsp_t filter_buf_i[TEST_BLOCK_LEN], filter_buf_q[TEST_BLOCK_LEN];
+
+/*****************************************************************************/
+
+/* Tx_Pulse()
+ *
+ * Root raised cosine pulse at t symbols, of unit energy
+ */
+static double Tx_Pulse(double t) {
+    const double a = TEST_RRC_ALPHA;
+
+    if (fabs(t) < 1e-9)
+        return 1.0 - a + 4.0 * a / M_PI;
+
+    if (fabs(fabs(t) - 0.25 / a) < 1e-9)
+        return a / sqrt(2.0) * ((1.0 + 2.0 / M_PI) * sin(M_PI / (4.0 * a)) +
+                (1.0 - 2.0 / M_PI) * cos(M_PI / (4.0 * a)));
+
+    return (sin(M_PI * t * (1.0 - a)) + 4.0 * a * t * cos(M_PI * t * (1.0 + a))) /
+        (M_PI * t * (1.0 - 16.0 * a * a * t * t));
+}
+
+/*****************************************************************************/
+
+/* Tx_Signal()
+ *
+ * Makes the I/Q samples of the frames convolutionally encoded
+ * as for Meteor-M2, QPSK modulated, pulse shaped and offset
+ * in frequency, with white gaussian noise of Es/N0 in dB
+ */
+static void Tx_Signal(double esn0) {
+    const int nframes = TEST_ALL_FRAMES;
+    const int taps = 2 * TEST_RRC_SPAN + 1;
+    const size_t nsym = (size_t)nframes * SOFT_FRAME_LEN / 2;
+    double sps = (double)TEST_SAMPLERATE / TEST_SYMBOL_RATE;
+    double sigma = TEST_AMPLITUDE * sqrt(sps / pow(10.0, esn0 / 10.0) / 2.0);
+    complex double *sym;
+    double *pulse;
+    uint32_t sh = 0, p, q, g;
+    uint8_t code[TX_CODE_LEN];
+    size_t k = 0;
+
+    mem_alloc((void **)&sym, nsym * sizeof(complex double));
+
+    /* Symbols of the encoded frames, bits 0/1 as +1/-1 */
+    for (int f = 0; f < nframes; f++) {
+        uint8_t cadu[TX_CADU_LEN];
+
+        Tx_Frame(f, tx_data[f], cadu);
+        Tx_Encode(cadu, &sh, code);
+        for (int j = 0; j < TX_CODE_LEN; j += 2, k++)
+            sym[k] = M_SQRT1_2 * ((code[j] ? -1.0 : 1.0) +
+                    (code[j + 1] ? -1.0 : 1.0) * I);
+    }
+
+    /* Sample n is at n * p / q symbols, so there are q phases of the pulse */
+    g = TEST_SAMPLERATE;
+    p = TEST_SYMBOL_RATE;
+    while (p) {
+        q = g % p;
+        g = p;
+        p = q;
+    }
+    p = TEST_SYMBOL_RATE / g;
+    q = TEST_SAMPLERATE / g;
+
+    mem_alloc((void **)&pulse, (size_t)q * taps * sizeof(double));
+    for (uint32_t ph = 0; ph < q; ph++)
+        for (int t = 0; t < taps; t++)
+            pulse[ph * taps + t] =
+                Tx_Pulse((double)ph / q + (double)(TEST_RRC_SPAN - t));
+
+    tx_len = (size_t)((double)nsym * sps);
+    mem_realloc((void **)&tx_i, tx_len * sizeof(double));
+    mem_realloc((void **)&tx_q, tx_len * sizeof(double));
+
+    for (size_t n = 0; n < tx_len; n++) {
+        size_t ks = n * p / q;
+        const double *h = pulse + (n * p % q) * taps;
+        complex double s = 0.0;
+
+        for (int t = 0; t < taps; t++) {
+            size_t idx = ks + (size_t)t;
+
+            if ((idx >= TEST_RRC_SPAN) && (idx - TEST_RRC_SPAN < nsym))
+                s += h[t] * sym[idx - TEST_RRC_SPAN];
+        }
+
+        s *= TEST_AMPLITUDE *
+            cexp(I * M_2PI * TEST_FREQ_OFFSET * (double)n / TEST_SAMPLERATE);
+
+        tx_i[n] = creal(s) + sigma * Tx_Gauss();
+        tx_q[n] = cimag(s) + sigma * Tx_Gauss();
+    }
+
+    free_ptr((void **)&pulse);
+    free_ptr((void **)&sym);
+}
+
+/*****************************************************************************/
+
+/* IQ_File_Input()
+ *
+ * Samples come from Tx_Signal() as from an I/Q file
+ */
+bool IQ_File_Input(void) {
+    return true;
+}
+
+/*****************************************************************************/
+
+/* IQ_File_Read()
+ *
+ * Puts the next block of samples into the I/Q filter buffers,
+ * zero padded at the end. Returns false when they are exhausted
+ */
+bool IQ_File_Read(void) {
+    size_t got = tx_len - tx_pos;
+
+    if (got > TEST_BLOCK_LEN)
+        got = TEST_BLOCK_LEN;
+
+    for (size_t idx = 0; idx < TEST_BLOCK_LEN; idx++) {
+        filter_buf_i[idx] = (idx < got) ? (dsp_t)tx_i[tx_pos + idx] : 0;
+        filter_buf_q[idx] = (idx < got) ? (dsp_t)tx_q[tx_pos + idx] : 0;
+    }
+    tx_pos += got;
+
+    return got == TEST_BLOCK_LEN;
+}
+
+/*****************************************************************************/
+
+/* Frame_Queue_Post()
+ *
+ * Keeps the frames of the demodulator, decoded after it has run,
+ * and whether they were to be decoded, the PLL being locked
+ */
+void Frame_Queue_Post(const int8_t *frame, bool decode) {
+    if (rx_count >= TEST_ALL_FRAMES + 8)
+        return;
+
+    memcpy(rx_frames[rx_count], frame, SOFT_FRAME_LEN);
+    rx_locked[rx_count++] = decode;
+}
+
+/*****************************************************************************/
+
+/* Run_Demod()
+ *
+ * Runs the samples of the signal through the I/Q filters and the
+ * demodulator as Demodulator_Thread(). Returns the time taken
+ */
+static double Run_Demod(void) {
+    struct timespec start, end;
+
+    filter_data_i.samples_buf = filter_buf_i;
+    filter_data_q.samples_buf = filter_buf_q;
+    if (!Init_Chebyshev_Filter(&filter_data_i, TEST_BLOCK_LEN,
+                TEST_FILTER_BW, demod_samplerate, TEST_FILTER_RIPPLE,
+                TEST_FILTER_POLES, FILTER_LOWPASS) ||
+            !Init_Chebyshev_Filter(&filter_data_q, TEST_BLOCK_LEN,
+                TEST_FILTER_BW, demod_samplerate, TEST_FILTER_RIPPLE,
+                TEST_FILTER_POLES, FILTER_LOWPASS))
+        exit(EXIT_FAILURE);
+
+    Demod_Init();
+    tx_pos   = 0;
+    rx_count = 0;
+    SetFlag(STATUS_RECEIVING | STATUS_DECODING);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (Demodulator_Run());
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    Demod_Deinit();
+    Deinit_Chebyshev_Filter(&filter_data_i);
+    Deinit_Chebyshev_Filter(&filter_data_q);
+
+    return (double)(end.tv_sec - start.tv_sec) +
+        (double)(end.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+/*****************************************************************************/
+
+/* Decode_Frames()
+ *
+ * Decodes the frames of the demodulator as Frame_Queue_Decoder(),
+ * but all of them: below about 7 dB Es/N0 the lock detector of the
+ * PLL stays unlocked, though frames still decode. Returns the number
+ * of frames counted which were decoded right, and the mean channel
+ * bit error rate in % of those in ber
+ */
+static int Decode_Frames(double *ber) {
+    static mtd_rec_t mtd;
+    static uint8_t soft_buf[3 * SOFT_FRAME_LEN];
+    bool seen[TEST_ALL_FRAMES] = { false };
+    int ok = 0;
+
+    Mtd_Init(&mtd);
+    memset(soft_buf, 0, sizeof(soft_buf));
+    *ber = 0.0;
+
+    for (int f = 0; f < rx_count; f++) {
+        memcpy(soft_buf + 2 * SOFT_FRAME_LEN, rx_frames[f], SOFT_FRAME_LEN);
+        memmove(soft_buf, soft_buf + SOFT_FRAME_LEN, 2 * SOFT_FRAME_LEN);
+
+        while (mtd.pos < SOFT_FRAME_LEN) {
+            int num;
+
+            if (!Mtd_One_Frame(&mtd, soft_buf))
+                continue;
+
+            /* A frame sent counts once, if decoded as sent */
+            num = mtd.ecced_data[0] | (mtd.ecced_data[1] << 8);
+            if ((num >= TEST_ALL_FRAMES) || seen[num] ||
+                    memcmp(mtd.ecced_data, tx_data[num], TX_DATA_LEN))
+                continue;
+            seen[num] = true;
+
+            if ((num >= TEST_LEAD_FRAMES) &&
+                    (num < TEST_LEAD_FRAMES + TEST_FRAMES)) {
+                *ber += Vit_Get_Percent_BER(&mtd.v);
+                ok++;
+            }
+        }
+
+        mtd.pos      -= SOFT_FRAME_LEN;
+        mtd.prev_pos -= SOFT_FRAME_LEN;
+    }
+
+    if (ok)
+        *ber /= ok;
+
+    return ok;
+}
+
+/*****************************************************************************/
+
+/* Save_Results()
+ *
+ * Writes the results of the runs to a file, a line per Es/N0
+ */
+static bool Save_Results(const char *fname) {
+    FILE *fp = fopen(fname, "w");
+
+    if (fp == NULL) {
+        perror(fname);
+        return false;
+    }
+
+    for (size_t i = 0; i < TEST_RUNS; i++)
+        fprintf(fp, "%.1f %d %.4f %.4f\n",
+                esn0[i], res_frames[i], res_ber[i], res_speed[i]);
+
+    return fclose(fp) == 0;
+}
+
+/*****************************************************************************/
+
+/* Check_Results()
+ *
+ * Checks the results of the runs against those in a file
+ * written by the other build, within the tolerances
+ */
+static bool Check_Results(const char *fname) {
+    FILE *fp = fopen(fname, "r");
+    bool ok = true;
+
+    if (fp == NULL) {
+        perror(fname);
+        return false;
+    }
+
+    printf("Against double precision, down to %.1f dB:\n", TEST_CLIFF_ESN0);
+    for (size_t i = 0; i < TEST_RUNS; i++) {
+        double ref_esn0, ref_ber, ref_speed;
+        int ref_frames;
+        bool pass;
+
+        if ((fscanf(fp, "%lf %d %lf %lf", &ref_esn0,
+                        &ref_frames, &ref_ber, &ref_speed) != 4) ||
+                (fabs(ref_esn0 - esn0[i]) > 0.01)) {
+            fprintf(stderr, "%s: no results of %.1f dB\n", fname, esn0[i]);
+            ok = false;
+            break;
+        }
+        if (esn0[i] < TEST_CLIFF_ESN0)
+            continue;
+
+        pass = (res_frames[i] >= ref_frames - TEST_MAX_LOST) &&
+            (res_ber[i] <= ref_ber * TEST_MAX_BER_RATIO + TEST_MAX_BER_DIFF) &&
+            (res_speed[i] >= ref_speed * TEST_MIN_SPEED);
+        printf("  Es/N0 %4.1f dB: frames %2d against %2d, channel BER %5.2f%% "
+                "against %5.2f%%, %5.2f against %5.2f MS/s: %s\n",
+                esn0[i], res_frames[i], ref_frames, res_ber[i], ref_ber,
+                res_speed[i], ref_speed, pass ? "pass" : "FAIL");
+        ok &= pass;
+    }
+
+    fclose(fp);
+
+    return ok;
+}
+
+/*****************************************************************************/
+
+/* main()
+ *
+ * Runs the DSP path and the decoder at each Es/N0, from high to
+ * low, then saves or checks the results in the file of argv[1]
+ */
+int main(int argc, char *argv[]) {
+    bool single = sizeof(dsp_t) == sizeof(float);
+    bool ok;
+
+    Cpu_Init(CPU_SIMD_MAX);
+    Init_Correlator_Tables();
+    Init_Ecc_Tables();
+    Tx_Init();
+
+    /* Meteor-M2 settings of the config file */
+    demod_samplerate         = TEST_SAMPLERATE;
+    rc_data.sdr_filter_bw    = TEST_FILTER_BW;
+    rc_data.symbol_rate      = TEST_SYMBOL_RATE;
+    rc_data.psk_mode         = QPSK;
+    rc_data.rrc_order        = 32;
+    rc_data.rrc_alpha        = TEST_RRC_ALPHA;
+    rc_data.interp_factor    = 4;
+    rc_data.costas_bandwidth = 100.0;
+    rc_data.pll_locked       = 0.8;
+    rc_data.pll_unlocked     = 1.03 * rc_data.pll_locked;
+    rc_data.costas_nco       = COSTAS_NCO_LUT;
+    SetFlag(HEADLESS_MODE);
+
+    printf("DSP path in %s precision, SIMD level %s:\n",
+            single ? "single" : "double", Cpu_Simd_Name(Cpu_Simd()));
+
+    for (size_t i = 0; i < TEST_RUNS; i++) {
+        double secs;
+        int locked = 0;
+
+        Tx_Seed(0x9E3779B97F4A7C15ULL);
+        Tx_Signal(esn0[i]);
+
+        secs = Run_Demod();
+        res_frames[i] = Decode_Frames(&res_ber[i]);
+        res_speed[i]  = (double)tx_len / secs * 1e-6;
+        for (int f = 0; f < rx_count; f++)
+            locked += rx_locked[f];
+
+        printf("  Es/N0 %4.1f dB: frames %2d of %d, channel BER %5.2f%%, "
+                "PLL locked %3d%%, %5.2f MS/s (%4.1fx real time)\n",
+                esn0[i], res_frames[i], TEST_FRAMES, res_ber[i],
+                rx_count ? 100 * locked / rx_count : 0, res_speed[i],
+                res_speed[i] * 1e6 / TEST_SAMPLERATE);
+    }
+
+    free_ptr((void **)&tx_i);
+    free_ptr((void **)&tx_q);
+
+    ok = (double)res_frames[0] / TEST_FRAMES >= TEST_MIN_YIELD;
+    if (argc > 1)
+        ok &= single ? Check_Results(argv[1]) : Save_Results(argv[1]);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,128 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Display, SDR device and decoder thread functions called by the
+ * demodulator, which the DSP tests run headless on samples of their
+ * own, decoding the frames themselves. They do nothing here */
+
+#include "../src/decoder/frame_queue.h"
+#include "../src/decoder/met_jpg.h"
+#include "../src/decoder/soft_file.h"
+#include "../src/glrpt/callback_func.h"
+#include "../src/glrpt/display.h"
+#include "../src/sdr/SoapySDR.h"
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+
+/* Sample rate of the demodulator, set by the tests */
+double demod_samplerate;
+
+/*****************************************************************************/
+
+void Display_Icon(GtkWidget *img, const gchar *name) {
+    (void)img;
+    (void)name;
+}
+
+/*****************************************************************************/
+
+void Display_Entry(GtkWidget *entry, const gchar *txt) {
+    (void)entry;
+    (void)txt;
+}
+
+/*****************************************************************************/
+
+void Snapshot_Waterfall(const dsp_t *buf_i, const dsp_t *buf_q) {
+    (void)buf_i;
+    (void)buf_q;
+}
+
+/*****************************************************************************/
+
+void Snapshot_Demod(const int8_t *buffer, Demod_t *demod) {
+    (void)buffer;
+    (void)demod;
+}
+
+/*****************************************************************************/
+
+gboolean Display_Snapshot(gpointer data) {
+    (void)data;
+
+    return FALSE;
+}
+
+/*****************************************************************************/
+
+void Error_Dialog(void) {
+}
+
+/*****************************************************************************/
+
+void Set_Check_Menu_Item(gchar *item_name, gboolean flag) {
+    (void)item_name;
+    (void)flag;
+}
+
+/*****************************************************************************/
+
+bool SoapySDR_Read_Block(void) {
+    return false;
+}
+
+/*****************************************************************************/
+
+void SoapySDR_Release_Block(void) {
+}
+
+/*****************************************************************************/
+
+void SoapySDR_Close_Device(void) {
+}
+
+/*****************************************************************************/
+
+bool Frame_Queue_Start(void) {
+    return true;
+}
+
+/*****************************************************************************/
+
+void Frame_Queue_Stop(void) {
+}
+
+/*****************************************************************************/
+
+void Soft_File_Write(const int8_t *frame) {
+    (void)frame;
+}
+
+/*****************************************************************************/
+
+void Soft_File_Close(void) {
+}
+
+/*****************************************************************************/
+
+void Mj_Dump_Image(void) {
+}
@@ -0,0 +1,304 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Test of the RS(255,223) decoder of interleaved code words against
+ * the decoder of single code words it replaced, with the plain kernels
+ * and those of each SIMD level the CPU has, which must also decode as
+ * the plain ones. All must return the same verdicts and bytes: on frames of synthetic code words with 0
+ * to 16 errors per word, which must be corrected, and with more errors
+ * than can be corrected; and on the frames the decoder hands to the
+ * RS decoder out of a soft symbol stream, with the bursts of errors
+ * of the Viterbi decoder. The stream is synthetic, or a file of 8 bit
+ * soft symbols given as argument, as recorded by glrpt -w */
+
+#include "../src/common/cpu.h"
+#include "../src/decoder/correlator.h"
+#include "../src/decoder/ecc.h"
+#include "../src/decoder/met_to_data.h"
+#include "legacy.h"
+#include "tx.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************************/
+
+/* Frames tested at each count of errors per word */
+#define TEST_FRAMES         200
+
+/* Errors per word that can be corrected, counts beyond,
+ * and all counts tested */
+#define TEST_MAX_ERRORS     16
+#define TEST_EXCESS_ERRORS  { 17, 18, 20, 24, 32, 64, 128 }
+#define TEST_COUNTS         (TEST_MAX_ERRORS + 1 + 7)
+
+/* Frames of the synthetic soft symbol stream, and its soft symbols:
+ * amplitude and noise, 1.4 dB Es/N0 per QPSK symbol, at the edge of
+ * decoding: about half the frames are corrected, the rest fail */
+#define TEST_STREAM_FRAMES  64
+#define TEST_SOFT_AMP       48.0
+#define TEST_SOFT_SIGMA     41.0
+
+/*****************************************************************************/
+
+static void Legacy_Decode_Interleaved(uint8_t *data, bool *ok);
+void __real_Ecc_Decode_Interleaved(uint8_t *data, bool *ok);
+void __wrap_Ecc_Decode_Interleaved(uint8_t *data, bool *ok);
+static bool Test_Errors(int errors, int n, bool plain);
+static bool Decode_Stream(FILE *fp, const char *name);
+static FILE *Tx_Stream(void);
+
+/*****************************************************************************/
+
+/* Frames and code words handed to the RS decoder by the decoder, those
+ * it corrected, and those where the two RS decoders differ */
+static int stream_frames, stream_corrected, stream_mismatches;
+
+/* Frames decoded, and verdicts, by the plain kernels
+ * at each count of errors, to check the others against */
+static uint8_t plain_data[TEST_COUNTS][TEST_FRAMES][TX_DATA_LEN];
+static bool plain_ok[TEST_COUNTS][TEST_FRAMES][ECC_INTERLEAVE];
+
+/*****************************************************************************/
+
+/* Legacy_Decode_Interleaved()
+ *
+ * Corrects the code words of a frame one by one, deinterleaved,
+ * as Ecc_Decode() was used by the decoder
+ */
+static void Legacy_Decode_Interleaved(uint8_t *data, bool *ok) {
+    uint8_t word[TX_RS_LEN];
+
+    for (int w = 0; w < ECC_INTERLEAVE; w++) {
+        for (int i = 0; i < TX_RS_LEN; i++)
+            word[i] = data[i * ECC_INTERLEAVE + w];
+        ok[w] = Legacy_Ecc_Decode(word, 0);
+        for (int i = 0; i < TX_RS_LEN; i++)
+            data[i * ECC_INTERLEAVE + w] = word[i];
+    }
+}
+
+/*****************************************************************************/
+
+/* __wrap_Ecc_Decode_Interleaved()
+ *
+ * Stands in for Ecc_Decode_Interleaved() in the decoder, linked with
+ * --wrap, and checks it against the legacy decoder on each frame
+ */
+void __wrap_Ecc_Decode_Interleaved(uint8_t *data, bool *ok) {
+    uint8_t ref[TX_DATA_LEN], in[TX_DATA_LEN];
+    bool ref_ok[ECC_INTERLEAVE];
+
+    memcpy(in, data, TX_DATA_LEN);
+    memcpy(ref, data, TX_DATA_LEN);
+    Legacy_Decode_Interleaved(ref, ref_ok);
+    __real_Ecc_Decode_Interleaved(data, ok);
+
+    stream_frames++;
+    if (memcmp(ref, data, TX_DATA_LEN) ||
+            memcmp(ref_ok, ok, sizeof(ref_ok)))
+        stream_mismatches++;
+
+    for (int w = 0; w < ECC_INTERLEAVE; w++)
+        for (int i = w; i < TX_DATA_LEN; i += ECC_INTERLEAVE)
+            if (ok[w] && (in[i] != data[i])) {
+                stream_corrected++;
+                break;
+            }
+}
+
+/*****************************************************************************/
+
+/* Test_Errors()
+ *
+ * Decodes frames with errors at random places in each of their code
+ * words, by both decoders, the n-th count tested. Up to TEST_MAX_ERRORS
+ * all must be corrected. Frames decoded by the plain kernels are kept,
+ * or else those of other kernels must match them
+ */
+static bool Test_Errors(int errors, int n, bool plain) {
+    uint8_t sent[TX_DATA_LEN], data[TX_DATA_LEN], ref[TX_DATA_LEN];
+    uint8_t cadu[TX_CADU_LEN];
+    bool ok[ECC_INTERLEAVE], ref_ok[ECC_INTERLEAVE];
+    int mismatches = 0, failed = 0, wrong = 0, kernel = 0;
+    bool pass;
+
+    Tx_Seed(0x5DEECE66DULL + (uint64_t)errors);
+
+    for (int f = 0; f < TEST_FRAMES; f++) {
+        Tx_Frame(f, sent, cadu);
+        memcpy(data, sent, TX_DATA_LEN);
+
+        for (int w = 0; w < ECC_INTERLEAVE; w++) {
+            bool hit[TX_RS_LEN] = { false };
+
+            for (int e = 0; e < errors; e++) {
+                int i;
+
+                do
+                    i = (int)(Tx_Rand() % TX_RS_LEN);
+                while (hit[i]);
+                hit[i] = true;
+                data[i * ECC_INTERLEAVE + w] ^= (uint8_t)(1 + Tx_Rand() % 255);
+            }
+        }
+
+        memcpy(ref, data, TX_DATA_LEN);
+        Legacy_Decode_Interleaved(ref, ref_ok);
+        Ecc_Decode_Interleaved(data, ok);
+
+        if (memcmp(ref, data, TX_DATA_LEN) || memcmp(ref_ok, ok, sizeof(ok)))
+            mismatches++;
+
+        if (plain) {
+            memcpy(plain_data[n][f], data, TX_DATA_LEN);
+            memcpy(plain_ok[n][f], ok, sizeof(ok));
+        } else if (memcmp(plain_data[n][f], data, TX_DATA_LEN) ||
+                memcmp(plain_ok[n][f], ok, sizeof(ok)))
+            kernel++;
+
+        for (int w = 0; w < ECC_INTERLEAVE; w++) {
+            bool same = true;
+
+            for (int i = w; i < TX_DATA_LEN; i += ECC_INTERLEAVE)
+                same &= data[i] == sent[i];
+            failed += !ok[w];
+            wrong  += ok[w] && !same;
+        }
+    }
+
+    pass = (mismatches == 0) && (kernel == 0) &&
+        ((errors > TEST_MAX_ERRORS) || ((failed == 0) && (wrong == 0)));
+    printf("  %3d errors per word: %4d words failed, %4d miscorrected, "
+            "%d frames differ, %d from plain: %s\n", errors, failed, wrong,
+            mismatches, kernel, pass ? "pass" : "FAIL");
+
+    return pass;
+}
+
+/*****************************************************************************/
+
+/* Tx_Stream()
+ *
+ * Writes the soft symbols of frames encoded as a stream
+ * to a temporary file. Returns it rewound
+ */
+static FILE *Tx_Stream(void) {
+    uint8_t data[TX_DATA_LEN], cadu[TX_CADU_LEN], code[TX_CODE_LEN];
+    int8_t soft[TX_CODE_LEN];
+    uint32_t sh = 0;
+    FILE *fp = tmpfile();
+
+    if (fp == NULL)
+        return NULL;
+
+    Tx_Seed(0x2545F4914F6CDD1DULL);
+    for (int f = 0; f < TEST_STREAM_FRAMES; f++) {
+        Tx_Frame(f, data, cadu);
+        Tx_Encode(cadu, &sh, code);
+        Tx_Soft(code, TX_CODE_LEN, TEST_SOFT_AMP, TEST_SOFT_SIGMA, soft);
+        fwrite(soft, 1, TX_CODE_LEN, fp);
+    }
+
+    rewind(fp);
+
+    return fp;
+}
+
+/*****************************************************************************/
+
+/* Decode_Stream()
+ *
+ * Decodes a soft symbol stream as Frame_Queue_Decoder(),
+ * the RS decoders checked against each other by the wrapper
+ */
+static bool Decode_Stream(FILE *fp, const char *name) {
+    static mtd_rec_t mtd;
+    static uint8_t soft_buf[3 * SOFT_FRAME_LEN];
+    int decoded = 0;
+    bool pass;
+
+    Mtd_Init(&mtd);
+    memset(soft_buf, 0, sizeof(soft_buf));
+    stream_frames = stream_corrected = stream_mismatches = 0;
+
+    while (fread(soft_buf + 2 * SOFT_FRAME_LEN, 1, SOFT_FRAME_LEN, fp) ==
+            SOFT_FRAME_LEN) {
+        memmove(soft_buf, soft_buf + SOFT_FRAME_LEN, 2 * SOFT_FRAME_LEN);
+
+        while (mtd.pos < SOFT_FRAME_LEN)
+            decoded += Mtd_One_Frame(&mtd, soft_buf);
+
+        mtd.pos      -= SOFT_FRAME_LEN;
+        mtd.prev_pos -= SOFT_FRAME_LEN;
+    }
+
+    pass = (stream_mismatches == 0) && (stream_corrected > 0);
+    printf("  %s: %d frames decoded of %d tried, %d words corrected, "
+            "%d frames differ: %s\n", name, decoded, stream_frames,
+            stream_corrected, stream_mismatches, pass ? "pass" : "FAIL");
+
+    return pass;
+}
+
+/*****************************************************************************/
+
+/* main()
+ *
+ * Tests the plain syndrome and Chien search kernels, then the SSSE3
+ * ones and those of the highest SIMD level of the CPU, if others, on
+ * synthetic frames and the stream of a file given, or a synthetic one
+ */
+int main(int argc, char *argv[]) {
+    static const int excess[] = TEST_EXCESS_ERRORS;
+    static const uint8_t levels[] = {
+        CPU_SIMD_NONE, CPU_SIMD_SSSE3, CPU_SIMD_MAX };
+    uint8_t last = CPU_SIMD_MAX + 1;
+    bool ok = true;
+
+    Tx_Init();
+    Init_Correlator_Tables();
+
+    for (size_t l = 0; l < sizeof(levels); l++) {
+        FILE *fp;
+        int n = 0;
+
+        Cpu_Init(levels[l]);
+        if (Cpu_Simd() == last)
+            continue;
+        last = Cpu_Simd();
+        Init_Ecc_Tables();
+
+        printf("RS decoder of SIMD level %s:\n", Cpu_Simd_Name(last));
+        for (int e = 0; e <= TEST_MAX_ERRORS; e++)
+            ok &= Test_Errors(e, n++, l == 0);
+        for (size_t e = 0; e < sizeof(excess) / sizeof(excess[0]); e++)
+            ok &= Test_Errors(excess[e], n++, l == 0);
+
+        fp = (argc > 1) ? fopen(argv[1], "rb") : Tx_Stream();
+        if (fp == NULL) {
+            perror((argc > 1) ? argv[1] : "soft symbol stream");
+            return EXIT_FAILURE;
+        }
+        ok &= Decode_Stream(fp, (argc > 1) ? argv[1] : "synthetic stream");
+        fclose(fp);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
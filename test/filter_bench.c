@@ -0,0 +1,125 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Benchmark of the I/Q filters, a cascade of second order sections
+ * filtering I and Q in one pass, against the direct form Chebyshev
+ * filter they replaced, run once for I and once for Q */
+
+#include "../src/common/common.h"
+#include "../src/sdr/filters.h"
+#include "legacy.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*****************************************************************************/
+
+/* Samples per block, as IQ_File_Read(), blocks of samples,
+ * and passes over them. The passband gain of the filters peaks
+ * above 1, so samples grow as the passes filter them in place */
+#define BENCH_BLOCK_LEN     16384
+#define BENCH_BLOCKS        64
+#define BENCH_PASSES        8
+
+/* Filters as set up by SoapySDR_Init_Filters() */
+#define BENCH_FILTER_BW     120000
+#define BENCH_SAMPLERATE    300000.0
+#define BENCH_RIPPLE        5.0
+#define BENCH_POLES         6
+
+/*****************************************************************************/
+
+static double Bench_Time(void);
+
+/*****************************************************************************/
+
+/* Bench_Time()
+ *
+ * Monotonic time in seconds
+ */
+static double Bench_Time(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/*****************************************************************************/
+
+/* main()
+ *
+ * Times the direct form filters, then DSP_Filter_IQ(),
+ * on the same blocks of noise
+ */
+int main(void) {
+    static dsp_t buf_i[BENCH_BLOCKS][BENCH_BLOCK_LEN];
+    static dsp_t buf_q[BENCH_BLOCKS][BENCH_BLOCK_LEN];
+    static double ref_i[BENCH_BLOCKS][BENCH_BLOCK_LEN];
+    static double ref_q[BENCH_BLOCKS][BENCH_BLOCK_LEN];
+    filter_data_t filter_i, filter_q;
+    legacy_filter_t legacy_i, legacy_q;
+    double start, check = 0.0;
+
+    if (!Init_Chebyshev_Filter(&filter_i, BENCH_BLOCK_LEN, BENCH_FILTER_BW,
+                BENCH_SAMPLERATE, BENCH_RIPPLE, BENCH_POLES, FILTER_LOWPASS) ||
+            !Init_Chebyshev_Filter(&filter_q, BENCH_BLOCK_LEN, BENCH_FILTER_BW,
+                BENCH_SAMPLERATE, BENCH_RIPPLE, BENCH_POLES, FILTER_LOWPASS))
+        return EXIT_FAILURE;
+
+    Legacy_Filter_Init(&legacy_i, filter_i.cutoff, BENCH_RIPPLE, BENCH_POLES);
+    Legacy_Filter_Init(&legacy_q, filter_i.cutoff, BENCH_RIPPLE, BENCH_POLES);
+
+    srand(1);
+    for (int blk = 0; blk < BENCH_BLOCKS; blk++)
+        for (int n = 0; n < BENCH_BLOCK_LEN; n++) {
+            ref_i[blk][n] = (double)(rand() % 2001 - 1000);
+            ref_q[blk][n] = (double)(rand() % 2001 - 1000);
+            buf_i[blk][n] = (dsp_t)ref_i[blk][n];
+            buf_q[blk][n] = (dsp_t)ref_q[blk][n];
+        }
+
+    start = Bench_Time();
+    for (int p = 0; p < BENCH_PASSES; p++)
+        for (int blk = 0; blk < BENCH_BLOCKS; blk++) {
+            Legacy_Filter(&legacy_i, ref_i[blk], BENCH_BLOCK_LEN);
+            Legacy_Filter(&legacy_q, ref_q[blk], BENCH_BLOCK_LEN);
+            check += ref_i[blk][p] + ref_q[blk][p];
+        }
+    printf("direct form filter, I and Q: %6.1f us per block\n",
+            (Bench_Time() - start) / (BENCH_PASSES * BENCH_BLOCKS) * 1e6);
+
+    start = Bench_Time();
+    for (int p = 0; p < BENCH_PASSES; p++)
+        for (int blk = 0; blk < BENCH_BLOCKS; blk++) {
+            filter_i.samples_buf = buf_i[blk];
+            filter_q.samples_buf = buf_q[blk];
+            DSP_Filter_IQ(&filter_i, &filter_q);
+            check += (double)buf_i[blk][p] + (double)buf_q[blk][p];
+        }
+    printf("second order sections, I/Q: %6.1f us per block\n",
+            (Bench_Time() - start) / (BENCH_PASSES * BENCH_BLOCKS) * 1e6);
+
+    Deinit_Chebyshev_Filter(&filter_i);
+    Deinit_Chebyshev_Filter(&filter_q);
+
+    /* Keeps the outputs live */
+    printf("checksum %.3g\n", check);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Equivalence test of the I/Q filters, a cascade of second order
+ * sections, against the direct form Chebyshev filter they replaced,
+ * on noise and tones over blocks of samples, with the states of the
+ * filters carried from block to block as by the demodulator */
+
+#include "../src/common/common.h"
+#include "../src/sdr/filters.h"
+#include "legacy.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*****************************************************************************/
+
+/* Samples per block, as IQ_File_Read(), and blocks filtered */
+#define TEST_BLOCK_LEN      16384
+#define TEST_BLOCKS         16
+
+/* Ripple of the filters, as in SoapySDR.c */
+#define TEST_RIPPLE         5.0
+
+/* Largest deviation from the direct form filter, relative to the RMS
+ * of its output. The direct form loses precision of its coefficients
+ * as poles are added, the cascade does not, so this is met up to 8
+ * poles but not by the 16 poles Init_Chebyshev_Filter() accepts */
+#define TEST_MAX_DEVIATION  1e-9
+
+/*****************************************************************************/
+
+static bool Test_Filter(uint32_t filter_bw, double sample_rate, uint32_t npoles);
+
+/*****************************************************************************/
+
+/* Buffers of the I/Q filters and of the direct form filters */
+static dsp_t buf_i[TEST_BLOCK_LEN], buf_q[TEST_BLOCK_LEN];
+static double ref_i[TEST_BLOCK_LEN], ref_q[TEST_BLOCK_LEN];
+
+/*****************************************************************************/
+
+/* Test_Filter()
+ *
+ * Filters the same samples through Init_Chebyshev_Filter() and
+ * DSP_Filter_IQ(), and through the direct form filters
+ */
+static bool Test_Filter(uint32_t filter_bw, double sample_rate, uint32_t npoles) {
+    filter_data_t filter_i, filter_q;
+    legacy_filter_t legacy_i, legacy_q;
+    double peak = 0.0, sum_sqr = 0.0;
+    bool ok;
+
+    if (!Init_Chebyshev_Filter(&filter_i, TEST_BLOCK_LEN, filter_bw,
+                sample_rate, TEST_RIPPLE, npoles, FILTER_LOWPASS) ||
+            !Init_Chebyshev_Filter(&filter_q, TEST_BLOCK_LEN, filter_bw,
+                sample_rate, TEST_RIPPLE, npoles, FILTER_LOWPASS))
+        return false;
+    filter_i.samples_buf = buf_i;
+    filter_q.samples_buf = buf_q;
+
+    /* The cutoff as Init_Chebyshev_Filter() has it */
+    Legacy_Filter_Init(&legacy_i, filter_i.cutoff, TEST_RIPPLE, npoles);
+    Legacy_Filter_Init(&legacy_q, filter_i.cutoff, TEST_RIPPLE, npoles);
+
+    srand(1);
+
+    for (int blk = 0; blk < TEST_BLOCKS; blk++) {
+        /* Noise and a tone in the passband and one in the stopband */
+        for (int n = 0; n < TEST_BLOCK_LEN; n++) {
+            double t = (double)(blk * TEST_BLOCK_LEN + n) / sample_rate;
+
+            ref_i[n] = 1000.0 * cos(M_2PI * 20000.0 * t) +
+                300.0 * cos(M_2PI * 0.4 * sample_rate * t) +
+                (double)(rand() % 2001 - 1000);
+            ref_q[n] = 1000.0 * sin(M_2PI * 20000.0 * t) +
+                300.0 * sin(M_2PI * 0.4 * sample_rate * t) +
+                (double)(rand() % 2001 - 1000);
+            buf_i[n] = (dsp_t)ref_i[n];
+            buf_q[n] = (dsp_t)ref_q[n];
+        }
+
+        DSP_Filter_IQ(&filter_i, &filter_q);
+        Legacy_Filter(&legacy_i, ref_i, TEST_BLOCK_LEN);
+        Legacy_Filter(&legacy_q, ref_q, TEST_BLOCK_LEN);
+
+        for (int n = 0; n < TEST_BLOCK_LEN; n++) {
+            peak = fmax(peak, fabs((double)buf_i[n] - ref_i[n]));
+            peak = fmax(peak, fabs((double)buf_q[n] - ref_q[n]));
+            sum_sqr += ref_i[n] * ref_i[n] + ref_q[n] * ref_q[n];
+        }
+    }
+
+    Deinit_Chebyshev_Filter(&filter_i);
+    Deinit_Chebyshev_Filter(&filter_q);
+
+    peak /= sqrt(sum_sqr / (2.0 * TEST_BLOCKS * TEST_BLOCK_LEN));
+    ok = peak <= TEST_MAX_DEVIATION;
+    printf("  %2u poles, bandwidth %6u at %6.0f S/s: deviation %.1e: %s\n",
+            npoles, filter_bw, sample_rate, peak, ok ? "pass" : "FAIL");
+
+    return ok;
+}
+
+/*****************************************************************************/
+
+/* main()
+ *
+ * Tests the filters of the demodulator sample rates
+ * and bandwidths of the config files, in 2 to 8 poles
+ */
+int main(void) {
+    static const uint32_t poles[] = { 2, 4, 6, 8 };
+    bool ok = true;
+
+    printf("I/Q filters against the direct form filter:\n");
+    for (size_t p = 0; p < sizeof(poles) / sizeof(poles[0]); p++) {
+        ok &= Test_Filter(110000, 288000.0, poles[p]);
+        ok &= Test_Filter(120000, 300000.0, poles[p]);
+        ok &= Test_Filter(140000, 480000.0, poles[p]);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
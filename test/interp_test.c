@@ -0,0 +1,146 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Test of the polyphase interpolating RRC filter of the demodulator
+ * against the full length RRC filter it replaced, fed each input
+ * sample factor times. On noise in blocks of random lengths, both
+ * must agree within TEST_TOLERANCE of the largest output, for the
+ * orders and interpolation factors in use and some odd ones */
+
+#include "../src/common/common.h"
+#include "../src/common/cpu.h"
+#include "../src/demodulator/filters.h"
+#include "legacy.h"
+#include "tx.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*****************************************************************************/
+
+/* Input samples, and the largest block filtered at once */
+#define TEST_SAMPLES        100000
+#define TEST_MAX_BLOCK      1000
+
+/* Filter orders and interpolation factors tested, the default
+ * first, and the samples per symbol and roll off of Meteor-M2,
+ * from 1.024 MS/s of the SDR decimated by 4 */
+#define TEST_ORDERS         { 32, 32, 32, 32, 16, 48 }
+#define TEST_FACTORS        { 4,  1,  2,  8,  3,  5  }
+#define TEST_OSF            (256000.0 / 72000.0)
+#define TEST_ALPHA          0.6
+
+/* Largest error allowed relative to the largest output: the
+ * sums are of other lengths and order, and of float taps and
+ * samples in the single precision build */
+#ifdef GLRPT_FLOAT_DSP
+#define TEST_TOLERANCE      1e-6
+#else
+#define TEST_TOLERANCE      1e-13
+#endif
+
+/*****************************************************************************/
+
+static bool Test_Filter(uint32_t order, uint32_t factor);
+
+/*****************************************************************************/
+
+/* Input samples */
+static dsp_t in_i[TEST_SAMPLES], in_q[TEST_SAMPLES];
+
+/*****************************************************************************/
+
+/* Test_Filter()
+ *
+ * Filters the input through both filters of order and factor,
+ * in blocks of random lengths through the polyphase one
+ */
+static bool Test_Filter(uint32_t order, uint32_t factor) {
+    Filter_t *flt = Filter_RRC(order, factor, TEST_OSF, TEST_ALPHA);
+    legacy_rrc_t legacy;
+    double err = 0.0, peak = 0.0;
+    uint32_t len;
+    bool pass;
+
+    Legacy_Rrc_Init(&legacy, order, factor, TEST_OSF, TEST_ALPHA);
+
+    Tx_Seed(2);
+    for (uint32_t idx = 0; idx < TEST_SAMPLES; idx += len) {
+        const cdsp_t *out;
+
+        len = 1 + Tx_Rand() % TEST_MAX_BLOCK;
+        if (len > TEST_SAMPLES - idx)
+            len = TEST_SAMPLES - idx;
+        out = Filter_Interp(flt, in_i + idx, in_q + idx, len);
+
+        for (uint32_t n = 0; n < len; n++) {
+            complex double in = in_i[idx + n] + in_q[idx + n] * I;
+
+            for (uint32_t p = 0; p < factor; p++) {
+                complex double ref = Legacy_Rrc_Fwd(&legacy, in);
+
+                err  = fmax(err, cabs(out[n * factor + p] - ref));
+                peak = fmax(peak, cabs(ref));
+            }
+        }
+    }
+
+    pass = err <= TEST_TOLERANCE * peak;
+    printf("  order %2u, factor %u: error %.2e of peak %.1f: %s\n",
+            order, factor, err, peak, pass ? "pass" : "FAIL");
+
+    Legacy_Rrc_Free(&legacy);
+    Filter_Free(flt);
+
+    return pass;
+}
+
+/*****************************************************************************/
+
+/* main()
+ *
+ * Tests the plain sub-filters and the kernels of each
+ * SIMD level of the CPU on the same input
+ */
+int main(void) {
+    static const uint32_t orders[] = TEST_ORDERS;
+    static const uint32_t factors[] = TEST_FACTORS;
+    uint8_t last = CPU_SIMD_MAX + 1;
+    bool ok = true;
+
+    Tx_Seed(1);
+    for (int idx = 0; idx < TEST_SAMPLES; idx++) {
+        in_i[idx] = (dsp_t)(100.0 * Tx_Gauss());
+        in_q[idx] = (dsp_t)(100.0 * Tx_Gauss());
+    }
+
+    for (uint8_t level = CPU_SIMD_NONE; level <= CPU_SIMD_MAX; level++) {
+        Cpu_Init(level);
+        if (Cpu_Simd() == last)
+            continue;
+        last = Cpu_Simd();
+
+        printf("RRC interpolator of SIMD level %s:\n", Cpu_Simd_Name(last));
+        for (size_t f = 0; f < sizeof(orders) / sizeof(orders[0]); f++)
+            ok &= Test_Filter(orders[f], factors[f]);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,636 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* The DSP and decoder kernels as they were before they were
+ * rewritten for speed, kept as the references of the tests
+ * and benchmarks of the kernels that replaced them */
+
+#include "legacy.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************************/
+
+/* Field tables of the RS(255,223) decoder, as in ecc.c */
+static const uint8_t legacy_alpha[256] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+    0x87, 0x89, 0x95, 0xad, 0xdd, 0x3d, 0x7a, 0xf4,
+    0x6f, 0xde, 0x3b, 0x76, 0xec, 0x5f, 0xbe, 0xfb,
+    0x71, 0xe2, 0x43, 0x86, 0x8b, 0x91, 0xa5, 0xcd,
+    0x1d, 0x3a, 0x74, 0xe8, 0x57, 0xae, 0xdb, 0x31,
+    0x62, 0xc4, 0x0f, 0x1e, 0x3c, 0x78, 0xf0, 0x67,
+    0xce, 0x1b, 0x36, 0x6c, 0xd8, 0x37, 0x6e, 0xdc,
+    0x3f, 0x7e, 0xfc, 0x7f, 0xfe, 0x7b, 0xf6, 0x6b,
+    0xd6, 0x2b, 0x56, 0xac, 0xdf, 0x39, 0x72, 0xe4,
+    0x4f, 0x9e, 0xbb, 0xf1, 0x65, 0xca, 0x13, 0x26,
+    0x4c, 0x98, 0xb7, 0xe9, 0x55, 0xaa, 0xd3, 0x21,
+    0x42, 0x84, 0x8f, 0x99, 0xb5, 0xed, 0x5d, 0xba,
+    0xf3, 0x61, 0xc2, 0x03, 0x06, 0x0c, 0x18, 0x30,
+    0x60, 0xc0, 0x07, 0x0e, 0x1c, 0x38, 0x70, 0xe0,
+    0x47, 0x8e, 0x9b, 0xb1, 0xe5, 0x4d, 0x9a, 0xb3,
+    0xe1, 0x45, 0x8a, 0x93, 0xa1, 0xc5, 0x0d, 0x1a,
+    0x34, 0x68, 0xd0, 0x27, 0x4e, 0x9c, 0xbf, 0xf9,
+    0x75, 0xea, 0x53, 0xa6, 0xcb, 0x11, 0x22, 0x44,
+    0x88, 0x97, 0xa9, 0xd5, 0x2d, 0x5a, 0xb4, 0xef,
+    0x59, 0xb2, 0xe3, 0x41, 0x82, 0x83, 0x81, 0x85,
+    0x8d, 0x9d, 0xbd, 0xfd, 0x7d, 0xfa, 0x73, 0xe6,
+    0x4b, 0x96, 0xab, 0xd1, 0x25, 0x4a, 0x94, 0xaf,
+    0xd9, 0x35, 0x6a, 0xd4, 0x2f, 0x5e, 0xbc, 0xff,
+    0x79, 0xf2, 0x63, 0xc6, 0x0b, 0x16, 0x2c, 0x58,
+    0xb0, 0xe7, 0x49, 0x92, 0xa3, 0xc1, 0x05, 0x0a,
+    0x14, 0x28, 0x50, 0xa0, 0xc7, 0x09, 0x12, 0x24,
+    0x48, 0x90, 0xa7, 0xc9, 0x15, 0x2a, 0x54, 0xa8,
+    0xd7, 0x29, 0x52, 0xa4, 0xcf, 0x19, 0x32, 0x64,
+    0xc8, 0x17, 0x2e, 0x5c, 0xb8, 0xf7, 0x69, 0xd2,
+    0x23, 0x46, 0x8c, 0x9f, 0xb9, 0xf5, 0x6d, 0xda,
+    0x33, 0x66, 0xcc, 0x1f, 0x3e, 0x7c, 0xf8, 0x77,
+    0xee, 0x5b, 0xb6, 0xeb, 0x51, 0xa2, 0xc3, 0x00
+};
+
+static const uint8_t legacy_indx[256] = {
+    255, 0, 1, 99, 2, 198, 100, 106,
+    3, 205, 199, 188, 101, 126, 107, 42,
+    4, 141, 206, 78, 200, 212, 189, 225,
+    102, 221, 127, 49, 108, 32, 43, 243,
+    5, 87, 142, 232, 207, 172, 79, 131,
+    201, 217, 213, 65, 190, 148, 226, 180,
+    103, 39, 222, 240, 128, 177, 50, 53,
+    109, 69, 33, 18, 44, 13, 244, 56,
+    6, 155, 88, 26, 143, 121, 233, 112,
+    208, 194, 173, 168, 80, 117, 132, 72,
+    202, 252, 218, 138, 214, 84, 66, 36,
+    191, 152, 149, 249, 227, 94, 181, 21,
+    104, 97, 40, 186, 223, 76, 241, 47,
+    129, 230, 178, 63, 51, 238, 54, 16,
+    110, 24, 70, 166, 34, 136, 19, 247,
+    45, 184, 14, 61, 245, 164, 57, 59,
+    7, 158, 156, 157, 89, 159, 27, 8,
+    144, 9, 122, 28, 234, 160, 113, 90,
+    209, 29, 195, 123, 174, 10, 169, 145,
+    81, 91, 118, 114, 133, 161, 73, 235,
+    203, 124, 253, 196, 219, 30, 139, 210,
+    215, 146, 85, 170, 67, 11, 37, 175,
+    192, 115, 153, 119, 150, 92, 250, 82,
+    228, 236, 95, 74, 182, 162, 22, 134,
+    105, 197, 98, 254, 41, 125, 187, 204,
+    224, 211, 77, 140, 242, 31, 48, 220,
+    130, 171, 231, 86, 179, 147, 64, 216,
+    52, 176, 239, 38, 55, 12, 17, 68,
+    111, 120, 25, 154, 71, 116, 167, 193,
+    35, 83, 137, 251, 20, 93, 248, 151,
+    46, 75, 185, 96, 15, 237, 62, 229,
+    246, 135, 165, 23, 58, 163, 60, 183
+};
+
+/*****************************************************************************/
+
+/* Legacy_Filter_Init()
+ *
+ * Calculates the coefficients of a Chebyshev low pass filter in direct
+ * form, as Init_Chebyshev_Filter() did, cutoff a fraction of sample rate
+ */
+void Legacy_Filter_Init(
+        legacy_filter_t *filter,
+        double cutoff,
+        double ripple,
+        uint32_t npoles) {
+    double ta[LEGACY_MAX_POLES + 3], tb[LEGACY_MAX_POLES + 3];
+    double a0, a1, a2, b1, b2, sa, sb, gain;
+    double rp, ip, es, vx, kx, t, w, m;
+    double d, xn0, xn1, xn2, yn1, yn2, k, tmp;
+    int np = (int)npoles;
+
+    memset(filter, 0, sizeof(legacy_filter_t));
+    filter->npoles = npoles;
+    filter->a[2] = 1.0;
+    filter->b[2] = 1.0;
+
+    /* S-domain to Z-domain conversion, and low pass to low pass transform */
+    t = 2.0 * tan(0.5);
+    w = 2.0 * M_PI * cutoff;
+    k = sin((1.0 - w) / 2.0) / sin((1.0 + w) / 2.0);
+
+    /* Find coefficients for 2-pole filter for each pole pair */
+    for (int p = 1; p <= np / 2; p++) {
+        tmp = M_PI / (double)np / 2.0 + (double)(p - 1) * M_PI / (double)np;
+        rp  = -cos(tmp);
+        ip  =  sin(tmp);
+
+        /* Wrap from a circle to an ellipse */
+        if (ripple > 0.0) {
+            tmp = 100.0 / (100.0 - ripple);
+            es  = sqrt(tmp * tmp - 1.0);
+            tmp = 1.0 / (double)np;
+            vx  = tmp * asinh(1.0 / es);
+            kx  = cosh(tmp * acosh(1.0 / es));
+            rp *= sinh(vx) / kx;
+            ip *= cosh(vx) / kx;
+        }
+
+        m = rp * rp + ip * ip;
+        d = 4.0 - 4.0 * rp * t + m * t * t;
+        xn0 = t * t / d;
+        xn1 = 2.0 * t * t / d;
+        xn2 = t * t / d;
+        yn1 = (8.0 - 2.0 * m * t * t) / d;
+        yn2 = (-4.0 - 4.0 * rp * t - m * t * t) / d;
+
+        d  = 1.0 + yn1 * k - yn2 * k * k;
+        a0 = (xn0 - xn1 * k + xn2 * k * k) / d;
+        a1 = (-2.0 * xn0 * k + xn1 + xn1 * k * k - 2.0 * xn2 * k) / d;
+        a2 = (xn0 * k * k - xn1 * k + xn2) / d;
+        b1 = (2.0 * k + yn1 + yn1 * k * k - 2.0 * yn2 * k) / d;
+        b2 = (-k * k - yn1 * k + yn2) / d;
+
+        /* Add coefficients to the cascade */
+        memcpy(ta, filter->a, sizeof(ta));
+        memcpy(tb, filter->b, sizeof(tb));
+        for (int i = 2; i <= np + 2; i++) {
+            filter->a[i] = a0 * ta[i] + a1 * ta[i - 1] + a2 * ta[i - 2];
+            filter->b[i] =      tb[i] - b1 * tb[i - 1] - b2 * tb[i - 2];
+        }
+    }
+
+    /* Finish combining coefficients and normalize the gain */
+    filter->b[2] = 0.0;
+    for (int i = 0; i <= np; i++) {
+        filter->a[i] =  filter->a[i + 2];
+        filter->b[i] = -filter->b[i + 2];
+    }
+
+    sa = 0.0;
+    sb = 0.0;
+    for (int i = 0; i <= np; i++) {
+        sa += filter->a[i];
+        sb += filter->b[i];
+    }
+
+    gain = sa / (1.0 - sb);
+    for (int i = 0; i <= np; i++)
+        filter->a[i] /= gain;
+}
+
+/*****************************************************************************/
+
+/* Legacy_Filter()
+ *
+ * Filters a buffer in place through the direct form filter,
+ * with its past samples in ring buffers, as DSP_Filter() did
+ */
+void Legacy_Filter(legacy_filter_t *filter, double *buf, uint32_t len) {
+    uint32_t npp1 = filter->npoles + 1;
+
+    for (uint32_t n = 0; n < len; n++) {
+        double yn0 = buf[n] * filter->a[0];
+
+        for (uint32_t i = 1; i < npp1; i++) {
+            yn0 += filter->a[i] * filter->x[filter->ring_idx];
+            yn0 += filter->b[i] * filter->y[filter->ring_idx];
+
+            filter->ring_idx++;
+            if (filter->ring_idx >= npp1)
+                filter->ring_idx = 0;
+        }
+
+        filter->y[filter->ring_idx] = yn0;
+        filter->x[filter->ring_idx] = buf[n];
+        buf[n] = yn0;
+    }
+}
+
+/*****************************************************************************/
+
+/* Legacy_Ecc_Decode()
+ *
+ * Corrects in place a RS(255,223) code word of 255 - pad symbols,
+ * as Ecc_Decode() did: syndromes by Horner's rule, Berlekamp-Massey,
+ * Chien search and Forney, with every sum of logs reduced by modulo.
+ * Returns false if it has more errors than can be corrected
+ */
+bool Legacy_Ecc_Decode(uint8_t *data, int pad) {
+    const uint8_t *alpha = legacy_alpha, *indx = legacy_indx;
+    int i, j, r, k, deg_lambda, el, deg_omega, syn_error, result;
+    uint8_t q, tmp, num1, num2, den, discr_r;
+    uint8_t lambda[33], b[33], reg[33], t[33], omega[33];
+    uint8_t root[32], s[32], loc[32];
+
+    for (i = 0; i < 32; i++)
+        s[i] = data[0];
+    for (j = 1; j < 255 - pad; j++)
+        for (i = 0; i < 32; i++)
+            if (s[i] == 0)
+                s[i] = data[j];
+            else
+                s[i] = data[j] ^ alpha[(indx[s[i]] + (112 + i) * 11) % 255];
+
+    syn_error = 0;
+    for (i = 0; i < 32; i++) {
+        syn_error |= s[i];
+        s[i] = indx[s[i]];
+    }
+    if (syn_error == 0)
+        return true;
+
+    memset(&lambda[1], 0, 32);
+    lambda[0] = 1;
+    for (i = 0; i < 33; i++)
+        b[i] = indx[lambda[i]];
+    el = 0;
+
+    for (r = 1; r <= 32; r++) {
+        discr_r = 0;
+        for (i = 0; i < r; i++)
+            if ((lambda[i] != 0) && (s[r - i - 1] != 255))
+                discr_r ^= alpha[(indx[lambda[i]] + s[r - i - 1]) % 255];
+
+        discr_r = indx[discr_r];
+        if (discr_r == 255) {
+            memmove(&b[1], b, 32);
+            b[0] = 255;
+            continue;
+        }
+
+        t[0] = lambda[0];
+        for (i = 0; i < 32; i++)
+            if (b[i] != 255)
+                t[i + 1] = lambda[i + 1] ^ alpha[(discr_r + b[i]) % 255];
+            else
+                t[i + 1] = lambda[i + 1];
+
+        if (2 * el <= r - 1) {
+            el = r - el;
+            for (i = 0; i < 32; i++)
+                if (lambda[i] == 0)
+                    b[i] = 255;
+                else
+                    b[i] = (uint8_t)((indx[lambda[i]] - discr_r + 255) % 255);
+        }
+        else {
+            memmove(&b[1], b, 32);
+            b[0] = 255;
+        }
+        memmove(lambda, t, 33);
+    }
+
+    deg_lambda = 0;
+    for (i = 0; i < 33; i++) {
+        lambda[i] = indx[lambda[i]];
+        if (lambda[i] != 255)
+            deg_lambda = i;
+    }
+
+    /* Chien search */
+    memmove(&reg[1], &lambda[1], 32);
+    result = 0;
+    for (i = 1, k = 115; i <= 255; i++, k = (k + 116) % 255) {
+        q = 1;
+        for (j = deg_lambda; j >= 1; j--)
+            if (reg[j] != 255) {
+                reg[j] = (uint8_t)((reg[j] + j) % 255);
+                q ^= alpha[reg[j]];
+            }
+        if (q != 0)
+            continue;
+
+        root[result] = (uint8_t)i;
+        loc[result]  = (uint8_t)k;
+        if (++result == deg_lambda)
+            break;
+    }
+
+    if (deg_lambda != result)
+        return false;
+
+    /* Forney */
+    deg_omega = deg_lambda - 1;
+    for (i = 0; i <= deg_omega; i++) {
+        tmp = 0;
+        for (j = i; j >= 0; j--)
+            if ((s[i - j] != 255) && (lambda[j] != 255))
+                tmp ^= alpha[(s[i - j] + lambda[j]) % 255];
+        omega[i] = indx[tmp];
+    }
+
+    for (j = result - 1; j >= 0; j--) {
+        num1 = 0;
+        for (i = deg_omega; i >= 0; i--)
+            if (omega[i] != 255)
+                num1 ^= alpha[(omega[i] + i * root[j]) % 255];
+        num2 = alpha[(root[j] * 111 + 255) % 255];
+        den = 0;
+
+        i = (deg_lambda < 31) ? deg_lambda : 31;
+        for (i &= ~1; i >= 0; i -= 2)
+            if (lambda[i + 1] != 255)
+                den ^= alpha[(lambda[i + 1] + i * root[j]) % 255];
+
+        if ((num1 != 0) && (loc[j] >= pad))
+            data[loc[j] - pad] ^=
+                alpha[(indx[num1] + indx[num2] + 255 - indx[den]) % 255];
+    }
+
+    return true;
+}
+
+/*****************************************************************************/
+
+/* Legacy_Boxcar()
+ *
+ * Decimates len interleaved 16 bit I/Q samples by summing factor
+ * of them in double precision, divided by scale, as the SDR thread
+ * did. Returns the number of outputs, len / factor
+ */
+uint32_t Legacy_Boxcar(
+        const int16_t *iq,
+        uint32_t len,
+        uint32_t factor,
+        double scale,
+        double *out_i,
+        double *out_q) {
+    uint32_t cnt = len / factor;
+
+    for (uint32_t n = 0; n < cnt; n++) {
+        double temp_i = 0.0, temp_q = 0.0;
+
+        for (uint32_t k = 0; k < factor; k++) {
+            temp_i += (double)iq[2 * (n * factor + k)];
+            temp_q += (double)iq[2 * (n * factor + k) + 1];
+        }
+
+        out_i[n] = temp_i / scale;
+        out_q[n] = temp_q / scale;
+    }
+
+    return cnt;
+}
+
+/*****************************************************************************/
+
+/* Legacy_Agc_Init()
+ *
+ * Initializes the AGC as Agc_Init() did
+ */
+void Legacy_Agc_Init(legacy_agc_t *agc) {
+    agc->target_ampl = 180.0;
+    agc->average     = 180.0;
+    agc->gain        = 1.0;
+    agc->bias        = 0.0;
+}
+
+/*****************************************************************************/
+
+/* Legacy_Agc_Apply()
+ *
+ * Applies the AGC to a sample as Agc_Apply() did, one sample
+ * at a time with the averages divided by their window sizes
+ */
+complex double Legacy_Agc_Apply(legacy_agc_t *agc, complex double sample) {
+    double rho;
+
+    /* Sliding window average */
+    agc->bias *= 262143.0;
+    agc->bias += sample;
+    agc->bias /= 262144.0;
+    sample    -= agc->bias;
+
+    /* Update the sample magnitude average */
+    rho = sqrt(creal(sample) * creal(sample) + cimag(sample) * cimag(sample));
+    agc->average *= 65535.0;
+    agc->average += rho;
+    agc->average /= 65536.0;
+
+    /* Apply AGC to samples */
+    agc->gain = agc->target_ampl / agc->average;
+    if (agc->gain > 20.0)
+        agc->gain = 20.0;
+
+    return sample * agc->gain;
+}
+
+/*****************************************************************************/
+
+/* Legacy_Rrc_Init()
+ *
+ * Calculates the taps of the RRC filter of order, at factor times
+ * osf samples per symbol, as Filter_RRC() did, Compute_RRC_Coeff()
+ * inlined, and clears its ring buffer
+ */
+void Legacy_Rrc_Init(
+        legacy_rrc_t *rrc,
+        uint32_t order,
+        uint32_t factor,
+        double osf,
+        double alpha) {
+    rrc->count    = order * 2 + 1;
+    rrc->coeff    = calloc(rrc->count, sizeof(double));
+    rrc->memory   = calloc(rrc->count, sizeof(complex double));
+    rrc->ring_idx = 0;
+    osf *= (double)factor;
+
+    for (int idx = 0; idx < (int)rrc->count; idx++) {
+        double t, mpt, at4;
+
+        if (idx == (int)order) {
+            rrc->coeff[idx] = 1.0 - alpha + 4.0 * alpha / M_PI;
+            continue;
+        }
+
+        t   = (double)abs((int)order - idx) / osf;
+        mpt = M_PI * t;
+        at4 = 4.0 * alpha * t;
+        rrc->coeff[idx] =
+            (sin(mpt * (1.0 - alpha)) + at4 * cos(mpt * (1.0 + alpha))) /
+            (mpt * (1.0 - at4 * at4));
+    }
+}
+
+/*****************************************************************************/
+
+/* Legacy_Rrc_Fwd()
+ *
+ * Feeds a sample through the RRC filter as Filter_Fwd() did, the
+ * ring index kept in the filter instead of a function static
+ */
+complex double Legacy_Rrc_Fwd(legacy_rrc_t *rrc, complex double in) {
+    complex double out = 0.0;
+    uint32_t idc = 0;
+    int idm = rrc->ring_idx;
+
+    /* Save input to the ring buffer, then sum the
+     * nodes from it to the end and from the start */
+    rrc->memory[idm] = in;
+    while (idm < (int)rrc->count)
+        out += rrc->memory[idm++] * rrc->coeff[idc++];
+
+    idm = 0;
+    while (idc < rrc->count)
+        out += rrc->memory[idm++] * rrc->coeff[idc++];
+
+    /* Move back in the ring buffer */
+    idm--;
+    if (idm < 0)
+        idm += (int)rrc->count;
+    rrc->ring_idx = idm;
+
+    return out;
+}
+
+/*****************************************************************************/
+
+/* Legacy_Rrc_Free()
+ *
+ * Frees the taps and ring buffer of the RRC filter
+ */
+void Legacy_Rrc_Free(legacy_rrc_t *rrc) {
+    free(rrc->coeff);
+    free(rrc->memory);
+    rrc->coeff  = NULL;
+    rrc->memory = NULL;
+}
+
+/*****************************************************************************/
+
+/* Correlation of a soft symbol with a pattern symbol, 0 or 0xFF,
+ * and patterns rotated and flipped in I/Q, as in correlator.c */
+static int legacy_corr_tab[256][256];
+static uint8_t legacy_rotate_iq_tab[256], legacy_invert_iq_tab[256];
+
+/*****************************************************************************/
+
+/* Legacy_Rotate_IQ_QW()
+ *
+ * Rotates the symbols of a pattern by shift quarter turns
+ */
+static uint64_t Legacy_Rotate_IQ_QW(uint64_t data, int shift) {
+    uint64_t result = 0;
+
+    for (int i = 0; i < LEGACY_PATTERN_CNT; i++) {
+        uint8_t bdata = (uint8_t)((data >> (56 - 8 * i)) & 0xff);
+
+        if ((shift == 1) || (shift == 3))
+            bdata = legacy_rotate_iq_tab[bdata];
+        if ((shift == 2) || (shift == 3))
+            bdata ^= 0xFF;
+        result = (result << 8) | bdata;
+    }
+
+    return result;
+}
+
+/*****************************************************************************/
+
+/* Legacy_Flip_IQ_QW()
+ *
+ * Swaps I and Q of the symbols of a pattern
+ */
+static uint64_t Legacy_Flip_IQ_QW(uint64_t data) {
+    uint64_t result = 0;
+
+    for (int i = 0; i < LEGACY_PATTERN_CNT; i++)
+        result = (result << 8) |
+            legacy_invert_iq_tab[(data >> (56 - 8 * i)) & 0xff];
+
+    return result;
+}
+
+/*****************************************************************************/
+
+/* Legacy_Corr_Set_Patt()
+ *
+ * Sets pattern n to p, a byte per symbol, MSB first
+ */
+static void Legacy_Corr_Set_Patt(legacy_corr_t *c, int n, uint64_t p) {
+    for (int i = 0; i < LEGACY_PATTERN_SIZE; i++)
+        c->patts[i][n] =
+            (((p >> (LEGACY_PATTERN_SIZE - i - 1)) & 1) != 0) ? 0xFF : 0;
+}
+
+/*****************************************************************************/
+
+/* Legacy_Corr_Init()
+ *
+ * Initializes the correlator tables as Init_Correlator_Tables()
+ * did, and the patterns of sync q as Correlator_Init() did
+ */
+void Legacy_Corr_Init(legacy_corr_t *c, uint64_t q) {
+    for (int i = 0; i <= 255; i++) {
+        legacy_rotate_iq_tab[i] =
+            (uint8_t)((((i & 0x55) ^ 0x55) << 1) | ((i & 0xAA) >> 1));
+        legacy_invert_iq_tab[i] =
+            (uint8_t)(((i & 0x55) << 1) | ((i & 0xAA) >> 1));
+
+        for (int j = 0; j <= 255; j++)
+            legacy_corr_tab[i][j] =
+                (int)(((i > 127) && (j == 0)) || ((i <= 127) && (j == 255)));
+    }
+
+    memset(c, 0, sizeof(*c));
+    for (int i = 0; i <= 3; i++)
+        Legacy_Corr_Set_Patt(c, i, Legacy_Rotate_IQ_QW(q, i));
+    for (int i = 0; i <= 3; i++)
+        Legacy_Corr_Set_Patt(c, i + 4,
+                Legacy_Rotate_IQ_QW(Legacy_Flip_IQ_QW(q), i));
+}
+
+/*****************************************************************************/
+
+/* Legacy_Corr_Correlate()
+ *
+ * Correlates the patterns at each offset of len soft symbols a
+ * symbol at a time by table lookups, as Corr_Correlate() did,
+ * stopping at a correlation over 55. Returns the pattern
+ * correlating best, -1 if none does
+ */
+int Legacy_Corr_Correlate(legacy_corr_t *c, const uint8_t *data, uint32_t len) {
+    int result = -1, k = 0;
+
+    memset(c->correlation, 0, sizeof(c->correlation));
+    memset(c->position, 0, sizeof(c->position));
+    memset(c->tmp_corr, 0, sizeof(c->tmp_corr));
+
+    for (int i = 0; (uint32_t)i < (len - LEGACY_PATTERN_SIZE); i++) {
+        for (int n = 0; n < LEGACY_PATTERN_CNT; n++)
+            c->tmp_corr[n] = 0;
+        for (int s = 0; s < LEGACY_PATTERN_SIZE; s++) {
+            const int *d = legacy_corr_tab[data[i + s]];
+
+            for (int n = 0; n < LEGACY_PATTERN_CNT; n++)
+                c->tmp_corr[n] += d[c->patts[s][n]];
+        }
+
+        for (int n = 0; n < LEGACY_PATTERN_CNT; n++)
+            if (c->tmp_corr[n] > c->correlation[n]) {
+                c->correlation[n] = c->tmp_corr[n];
+                c->position[n] = i;
+                c->tmp_corr[n] = 0;
+                if (c->correlation[n] > 55)
+                    return n;
+            }
+    }
+
+    for (int n = 0; n < LEGACY_PATTERN_CNT; n++)
+        if (c->correlation[n] > k) {
+            result = n;
+            k = c->correlation[n];
+        }
+
+    return result;
+}
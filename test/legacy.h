@@ -0,0 +1,102 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+#ifndef TEST_LEGACY_H
+#define TEST_LEGACY_H
+
+/*****************************************************************************/
+
+#include <complex.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*****************************************************************************/
+
+/* Max poles of the direct form Chebyshev filter */
+#define LEGACY_MAX_POLES    16
+
+/* Soft symbols of a sync pattern, and patterns */
+#define LEGACY_PATTERN_SIZE 64
+#define LEGACY_PATTERN_CNT  8
+
+/*****************************************************************************/
+
+/* Chebyshev filter in direct form, its coefficients and ring buffers */
+typedef struct legacy_filter_t {
+    double a[LEGACY_MAX_POLES + 3], b[LEGACY_MAX_POLES + 3];
+    double x[LEGACY_MAX_POLES + 1], y[LEGACY_MAX_POLES + 1];
+    uint32_t npoles, ring_idx;
+} legacy_filter_t;
+
+/* AGC of the demodulator, with its averages and gain */
+typedef struct legacy_agc_t {
+    double average;
+    double gain;
+    double target_ampl;
+    complex double bias;
+} legacy_agc_t;
+
+/* RRC filter of the demodulator, fed factor times per
+ * input sample, its taps and ring buffer of inputs */
+typedef struct legacy_rrc_t {
+    complex double *memory;
+    double *coeff;
+    uint32_t count;
+    int ring_idx;
+} legacy_rrc_t;
+
+/* Correlator of the sync patterns, a byte per pattern symbol */
+typedef struct legacy_corr_t {
+    uint8_t patts[LEGACY_PATTERN_SIZE][LEGACY_PATTERN_CNT];
+
+    int
+        correlation[LEGACY_PATTERN_CNT],
+        tmp_corr[LEGACY_PATTERN_CNT],
+        position[LEGACY_PATTERN_CNT];
+} legacy_corr_t;
+
+/*****************************************************************************/
+
+void Legacy_Filter_Init(
+        legacy_filter_t *filter,
+        double cutoff,
+        double ripple,
+        uint32_t npoles);
+void Legacy_Filter(legacy_filter_t *filter, double *buf, uint32_t len);
+bool Legacy_Ecc_Decode(uint8_t *data, int pad);
+uint32_t Legacy_Boxcar(
+        const int16_t *iq,
+        uint32_t len,
+        uint32_t factor,
+        double scale,
+        double *out_i,
+        double *out_q);
+void Legacy_Agc_Init(legacy_agc_t *agc);
+complex double Legacy_Agc_Apply(legacy_agc_t *agc, complex double sample);
+void Legacy_Rrc_Init(
+        legacy_rrc_t *rrc,
+        uint32_t order,
+        uint32_t factor,
+        double osf,
+        double alpha);
+complex double Legacy_Rrc_Fwd(legacy_rrc_t *rrc, complex double in);
+void Legacy_Rrc_Free(legacy_rrc_t *rrc);
+void Legacy_Corr_Init(legacy_corr_t *c, uint64_t q);
+int Legacy_Corr_Correlate(legacy_corr_t *c, const uint8_t *data, uint32_t len);
+
+/*****************************************************************************/
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Benchmark of the NCOs of the Costas loop mixing samples, the
+ * table NCO and the cexp() one, and of mixing by sin() and cos()
+ * of a wrapped phase for comparison */
+
+#include "../src/common/common.h"
+#include "../src/demodulator/pll.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*****************************************************************************/
+
+/* Samples mixed per run, runs of which the best is taken
+ * on a noisy machine, and the NCO frequency in rad per sample */
+#define BENCH_SAMPLES       (1 << 22)
+#define BENCH_RUNS          5
+#define BENCH_FREQ          0.0173
+
+/*****************************************************************************/
+
+static double Bench_Time(void);
+static double Bench_Costas(uint8_t type, cdsp_t *check);
+static double Bench_Sin_Cos(cdsp_t *check);
+
+/*****************************************************************************/
+
+/* Bench_Time()
+ *
+ * Monotonic time in seconds
+ */
+static double Bench_Time(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/*****************************************************************************/
+
+/* Bench_Costas()
+ *
+ * Best time in seconds of mixing the samples by Costas_Mix()
+ * with an NCO of type, the outputs summed into check
+ */
+static double Bench_Costas(uint8_t type, cdsp_t *check) {
+    Costas_t *costas = Costas_Init(0.01, QPSK, type);
+    double best = INFINITY;
+
+    /* Set as Costas_Correct_Phase() does */
+    costas->nco_freq = BENCH_FREQ;
+    costas->nco_step = (int32_t)lrint(BENCH_FREQ * 4294967296.0 / M_2PI);
+
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        cdsp_t samp = 1.0 + 0.5 * I;
+        double start = Bench_Time();
+
+        for (int n = 0; n < BENCH_SAMPLES; n++) {
+            *check += Costas_Mix(costas, samp);
+            samp = -samp;
+        }
+        best = fmin(best, Bench_Time() - start);
+    }
+
+    Costas_Free(costas);
+
+    return best;
+}
+
+/*****************************************************************************/
+
+/* Bench_Sin_Cos()
+ *
+ * Best time in seconds of mixing the samples by sin() and cos()
+ * of a phase wrapped by fmod(), the outputs summed into check
+ */
+static double Bench_Sin_Cos(cdsp_t *check) {
+    double best = INFINITY;
+
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        cdsp_t samp = 1.0 + 0.5 * I;
+        double phase = 0.0, start = Bench_Time();
+
+        for (int n = 0; n < BENCH_SAMPLES; n++) {
+            *check += samp * (cos(phase) - sin(phase) * I);
+            phase = fmod(phase + BENCH_FREQ, M_2PI);
+            samp = -samp;
+        }
+        best = fmin(best, Bench_Time() - start);
+    }
+
+    return best;
+}
+
+/*****************************************************************************/
+
+/* main()
+ *
+ * Times sin() and cos(), then each NCO of the Costas loop
+ */
+int main(void) {
+    cdsp_t check = 0.0;
+
+    printf("sin() and cos(): %6.2f ns per sample\n",
+            Bench_Sin_Cos(&check) / BENCH_SAMPLES * 1e9);
+    printf("cexp() NCO:      %6.2f ns per sample\n",
+            Bench_Costas(COSTAS_NCO_CEXP, &check) / BENCH_SAMPLES * 1e9);
+    printf("table NCO:       %6.2f ns per sample\n",
+            Bench_Costas(COSTAS_NCO_LUT, &check) / BENCH_SAMPLES * 1e9);
+
+    /* Keeps the outputs live */
+    printf("checksum %g\n", creal(check) + cimag(check));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,170 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Accuracy test of the table NCO of the Costas loop. Its phasors must
+ * be within TEST_AMPL_ERROR of unit magnitude and TEST_PHASE_ERROR of
+ * the phase of the accumulator, at phases spread over the circle and
+ * next to each table entry; and running free at a frequency, its phase
+ * must follow the cexp() NCO within the rounding of its step */
+
+#include "../src/common/common.h"
+#include "../src/demodulator/pll.h"
+
+#include <complex.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*****************************************************************************/
+
+/* Phases tested spread over the circle, by an odd step to
+ * hit all table intervals, and around each table entry */
+#define TEST_PHASES         (1 << 22)
+#define TEST_PHASE_STEP     0x9E3779B9u
+#define TEST_LUT_BITS       10
+#define TEST_LUT_LEN        (1u << TEST_LUT_BITS)
+#define TEST_NEAR_ENTRY     16
+
+/* Samples and frequencies, in rad per sample, the NCOs run at */
+#define TEST_RUN_SAMPLES    1000000
+#define TEST_FREQS          { 0.001, -0.0173, 0.31, -0.79 }
+
+/* Largest magnitude and phase errors of linear interpolation between
+ * unit phasors d = 2 Pi / 1024 apart: 1 - cos(d / 2), 4.7e-6, and
+ * d^3 sqrt(3) / 108, 3.7e-9 rad. The float build adds the rounding
+ * of its table and products */
+#ifdef GLRPT_FLOAT_DSP
+#define TEST_AMPL_ERROR     5e-6
+#define TEST_PHASE_ERROR    2e-7
+#else
+#define TEST_AMPL_ERROR     4.8e-6
+#define TEST_PHASE_ERROR    4e-9
+#endif
+
+/*****************************************************************************/
+
+static double Phasor_Error(Costas_t *nco, uint32_t acc, double *ampl);
+static bool Test_Phasors(void);
+static bool Test_Run(double freq);
+
+/*****************************************************************************/
+
+/* Phasor_Error()
+ *
+ * Phase error of the phasor of the table NCO at accumulator
+ * value acc against exp(-j*phase), and its magnitude error
+ */
+static double Phasor_Error(Costas_t *nco, uint32_t acc, double *ampl) {
+    complex double out, exact;
+
+    nco->nco_acc  = acc;
+    nco->nco_step = 0;
+    out   = Costas_Mix(nco, 1.0);
+    exact = cexp(-I * M_2PI * (double)acc / 4294967296.0);
+
+    *ampl = fabs(cabs(out) - 1.0);
+    return fabs(carg(out * conj(exact)));
+}
+
+/*****************************************************************************/
+
+/* Test_Phasors()
+ *
+ * Largest phase and magnitude errors of the phasors of the table
+ * NCO, at phases spread over the circle and next to table entries
+ */
+static bool Test_Phasors(void) {
+    Costas_t *nco = Costas_Init(0.01, QPSK, COSTAS_NCO_LUT);
+    double phase_err = 0.0, ampl_err = 0.0, ampl;
+    uint32_t acc = 0;
+    bool pass;
+
+    for (int n = 0; n < TEST_PHASES; n++, acc += TEST_PHASE_STEP) {
+        phase_err = fmax(phase_err, Phasor_Error(nco, acc, &ampl));
+        ampl_err  = fmax(ampl_err, ampl);
+    }
+
+    for (uint32_t e = 0; e < TEST_LUT_LEN; e++)
+        for (int d = -TEST_NEAR_ENTRY; d <= TEST_NEAR_ENTRY; d++) {
+            acc = (e << (32 - TEST_LUT_BITS)) + (uint32_t)d;
+            phase_err = fmax(phase_err, Phasor_Error(nco, acc, &ampl));
+            ampl_err  = fmax(ampl_err, ampl);
+        }
+
+    pass = (phase_err <= TEST_PHASE_ERROR) && (ampl_err <= TEST_AMPL_ERROR);
+    printf("  phasors: phase error %.2e rad, magnitude error %.2e: %s\n",
+            phase_err, ampl_err, pass ? "pass" : "FAIL");
+
+    Costas_Free(nco);
+
+    return pass;
+}
+
+/*****************************************************************************/
+
+/* Test_Run()
+ *
+ * Runs the table and cexp() NCOs free at a frequency, whose phases
+ * must stay within the rounding of the accumulator step, half a unit
+ * per sample, and the phase error of the phasors apart
+ */
+static bool Test_Run(double freq) {
+    Costas_t *lut = Costas_Init(0.01, QPSK, COSTAS_NCO_LUT);
+    Costas_t *ref = Costas_Init(0.01, QPSK, COSTAS_NCO_CEXP);
+    double err = 0.0, bound;
+    bool pass;
+
+    /* Set as Costas_Correct_Phase() does */
+    lut->nco_step = (int32_t)lrint(freq * 4294967296.0 / M_2PI);
+    ref->nco_freq = freq;
+
+    for (int n = 0; n < TEST_RUN_SAMPLES; n++) {
+        cdsp_t a = Costas_Mix(lut, 1.0);
+        cdsp_t b = Costas_Mix(ref, 1.0);
+
+        err = fmax(err, fabs(carg(a * conj(b))));
+    }
+
+    bound = TEST_RUN_SAMPLES * M_PI / 4294967296.0 + 2.0 * TEST_PHASE_ERROR;
+    pass = err <= bound;
+    printf("  free run at %+.4f rad: phase apart %.2e rad, bound %.2e: %s\n",
+            freq, err, bound, pass ? "pass" : "FAIL");
+
+    Costas_Free(lut);
+    Costas_Free(ref);
+
+    return pass;
+}
+
+/*****************************************************************************/
+
+/* main()
+ *
+ * Tests the phasors, then the free running NCO at each frequency
+ */
+int main(void) {
+    static const double freqs[] = TEST_FREQS;
+    bool ok = true;
+
+    printf("Table NCO:\n");
+    ok &= Test_Phasors();
+    for (size_t f = 0; f < sizeof(freqs) / sizeof(freqs[0]); f++)
+        ok &= Test_Run(freqs[f]);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,92 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Functions of utils.c called by the DSP and decoder sources, which
+ * the tests build without the GUI. Messages go to stderr as in
+ * headless mode, and the tests run single threaded */
+
+#include "../src/glrpt/utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*****************************************************************************/
+
+static int Flags = 0;
+
+/*****************************************************************************/
+
+void Show_Message(const char *mesg, const char *attr) {
+    (void)attr;
+
+    fprintf(stderr, "glrpt: %s\n", mesg);
+}
+
+/*****************************************************************************/
+
+void mem_alloc(void **ptr, size_t req) {
+    *ptr = calloc(1, req);
+    if (*ptr == NULL) {
+        perror("glrpt: A memory allocation request failed");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*****************************************************************************/
+
+void mem_realloc(void **ptr, size_t req) {
+    *ptr = realloc(*ptr, req);
+    if (*ptr == NULL) {
+        perror("glrpt: A memory allocation request failed");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*****************************************************************************/
+
+void free_ptr(void **ptr) {
+    free(*ptr);
+    *ptr = NULL;
+}
+
+/*****************************************************************************/
+
+void Cleanup(void) {
+}
+
+/*****************************************************************************/
+
+int isFlagSet(int flag) {
+    return Flags & flag;
+}
+
+/*****************************************************************************/
+
+int isFlagClear(int flag) {
+    return !(Flags & flag);
+}
+
+/*****************************************************************************/
+
+void SetFlag(int flag) {
+    Flags |= flag;
+}
+
+/*****************************************************************************/
+
+void ClearFlag(int flag) {
+    Flags &= ~flag;
+}
@@ -0,0 +1,201 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Synthetic Meteor-M2 frames for the tests: random data of RS(255,223)
+ * code words as of CCSDS, interleaved and randomized into CADUs, and
+ * their convolutionally encoded soft symbols with gaussian noise */
+
+#include "tx.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/*****************************************************************************/
+
+/* State of the random generator */
+static uint64_t rand_state;
+
+/* Galois field of the RS code, its generator polynomial
+ * and the pseudo random sequence of CADU data */
+static uint8_t gf_exp[2 * TX_RS_LEN], gf_log[TX_RS_LEN + 1];
+static uint8_t rs_gen[TX_RS_LEN - TX_RS_DATA_LEN + 1];
+static uint8_t pn_seq[TX_RS_LEN];
+
+/*****************************************************************************/
+
+/* Tx_Seed()
+ *
+ * Seeds the random generator, for the same data and noise on each run
+ */
+void Tx_Seed(uint64_t seed) {
+    rand_state = seed;
+}
+
+/*****************************************************************************/
+
+/* Tx_Rand()
+ *
+ * A xorshift64* random number
+ */
+uint32_t Tx_Rand(void) {
+    rand_state ^= rand_state >> 12;
+    rand_state ^= rand_state << 25;
+    rand_state ^= rand_state >> 27;
+
+    return (uint32_t)((rand_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+/*****************************************************************************/
+
+/* Tx_Gauss()
+ *
+ * A normally distributed random number of unit variance (Box-Muller)
+ */
+double Tx_Gauss(void) {
+    double u1 = ((double)Tx_Rand() + 1.0) / 4294967297.0;
+    double u2 = (double)Tx_Rand() / 4294967296.0;
+
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/*****************************************************************************/
+
+/* Tx_Init()
+ *
+ * Makes the tables of the RS code of CCSDS, conventional basis,
+ * and its pseudo random sequence, h(x) = x^8 + x^7 + x^5 + x^3 + 1
+ */
+void Tx_Init(void) {
+    uint32_t x = 1, sr = 0xff;
+
+    for (int i = 0; i < TX_RS_LEN; i++) {
+        gf_exp[i] = gf_exp[i + TX_RS_LEN] = (uint8_t)x;
+        gf_log[x] = (uint8_t)i;
+        x <<= 1;
+        if (x & 0x100)
+            x ^= 0x187;
+    }
+
+    /* Product of (x - a^(11 * (112 + i))), of coefficients of x^k */
+    memset(rs_gen, 0, sizeof(rs_gen));
+    rs_gen[0] = 1;
+    for (int i = 0; i < TX_RS_LEN - TX_RS_DATA_LEN; i++) {
+        uint8_t root = gf_exp[(112 + i) * 11 % TX_RS_LEN];
+
+        for (int k = TX_RS_LEN - TX_RS_DATA_LEN; k >= 0; k--) {
+            uint8_t prod = (rs_gen[k] && root) ?
+                gf_exp[gf_log[rs_gen[k]] + gf_log[root]] : 0;
+
+            rs_gen[k] = (uint8_t)(prod ^ (k ? rs_gen[k - 1] : 0));
+        }
+    }
+
+    for (int i = 0; i < TX_RS_LEN; i++) {
+        uint8_t b = 0;
+
+        for (int n = 0; n < 8; n++) {
+            b = (uint8_t)((b << 1) | (sr & 1));
+            sr = (sr >> 1) | (((sr ^ (sr >> 3) ^ (sr >> 5) ^ (sr >> 7)) & 1) << 7);
+        }
+
+        pn_seq[i] = b;
+    }
+}
+
+/*****************************************************************************/
+
+/* Tx_Rs_Encode()
+ *
+ * Appends the parity of TX_RS_DATA_LEN bytes of data in word
+ */
+void Tx_Rs_Encode(uint8_t *word) {
+    uint8_t rem[TX_RS_LEN - TX_RS_DATA_LEN] = { 0 };
+    const int npar = TX_RS_LEN - TX_RS_DATA_LEN;
+
+    for (int j = 0; j < TX_RS_DATA_LEN; j++) {
+        uint8_t fb = word[j] ^ rem[0];
+
+        memmove(rem, rem + 1, npar - 1);
+        rem[npar - 1] = 0;
+
+        if (fb)
+            for (int k = 0; k < npar; k++)
+                if (rs_gen[npar - 1 - k])
+                    rem[k] ^= gf_exp[gf_log[fb] + gf_log[rs_gen[npar - 1 - k]]];
+    }
+
+    memcpy(word + TX_RS_DATA_LEN, rem, npar);
+}
+
+/*****************************************************************************/
+
+/* Tx_Frame()
+ *
+ * Makes the CADU of frame num: random data, numbered in its first
+ * bytes, in 4 code words interleaved byte by byte into data, then
+ * randomized behind the sync word
+ */
+void Tx_Frame(int num, uint8_t *data, uint8_t *cadu) {
+    static const uint8_t sync[4] = { 0x1A, 0xCF, 0xFC, 0x1D };
+    uint8_t word[TX_RS_LEN];
+
+    for (int w = 0; w < 4; w++) {
+        for (int i = 0; i < TX_RS_DATA_LEN; i++)
+            word[i] = (uint8_t)Tx_Rand();
+        if (w < 2)
+            word[0] = (uint8_t)(num >> (8 * w));
+        Tx_Rs_Encode(word);
+
+        for (int i = 0; i < TX_RS_LEN; i++)
+            data[i * 4 + w] = word[i];
+    }
+
+    memcpy(cadu, sync, sizeof(sync));
+    for (int j = 0; j < TX_DATA_LEN; j++)
+        cadu[4 + j] = data[j] ^ pn_seq[j % TX_RS_LEN];
+}
+
+/*****************************************************************************/
+
+/* Tx_Encode()
+ *
+ * Convolutionally encodes a CADU into TX_CODE_LEN code bits, of
+ * polynomials A and B in turn. The encoder state sh runs on from
+ * the CADU before, so consecutive CADUs encode as a stream
+ */
+void Tx_Encode(const uint8_t *cadu, uint32_t *sh, uint8_t *code) {
+    for (int j = 0; j < TX_CADU_LEN * 8; j++) {
+        *sh = ((*sh << 1) | ((cadu[j / 8] >> (7 - j % 8)) & 1)) & 0x7F;
+        code[2 * j]     = (uint8_t)__builtin_parity(*sh & TX_POLYA);
+        code[2 * j + 1] = (uint8_t)__builtin_parity(*sh & TX_POLYB);
+    }
+}
+
+/*****************************************************************************/
+
+/* Tx_Soft()
+ *
+ * Soft symbols of len code bits as of the demodulator, bits 0/1
+ * as +amp/-amp, with gaussian noise of sigma, clipped to int8
+ */
+void Tx_Soft(const uint8_t *code, int len, double amp, double sigma, int8_t *soft) {
+    for (int n = 0; n < len; n++) {
+        double s = (code[n] ? -amp : amp) + sigma * Tx_Gauss();
+
+        soft[n] = (int8_t)lrint(fmax(-127.0, fmin(127.0, s)));
+    }
+}
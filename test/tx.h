@@ -0,0 +1,52 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+#ifndef TEST_TX_H
+#define TEST_TX_H
+
+/*****************************************************************************/
+
+#include <stdint.h>
+
+/*****************************************************************************/
+
+/* CADU of a frame: sync word and 4 interleaved RS(255,223) words */
+#define TX_CADU_LEN     1024
+#define TX_DATA_LEN     (TX_CADU_LEN - 4)
+#define TX_RS_LEN       255
+#define TX_RS_DATA_LEN  223
+
+/* Code bits of a CADU, two per data bit */
+#define TX_CODE_LEN     (2 * 8 * TX_CADU_LEN)
+
+/* Polynomials of the convolutional code, as in viterbi27.c */
+#define TX_POLYA        79
+#define TX_POLYB        109
+
+/*****************************************************************************/
+
+void Tx_Seed(uint64_t seed);
+uint32_t Tx_Rand(void);
+double Tx_Gauss(void);
+void Tx_Init(void);
+void Tx_Rs_Encode(uint8_t *word);
+void Tx_Frame(int num, uint8_t *data, uint8_t *cadu);
+void Tx_Encode(const uint8_t *cadu, uint32_t *sh, uint8_t *code);
+void Tx_Soft(const uint8_t *code, int len, double amp, double sigma, int8_t *soft);
+
+/*****************************************************************************/
+
+#endif
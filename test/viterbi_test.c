@@ -0,0 +1,151 @@
+/*
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License as
+ *  published by the Free Software Foundation; either version 3 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details:
+ *
+ *  http://www.gnu.org/copyleft/gpl.txt
+ */
+
+/*****************************************************************************/
+
+/* Test of the add-compare-select kernels of the Viterbi decoder of
+ * each SIMD level the CPU supports against the plain one. On the same
+ * frames of soft symbols, from noiseless to beyond decoding and noise
+ * alone, all must decode the same bytes and count the same errors */
+
+#include "../src/common/cpu.h"
+#include "../src/decoder/correlator.h"
+#include "../src/decoder/met_to_data.h"
+#include "../src/decoder/viterbi27.h"
+#include "../src/glrpt/utils.h"
+#include "tx.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*****************************************************************************/
+
+/* Frames at each noise level, amplitude of soft symbols, and
+ * noise levels: none, 2.5 dB Es/N0, 1.4 dB at the edge of
+ * decoding, -1.2 dB beyond it, and noise alone if amplitude 0 */
+#define TEST_FRAMES     24
+#define TEST_SOFT_AMP   48.0
+#define TEST_SIGMAS     { 0.0, 36.0, 41.0, 55.0, 48.0 }
+#define TEST_AMPS       { TEST_SOFT_AMP, TEST_SOFT_AMP, TEST_SOFT_AMP, \
+                          TEST_SOFT_AMP, 0.0 }
+#define TEST_LEVELS     5
+
+/*****************************************************************************/
+
+static void Tx_Frames(void);
+static void Decode_Frames(uint8_t *out, int *errors);
+
+/*****************************************************************************/
+
+/* Soft symbols of the frames, and the bytes decoded
+ * and errors counted by the plain kernel */
+static uint8_t soft[TEST_LEVELS * TEST_FRAMES][SOFT_FRAME_LEN];
+static uint8_t ref_out[TEST_LEVELS * TEST_FRAMES][HARD_FRAME_LEN];
+static int ref_errors[TEST_LEVELS * TEST_FRAMES];
+
+/*****************************************************************************/
+
+/* Tx_Frames()
+ *
+ * Soft symbols of frames encoded as a stream,
+ * at each noise level in turn, aligned to sync
+ */
+static void Tx_Frames(void) {
+    static const double sigmas[] = TEST_SIGMAS;
+    static const double amps[] = TEST_AMPS;
+    uint8_t data[TX_DATA_LEN], cadu[TX_CADU_LEN], code[TX_CODE_LEN];
+    uint32_t sh = 0;
+
+    Tx_Seed(0x853C49E6748FEA9BULL);
+    for (int l = 0; l < TEST_LEVELS; l++)
+        for (int f = 0; f < TEST_FRAMES; f++) {
+            Tx_Frame(f, data, cadu);
+            Tx_Encode(cadu, &sh, code);
+            Tx_Soft(code, TX_CODE_LEN, amps[l], sigmas[l],
+                    (int8_t *)soft[l * TEST_FRAMES + f]);
+        }
+}
+
+/*****************************************************************************/
+
+/* Decode_Frames()
+ *
+ * Decodes all frames with the kernel bound to the CPU
+ * features, into out and their error counts
+ */
+static void Decode_Frames(uint8_t *out, int *errors) {
+    static viterbi27_rec_t vit;
+
+    Mk_Viterbi27(&vit);
+    for (int f = 0; f < TEST_LEVELS * TEST_FRAMES; f++) {
+        Vit_Decode(&vit, soft[f], out + f * HARD_FRAME_LEN);
+        errors[f] = vit.BER;
+    }
+    free_ptr((void **)&vit.pair_distances);
+}
+
+/*****************************************************************************/
+
+/* main()
+ *
+ * Decodes the frames by the plain kernel, then
+ * by each SIMD level the CPU has a kernel of
+ */
+int main(void) {
+    static const double sigmas[] = TEST_SIGMAS;
+    static const double amps[] = TEST_AMPS;
+    static uint8_t out[TEST_LEVELS * TEST_FRAMES][HARD_FRAME_LEN];
+    static const uint8_t levels[] = { CPU_SIMD_SSE2, CPU_SIMD_AVX2 };
+    int errors[TEST_LEVELS * TEST_FRAMES];
+    uint8_t last = CPU_SIMD_NONE;
+    bool ok = true;
+
+    Init_Correlator_Tables();
+    Tx_Init();
+    Tx_Frames();
+
+    Cpu_Init(CPU_SIMD_NONE);
+    Decode_Frames(ref_out[0], ref_errors);
+
+    for (size_t l = 0; l < sizeof(levels); l++) {
+        Cpu_Init(levels[l]);
+        if (Cpu_Simd() == last)
+            continue;
+        last = Cpu_Simd();
+
+        printf("Viterbi kernel of SIMD level %s:\n", Cpu_Simd_Name(last));
+        Decode_Frames(out[0], errors);
+
+        for (int n = 0; n < TEST_LEVELS; n++) {
+            int bytes = 0, counts = 0, sum = 0;
+
+            for (int f = n * TEST_FRAMES; f < (n + 1) * TEST_FRAMES; f++) {
+                bytes  += memcmp(out[f], ref_out[f], HARD_FRAME_LEN) != 0;
+                counts += errors[f] != ref_errors[f];
+                sum    += ref_errors[f];
+            }
+
+            ok &= (bytes == 0) && (counts == 0);
+            printf("  amplitude %2.0f, noise %2.0f: %6d errors, %d frames "
+                    "decode otherwise, %d count otherwise: %s\n", amps[n],
+                    sigmas[n], sum, bytes, counts,
+                    (bytes == 0) && (counts == 0) ? "pass" : "FAIL");
+        }
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}